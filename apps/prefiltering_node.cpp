@@ -37,7 +37,19 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <s_graphs/msg/prefiltering_status.hpp>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "geometry_msgs/msg/transform_stamped.hpp"
 #include "pcl_conversions/pcl_conversions.h"
@@ -57,28 +69,92 @@ class PrefilteringNode : public rclcpp::Node {
 
   PrefilteringNode() : Node("prefiltering_node") {
     initialize_params();
+    on_set_parameters_handle = this->add_on_set_parameters_callback(
+        std::bind(&PrefilteringNode::on_set_parameters, this, std::placeholders::_1));
 
     tf_buffer = std::make_unique<tf2_ros::Buffer>(this->get_clock());
     tf_listener = std::make_shared<tf2_ros::TransformListener>(*tf_buffer);
 
+    // imu and point callbacks only fill the buffers, each group lets one of them run
+    // while the other is busy
+    callback_group_imu =
+        this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+    callback_group_points =
+        this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+
     if (this->get_parameter("deskewing").get_parameter_value().get<bool>()) {
+      rclcpp::SubscriptionOptions imu_opt;
+      imu_opt.callback_group = callback_group_imu;
       imu_sub = this->create_subscription<sensor_msgs::msg::Imu>(
           "imu/data",
           1,
-          std::bind(&PrefilteringNode::imu_callback, this, std::placeholders::_1));
+          std::bind(&PrefilteringNode::imu_callback, this, std::placeholders::_1),
+          imu_opt);
     }
 
+    rclcpp::SubscriptionOptions points_opt;
+    points_opt.callback_group = callback_group_points;
     points_sub = this->create_subscription<sensor_msgs::msg::PointCloud2>(
         "velodyne_points",
         64,
-        std::bind(&PrefilteringNode::cloud_callback, this, std::placeholders::_1));
+        std::bind(&PrefilteringNode::cloud_callback, this, std::placeholders::_1),
+        points_opt);
     points_pub =
         this->create_publisher<sensor_msgs::msg::PointCloud2>("filtered_points", 32);
     colored_pub =
         this->create_publisher<sensor_msgs::msg::PointCloud2>("colored_points", 32);
+    status_pub = this->create_publisher<s_graphs::msg::PrefilteringStatus>(
+        "prefiltering/status", 8);
+
+    stopping = false;
+    next_scan_seq = 0;
+    next_output_seq = 0;
+    dropped_scans = 0;
+    processed_scans = 0;
+
+    // every worker owns its filters, pcl filters keep their input and search state
+    workers.resize(std::max(1, num_workers));
+    for (auto& worker : workers) {
+      worker.downsample_filter = create_downsample_filter();
+      worker.outlier_removal_filter = create_outlier_removal_filter();
+      worker.thread = std::thread(&PrefilteringNode::worker_loop, this, &worker);
+    }
+  }
+
+  ~PrefilteringNode() {
+    {
+      std::lock_guard<std::mutex> lock(scan_queue_mutex);
+      stopping = true;
+    }
+    scan_queue_cv.notify_all();
+    for (auto& worker : workers) {
+      if (worker.thread.joinable()) worker.thread.join();
+    }
   }
 
  private:
+  struct ImuSample {
+    rclcpp::Time stamp;
+    Eigen::Vector3f angular_velocity;
+  };
+
+  struct ScanJob {
+    uint64_t seq;
+    sensor_msgs::msg::PointCloud2::SharedPtr msg;
+    std::chrono::steady_clock::time_point received;
+  };
+
+  struct PendingOutput {
+    std::chrono::steady_clock::time_point received;
+    pcl::PointCloud<PointT>::ConstPtr cloud;
+  };
+
+  struct Worker {
+    std::thread thread;
+    pcl::Filter<PointT>::Ptr downsample_filter;
+    pcl::Filter<PointT>::Ptr outlier_removal_filter;
+  };
+
   void initialize_params() {
     this->declare_parameter("deskewing", false);
     this->declare_parameter("downsample_method", "VOXELGRID");
@@ -93,28 +169,21 @@ class PrefilteringNode : public rclcpp::Node {
     this->declare_parameter("distance_far_thresh", 100.0);
     this->declare_parameter("base_link_frame", "");
     this->declare_parameter("scan_period", 0.1);
+    this->declare_parameter("num_workers", 2);
+    this->declare_parameter("scan_queue_size", 4);
 
-    std::string downsample_method = this->get_parameter("downsample_method")
-                                        .get_parameter_value()
-                                        .get<std::string>();
-    double downsample_resolution = this->get_parameter("downsample_resolution")
-                                       .get_parameter_value()
-                                       .get<double>();
+    downsample_method = this->get_parameter("downsample_method")
+                            .get_parameter_value()
+                            .get<std::string>();
+    downsample_resolution = this->get_parameter("downsample_resolution")
+                                .get_parameter_value()
+                                .get<double>();
 
     if (downsample_method == "VOXELGRID") {
       std::cout << "downsample: VOXELGRID " << downsample_resolution << std::endl;
-      boost::shared_ptr<pcl::VoxelGrid<PointT>> voxelgrid(new pcl::VoxelGrid<PointT>());
-      voxelgrid->setLeafSize(
-          downsample_resolution, downsample_resolution, downsample_resolution);
-      downsample_filter = voxelgrid;
     } else if (downsample_method == "APPROX_VOXELGRID") {
       std::cout << "downsample: APPROX_VOXELGRID " << downsample_resolution
                 << std::endl;
-      boost::shared_ptr<pcl::ApproximateVoxelGrid<PointT>> approx_voxelgrid(
-          new pcl::ApproximateVoxelGrid<PointT>());
-      approx_voxelgrid->setLeafSize(
-          downsample_resolution, downsample_resolution, downsample_resolution);
-      downsample_filter = approx_voxelgrid;
     } else {
       if (downsample_method != "NONE") {
         std::cerr << "warning: unknown downsampling type (" << downsample_method << ")"
@@ -124,36 +193,24 @@ class PrefilteringNode : public rclcpp::Node {
       std::cout << "downsample: NONE" << std::endl;
     }
 
-    std::string outlier_removal_method = this->get_parameter("outlier_removal_method")
-                                             .get_parameter_value()
-                                             .get<std::string>();
+    outlier_removal_method = this->get_parameter("outlier_removal_method")
+                                 .get_parameter_value()
+                                 .get<std::string>();
+    statistical_mean_k =
+        this->get_parameter("statistical_mean_k").get_parameter_value().get<int>();
+    statistical_stddev =
+        this->get_parameter("statistical_stddev").get_parameter_value().get<double>();
+    radius_radius =
+        this->get_parameter("radius_radius").get_parameter_value().get<double>();
+    radius_min_neighbors = this->get_parameter("radius_min_neighbors")
+                               .get_parameter_value()
+                               .get<double>();
     if (outlier_removal_method == "STATISTICAL") {
-      int mean_k =
-          this->get_parameter("statistical_mean_k").get_parameter_value().get<int>();
-      double stddev_mul_thresh =
-          this->get_parameter("statistical_stddev").get_parameter_value().get<double>();
-      std::cout << "outlier_removal: STATISTICAL " << mean_k << " - "
-                << stddev_mul_thresh << std::endl;
-
-      pcl::StatisticalOutlierRemoval<PointT>::Ptr sor(
-          new pcl::StatisticalOutlierRemoval<PointT>());
-      sor->setMeanK(mean_k);
-      sor->setStddevMulThresh(stddev_mul_thresh);
-      outlier_removal_filter = sor;
+      std::cout << "outlier_removal: STATISTICAL " << statistical_mean_k << " - "
+                << statistical_stddev << std::endl;
     } else if (outlier_removal_method == "RADIUS") {
-      double radius =
-          this->get_parameter("radius_radius").get_parameter_value().get<double>();
-      int min_neighbors = this->get_parameter("radius_min_neighbors")
-                              .get_parameter_value()
-                              .get<double>();
-      std::cout << "outlier_removal: RADIUS " << radius << " - " << min_neighbors
-                << std::endl;
-
-      pcl::RadiusOutlierRemoval<PointT>::Ptr rad(
-          new pcl::RadiusOutlierRemoval<PointT>());
-      rad->setRadiusSearch(radius);
-      rad->setMinNeighborsInRadius(min_neighbors);
-      outlier_removal_filter = rad;
+      std::cout << "outlier_removal: RADIUS " << radius_radius << " - "
+                << radius_min_neighbors << std::endl;
     } else {
       std::cout << "outlier_removal: NONE" << std::endl;
     }
@@ -165,6 +222,12 @@ class PrefilteringNode : public rclcpp::Node {
     distance_far_thresh =
         this->get_parameter("distance_far_thresh").get_parameter_value().get<double>();
 
+    scan_period =
+        this->get_parameter("scan_period").get_parameter_value().get<double>();
+    num_workers = this->get_parameter("num_workers").get_parameter_value().get<int>();
+    scan_queue_size =
+        this->get_parameter("scan_queue_size").get_parameter_value().get<int>();
+
     base_link_frame =
         this->get_parameter("base_link_frame").get_parameter_value().get<std::string>();
     std::string ns = this->get_namespace();
@@ -174,16 +237,198 @@ class PrefilteringNode : public rclcpp::Node {
     }
   }
 
+  /**
+   * @brief keeps the cached values of the parameters read per scan up to date, they
+   * are read by the workers without going through the parameter interface
+   * @param parameters
+   * @return always successful
+   */
+  rcl_interfaces::msg::SetParametersResult on_set_parameters(
+      const std::vector<rclcpp::Parameter>& parameters) {
+    for (const auto& parameter : parameters) {
+      if (parameter.get_name() == "distance_near_thresh") {
+        distance_near_thresh = parameter.as_double();
+      } else if (parameter.get_name() == "distance_far_thresh") {
+        distance_far_thresh = parameter.as_double();
+      } else if (parameter.get_name() == "scan_period") {
+        scan_period = parameter.as_double();
+      }
+    }
+
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    return result;
+  }
+
+  /**
+   * @brief looks up a transform between frames attached to the robot. Those are
+   * static, so the first successful lookup of a frame pair is cached
+   * @param target_frame
+   * @param source_frame
+   * @return transform from source_frame to target_frame
+   */
+  geometry_msgs::msg::TransformStamped lookup_static_transform(
+      const std::string& target_frame,
+      const std::string& source_frame) {
+    const auto frames = std::make_pair(target_frame, source_frame);
+    {
+      std::lock_guard<std::mutex> lock(static_transforms_mutex);
+      auto found = static_transforms.find(frames);
+      if (found != static_transforms.end()) {
+        return found->second;
+      }
+    }
+
+    geometry_msgs::msg::TransformStamped transform_msg =
+        tf_buffer->lookupTransform(target_frame, source_frame, tf2::TimePointZero);
+
+    std::lock_guard<std::mutex> lock(static_transforms_mutex);
+    static_transforms.emplace(frames, transform_msg);
+    return transform_msg;
+  }
+
+  pcl::Filter<PointT>::Ptr create_downsample_filter() const {
+    if (downsample_method == "VOXELGRID") {
+      boost::shared_ptr<pcl::VoxelGrid<PointT>> voxelgrid(new pcl::VoxelGrid<PointT>());
+      voxelgrid->setLeafSize(
+          downsample_resolution, downsample_resolution, downsample_resolution);
+      return voxelgrid;
+    } else if (downsample_method == "APPROX_VOXELGRID") {
+      boost::shared_ptr<pcl::ApproximateVoxelGrid<PointT>> approx_voxelgrid(
+          new pcl::ApproximateVoxelGrid<PointT>());
+      approx_voxelgrid->setLeafSize(
+          downsample_resolution, downsample_resolution, downsample_resolution);
+      return approx_voxelgrid;
+    }
+    return nullptr;
+  }
+
+  pcl::Filter<PointT>::Ptr create_outlier_removal_filter() const {
+    if (outlier_removal_method == "STATISTICAL") {
+      pcl::StatisticalOutlierRemoval<PointT>::Ptr sor(
+          new pcl::StatisticalOutlierRemoval<PointT>());
+      sor->setMeanK(statistical_mean_k);
+      sor->setStddevMulThresh(statistical_stddev);
+      return sor;
+    } else if (outlier_removal_method == "RADIUS") {
+      pcl::RadiusOutlierRemoval<PointT>::Ptr rad(
+          new pcl::RadiusOutlierRemoval<PointT>());
+      rad->setRadiusSearch(radius_radius);
+      rad->setMinNeighborsInRadius(static_cast<int>(radius_min_neighbors));
+      return rad;
+    }
+    return nullptr;
+  }
+
   void imu_callback(sensor_msgs::msg::Imu::SharedPtr imu_msg) {
-    imu_queue.push_back(imu_msg);
+    ImuSample sample{rclcpp::Time(imu_msg->header.stamp),
+                     Eigen::Vector3f(imu_msg->angular_velocity.x,
+                                     imu_msg->angular_velocity.y,
+                                     imu_msg->angular_velocity.z)};
+
+    std::lock_guard<std::mutex> lock(imu_queue_mutex);
+    imu_queue.push_back(sample);
+    while (imu_queue.size() > imu_queue_capacity) imu_queue.pop_front();
   }
 
+  /**
+   * @brief queues a scan for the workers. If they fall behind, the oldest queued
+   * scan is dropped so that the published clouds stay recent
+   * @param src_cloud_msg
+   */
   void cloud_callback(const sensor_msgs::msg::PointCloud2::SharedPtr src_cloud_msg) {
+    {
+      std::lock_guard<std::mutex> lock(scan_queue_mutex);
+      scan_queue.push_back(ScanJob{0, src_cloud_msg, std::chrono::steady_clock::now()});
+      if (static_cast<int>(scan_queue.size()) > std::max(1, scan_queue_size)) {
+        scan_queue.pop_front();
+        dropped_scans++;
+      }
+    }
+    scan_queue_cv.notify_one();
+  }
+
+  /**
+   * @brief takes scans from the queue and prefilters them. Scans are numbered when
+   * they are taken, so the dropped ones leave no gap in the output order
+   * @param worker
+   */
+  void worker_loop(Worker* worker) {
+    while (true) {
+      ScanJob job;
+      {
+        std::unique_lock<std::mutex> lock(scan_queue_mutex);
+        scan_queue_cv.wait(lock, [this] { return stopping || !scan_queue.empty(); });
+        if (stopping) {
+          return;
+        }
+        job = scan_queue.front();
+        scan_queue.pop_front();
+        job.seq = next_scan_seq++;
+      }
+
+      pcl::PointCloud<PointT>::ConstPtr filtered = prefilter(job.msg, *worker);
+      publish_in_order(job, filtered);
+    }
+  }
+
+  /**
+   * @brief publishes the prefiltered scans in the order they were taken from the
+   * queue. A scan that is done before its predecessors waits for them
+   * @param job
+   * @param filtered  prefiltered cloud, null if the scan was discarded
+   */
+  void publish_in_order(const ScanJob& job,
+                        const pcl::PointCloud<PointT>::ConstPtr& filtered) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    pending_outputs[job.seq] = PendingOutput{job.received, filtered};
+
+    while (true) {
+      auto next = pending_outputs.find(next_output_seq);
+      if (next == pending_outputs.end()) {
+        break;
+      }
+
+      if (next->second.cloud) {
+        sensor_msgs::msg::PointCloud2 filtered_msg;
+        pcl::toROSMsg(*next->second.cloud, filtered_msg);
+        points_pub->publish(filtered_msg);
+        processed_scans++;
+        publish_status(filtered_msg.header, next->second.received);
+      }
+      pending_outputs.erase(next);
+      next_output_seq++;
+    }
+  }
+
+  void publish_status(const std_msgs::msg::Header& header,
+                      const std::chrono::steady_clock::time_point& received) {
+    if (status_pub->get_subscription_count() == 0) {
+      return;
+    }
+
+    s_graphs::msg::PrefilteringStatus status;
+    status.header = header;
+    status.latency =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - received)
+            .count();
+    {
+      std::lock_guard<std::mutex> lock(scan_queue_mutex);
+      status.queued_scans = scan_queue.size();
+      status.dropped_scans = dropped_scans;
+    }
+    status.processed_scans = processed_scans;
+    status_pub->publish(status);
+  }
+
+  pcl::PointCloud<PointT>::ConstPtr prefilter(
+      const sensor_msgs::msg::PointCloud2::SharedPtr& src_cloud_msg,
+      const Worker& worker) {
     pcl::PointCloud<PointT>::Ptr src_cloud(new pcl::PointCloud<PointT>());
     pcl::fromROSMsg(*src_cloud_msg, *src_cloud);
 
     if (src_cloud->empty()) {
-      return;
+      return nullptr;
     }
 
     src_cloud = deskewing(src_cloud);
@@ -192,15 +437,15 @@ class PrefilteringNode : public rclcpp::Node {
     geometry_msgs::msg::TransformStamped transform_msg;
     if (!base_link_frame.empty()) {
       try {
-        transform_msg = tf_buffer->lookupTransform(
-            base_link_frame, src_cloud->header.frame_id, tf2::TimePointZero);
+        transform_msg =
+            lookup_static_transform(base_link_frame, src_cloud->header.frame_id);
       } catch (const tf2::TransformException& ex) {
         RCLCPP_INFO(this->get_logger(),
                     "Could not transform %s to %s: %s",
                     base_link_frame.c_str(),
                     src_cloud->header.frame_id.c_str(),
                     ex.what());
-        return;
+        return nullptr;
       }
 
       pcl::PointCloud<PointT>::Ptr transformed(new pcl::PointCloud<PointT>());
@@ -211,16 +456,14 @@ class PrefilteringNode : public rclcpp::Node {
     }
 
     pcl::PointCloud<PointT>::ConstPtr filtered = distance_filter(src_cloud);
-    filtered = downsample(filtered);
-    filtered = outlier_removal(filtered);
-
-    sensor_msgs::msg::PointCloud2 filtered_msg;
-    pcl::toROSMsg(*filtered, filtered_msg);
-    points_pub->publish(filtered_msg);
+    filtered = downsample(filtered, worker.downsample_filter);
+    filtered = outlier_removal(filtered, worker.outlier_removal_filter);
+    return filtered;
   }
 
   pcl::PointCloud<PointT>::ConstPtr downsample(
-      const pcl::PointCloud<PointT>::ConstPtr& cloud) const {
+      const pcl::PointCloud<PointT>::ConstPtr& cloud,
+      const pcl::Filter<PointT>::Ptr& downsample_filter) const {
     if (!downsample_filter) {
       return cloud;
     }
@@ -234,7 +477,8 @@ class PrefilteringNode : public rclcpp::Node {
   }
 
   pcl::PointCloud<PointT>::ConstPtr outlier_removal(
-      const pcl::PointCloud<PointT>::ConstPtr& cloud) const {
+      const pcl::PointCloud<PointT>::ConstPtr& cloud,
+      const pcl::Filter<PointT>::Ptr& outlier_removal_filter) const {
     if (!outlier_removal_filter) {
       return cloud;
     }
@@ -252,12 +496,14 @@ class PrefilteringNode : public rclcpp::Node {
     pcl::PointCloud<PointT>::Ptr filtered(new pcl::PointCloud<PointT>());
     filtered->reserve(cloud->size());
 
+    const double near_thresh = distance_near_thresh;
+    const double far_thresh = distance_far_thresh;
     std::copy_if(cloud->begin(),
                  cloud->end(),
                  std::back_inserter(filtered->points),
                  [&](const PointT& p) {
                    double d = p.getVector3fMap().norm();
-                   return d > distance_near_thresh && d < distance_far_thresh;
+                   return d > near_thresh && d < far_thresh;
                  });
 
     filtered->width = filtered->size();
@@ -271,8 +517,27 @@ class PrefilteringNode : public rclcpp::Node {
 
   pcl::PointCloud<PointT>::Ptr deskewing(const pcl::PointCloud<PointT>::Ptr& cloud) {
     rclcpp::Time stamp = pcl_conversions::fromPCL(cloud->header.stamp);
-    if (imu_queue.empty()) {
-      return cloud;
+
+    // the first imu sample after the scan, or the last one received. Samples are not
+    // consumed since workers may deskew scans out of order
+    Eigen::Vector3f ang_v;
+    {
+      std::lock_guard<std::mutex> lock(imu_queue_mutex);
+      if (imu_queue.empty()) {
+        return cloud;
+      }
+
+      auto loc = std::upper_bound(
+          imu_queue.begin(),
+          imu_queue.end(),
+          stamp,
+          [](const rclcpp::Time& stamp, const ImuSample& imu) {
+            return stamp < imu.stamp;
+          });
+      if (loc == imu_queue.end()) {
+        loc = std::prev(loc);
+      }
+      ang_v = -loc->angular_velocity;
     }
 
     // the color encodes the point number in the point sequence
@@ -298,24 +563,6 @@ class PrefilteringNode : public rclcpp::Node {
       colored_pub->publish(colored_msg);
     }
 
-    sensor_msgs::msg::Imu::SharedPtr imu_msg = imu_queue.front();
-
-    auto loc = imu_queue.begin();
-    for (; loc != imu_queue.end(); loc++) {
-      imu_msg = (*loc);
-
-      if (rclcpp::Time((*loc)->header.stamp) > stamp) {
-        break;
-      }
-    }
-
-    imu_queue.erase(imu_queue.begin(), loc);
-
-    Eigen::Vector3f ang_v(imu_msg->angular_velocity.x,
-                          imu_msg->angular_velocity.y,
-                          imu_msg->angular_velocity.z);
-    ang_v *= -1;
-
     pcl::PointCloud<PointT>::Ptr deskewed(new pcl::PointCloud<PointT>());
     deskewed->header = cloud->header;
     deskewed->is_dense = cloud->is_dense;
@@ -323,8 +570,7 @@ class PrefilteringNode : public rclcpp::Node {
     deskewed->height = cloud->height;
     deskewed->resize(cloud->size());
 
-    double scan_period =
-        this->get_parameter("scan_period").get_parameter_value().get<double>();
+    const double scan_period = this->scan_period;
     for (size_t i = 0; i < cloud->size(); i++) {
       const auto& pt = cloud->at(i);
 
@@ -344,31 +590,70 @@ class PrefilteringNode : public rclcpp::Node {
   }
 
  private:
+  rclcpp::CallbackGroup::SharedPtr callback_group_imu;
+  rclcpp::CallbackGroup::SharedPtr callback_group_points;
+
   rclcpp::Subscription<sensor_msgs::msg::Imu>::SharedPtr imu_sub;
-  std::vector<sensor_msgs::msg::Imu::SharedPtr> imu_queue;
+  static constexpr size_t imu_queue_capacity = 2000;
+  std::mutex imu_queue_mutex;
+  std::deque<ImuSample> imu_queue;
 
   rclcpp::Subscription<sensor_msgs::msg::PointCloud2>::SharedPtr points_sub;
   rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr points_pub;
   rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr colored_pub;
+  rclcpp::Publisher<s_graphs::msg::PrefilteringStatus>::SharedPtr status_pub;
 
   std::shared_ptr<tf2_ros::TransformListener> tf_listener{nullptr};
   std::unique_ptr<tf2_ros::Buffer> tf_buffer;
 
   std::string base_link_frame;
 
-  bool use_distance_filter;
-  double distance_near_thresh;
-  double distance_far_thresh;
+  std::mutex static_transforms_mutex;
+  std::map<std::pair<std::string, std::string>, geometry_msgs::msg::TransformStamped>
+      static_transforms;
 
-  pcl::Filter<PointT>::Ptr downsample_filter;
-  pcl::Filter<PointT>::Ptr outlier_removal_filter;
+  // parameters read per scan, updated by on_set_parameters
+  rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr
+      on_set_parameters_handle;
+  bool use_distance_filter;
+  std::atomic<double> distance_near_thresh;
+  std::atomic<double> distance_far_thresh;
+  std::atomic<double> scan_period;
+
+  std::string downsample_method;
+  double downsample_resolution;
+  std::string outlier_removal_method;
+  int statistical_mean_k;
+  double statistical_stddev;
+  double radius_radius;
+  double radius_min_neighbors;
+
+  // scan pipeline
+  int num_workers;
+  int scan_queue_size;
+  std::vector<Worker> workers;
+
+  std::mutex scan_queue_mutex;
+  std::condition_variable scan_queue_cv;
+  std::deque<ScanJob> scan_queue;
+  bool stopping;
+  uint64_t next_scan_seq;
+  uint64_t dropped_scans;
+
+  std::mutex output_mutex;
+  std::map<uint64_t, PendingOutput> pending_outputs;
+  uint64_t next_output_seq;
+  uint64_t processed_scans;
 };
 
 }  // namespace s_graphs
 
 int main(int argc, char* argv[]) {
   rclcpp::init(argc, argv);
-  rclcpp::spin(std::make_shared<s_graphs::PrefilteringNode>());
+  rclcpp::executors::MultiThreadedExecutor multi_executor;
+  auto node = std::make_shared<s_graphs::PrefilteringNode>();
+  multi_executor.add_node(node);
+  multi_executor.spin();
   rclcpp::shutdown();
   return 0;
 }
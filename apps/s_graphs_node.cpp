@@ -40,11 +40,14 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <boost/format.hpp>
 #include <boost/lockfree/spsc_queue.hpp>
 #include <boost/thread.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <ctime>
 #include <mutex>
 #include <s_graphs/backend/floor_mapper.hpp>
 #include <s_graphs/backend/gps_mapper.hpp>
 #include <s_graphs/backend/graph_slam.hpp>
+#include <s_graphs/backend/hierarchical_optimizer.hpp>
 #include <s_graphs/backend/imu_mapper.hpp>
 #include <s_graphs/backend/keyframe_mapper.hpp>
 #include <s_graphs/backend/loop_mapper.hpp>
@@ -57,6 +60,8 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <s_graphs/common/infinite_rooms.hpp>
 #include <s_graphs/common/information_matrix_calculator.hpp>
 #include <s_graphs/common/keyframe.hpp>
+#include <s_graphs/common/keyframe_index.hpp>
+#include <s_graphs/common/keyframe_state_store.hpp>
 #include <s_graphs/common/map_cloud_generator.hpp>
 #include <s_graphs/common/nmea_sentence_parser.hpp>
 #include <s_graphs/common/plane_utils.hpp>
@@ -65,11 +70,14 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <s_graphs/common/rooms.hpp>
 #include <s_graphs/common/ros_time_hash.hpp>
 #include <s_graphs/common/ros_utils.hpp>
+#include <s_graphs/common/tiled_map_cloud.hpp>
 #include <s_graphs/frontend/keyframe_updater.hpp>
 #include <s_graphs/frontend/loop_detector.hpp>
 #include <s_graphs/frontend/plane_analyzer.hpp>
 #include <s_graphs/visualization/graph_publisher.hpp>
 #include <s_graphs/visualization/graph_visualizer.hpp>
+#include <s_graphs/visualization/trajectory_buffer.hpp>
+#include <thread>
 #include <unordered_map>
 
 #include "geographic_msgs/msg/geo_point_stamped.hpp"
@@ -82,6 +90,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include "pcl_ros/transforms.hpp"
 #include "rclcpp/rclcpp.hpp"
 #include "s_graphs/msg/floor_coeffs.hpp"
+#include "s_graphs/msg/map_tiles.hpp"
 #include "s_graphs/msg/plane_data.hpp"
 #include "s_graphs/msg/planes_data.hpp"
 #include "s_graphs/msg/point_clouds.hpp"
@@ -97,6 +106,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include "sensor_msgs/msg/nav_sat_fix.hpp"
 #include "sensor_msgs/msg/point_cloud2.hpp"
 #include "std_msgs/msg/color_rgba.hpp"
+#include "std_msgs/msg/empty.hpp"
 #include "tf2_eigen/tf2_eigen.h"
 #include "tf2_geometry_msgs/tf2_geometry_msgs.h"
 #include "tf2_ros/buffer_interface.h"
@@ -128,13 +138,34 @@ class SGraphsNode : public rclcpp::Node {
 
     map_cloud_resolution =
         this->get_parameter("map_cloud_resolution").get_parameter_value().get<double>();
+    map_publish_time_budget = this->get_parameter("map_publish_time_budget")
+                                  .get_parameter_value()
+                                  .get<double>();
+    tiled_map_cloud = std::make_unique<TiledMapCloud>(
+        map_cloud_resolution,
+        this->get_parameter("map_tile_size").get_parameter_value().get<double>(),
+        this->get_parameter("map_tile_pose_tolerance")
+            .get_parameter_value()
+            .get<double>());
+    all_map_planes_lod_level = this->get_parameter("all_map_planes_lod_level")
+                                   .get_parameter_value()
+                                   .get<int>();
     wait_trans_odom2map =
         this->get_parameter("wait_trans_odom2map").get_parameter_value().get<bool>();
     use_map2map_transform =
         this->get_parameter("use_map2map_transform").get_parameter_value().get<bool>();
     got_trans_odom2map = false;
     trans_odom2map.setIdentity();
-    odom_path_vec.clear();
+    trajectory_buffer = std::make_unique<TrajectoryBuffer>(
+        this->get_parameter("odom_path_tail_size").get_parameter_value().get<int>(),
+        this->get_parameter("odom_path_max_size").get_parameter_value().get<int>(),
+        this->get_parameter("odom_path_min_distance")
+            .get_parameter_value()
+            .get<double>(),
+        this->get_parameter("odom_path_min_angle").get_parameter_value().get<double>(),
+        this->get_parameter("odom_path_full_interval")
+            .get_parameter_value()
+            .get<int>());
 
     max_keyframes_per_update = this->get_parameter("max_keyframes_per_update")
                                    .get_parameter_value()
@@ -244,6 +275,11 @@ class SGraphsNode : public rclcpp::Node {
         1,
         std::bind(&SGraphsNode::floor_data_callback, this, std::placeholders::_1),
         sub_opt);
+    graph_snapshot_sub = this->create_subscription<std_msgs::msg::Empty>(
+        "s_graphs/graph_snapshot_request",
+        1,
+        std::bind(&SGraphsNode::graph_snapshot_callback, this, std::placeholders::_1),
+        sub_opt);
 
     if (this->get_parameter("enable_gps").get_parameter_value().get<bool>()) {
       gps_sub = this->create_subscription<geographic_msgs::msg::GeoPointStamped>(
@@ -277,9 +313,13 @@ class SGraphsNode : public rclcpp::Node {
         "s_graphs/odom_pose_corrected", 10, pub_opt);
     odom_path_corrected_pub = this->create_publisher<nav_msgs::msg::Path>(
         "s_graphs/odom_path_corrected", 10, pub_opt);
+    odom_path_corrected_tail_pub = this->create_publisher<nav_msgs::msg::Path>(
+        "s_graphs/odom_path_corrected_tail", 10, pub_opt);
 
     map_points_pub = this->create_publisher<sensor_msgs::msg::PointCloud2>(
         "s_graphs/map_points", 1, pub_opt);
+    map_points_updates_pub = this->create_publisher<s_graphs::msg::MapTiles>(
+        "s_graphs/map_points_updates", 1, pub_opt);
     map_planes_pub = this->create_publisher<s_graphs::msg::PlanesData>(
         "s_graphs/map_planes", 1, pub_opt);
     all_map_planes_pub = this->create_publisher<s_graphs::msg::PlanesData>(
@@ -288,6 +328,8 @@ class SGraphsNode : public rclcpp::Node {
         "s_graphs/read_until", 32, pub_opt);
     graph_pub = this->create_publisher<reasoning_msgs::msg::Graph>(
         "s_graphs/graph_structure", 32, pub_opt);
+    graph_updates_pub = this->create_publisher<reasoning_msgs::msg::Graph>(
+        "s_graphs/graph_structure_updates", 32, pub_opt);
 
     dump_service_server = this->create_service<s_graphs::srv::DumpGraph>(
         "s_graphs/dump",
@@ -331,6 +373,8 @@ class SGraphsNode : public rclcpp::Node {
 
     if (optimization_type == "GLOBAL") {
       ongoing_optimization_class = optimization_class::GLOBAL;
+    } else if (optimization_type == "HIERARCHICAL") {
+      ongoing_optimization_class = optimization_class::HIERARCHICAL;
     } else {
       ongoing_optimization_class = optimization_class::GLOBAL_LOCAL;
     }
@@ -374,6 +418,23 @@ class SGraphsNode : public rclcpp::Node {
     this->declare_parameter("color_r", 0.0);
     this->declare_parameter("color_g", 0.0);
     this->declare_parameter("color_b", 0.0);
+    this->declare_parameter("marker_delta_threshold", 0.01);
+    this->declare_parameter("marker_full_refresh_ticks", 10);
+    this->declare_parameter("plane_lod_voxel_resolutions",
+                            std::vector<double>{0.05, 0.2, 0.5});
+    this->declare_parameter("plane_lod_near_distance", 10.0);
+    this->declare_parameter("plane_lod_far_distance", 40.0);
+    this->declare_parameter("plane_lod_point_budget", 200000);
+    this->declare_parameter("all_map_planes_lod_level", 0);
+    this->declare_parameter("graph_full_snapshot_ticks", 20);
+    this->declare_parameter("odom_path_tail_size", 200);
+    this->declare_parameter("odom_path_max_size", 20000);
+    this->declare_parameter("odom_path_min_distance", 0.2);
+    this->declare_parameter("odom_path_min_angle", 0.1);
+    this->declare_parameter("odom_path_full_interval", 100);
+    this->declare_parameter("map_publish_time_budget", 0.5);
+    this->declare_parameter("map_tile_size", 20.0);
+    this->declare_parameter("map_tile_pose_tolerance", 0.01);
     this->declare_parameter("save_timings", false);
 
     this->declare_parameter("max_keyframes_per_update", 10);
@@ -428,6 +489,11 @@ class SGraphsNode : public rclcpp::Node {
     this->declare_parameter("use_perpendicular_plane_constraint", false);
     this->declare_parameter("g2o_solver_num_iterations", 1024);
     this->declare_parameter("g2o_solver_type", "lm_var");
+    this->declare_parameter("g2o_solver_num_threads", 0);
+    this->declare_parameter("g2o_solver_block_ordering", true);
+    this->declare_parameter("optimization_time_budget", 0.0);
+    this->declare_parameter("optimization_intermediate_updates", false);
+    this->declare_parameter("optimization_intermediate_update_period", 0.2);
 
     this->declare_parameter("min_seg_points", 100);
     this->declare_parameter("min_horizontal_inliers", 500);
@@ -440,6 +506,7 @@ class SGraphsNode : public rclcpp::Node {
     this->declare_parameter("use_point_to_plane", false);
     this->declare_parameter("plane_information", 0.01);
     this->declare_parameter("plane_dist_threshold", 0.15);
+    this->declare_parameter("plane_maha_dist_threshold", 3.37);
     this->declare_parameter("plane_points_dist", 0.5);
     this->declare_parameter("min_plane_points", 100);
 
@@ -455,6 +522,8 @@ class SGraphsNode : public rclcpp::Node {
     this->declare_parameter("keyframe_timer_update_interval", 3.0);
     this->declare_parameter("map_cloud_update_interval", 3.0);
     this->declare_parameter("optimization_type", "GLOBAL");
+    this->declare_parameter("hierarchical_subproblem_iterations", 10);
+    this->declare_parameter("hierarchical_max_rounds", 5);
   }
 
   void init_subclass() {
@@ -464,6 +533,58 @@ class SGraphsNode : public rclcpp::Node {
     compressed_graph = std::make_unique<GraphSLAM>(
         this->get_parameter("g2o_solver_type").get_parameter_value().get<std::string>(),
         this->get_parameter("save_timings").get_parameter_value().get<bool>());
+    SolverConfig solver_config;
+    solver_config.solver_type =
+        this->get_parameter("g2o_solver_type").get_parameter_value().get<std::string>();
+    solver_config.num_threads =
+        this->get_parameter("g2o_solver_num_threads").get_parameter_value().get<int>();
+    solver_config.block_ordering = this->get_parameter("g2o_solver_block_ordering")
+                                       .get_parameter_value()
+                                       .get<bool>();
+    covisibility_graph->configure_solver(solver_config);
+    compressed_graph->configure_solver(solver_config);
+    RCLCPP_INFO(this->get_logger(),
+                "g2o parallel error/jacobian evaluation: %s",
+                GraphSLAM::solver_supports_threads() ? "enabled" : "not available");
+    compressed_graph->set_optimization_time_budget(
+        this->get_parameter("optimization_time_budget")
+            .get_parameter_value()
+            .get<double>());
+    if (this->get_parameter("optimization_intermediate_updates")
+            .get_parameter_value()
+            .get<bool>()) {
+      // publish improving iterates at most once per period, copying only the
+      // vertices that moved since the previous one
+      const double update_period =
+          this->get_parameter("optimization_intermediate_update_period")
+              .get_parameter_value()
+              .get<double>();
+      compressed_graph->set_iteration_callback([this, update_period](int, double) {
+        const auto now = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> elapsed = now - last_intermediate_update;
+        if (elapsed.count() < update_period) return;
+        last_intermediate_update = now;
+
+        std::vector<g2o::OptimizableGraph::Vertex*> changed_vertices;
+        for (const auto vertex : compressed_graph->graph->activeVertices()) {
+          if (!vertex->fixed() && compressed_graph->mark_vertex_changed(vertex->id()))
+            changed_vertices.push_back(vertex);
+        }
+        if (changed_vertices.empty()) return;
+
+        graph_mutex.lock();
+        GraphUtils::update_graph(changed_vertices,
+                                 covisibility_graph,
+                                 keyframes,
+                                 x_vert_planes,
+                                 y_vert_planes,
+                                 rooms_vec,
+                                 x_infinite_rooms,
+                                 y_infinite_rooms,
+                                 floors_vec);
+        graph_mutex.unlock();
+      });
+    }
     visualization_graph = std::make_unique<GraphSLAM>();
     keyframe_updater = std::make_unique<KeyframeUpdater>(shared_from_this());
     plane_analyzer = std::make_unique<PlaneAnalyzer>(shared_from_this());
@@ -480,13 +601,25 @@ class SGraphsNode : public rclcpp::Node {
     keyframe_mapper = std::make_unique<KeyframeMapper>(shared_from_this());
     gps_mapper = std::make_unique<GPSMapper>(shared_from_this());
     imu_mapper = std::make_unique<IMUMapper>(shared_from_this());
-    graph_publisher = std::make_unique<GraphPublisher>();
+    graph_publisher = std::make_unique<GraphPublisher>(shared_from_this());
     wall_mapper = std::make_unique<WallMapper>(shared_from_this());
     room_graph_generator = std::make_unique<RoomGraphGenerator>(shared_from_this());
+    hierarchical_optimizer =
+        std::make_unique<HierarchicalOptimizer>(shared_from_this());
 
+    map_publish_thread = std::thread(&SGraphsNode::map_publish_loop, this);
     main_timer->cancel();
   }
 
+  ~SGraphsNode() {
+    {
+      std::lock_guard<std::mutex> lock(map_publish_mutex);
+      map_publish_stop = true;
+    }
+    map_publish_cv.notify_one();
+    if (map_publish_thread.joinable()) map_publish_thread.join();
+  }
+
  private:
   /**
    * @brief receive the raw odom msg to publish the corrected odom after s
@@ -496,15 +629,13 @@ class SGraphsNode : public rclcpp::Node {
     Eigen::Isometry3d odom = odom2isometry(odom_msg);
     geometry_msgs::msg::TransformStamped odom2map_transform;
     Eigen::Isometry3d map2map_trans(trans_map2map.cast<double>());
-    Eigen::Matrix4f odom_corrected;
+    Eigen::Isometry3d odom_pose = odom;
     if (use_map2map_transform) {
-      Eigen::Isometry3d odom_trans = map2map_trans * odom;
-      odom_corrected = trans_odom2map * odom_trans.matrix().cast<float>();
-    } else {
-      odom_corrected = trans_odom2map * odom.matrix().cast<float>();
+      odom_pose = map2map_trans * odom;
     }
     geometry_msgs::msg::PoseStamped pose_stamped_corrected =
-        matrix2PoseStamped(odom_msg->header.stamp, odom_corrected, map_frame_id);
+        trajectory_buffer->add_pose(
+            odom_msg->header.stamp, odom_pose, trans_odom2map, map_frame_id);
     publish_corrected_odom(pose_stamped_corrected);
 
     // this is dirty but temp solution for no /clock topic in ros2
@@ -626,6 +757,8 @@ class SGraphsNode : public rclcpp::Node {
       return;
     }
 
+    const size_t num_rooms =
+        rooms_vec.size() + x_infinite_rooms.size() + y_infinite_rooms.size();
     for (const auto& room_data_msg : room_data_queue) {
       for (const auto& room_data : room_data_msg.rooms) {
         if (room_data.x_planes.size() == 2 && room_data.y_planes.size() == 2) {
@@ -701,6 +834,11 @@ class SGraphsNode : public rclcpp::Node {
       room_data_queue.pop_front();
       room_data_queue_mutex.unlock();
     }
+
+    // a running optimization is stopped so that the next one includes the new rooms
+    if (rooms_vec.size() + x_infinite_rooms.size() + y_infinite_rooms.size() >
+        num_rooms)
+      compressed_graph->request_preemption();
   }
 
   /**
@@ -959,11 +1097,15 @@ class SGraphsNode : public rclcpp::Node {
     flush_floor_data_queue();
 
     // loop detection
+    graph_mutex.lock();
+    keyframe_store.sync(*covisibility_graph);
+    graph_mutex.unlock();
     std::vector<Loop::Ptr> loops =
-        loop_detector->detect(keyframes, new_keyframes, *covisibility_graph);
+        loop_detector->detect(keyframe_store, new_keyframes, *covisibility_graph);
     if (loops.size() > 0) {
       loop_found = true;
       loop_mapper->add_loops(covisibility_graph, loops, graph_mutex);
+      compressed_graph->request_preemption();
     }
 
     graph_mutex.lock();
@@ -971,6 +1113,10 @@ class SGraphsNode : public rclcpp::Node {
                    new_keyframes.end(),
                    std::inserter(keyframes, keyframes.end()),
                    [](const KeyFrame::Ptr& k) { return std::make_pair(k->id(), k); });
+    for (const auto& new_keyframe : new_keyframes) {
+      keyframe_index.insert(new_keyframe);
+      keyframe_store.insert(new_keyframe);
+    }
 
     new_keyframes.clear();
     graph_mutex.unlock();
@@ -985,13 +1131,10 @@ class SGraphsNode : public rclcpp::Node {
       anchor_node->setEstimate(anchor_target);
     }
 
-    std::vector<KeyFrameSnapshot::Ptr> snapshot(keyframes.size());
-    std::transform(keyframes.begin(),
-                   keyframes.end(),
-                   snapshot.begin(),
-                   [=](const std::pair<int, KeyFrame::Ptr>& k) {
-                     return std::make_shared<KeyFrameSnapshot>(k.second);
-                   });
+    graph_mutex.lock();
+    keyframe_store.sync(*covisibility_graph);
+    std::vector<KeyFrameSnapshot::Ptr> snapshot = keyframe_store.create_snapshots();
+    graph_mutex.unlock();
     keyframes_snapshot.swap(snapshot);
 
     for (const auto& keyframe_snapshot : keyframes_snapshot) {
@@ -1083,6 +1226,7 @@ class SGraphsNode : public rclcpp::Node {
 
     graph_mutex.lock();
     const int keyframe_id = keyframes.rbegin()->first;
+    const int keyframe_vertex_id = keyframes.rbegin()->second->node->id();
     graph_mutex.unlock();
 
     switch (ongoing_optimization_class) {
@@ -1119,16 +1263,35 @@ class SGraphsNode : public rclcpp::Node {
         graph_mutex.unlock();
         break;
       }
+
+      case optimization_class::HIERARCHICAL: {
+        graph_mutex.lock();
+        GraphUtils::copy_graph(covisibility_graph, compressed_graph, keyframes);
+        global_optimization = true;
+        graph_mutex.unlock();
+        break;
+      }
       default:
         break;
     }
 
     // optimize the pose graph
     try {
-      if (!global_optimization)
-        compressed_graph->optimize("local", num_iterations);
+      int iterations;
+      if (ongoing_optimization_class == optimization_class::HIERARCHICAL)
+        iterations =
+            hierarchical_optimizer->optimize(compressed_graph.get(), num_iterations);
+      else if (!global_optimization)
+        iterations = compressed_graph->optimize("local", num_iterations);
       else {
-        compressed_graph->optimize("global", num_iterations);
+        iterations = compressed_graph->optimize("global", num_iterations);
+      }
+      if (!constant_covariance && iterations > 0) {
+        // the hierarchical levels end on a solve with the landmarks held fixed, the
+        // marginals need the system of the whole graph
+        if (ongoing_optimization_class == optimization_class::HIERARCHICAL)
+          compressed_graph->build_full_system();
+        compressed_graph->update_landmark_marginals({keyframe_vertex_id});
       }
     } catch (std::invalid_argument& e) {
       std::cout << e.what() << std::endl;
@@ -1137,6 +1300,7 @@ class SGraphsNode : public rclcpp::Node {
 
     graph_mutex.lock();
     GraphUtils::update_graph(compressed_graph,
+                             covisibility_graph,
                              keyframes,
                              x_vert_planes,
                              y_vert_planes,
@@ -1144,6 +1308,7 @@ class SGraphsNode : public rclcpp::Node {
                              x_infinite_rooms,
                              y_infinite_rooms,
                              floors_vec);
+    if (!constant_covariance) update_plane_covariances(keyframe_vertex_id);
 
     Eigen::Isometry3d trans = keyframes[keyframe_id]->node->estimate() *
                               keyframes[keyframe_id]->odom.inverse();
@@ -1155,6 +1320,8 @@ class SGraphsNode : public rclcpp::Node {
                          map_frame_id,
                          odom_frame_id);
     odom2map_pub->publish(ts);
+    keyframe_store.sync(*covisibility_graph);
+    trajectory_buffer->reanchor(keyframe_index);
     graph_mutex.unlock();
 
     trans_odom2map_mutex.lock();
@@ -1201,10 +1368,65 @@ class SGraphsNode : public rclcpp::Node {
   }
 
   /**
-   * @brief generate map point cloud and publish it
+   * @brief copy the plane marginals recovered at the last solve into the mapped
+   * planes, so that the data association gates against them. Planes without a
+   * marginal keep their previous covariance. The marginal of the latest keyframe is
+   * handed to the plane mapper to propagate into the next detections.
+   * @param keyframe_vertex_id
+   */
+  void update_plane_covariances(const int keyframe_vertex_id) {
+    auto update = [this](auto& planes) {
+      for (auto& plane : planes) {
+        const LandmarkMarginal* marginal =
+            compressed_graph->get_landmark_marginal(plane.second.id);
+        if (marginal == nullptr || marginal->covariance.rows() != 3) continue;
+        plane.second.covariance = marginal->covariance;
+      }
+    };
+    update(x_vert_planes);
+    update(y_vert_planes);
+    update(hort_planes);
+
+    const LandmarkMarginal* pose_marginal =
+        compressed_graph->get_landmark_marginal(keyframe_vertex_id);
+    if (pose_marginal != nullptr && pose_marginal->covariance.rows() == 6)
+      plane_mapper->set_keyframe_pose_covariance(pose_marginal->covariance);
+  }
+
+  /**
+   * @brief wake up the map publishing thread. Requests arriving while it is still
+   * busy are merged, so the publishing rate adapts to the cost of a cycle.
    * @param event
    */
   void map_publish_timer_callback() {
+    {
+      std::lock_guard<std::mutex> lock(map_publish_mutex);
+      map_publish_requested = true;
+    }
+    map_publish_cv.notify_one();
+  }
+
+  /**
+   * @brief map publishing thread, runs publish_map for every request
+   */
+  void map_publish_loop() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(map_publish_mutex);
+        map_publish_cv.wait(
+            lock, [this] { return map_publish_requested || map_publish_stop; });
+        if (map_publish_stop) return;
+        map_publish_requested = false;
+      }
+      publish_map();
+    }
+  }
+
+  /**
+   * @brief update the map tiles within the time budget and publish the map point
+   * cloud, the rebuilt tiles and the markers
+   */
+  void publish_map() {
     if (map_points_pub->get_subscription_count() < 0 || !graph_updated) {
       return;
     }
@@ -1225,18 +1447,28 @@ class SGraphsNode : public rclcpp::Node {
       current_loop++;
     }
 
-    auto cloud =
-        map_cloud_generator->generate(current_keyframes_snapshot, map_cloud_resolution);
-    if (!cloud) {
+    if (current_keyframes_snapshot.empty()) {
       return;
     }
 
+    // the keyframes left over by the time budget are picked up by the next cycle
+    tiled_map_cloud->update(current_keyframes_snapshot, map_publish_time_budget);
+    auto cloud = tiled_map_cloud->get_map();
     cloud->header.frame_id = map_frame_id;
     cloud->header.stamp = current_keyframes_snapshot.back()->cloud->header.stamp;
+    pcl::toROSMsg(*cloud, map_cloud_msg);
 
-    sensor_msgs::msg::PointCloud2::SharedPtr cloud_msg(
-        new sensor_msgs::msg::PointCloud2());
-    pcl::toROSMsg(*cloud, *cloud_msg);
+    // every rebuilt tile replaces the previous one, erased tiles come empty
+    auto updated_tiles = tiled_map_cloud->get_updated_tiles();
+    map_updates_msg.header = map_cloud_msg.header;
+    map_updates_msg.tiles.resize(updated_tiles.size());
+    for (size_t i = 0; i < updated_tiles.size(); i++) {
+      auto& tile_msg = map_updates_msg.tiles[i];
+      tile_msg.x = updated_tiles[i].first.first;
+      tile_msg.y = updated_tiles[i].first.second;
+      updated_tiles[i].second->header = cloud->header;
+      pcl::toROSMsg(*updated_tiles[i].second, tile_msg.cloud);
+    }
 
     auto current_time = this->now();
     auto markers = graph_visualizer->create_marker_array(
@@ -1262,12 +1494,14 @@ class SGraphsNode : public rclcpp::Node {
 
     markers_pub->publish(markers);
     publish_all_mapped_planes(x_planes_snapshot, y_planes_snapshot);
-    map_points_pub->publish(*cloud_msg);
+    map_points_pub->publish(map_cloud_msg);
+    if (!updated_tiles.empty()) map_points_updates_pub->publish(map_updates_msg);
     publish_graph();
   }
 
   /**
-   * @brief generate graph structure and publish it
+   * @brief generate graph structure and publish it. Full snapshots go to
+   * graph_structure, the diffs in between to graph_structure_updates.
    * @param event
    */
   void publish_graph() {
@@ -1277,19 +1511,30 @@ class SGraphsNode : public rclcpp::Node {
     } else {
       graph_type = "Online";
     }
-    auto graph_structure =
-        graph_publisher->publish_graph(covisibility_graph->graph.get(),
-                                       "Online",
-                                       x_vert_planes_prior,
-                                       y_vert_planes_prior,
-                                       rooms_vec_prior,
-                                       x_planes_snapshot,
-                                       y_planes_snapshot,
-                                       rooms_vec_snapshot,
-                                       x_inf_rooms_snapshot,
-                                       y_inf_rooms_snapshot);
+    reasoning_msgs::msg::Graph graph_structure;
+    bool full_snapshot = graph_publisher->publish_graph_update(covisibility_graph,
+                                                               "Online",
+                                                               x_vert_planes_prior,
+                                                               y_vert_planes_prior,
+                                                               rooms_vec_prior,
+                                                               x_planes_snapshot,
+                                                               y_planes_snapshot,
+                                                               rooms_vec_snapshot,
+                                                               graph_structure);
     graph_structure.name = graph_type;
-    graph_pub->publish(graph_structure);
+    if (full_snapshot) {
+      graph_pub->publish(graph_structure);
+    } else if (!graph_structure.nodes.empty() || !graph_structure.edges.empty()) {
+      graph_updates_pub->publish(graph_structure);
+    }
+  }
+
+  /**
+   * @brief request a full snapshot of the graph structure on the next publish
+   * @param msg
+   */
+  void graph_snapshot_callback(const std_msgs::msg::Empty::SharedPtr msg) {
+    if (graph_publisher) graph_publisher->request_full_snapshot();
   }
 
   /**
@@ -1404,7 +1649,10 @@ class SGraphsNode : public rclcpp::Node {
       } else {
         plane_data.data_source = "Online";
       }
-      for (const auto& plane_point_data : (x_vert_plane).cloud_seg_map->points) {
+      auto plane_points = get_all_map_plane_points(
+          PlaneUtils::plane_class::X_VERT_PLANE, x_vert_plane);
+      plane_data.plane_points.reserve(plane_points->size());
+      for (const auto& plane_point_data : plane_points->points) {
         geometry_msgs::msg::Vector3 plane_point;
         plane_point.x = plane_point_data.x;
         plane_point.y = plane_point_data.y;
@@ -1430,7 +1678,10 @@ class SGraphsNode : public rclcpp::Node {
       } else {
         plane_data.data_source = "Online";
       }
-      for (const auto& plane_point_data : (y_vert_plane).cloud_seg_map->points) {
+      auto plane_points = get_all_map_plane_points(
+          PlaneUtils::plane_class::Y_VERT_PLANE, y_vert_plane);
+      plane_data.plane_points.reserve(plane_points->size());
+      for (const auto& plane_point_data : plane_points->points) {
         geometry_msgs::msg::Vector3 plane_point;
         plane_point.x = plane_point_data.x;
         plane_point.y = plane_point_data.y;
@@ -1443,16 +1694,33 @@ class SGraphsNode : public rclcpp::Node {
   }
 
   /**
-   * @brief publish odom corrected pose and path
+   * @brief points of the plane sent on the all_map_planes topic, decimated to the
+   * configured level of detail when available
+   *
    */
-  void publish_corrected_odom(geometry_msgs::msg::PoseStamped pose_stamped_corrected) {
-    nav_msgs::msg::Path path_stamped_corrected;
-    path_stamped_corrected.header = pose_stamped_corrected.header;
-    odom_path_vec.push_back(pose_stamped_corrected);
-    path_stamped_corrected.poses = odom_path_vec;
+  pcl::PointCloud<PointNormal>::ConstPtr get_all_map_plane_points(
+      const int plane_type, const VerticalPlanes& plane) {
+    const PlaneLOD& plane_lod = graph_visualizer->get_plane_lod();
+    if (all_map_planes_lod_level >= 0 &&
+        all_map_planes_lod_level < plane_lod.get_outline_level()) {
+      const PlaneGeometryLOD* plane_geometry = plane_lod.find(plane_type, plane.id);
+      if (plane_geometry && plane_geometry->is_current(plane))
+        return plane_geometry->voxel_levels[all_map_planes_lod_level];
+    }
+    return plane.cloud_seg_map;
+  }
 
+  /**
+   * @brief publish odom corrected pose and the tail of the path, the whole decimated
+   * path is only published every few poses or after an optimization
+   */
+  void publish_corrected_odom(
+      const geometry_msgs::msg::PoseStamped& pose_stamped_corrected) {
     odom_pose_corrected_pub->publish(pose_stamped_corrected);
-    odom_path_corrected_pub->publish(path_stamped_corrected);
+    odom_path_corrected_tail_pub->publish(trajectory_buffer->get_tail());
+    if (trajectory_buffer->is_full_path_due()) {
+      odom_path_corrected_pub->publish(trajectory_buffer->get_path());
+    }
   }
 
   /**
@@ -1606,13 +1874,15 @@ class SGraphsNode : public rclcpp::Node {
 
       Eigen::Isometry3d relative_pose =
           next_keyframe->odom.inverse() * prev_keyframe->odom;
-      Eigen::MatrixXd information = inf_calclator->calc_information_matrix(
+      InformationMatrix<6> information = inf_calclator->calc_information_matrix(
           next_keyframe->cloud, prev_keyframe->cloud, relative_pose);
       auto edge = covisibility_graph->add_se3_edge(
           next_keyframe->node, prev_keyframe->node, relative_pose, information);
       covisibility_graph->add_robust_kernel(edge, "Huber", 1.0);
     }
     keyframes = loaded_keyframes;
+    keyframe_index.rebuild(keyframes);
+    keyframe_store.rebuild(keyframes);
     std::cout << " loaded keyframes size : " << keyframes.size() << std::endl;
 
     for (const auto& directoryPath : keyframe_directories) {
@@ -1654,7 +1924,7 @@ class SGraphsNode : public rclcpp::Node {
     for (auto& y_vert_plane : y_vert_planes) {
       Eigen::Matrix3d plane_information_mat =
           Eigen::Matrix3d::Identity() * plane_information;
-      plane_information_mat(3, 3) = plane_information_mat(3, 3) / 10;
+      plane_information_mat(2, 2) = plane_information_mat(2, 2) / 10;
 
       assert(y_vert_plane.second.cloud_seg_body_vec.size() ==
              y_vert_plane.second.keyframe_node_vec.size());
@@ -1680,7 +1950,7 @@ class SGraphsNode : public rclcpp::Node {
     for (auto& x_vert_plane : x_vert_planes) {
       Eigen::Matrix3d plane_information_mat =
           Eigen::Matrix3d::Identity() * plane_information;
-      plane_information_mat(3, 3) = plane_information_mat(3, 3) / 10;
+      plane_information_mat(2, 2) = plane_information_mat(2, 2) / 10;
 
       assert(x_vert_plane.second.cloud_seg_body_vec.size() ==
              x_vert_plane.second.keyframe_node_vec.size());
@@ -1765,6 +2035,7 @@ class SGraphsNode : public rclcpp::Node {
   rclcpp::Subscription<s_graphs::msg::RoomsData>::SharedPtr room_data_sub;
   rclcpp::Subscription<s_graphs::msg::WallsData>::SharedPtr wall_data_sub;
   rclcpp::Subscription<s_graphs::msg::RoomData>::SharedPtr floor_data_sub;
+  rclcpp::Subscription<std_msgs::msg::Empty>::SharedPtr graph_snapshot_sub;
   rclcpp::Subscription<sensor_msgs::msg::PointCloud2>::SharedPtr point_cloud_sub;
   rclcpp::Subscription<geometry_msgs::msg::PoseStamped>::SharedPtr init_odom2map_sub,
       map_2map_transform_sub;
@@ -1772,7 +2043,7 @@ class SGraphsNode : public rclcpp::Node {
   std::mutex trans_odom2map_mutex;
   Eigen::Matrix4f trans_odom2map, trans_map2map;
   bool wait_trans_odom2map, got_trans_odom2map, use_map2map_transform;
-  std::vector<geometry_msgs::msg::PoseStamped> odom_path_vec;
+  std::unique_ptr<TrajectoryBuffer> trajectory_buffer;
   std::string map_frame_id;
   std::string odom_frame_id;
   std::string points_topic;
@@ -1781,11 +2052,14 @@ class SGraphsNode : public rclcpp::Node {
   rclcpp::Publisher<geometry_msgs::msg::TransformStamped>::SharedPtr odom2map_pub;
   rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr odom_pose_corrected_pub;
   rclcpp::Publisher<nav_msgs::msg::Path>::SharedPtr odom_path_corrected_pub;
+  rclcpp::Publisher<nav_msgs::msg::Path>::SharedPtr odom_path_corrected_tail_pub;
   rclcpp::Publisher<std_msgs::msg::Header>::SharedPtr read_until_pub;
   rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr map_points_pub;
+  rclcpp::Publisher<s_graphs::msg::MapTiles>::SharedPtr map_points_updates_pub;
   rclcpp::Publisher<s_graphs::msg::PlanesData>::SharedPtr map_planes_pub;
   rclcpp::Publisher<s_graphs::msg::PlanesData>::SharedPtr all_map_planes_pub;
   rclcpp::Publisher<reasoning_msgs::msg::Graph>::SharedPtr graph_pub;
+  rclcpp::Publisher<reasoning_msgs::msg::Graph>::SharedPtr graph_updates_pub;
 
   std::shared_ptr<tf2_ros::TransformListener> tf_listener{nullptr};
   std::unique_ptr<tf2_ros::Buffer> tf_buffer;
@@ -1832,6 +2106,7 @@ class SGraphsNode : public rclcpp::Node {
   int keyframe_window_size;
   bool extract_planar_surfaces;
   bool constant_covariance;
+  std::chrono::steady_clock::time_point last_intermediate_update;
   double min_plane_points;
   double infinite_room_information;
   double room_information, plane_information;
@@ -1839,6 +2114,7 @@ class SGraphsNode : public rclcpp::Node {
   enum optimization_class : uint8_t {
     GLOBAL = 1,
     GLOBAL_LOCAL = 2,
+    HIERARCHICAL = 3,
   } ongoing_optimization_class;
 
   // vertical and horizontal planes
@@ -1870,9 +2146,21 @@ class SGraphsNode : public rclcpp::Node {
   // for map cloud generation
   std::atomic_bool graph_updated;
   double map_cloud_resolution;
+  int all_map_planes_lod_level;
   std::vector<KeyFrameSnapshot::Ptr> keyframes_snapshot;
   std::unique_ptr<MapCloudGenerator> map_cloud_generator;
 
+  // map publishing thread woken up by map_publish_timer
+  double map_publish_time_budget;
+  std::unique_ptr<TiledMapCloud> tiled_map_cloud;
+  sensor_msgs::msg::PointCloud2 map_cloud_msg;
+  s_graphs::msg::MapTiles map_updates_msg;
+  std::thread map_publish_thread;
+  std::mutex map_publish_mutex;
+  std::condition_variable map_publish_cv;
+  bool map_publish_requested = false;
+  bool map_publish_stop = false;
+
   boost::lockfree::spsc_queue<KeyFrameSnapshot::Ptr> keyframes_snapshot_queue{1000};
   boost::lockfree::spsc_queue<KeyFrame::Ptr> complete_keyframes_queue{1000};
   std::vector<KeyFrame::Ptr> current_keyframes;
@@ -1885,6 +2173,8 @@ class SGraphsNode : public rclcpp::Node {
   g2o::VertexSE3* anchor_node;
   g2o::EdgeSE3* anchor_edge;
   std::map<int, KeyFrame::Ptr> keyframes;
+  KeyFrameIndex keyframe_index;  // keyframes sorted by stamp
+  KeyFrameStateStore keyframe_store;  // contiguous keyframe poses for bulk queries
   std::unordered_map<rclcpp::Time, KeyFrame::Ptr, RosTimeHash> keyframe_hash;
 
   std::shared_ptr<GraphSLAM> covisibility_graph;
@@ -1901,6 +2191,7 @@ class SGraphsNode : public rclcpp::Node {
   std::unique_ptr<InfiniteRoomMapper> inf_room_mapper;
   std::unique_ptr<FiniteRoomMapper> finite_room_mapper;
   std::unique_ptr<FloorMapper> floor_mapper;
+  std::unique_ptr<HierarchicalOptimizer> hierarchical_optimizer;
   std::unique_ptr<GraphVisualizer> graph_visualizer;
   std::unique_ptr<KeyframeMapper> keyframe_mapper;
   std::unique_ptr<GPSMapper> gps_mapper;
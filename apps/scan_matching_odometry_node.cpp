@@ -33,6 +33,9 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <pcl/filters/passthrough.h>
 #include <pcl/filters/voxel_grid.h>
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <s_graphs/common/ros_utils.hpp>
@@ -65,7 +68,16 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
 
     this->declare_parameter("enable_robot_odometry_init_guess", false);
     this->declare_parameter("enable_imu_frontend", false);
-    if (this->get_parameter("enable_imu_frontend").get_parameter_value().get<bool>()) {
+    enable_robot_odometry_init_guess =
+        this->get_parameter("enable_robot_odometry_init_guess")
+            .get_parameter_value()
+            .get<bool>();
+    enable_imu_frontend =
+        this->get_parameter("enable_imu_frontend").get_parameter_value().get<bool>();
+    on_set_parameters_handle = this->add_on_set_parameters_callback(std::bind(
+        &ScanMatchingOdometryNode::on_set_parameters, this, std::placeholders::_1));
+
+    if (enable_imu_frontend) {
       msf_pose_sub =
           this->create_subscription<geometry_msgs::msg::PoseWithCovarianceStamped>(
               "msf_core/pose",
@@ -137,6 +149,13 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
     keyframe_delta_time =
         this->get_parameter("keyframe_delta_time").get_parameter_value().get<double>();
 
+    // Fraction of the keyframe thresholds after which the target of the next keyframe
+    // is built in the background. If this value is zero, targets are built on switch
+    this->declare_parameter("keyframe_prebuild_ratio", 0.8);
+    keyframe_prebuild_ratio = this->get_parameter("keyframe_prebuild_ratio")
+                                  .get_parameter_value()
+                                  .get<double>();
+
     // Registration validation by thresholding
     this->declare_parameter("transform_thresholding", false);
     this->declare_parameter("max_acceptable_trans", 1.0);
@@ -222,6 +241,7 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
             .get<std::string>()};
 
     registration = select_registration_method(params);
+    standby_registration = select_registration_method(params);
   }
 
   /**
@@ -286,6 +306,8 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
   Eigen::Matrix4f matching(const rclcpp::Time& stamp,
                            const pcl::PointCloud<PointT>::ConstPtr& cloud) {
     if (!keyframe) {
+      if (candidate_ready.valid()) candidate_ready.wait();
+      candidate_ready = std::future<void>();
       prev_time = rclcpp::Time();
       prev_trans.setIdentity();
       keyframe_pose.setIdentity();
@@ -301,7 +323,7 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
     std::string msf_source;
     Eigen::Isometry3f msf_delta = Eigen::Isometry3f::Identity();
 
-    if (this->get_parameter("enable_imu_frontend").get_parameter_value().get<bool>()) {
+    if (enable_imu_frontend) {
       if (msf_pose && rclcpp::Time(msf_pose->header.stamp) > keyframe_stamp &&
           msf_pose_after_update &&
           rclcpp::Time(msf_pose_after_update->header.stamp) > keyframe_stamp) {
@@ -314,9 +336,7 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
       } else {
         std::cerr << "msf data is too old" << std::endl;
       }
-    } else if (this->get_parameter("enable_robot_odometry_init_guess")
-                   .get_parameter_value()
-                   .get<bool>()) {
+    } else if (enable_robot_odometry_init_guess) {
       geometry_msgs::msg::TransformStamped transform_msg;
       if (tf_buffer->canTransform(cloud->header.frame_id,
                                   stamp,
@@ -399,13 +419,20 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
     double delta_time = (stamp - keyframe_stamp).seconds();
     if (delta_trans > keyframe_delta_trans || delta_angle > keyframe_delta_angle ||
         delta_time > keyframe_delta_time) {
-      keyframe = filtered;
-      registration->setInputTarget(keyframe);
-
-      keyframe_pose = odom;
-      keyframe_stamp = stamp;
-      prev_time = stamp;
-      prev_trans.setIdentity();
+      if (!promote_candidate_keyframe(stamp, odom)) {
+        keyframe = filtered;
+        registration->setInputTarget(keyframe);
+
+        keyframe_pose = odom;
+        keyframe_stamp = stamp;
+        prev_time = stamp;
+        prev_trans.setIdentity();
+      }
+    } else if (keyframe_prebuild_ratio > 0.0 &&
+               (delta_trans > keyframe_prebuild_ratio * keyframe_delta_trans ||
+                delta_angle > keyframe_prebuild_ratio * keyframe_delta_angle ||
+                delta_time > keyframe_prebuild_ratio * keyframe_delta_time)) {
+      prebuild_candidate_keyframe(stamp, filtered, odom);
     }
 
     if (aligned_points_pub->get_subscription_count() > 0) {
@@ -419,6 +446,118 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
     return odom;
   }
 
+  /**
+   * @brief keeps the cached values of the parameters read per frame up to date.
+   * enable_imu_frontend decides which subscriptions exist and cannot be changed
+   * @param parameters
+   * @return whether the parameters can be set
+   */
+  rcl_interfaces::msg::SetParametersResult on_set_parameters(
+      const std::vector<rclcpp::Parameter>& parameters) {
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    for (const auto& parameter : parameters) {
+      if (parameter.get_name() == "enable_imu_frontend" &&
+          parameter.as_bool() != enable_imu_frontend) {
+        result.successful = false;
+        result.reason = "enable_imu_frontend can only be set at startup";
+        return result;
+      }
+    }
+
+    for (const auto& parameter : parameters) {
+      const std::string& name = parameter.get_name();
+      if (name == "enable_robot_odometry_init_guess") {
+        enable_robot_odometry_init_guess = parameter.as_bool();
+      } else if (name == "keyframe_delta_trans") {
+        keyframe_delta_trans = parameter.as_double();
+      } else if (name == "keyframe_delta_angle") {
+        keyframe_delta_angle = parameter.as_double();
+      } else if (name == "keyframe_delta_time") {
+        keyframe_delta_time = parameter.as_double();
+      } else if (name == "keyframe_prebuild_ratio") {
+        keyframe_prebuild_ratio = parameter.as_double();
+      } else if (name == "transform_thresholding") {
+        transform_thresholding = parameter.as_bool();
+      } else if (name == "max_acceptable_trans") {
+        max_acceptable_trans = parameter.as_double();
+      } else if (name == "max_acceptable_angle") {
+        max_acceptable_angle = parameter.as_double();
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief build the target of a keyframe candidate on the standby registration in a
+   * background thread. A candidate that is still being built is kept, a ready one is
+   * replaced by the newer frame.
+   * @param stamp  timestamp of the candidate
+   * @param cloud  downsampled cloud of the candidate
+   * @param pose   odometry pose of the candidate
+   */
+  void prebuild_candidate_keyframe(const rclcpp::Time& stamp,
+                                   const pcl::PointCloud<PointT>::ConstPtr& cloud,
+                                   const Eigen::Matrix4f& pose) {
+    if (candidate_ready.valid() &&
+        candidate_ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return;
+
+    candidate_keyframe = cloud;
+    candidate_pose = pose;
+    candidate_stamp = stamp;
+    candidate_ready = std::async(std::launch::async,
+                                 &ScanMatchingOdometryNode::build_target,
+                                 standby_registration,
+                                 cloud);
+  }
+
+  /**
+   * @brief switch to the prebuilt candidate as the new keyframe by exchanging the
+   * registrations
+   * @param stamp  timestamp of the current frame
+   * @param odom   odometry pose of the current frame
+   * @return false if no newer candidate is ready
+   */
+  bool promote_candidate_keyframe(const rclcpp::Time& stamp,
+                                  const Eigen::Matrix4f& odom) {
+    if (!candidate_ready.valid() ||
+        candidate_ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return false;
+    // a candidate older than the keyframe was overtaken by a synchronous switch
+    if (candidate_stamp <= keyframe_stamp) return false;
+    candidate_ready.get();
+
+    std::swap(registration, standby_registration);
+    keyframe = candidate_keyframe;
+    keyframe_pose = candidate_pose;
+    keyframe_stamp = candidate_stamp;
+    prev_time = stamp;
+    prev_trans = candidate_pose.inverse() * odom;
+    return true;
+  }
+
+  /**
+   * @brief set the target of a registration and build its search structures. Methods
+   * that build them lazily do so on the first alignment, so a subset of the target is
+   * aligned against it
+   * @param target_registration  registration to prepare
+   * @param target               target cloud
+   */
+  static void build_target(
+      const pcl::Registration<PointT, PointT>::Ptr& target_registration,
+      const pcl::PointCloud<PointT>::ConstPtr& target) {
+    target_registration->setInputTarget(target);
+
+    pcl::PointCloud<PointT>::Ptr probe(new pcl::PointCloud<PointT>());
+    const size_t step = std::max<size_t>(1, target->size() / 64);
+    for (size_t i = 0; i < target->size(); i += step) probe->push_back(target->at(i));
+    target_registration->setInputSource(probe);
+
+    pcl::PointCloud<PointT> aligned;
+    target_registration->align(aligned);
+  }
+
   /**
    * @brief publish odometry
    * @param stamp  timestamp
@@ -468,26 +607,16 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
     s_graphs::msg::ScanMatchingStatus status;
     status.header.frame_id = frame_id;
     status.header.stamp = stamp;
-    status.has_converged = registration->hasConverged();
-    status.matching_error = registration->getFitnessScore();
 
     const double max_correspondence_dist = 0.5;
-
-    int num_inliers = 0;
-    std::vector<int> k_indices;
-    std::vector<float> k_sq_dists;
-    for (size_t i = 0; i < aligned->size(); i++) {
-      const auto& pt = aligned->at(i);
-      registration->getSearchMethodTarget()->nearestKSearch(
-          pt, 1, k_indices, k_sq_dists);
-      if (k_sq_dists[0] < max_correspondence_dist * max_correspondence_dist) {
-        num_inliers++;
-      }
-    }
-    status.inlier_fraction = static_cast<float>(num_inliers) / aligned->size();
+    const RegistrationResult result =
+        get_registration_result(*registration, *aligned, max_correspondence_dist);
+    status.has_converged = result.has_converged;
+    status.matching_error = result.fitness_score;
+    status.inlier_fraction = result.inlier_fraction;
 
     status.relative_pose = isometry2pose(
-        Eigen::Isometry3f(registration->getFinalTransformation()).cast<double>());
+        Eigen::Isometry3f(result.final_transformation).cast<double>());
 
     if (!msf_source.empty()) {
       status.prediction_labels.resize(1);
@@ -495,8 +624,7 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
 
       status.prediction_errors.resize(1);
       Eigen::Isometry3f error =
-          Eigen::Isometry3f(registration->getFinalTransformation()).inverse() *
-          msf_delta;
+          Eigen::Isometry3f(result.final_transformation).inverse() * msf_delta;
       status.prediction_errors[0] = isometry2pose(error.cast<double>());
     }
 
@@ -540,6 +668,12 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
   geometry_msgs::msg::PoseWithCovarianceStamped::SharedPtr msf_pose_after_update;
   bool publish_tf;
 
+  // parameters read per frame, updated by on_set_parameters
+  rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr
+      on_set_parameters_handle;
+  bool enable_imu_frontend;
+  bool enable_robot_odometry_init_guess;
+
   rclcpp::Time prev_time;
   Eigen::Matrix4f prev_trans;     // previous estimated transform from keyframe
   Eigen::Matrix4f keyframe_pose;  // keyframe pose
@@ -549,6 +683,14 @@ class ScanMatchingOdometryNode : public rclcpp::Node {
   //
   pcl::Filter<PointT>::Ptr downsample_filter;
   pcl::Registration<PointT, PointT>::Ptr registration;
+
+  // double-buffered registration target
+  double keyframe_prebuild_ratio;
+  pcl::Registration<PointT, PointT>::Ptr standby_registration;
+  std::future<void> candidate_ready;
+  pcl::PointCloud<PointT>::ConstPtr candidate_keyframe;
+  Eigen::Matrix4f candidate_pose;
+  rclcpp::Time candidate_stamp;
 };
 
 }  // namespace s_graphs
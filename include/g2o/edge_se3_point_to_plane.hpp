@@ -61,19 +61,42 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <g2o/types/slam3d_addons/vertex_plane.h>
 
 namespace g2o {
-class EdgeSE3PointToPlane
-    : public g2o::BaseBinaryEdge<1, Eigen::Matrix4d, g2o::VertexSE3, g2o::VertexPlane> {
+/**
+ * @brief Point to plane edge. The measurement Gij = sum(p * p^T) of the homogeneous
+ * plane points is symmetric, so only its upper triangle is kept, packed row by row
+ * in 10 entries.
+ */
+class EdgeSE3PointToPlane : public g2o::BaseBinaryEdge<1,
+                                                       Eigen::Matrix<double, 10, 1>,
+                                                       g2o::VertexSE3,
+                                                       g2o::VertexPlane> {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef Eigen::Matrix<double, 10, 1> PackedGram;
+
   EdgeSE3PointToPlane()
-      : BaseBinaryEdge<1, Eigen::Matrix4d, g2o::VertexSE3, g2o::VertexPlane>() {}
+      : BaseBinaryEdge<1, PackedGram, g2o::VertexSE3, g2o::VertexPlane>() {}
 
   void computeError() override;
 
-  void setMeasurement(const Eigen::Matrix4d& m) override { _measurement = m; }
+  /**
+   * @brief Closed form jacobians of e = q^T * Gij * q / 2, with q = Ti^T * Pj the
+   * plane in the keyframe frame
+   */
+  void linearizeOplus() override;
+
+  void setMeasurement(const PackedGram& m) override { _measurement = m; }
+
+  void setMeasurement(const Eigen::Matrix4d& m) { _measurement = pack(m); }
 
   virtual bool read(std::istream& is) override;
   virtual bool write(std::ostream& os) const override;
+
+  static PackedGram pack(const Eigen::Matrix4d& m);
+
+ private:
+  Eigen::Vector4d plane_in_keyframe() const;
+  Eigen::Vector4d gram_product(const Eigen::Vector4d& q) const;
 };
 }  // namespace g2o
 
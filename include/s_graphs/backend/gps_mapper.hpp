@@ -38,6 +38,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <g2o/edge_se3_priorxyz.hpp>
 #include <s_graphs/backend/graph_slam.hpp>
 #include <s_graphs/common/keyframe.hpp>
+#include <s_graphs/common/time_series_buffer.hpp>
 
 #include "geodesy/utm.h"
 #include "geodesy/wgs84.h"
@@ -60,12 +61,26 @@ class GPSMapper {
   ~GPSMapper();
 
  public:
+  /**
+   * @brief Moves the gps queue into the time series and adds a prior edge for
+   * every new keyframe with gps data around its stamp. The utm position is linearly
+   * interpolated between the two bracketing gps samples.
+   *
+   * @param covisibility_graph
+   * @param gps_queue: drained by the call
+   * @param keyframes
+   * @return true if an edge was added
+   */
   bool map_gps_data(
       std::shared_ptr<GraphSLAM>& covisibility_graph,
       std::deque<geographic_msgs::msg::GeoPointStamped::SharedPtr>& gps_queue,
       const std::map<int, KeyFrame::Ptr>& keyframes);
 
  private:
+  Eigen::Vector3d to_utm(const geographic_msgs::msg::GeoPointStamped& gps) const;
+
+ private:
+  TimeSeriesAssociation<geographic_msgs::msg::GeoPointStamped::SharedPtr> gps_series;
   boost::optional<Eigen::Vector3d> zero_utm;
   double gps_time_offset;
   double gps_edge_stddev_xy;
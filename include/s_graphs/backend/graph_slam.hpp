@@ -33,6 +33,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #define GRAPH_SLAM_HPP
 
 #include <g2o/core/hyper_graph.h>
+#include <g2o/core/hyper_graph_action.h>
 #include <g2o/core/sparse_block_matrix.h>
 #include <g2o/core/sparse_optimizer.h>
 
@@ -42,7 +43,13 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <g2o/edge_wall_two_planes.hpp>
 #include <g2o/vertex_deviation.hpp>
 #include <g2o/vertex_wall.hpp>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "rclcpp/rclcpp.hpp"
 namespace g2o {
@@ -88,6 +95,39 @@ class VertexDeviation;
 
 namespace s_graphs {
 
+/**
+ * @brief Information matrix of an edge with a D dimensional error. It is fixed size,
+ * so it needs no heap allocation. A fixed size matrix of the wrong size fails at
+ * compile time. An Eigen::MatrixXd still converts implicitly, and its size is only
+ * checked by the Eigen assertions at runtime.
+ */
+template <int D>
+using InformationMatrix = Eigen::Matrix<double, D, D>;
+
+/**
+ * @brief Marginal covariance of a landmark vertex recovered after a solve. Only
+ * positive definite blocks are kept.
+ */
+struct LandmarkMarginal {
+  Eigen::MatrixXd covariance;
+};
+
+/**
+ * @brief Settings of the g2o solver owned by a GraphSLAM instance. S-Graphs mixes
+ * vertices of 1 to 6 dof (infinite rooms, rooms, planes, keyframes), so only the
+ * variable block solvers (*_var*) apply; the fixed 6_3 ones reject the room vertices.
+ */
+struct SolverConfig {
+  std::string solver_type = "lm_var_cholmod";
+  /** OpenMP threads for the error and jacobian evaluation, 0 keeps the default. Only
+   * effective when g2o itself was built with G2O_OPENMP, see
+   * GraphSLAM::solver_supports_threads() */
+  int num_threads = 0;
+  /** fill-reducing ordering on the block structure instead of the scalar one. This
+   * is already the default of the CCS based linear solvers, false disables it */
+  bool block_ordering = true;
+};
+
 /**
  * @brief
  */
@@ -143,6 +183,55 @@ class GraphSLAM {
    */
   int increment_local_nbr_of_edges();
 
+  /**
+   * @brief Revision counter of the graph. It is bumped every time a vertex or
+   * an edge is added or removed, or a vertex estimate is marked as updated.
+   *
+   * @return Current revision of the graph.
+   */
+  uint64_t get_revision() const;
+
+  /**
+   * @brief Revision at which a vertex or an edge was last added or removed.
+   *
+   * @return Revision of the last structural change.
+   */
+  uint64_t get_structure_revision() const;
+
+  /**
+   * @brief Revision at which the given vertex was last added or updated.
+   *
+   * @param vertex_id
+   * @return Revision of the vertex, 0 if it is not tracked.
+   */
+  uint64_t get_vertex_revision(const int vertex_id) const;
+
+  /**
+   * @brief Mark the estimate of a vertex as changed. Estimates set outside of
+   * GraphSLAM (e.g. copied back after an optimization) must be reported here so
+   * that incremental consumers pick them up.
+   *
+   * @param vertex_id
+   */
+  void mark_vertex_updated(const int vertex_id);
+
+  /**
+   * @brief Mark a vertex as changed only if its estimate moved by more than the
+   * revision threshold since it was last marked.
+   *
+   * @param vertex_id
+   * @return Whether the vertex got a new revision
+   */
+  bool mark_vertex_changed(const int vertex_id);
+
+  /**
+   * @brief Smallest change of an estimate parameter (as in getEstimateData) that
+   * gives a vertex a new revision in mark_vertex_changed.
+   *
+   * @param threshold
+   */
+  void set_revision_threshold(const double threshold);
+
   /**
    * @brief Set the current solver type
    *
@@ -150,6 +239,63 @@ class GraphSLAM {
    */
   void select_solver_type(const std::string& solver_type);
 
+  /**
+   * @brief Apply a solver configuration. The solver is only reallocated when its
+   * type changes, the thread count is applied around every optimization.
+   *
+   * @param config
+   */
+  void configure_solver(const SolverConfig& config);
+
+  /**
+   * @brief Whether g2o evaluates the errors and jacobians in parallel, i.e. it was
+   * built with G2O_OPENMP. Otherwise SolverConfig::num_threads has no effect.
+   */
+  static bool solver_supports_threads();
+
+  /**
+   * @brief Solver configuration currently in use.
+   *
+   * @return Current solver configuration
+   */
+  const SolverConfig& get_solver_config() const;
+
+  /**
+   * @brief Bound the wall time of the following optimizations. The solver stops
+   * after the first iteration that exceeds the budget.
+   *
+   * @param seconds Time budget, 0 disables it
+   */
+  void set_optimization_time_budget(const double seconds);
+
+  /**
+   * @brief Stop the running optimization after its current iteration. It can be
+   * called from any thread, a request made between two optimizations is discarded.
+   */
+  void request_preemption();
+
+  /**
+   * @brief Register a callback run from the optimizing thread after every iteration
+   * that lowers the chi2, while the estimates of the graph are consistent.
+   *
+   * @param callback Receives the iteration and the robust chi2, empty to disable it
+   */
+  void set_iteration_callback(const std::function<void(int, double)>& callback);
+
+  /**
+   * @brief Reset the preemption request and restart the time budget. optimize()
+   * calls it, solvers driving the g2o graph directly must call it first.
+   */
+  void begin_optimization();
+
+  /**
+   * @brief
+   *
+   * @return true once the running optimization was preempted or ran out of its time
+   * budget. Solvers chaining several g2o solves check it between them.
+   */
+  bool optimization_stopped() const;
+
   /**
    * @brief Add a SE3 node to the graph.
    *
@@ -298,7 +444,7 @@ class GraphSLAM {
   g2o::EdgeSE3* add_se3_edge(g2o::VertexSE3* v1,
                              g2o::VertexSE3* v2,
                              const Eigen::Isometry3d& relative_pose,
-                             const Eigen::MatrixXd& information_matrix,
+                             const InformationMatrix<6>& information_matrix,
                              const bool use_edge_size_id = false);
 
   /**
@@ -314,7 +460,7 @@ class GraphSLAM {
       g2o::VertexSE3* v1,
       g2o::VertexSE3* v2,
       const Eigen::Isometry3d& relative_pose,
-      const Eigen::MatrixXd& information_matrix);
+      const InformationMatrix<6>& information_matrix);
 
   /**
    * @brief copy an edge from another graph
@@ -346,7 +492,7 @@ class GraphSLAM {
   g2o::EdgeSE3Plane* add_se3_plane_edge(g2o::VertexSE3* v_se3,
                                         g2o::VertexPlane* v_plane,
                                         const Eigen::Vector4d& plane_coeffs,
-                                        const Eigen::MatrixXd& information_matrix);
+                                        const InformationMatrix<3>& information_matrix);
   /**
    * @brief copy an edge from another graph
    *
@@ -373,7 +519,7 @@ class GraphSLAM {
    * @param edge_se3
    */
   void update_se3edge_information(g2o::EdgeSE3* edge_se3,
-                                  Eigen::MatrixXd information_matrix);
+                                  const InformationMatrix<6>& information_matrix);
 
   /**
    * @brief Add an edge between an SE3 node and to a plane using point to plane
@@ -389,7 +535,7 @@ class GraphSLAM {
       g2o::VertexSE3* v_se3,
       g2o::VertexPlane* v_plane,
       const Eigen::Matrix4d& points_matrix,
-      const Eigen::MatrixXd& information_matrix);
+      const InformationMatrix<1>& information_matrix);
 
   /**
    * @brief Add an edge between an SE3 node and a point_xyz node
@@ -404,7 +550,7 @@ class GraphSLAM {
       g2o::VertexSE3* v_se3,
       g2o::VertexPointXYZ* v_xyz,
       const Eigen::Vector3d& xyz,
-      const Eigen::MatrixXd& information_matrix);
+      const InformationMatrix<3>& information_matrix);
 
   /**
    * @brief Add a prior edge to an SE3 node
@@ -417,7 +563,7 @@ class GraphSLAM {
   g2o::EdgePlanePriorNormal* add_plane_normal_prior_edge(
       g2o::VertexPlane* v,
       const Eigen::Vector3d& normal,
-      const Eigen::MatrixXd& information_matrix);
+      const InformationMatrix<3>& information_matrix);
 
   /**
    * @brief
@@ -430,7 +576,7 @@ class GraphSLAM {
   g2o::EdgePlanePriorDistance* add_plane_distance_prior_edge(
       g2o::VertexPlane* v,
       double distance,
-      const Eigen::MatrixXd& information_matrix);
+      const InformationMatrix<1>& information_matrix);
 
   /**
    * @brief
@@ -440,9 +586,10 @@ class GraphSLAM {
    * @param information_matrix
    * @return registered edge
    */
-  g2o::EdgeSE3PriorXY* add_se3_prior_xy_edge(g2o::VertexSE3* v_se3,
-                                             const Eigen::Vector2d& xy,
-                                             const Eigen::MatrixXd& information_matrix);
+  g2o::EdgeSE3PriorXY* add_se3_prior_xy_edge(
+      g2o::VertexSE3* v_se3,
+      const Eigen::Vector2d& xy,
+      const InformationMatrix<2>& information_matrix);
 
   /**
    * @brief
@@ -455,7 +602,7 @@ class GraphSLAM {
   g2o::EdgeSE3PriorXYZ* add_se3_prior_xyz_edge(
       g2o::VertexSE3* v_se3,
       const Eigen::Vector3d& xyz,
-      const Eigen::MatrixXd& information_matrix);
+      const InformationMatrix<3>& information_matrix);
 
   /**
    * @brief
@@ -468,7 +615,7 @@ class GraphSLAM {
   g2o::EdgeSE3PriorQuat* add_se3_prior_quat_edge(
       g2o::VertexSE3* v_se3,
       const Eigen::Quaterniond& quat,
-      const Eigen::MatrixXd& information_matrix);
+      const InformationMatrix<3>& information_matrix);
 
   /**
    * @brief
@@ -483,7 +630,7 @@ class GraphSLAM {
       g2o::VertexSE3* v_se3,
       const Eigen::Vector3d& direction,
       const Eigen::Vector3d& measurement,
-      const Eigen::MatrixXd& information_matrix);
+      const InformationMatrix<3>& information_matrix);
 
   /**
    * @brief
@@ -497,7 +644,7 @@ class GraphSLAM {
   g2o::EdgePlane* add_plane_edge(g2o::VertexPlane* v_plane1,
                                  g2o::VertexPlane* v_plane2,
                                  const Eigen::Vector4d& measurement,
-                                 const Eigen::Matrix4d& information);
+                                 const InformationMatrix<4>& information);
 
   /**
    * @brief
@@ -508,10 +655,11 @@ class GraphSLAM {
    * @param information
    * @return registered edge
    */
-  g2o::EdgePlaneIdentity* add_plane_identity_edge(g2o::VertexPlane* v_plane1,
-                                                  g2o::VertexPlane* v_plane2,
-                                                  const Eigen::Vector4d& measurement,
-                                                  const Eigen::Matrix4d& information);
+  g2o::EdgePlaneIdentity* add_plane_identity_edge(
+      g2o::VertexPlane* v_plane1,
+      g2o::VertexPlane* v_plane2,
+      const Eigen::Vector4d& measurement,
+      const InformationMatrix<4>& information);
 
   /**
    * @brief
@@ -522,10 +670,11 @@ class GraphSLAM {
    * @param information
    * @return registered edge
    */
-  g2o::EdgePlaneParallel* add_plane_parallel_edge(g2o::VertexPlane* v_plane1,
-                                                  g2o::VertexPlane* v_plane2,
-                                                  const Eigen::Vector3d& measurement,
-                                                  const Eigen::MatrixXd& information);
+  g2o::EdgePlaneParallel* add_plane_parallel_edge(
+      g2o::VertexPlane* v_plane1,
+      g2o::VertexPlane* v_plane2,
+      const Eigen::Vector3d& measurement,
+      const InformationMatrix<1>& information);
 
   /**
    * @brief
@@ -540,7 +689,7 @@ class GraphSLAM {
       g2o::VertexPlane* v_plane1,
       g2o::VertexPlane* v_plane2,
       const Eigen::Vector3d& measurement,
-      const Eigen::MatrixXd& information);
+      const InformationMatrix<1>& information);
 
   /**
    * @brief add edges between duplicate planes
@@ -553,7 +702,7 @@ class GraphSLAM {
    */
   g2o::Edge2Planes* add_2planes_edge(g2o::VertexPlane* v_plane1,
                                      g2o::VertexPlane* v_plane2,
-                                     const Eigen::MatrixXd& information);
+                                     const InformationMatrix<3>& information);
 
   /**
    * @brief copy the 2planes edges from another graph
@@ -592,7 +741,7 @@ class GraphSLAM {
       g2o::VertexDeviation* v_se3,
       g2o::VertexPlane* v_plane1,
       g2o::VertexPlane* v_plane2,
-      const Eigen::MatrixXd& information);
+      const InformationMatrix<3>& information);
 
   /**
    * @brief
@@ -606,7 +755,7 @@ class GraphSLAM {
   g2o::EdgeSE3Room* add_se3_room_edge(g2o::VertexSE3* v_se3,
                                       g2o::VertexRoom* v_room,
                                       const Eigen::Vector2d& measurement,
-                                      const Eigen::MatrixXd& information);
+                                      const InformationMatrix<2>& information);
 
   /**
    * @brief
@@ -622,7 +771,7 @@ class GraphSLAM {
                                               g2o::VertexPlane* v_plane1,
                                               g2o::VertexPlane* v_plane2,
                                               g2o::VertexRoom* v_cluster_center,
-                                              const Eigen::MatrixXd& information);
+                                              const InformationMatrix<2>& information);
 
   bool remove_room_2planes_edge(g2o::EdgeRoom2Planes* room_plane_edge);
 
@@ -657,7 +806,7 @@ class GraphSLAM {
                                               g2o::VertexPlane* v_xplane2,
                                               g2o::VertexPlane* v_yplane1,
                                               g2o::VertexPlane* v_yplane2,
-                                              const Eigen::MatrixXd& information);
+                                              const InformationMatrix<2>& information);
 
   /**
    * @brief
@@ -689,7 +838,7 @@ class GraphSLAM {
   g2o::EdgeFloorRoom* add_floor_room_edge(g2o::VertexFloor* v_floor,
                                           g2o::VertexRoom* v_room,
                                           const Eigen::Vector2d& measurement,
-                                          const Eigen::MatrixXd& information);
+                                          const InformationMatrix<2>& information);
 
   /**
    * @brief copy the floor room edge from a graph
@@ -724,7 +873,7 @@ class GraphSLAM {
       g2o::VertexInfiniteRoom* v_xcorr1,
       g2o::VertexInfiniteRoom* v_xcorr2,
       const double& measurement,
-      const Eigen::MatrixXd& information);
+      const InformationMatrix<1>& information);
 
   /**
    * @brief
@@ -739,13 +888,13 @@ class GraphSLAM {
       g2o::VertexInfiniteRoom* v_ycorr1,
       g2o::VertexInfiniteRoom* v_ycorr2,
       const double& measurement,
-      const Eigen::MatrixXd& information);
+      const InformationMatrix<1>& information);
 
   g2o::EdgeWall2Planes* add_wall_2planes_edge(g2o::VertexWallXYZ* v_wall,
                                               g2o::VertexPlane* v_plane1,
                                               g2o::VertexPlane* v_plane2,
                                               Eigen::Vector3d wall_point,
-                                              const Eigen::MatrixXd& information);
+                                              const InformationMatrix<3>& information);
 
   /**
    * @brief
@@ -757,11 +906,12 @@ class GraphSLAM {
    * @param information
    * @return registered edge
    */
-  g2o::EdgeDoorWay2Rooms* add_doorway_2rooms_edge(g2o::VertexDoorWay* v_door_r1,
-                                                  g2o::VertexDoorWay* v_door_r2,
-                                                  g2o::VertexRoom* v_room1,
-                                                  g2o::VertexRoom* v_room2,
-                                                  const Eigen::MatrixXd& information);
+  g2o::EdgeDoorWay2Rooms* add_doorway_2rooms_edge(
+      g2o::VertexDoorWay* v_door_r1,
+      g2o::VertexDoorWay* v_door_r2,
+      g2o::VertexRoom* v_room1,
+      g2o::VertexRoom* v_room2,
+      const InformationMatrix<3>& information);
 
   /**
    * @brief deviations betwen rooms edge
@@ -775,7 +925,7 @@ class GraphSLAM {
       g2o::VertexDeviation* v1,
       g2o::VertexRoom* v2,
       g2o::VertexRoom* v3,
-      const Eigen::MatrixXd& information);
+      const InformationMatrix<6>& information);
 
   /**
    * @brief Merge prior and online rooms with 0 error
@@ -786,7 +936,7 @@ class GraphSLAM {
    */
   g2o::Edge2Rooms* add_2rooms_edge(g2o::VertexRoom* v1,
                                    g2o::VertexRoom* v2,
-                                   const Eigen::MatrixXd& information);
+                                   const InformationMatrix<2>& information);
 
   /**
    * @brief
@@ -818,6 +968,33 @@ class GraphSLAM {
   bool compute_landmark_marginals(g2o::SparseBlockMatrix<Eigen::MatrixXd>& spinv,
                                   std::vector<std::pair<int, int>> vert_pairs_vec);
 
+  /**
+   * @brief Recover the marginal covariances of the plane and room vertices from the
+   * last solve. Only their diagonal blocks are requested from the solver, and each
+   * positive definite one is cached until the next call.
+   *
+   * @param pose_ids: ids of pose vertices whose marginals are recovered as well
+   * @return Number of vertices whose marginals were recovered
+   */
+  int update_landmark_marginals(const std::vector<int>& pose_ids = {});
+
+  /**
+   * @brief Initialize every vertex and edge of the graph and build its Hessian at the
+   * current estimates, without iterating. Solvers that only optimize subsets of the
+   * graph call it so that update_landmark_marginals() covers the whole graph.
+   *
+   * @return true if the system was built
+   */
+  bool build_full_system();
+
+  /**
+   * @brief Marginal of a landmark vertex cached by update_landmark_marginals()
+   *
+   * @param vertex_id
+   * @return Cached marginal, nullptr if none was recovered at the last solve
+   */
+  const LandmarkMarginal* get_landmark_marginal(const int vertex_id) const;
+
   /**
    * @brief Save the pose graph to a file
    *
@@ -832,11 +1009,38 @@ class GraphSLAM {
    */
   bool load(const std::string& filename);
 
+ private:
+  bool allocate_solver(const std::string& solver_type);
+  void apply_block_ordering(const bool block_ordering);
+  void on_iteration(const int iteration);
+  void mark_vertex_added(const int vertex_id);
+  void mark_vertex_removed(const int vertex_id);
+  void mark_structure_updated();
+
  public:
   g2o::RobustKernelFactory* robust_kernel_factory;
   std::unique_ptr<g2o::SparseOptimizer> graph;  // g2o graph
+  SolverConfig solver_config;
+  std::unique_ptr<g2o::HyperGraphAction> post_iteration_action;
+  std::function<void(int, double)> iteration_callback;
+  std::atomic<bool> preemption_requested;
+  bool force_stop;
+  double best_chi2;
+  double optimization_time_budget;
+  rclcpp::Time optimization_start;
   int nbr_of_vertices;
   int nbr_of_edges;
+  struct VertexRevision {
+    uint64_t revision;
+    std::vector<double> estimate;  // estimate data when the revision was given
+  };
+  std::atomic<uint64_t> revision;
+  std::atomic<uint64_t> structure_revision;
+  // read by the publishing threads without the graph mutex
+  mutable std::mutex vertex_revisions_mutex;
+  std::unordered_map<int, VertexRevision> vertex_revisions;
+  double revision_threshold;
+  std::unordered_map<int, LandmarkMarginal> landmark_marginals;
   int timing_counter;
   double sum_prev_timings;
   bool save_compute_time;
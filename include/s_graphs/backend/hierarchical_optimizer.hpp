@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef HIERARCHICAL_OPTIMIZER_HPP
+#define HIERARCHICAL_OPTIMIZER_HPP
+
+#include <g2o/core/sparse_optimizer.h>
+#include <g2o/types/slam3d/vertex_se3.h>
+#include <g2o/types/slam3d_addons/vertex_plane.h>
+
+#include <Eigen/Dense>
+#include <s_graphs/backend/graph_slam.hpp>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+
+namespace s_graphs {
+
+/**
+ * @brief Optimizes an S-Graph level by level instead of in one sparse system. The
+ * keyframes and planes of every room are solved as independent subproblems, each room
+ * is condensed into priors on its planes, the condensed room/floor graph is solved and
+ * the keyframes are finally back-substituted with all the landmarks held fixed.
+ *
+ * This is not an exact Schur complement. A room subproblem holds the keyframes and
+ * planes of its neighbours fixed, so its plane priors are marginals conditioned on
+ * that boundary and are overconfident. The condensed solve holds every keyframe
+ * fixed, so the odometry and loop closures between rooms only act through the room
+ * subproblems and the back-substitution. The three levels are therefore repeated,
+ * each pass starting from the estimates of the previous one, until the robust chi2
+ * of the whole graph stops decreasing. A pass that increases it is rolled back.
+ */
+class HierarchicalOptimizer {
+ public:
+  /**
+   * @brief Constructor of class HierarchicalOptimizer
+   *
+   * @param node
+   */
+  HierarchicalOptimizer(const rclcpp::Node::SharedPtr node);
+  ~HierarchicalOptimizer();
+
+ public:
+  /**
+   * @brief Optimize the graph hierarchically. Vertices fixed in the graph stay fixed.
+   *
+   * @param graph_slam
+   * @param num_iterations Iterations of the condensed room/floor solve of each pass
+   * @return Iterations of the room, condensed and back-substitution solves of the
+   * kept passes, -1 if the graph is too small to be optimized
+   */
+  int optimize(GraphSLAM* graph_slam, const int num_iterations);
+
+ private:
+  /**
+   * @brief Keyframes and planes owned by one finite or infinite room. A plane belongs
+   * to the first room bounded by it, a keyframe to the room whose planes it observes
+   * most.
+   */
+  struct RoomCluster {
+    g2o::OptimizableGraph::Vertex* room_node;
+    std::vector<g2o::VertexSE3*> keyframes;
+    std::vector<g2o::VertexPlane*> planes;
+  };
+
+  /**
+   * @brief Plane estimate and information recovered from a room subproblem.
+   */
+  struct PlanePrior {
+    g2o::VertexPlane* plane;
+    Eigen::Vector4d coeffs;
+    Eigen::Matrix3d information;
+  };
+
+  /**
+   * @brief
+   *
+   * @param graph
+   * @return Room clusters ordered by room id
+   */
+  std::vector<RoomCluster> build_room_clusters(g2o::SparseOptimizer* graph) const;
+
+  /**
+   * @brief Solve the keyframes and planes of a room with its neighbourhood fixed and
+   * condense the result into one prior per plane.
+   *
+   * @param graph
+   * @param cluster
+   * @param plane_priors
+   * @return Number of iterations
+   */
+  int solve_room(g2o::SparseOptimizer* graph,
+                 const RoomCluster& cluster,
+                 std::vector<PlanePrior>& plane_priors) const;
+
+  /**
+   * @brief Solve the planes, rooms and floors with the keyframes fixed, using the
+   * plane priors in place of the keyframe observations they condense.
+   *
+   * @param graph
+   * @param plane_priors
+   * @param num_iterations
+   * @return Number of iterations
+   */
+  int solve_condensed(g2o::SparseOptimizer* graph,
+                      const std::vector<PlanePrior>& plane_priors,
+                      const int num_iterations) const;
+
+  /**
+   * @brief Solve the keyframes with every landmark fixed.
+   *
+   * @param graph
+   * @return Number of iterations
+   */
+  int solve_keyframes(g2o::SparseOptimizer* graph) const;
+
+ private:
+  int subproblem_iterations;
+  int max_rounds;
+};
+
+}  // namespace s_graphs
+
+#endif  // HIERARCHICAL_OPTIMIZER_HPP
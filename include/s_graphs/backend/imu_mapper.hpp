@@ -34,6 +34,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 #include <s_graphs/backend/graph_slam.hpp>
 #include <s_graphs/common/keyframe.hpp>
+#include <s_graphs/common/time_series_buffer.hpp>
 
 #include "g2o/edge_se3_priorquat.hpp"
 #include "g2o/edge_se3_priorvec.hpp"
@@ -62,6 +63,19 @@ class IMUMapper {
   ~IMUMapper();
 
  public:
+  /**
+   * @brief Moves the imu queue into the time series and adds orientation and
+   * acceleration priors for every new keyframe with imu data around its stamp. The
+   * orientation is slerped and the acceleration linearly interpolated between the
+   * two bracketing imu samples.
+   *
+   * @param graph_slam
+   * @param tf_buffer
+   * @param imu_queue: drained by the call
+   * @param keyframes
+   * @param base_frame_id
+   * @return true if an edge was added
+   */
   bool map_imu_data(std::shared_ptr<GraphSLAM>& graph_slam,
                     const std::unique_ptr<tf2_ros::Buffer>& tf_buffer,
                     std::deque<sensor_msgs::msg::Imu::SharedPtr>& imu_queue,
@@ -69,6 +83,21 @@ class IMUMapper {
                     const std::string base_frame_id);
 
  private:
+  /**
+   * @brief Rotation from the imu frame to the base frame. The transform is static,
+   * so it is only looked up again when one of the frames changes.
+   *
+   * @return false if the transform is not available yet
+   */
+  bool update_imu_to_base_rotation(const std::unique_ptr<tf2_ros::Buffer>& tf_buffer,
+                                   const std::string& imu_frame_id,
+                                   const std::string& base_frame_id);
+
+ private:
+  TimeSeriesAssociation<sensor_msgs::msg::Imu::SharedPtr> imu_series;
+  boost::optional<Eigen::Quaterniond> imu_to_base_rotation;
+  std::pair<std::string, std::string> imu_to_base_frame_ids;
+
   double imu_time_offset;
   bool enable_imu_orientation;
   double imu_orientation_edge_stddev;
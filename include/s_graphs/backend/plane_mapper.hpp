@@ -48,6 +48,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <s_graphs/common/plane_utils.hpp>
 #include <s_graphs/common/planes.hpp>
 #include <string>
+#include <vector>
 
 #include "geometry_msgs/msg/point.hpp"
 #include "pcl_ros/transforms.hpp"
@@ -137,46 +138,56 @@ class PlaneMapper {
                       const std::unordered_map<int, VerticalPlanes>& y_vert_planes,
                       const std::unordered_map<int, HorizontalPlanes>& hort_planes);
 
- private:
   /**
-   * @brief
+   * @brief Associates all the planes of one class detected in a keyframe at once.
+   * The distances of the detections to the mapped planes are computed as one matrix,
+   * and every detection takes its closest plane it overlaps, so several segments of
+   * one wall seen in the same keyframe join the same plane. Horizontal planes are
+   * gated like the vertical ones, without the point overlap test; the per-detection
+   * search never updated its minimum for them and so always created a new
+   * horizontal plane.
    *
-   * @param graph_slam
+   * With constant_covariance the distance is the norm of the error in the keyframe
+   * frame, gated by plane_dist_threshold. Otherwise the error is taken in the map
+   * frame, where the landmark marginals live, and weighted by the landmark
+   * covariance plus the detection covariance propagated through the keyframe pose.
+   * That mahalanobis distance is gated by plane_maha_dist_threshold.
+   *
+   * @param plane_type
    * @param keyframe
-   * @param det_plane_body_frame
+   * @param det_planes: detected planes in the body frame
+   * @param cloud_seg_body_vec: segmented points of each detection
    * @param x_vert_planes
    * @param y_vert_planes
    * @param hort_planes
-   * @return
+   * @return id of the associated plane for each detection, -1 for a new plane
    */
-  int add_planes_to_graph(std::shared_ptr<GraphSLAM>& graph_slam,
-                          KeyFrame::Ptr& keyframe,
-                          const g2o::Plane3D& det_plane_body_frame,
-                          std::unordered_map<int, VerticalPlanes>& x_vert_planes,
-                          std::unordered_map<int, VerticalPlanes>& y_vert_planes,
-                          std::unordered_map<int, HorizontalPlanes>& hort_planes);
+  std::vector<int> associate_planes(
+      const int& plane_type,
+      const KeyFrame::Ptr& keyframe,
+      const std::vector<g2o::Plane3D>& det_planes,
+      const std::vector<pcl::PointCloud<PointNormal>::Ptr>& cloud_seg_body_vec,
+      const std::unordered_map<int, VerticalPlanes>& x_vert_planes,
+      const std::unordered_map<int, VerticalPlanes>& y_vert_planes,
+      const std::unordered_map<int, HorizontalPlanes>& hort_planes);
 
   /**
-   * @brief
+   * @brief Sets the pose covariance propagated into the detections when gating on
+   * the solver marginals. It is the marginal of the latest keyframe at the last
+   * solve, and stays zero until one is recovered.
+   *
+   * @param covariance: pose covariance [t, qx, qy, qz]
+   */
+  void set_keyframe_pose_covariance(const Eigen::Matrix<double, 6, 6>& covariance);
+
+ private:
+  /**
+   * @brief Get the plane type based on the largest value of the normal orientation
    *
-   * @param graph_slam
-   * @param plane_type
-   * @param keyframe
    * @param det_plane_map_frame
-   * @param det_plane_body_frame
-   * @param x_vert_planes
-   * @param y_vert_planes
-   * @param hort_planes
-   * @return
+   * @return Plane class, -1 if no component dominates
    */
-  int sort_planes(std::shared_ptr<GraphSLAM>& graph_slam,
-                  const int& plane_type,
-                  KeyFrame::Ptr& keyframe,
-                  const g2o::Plane3D& det_plane_map_frame,
-                  const g2o::Plane3D& det_plane_body_frame,
-                  std::unordered_map<int, VerticalPlanes>& x_vert_planes,
-                  std::unordered_map<int, VerticalPlanes>& y_vert_planes,
-                  std::unordered_map<int, HorizontalPlanes>& hort_planes);
+  int get_plane_type(const g2o::Plane3D& det_plane_map_frame) const;
 
   /**
    * @brief
@@ -186,6 +197,8 @@ class PlaneMapper {
    * @param keyframe
    * @param det_plane_map_frame
    * @param det_plane_body_frame
+   * @param Gij: point-to-plane gram matrix of the detection
+   * @param data_association: id of the associated plane, -1 to add a new one
    * @param x_vert_planes
    * @param y_vert_planes
    * @param hort_planes
@@ -196,10 +209,29 @@ class PlaneMapper {
                     KeyFrame::Ptr& keyframe,
                     const g2o::Plane3D& det_plane_map_frame,
                     const g2o::Plane3D& det_plane_body_frame,
+                    const Eigen::Matrix4d& Gij,
+                    int data_association,
                     std::unordered_map<int, VerticalPlanes>& x_vert_planes,
                     std::unordered_map<int, VerticalPlanes>& y_vert_planes,
                     std::unordered_map<int, HorizontalPlanes>& hort_planes);
 
+  /**
+   * @brief Keeps the points of cloud_seg_body closer than point_to_plane_inlier_dist
+   * to the detected plane. All the residuals are computed in a single pass over the
+   * mapped point coordinates, and Gij is accumulated block by block over the inliers.
+   *
+   * @param det_plane_map_frame
+   * @param keyframe_pose
+   * @param cloud_seg_body: left untouched, it can be shared with other components
+   * @param Gij: sum of p * p^T over the homogeneous inlier points
+   * @return new cloud with the inlier points, in their original order
+   */
+  pcl::PointCloud<PointNormal>::Ptr filter_point_to_plane_inliers(
+      const g2o::Plane3D& det_plane_map_frame,
+      const Eigen::Isometry3d& keyframe_pose,
+      const pcl::PointCloud<PointNormal>::ConstPtr& cloud_seg_body,
+      Eigen::Matrix4d& Gij) const;
+
   /**
    * @brief
    *
@@ -223,6 +255,9 @@ class PlaneMapper {
   bool use_point_to_plane;
   double plane_information;
   double plane_dist_threshold;
+  double plane_maha_dist_threshold;
+  bool constant_covariance;
+  Eigen::Matrix<double, 6, 6> keyframe_pose_covariance;
   double plane_points_dist;
   double infinite_room_min_plane_length;
   double room_min_plane_length, room_max_plane_length;
@@ -44,8 +44,10 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <g2o/vertex_room.hpp>
 #include <s_graphs/backend/graph_slam.hpp>
 #include <s_graphs/common/infinite_rooms.hpp>
+#include <memory>
 #include <s_graphs/common/plane_utils.hpp>
 #include <s_graphs/common/planes.hpp>
+#include <s_graphs/common/room_registry.hpp>
 #include <s_graphs/common/rooms.hpp>
 #include <string>
 
@@ -133,6 +135,26 @@ class MapperUtils {
     graph_slam->add_robust_kernel(edge, "Huber", 1.0);
   }
 
+  /**
+   * @brief Picks which of the two mapped planes of a room corresponds to a detected
+   * plane, from the orientation of their normals
+   *
+   * @param det_plane
+   * @param mapped_plane1
+   * @param mapped_plane2
+   * @return the detected plane itself if it already is one of the mapped planes
+   */
+  const VerticalPlanes& match_room_plane(const VerticalPlanes& det_plane,
+                                         const VerticalPlanes& mapped_plane1,
+                                         const VerticalPlanes& mapped_plane2) const {
+    if (det_plane.id == mapped_plane1.id || det_plane.id == mapped_plane2.id)
+      return det_plane;
+    if (det_plane.plane_node->estimate().coeffs().head(3).dot(
+            mapped_plane1.plane_node->estimate().coeffs().head(3)) > 0)
+      return mapped_plane1;
+    return mapped_plane2;
+  }
+
   bool check_plane_ids(const std::set<g2o::HyperGraph::Edge*>& plane_edges,
                        const g2o::VertexPlane* plane_node) {
     for (auto edge_itr = plane_edges.begin(); edge_itr != plane_edges.end();
@@ -236,6 +258,7 @@ class InfiniteRoomMapper : public MapperUtils {
   /**
    * @brief
    *
+   * @param graph_slam
    * @param plane_type
    * @param corr_pose
    * @param plane1
@@ -248,6 +271,7 @@ class InfiniteRoomMapper : public MapperUtils {
    * @return
    */
   int associate_infinite_rooms(
+      std::shared_ptr<GraphSLAM>& graph_slam,
       const int& plane_type,
       const Eigen::Isometry3d& room_center,
       const VerticalPlanes& plane1,
@@ -263,13 +287,13 @@ class InfiniteRoomMapper : public MapperUtils {
    * @brief
    *
    * @param plane_type
-   * @param plane_edges
+   * @param plane_id
    * @param corr_node
-   * @return Success or failure
+   * @return true if the plane bounds the infinite room
    */
   bool check_infinite_room_ids(const int plane_type,
-                               const std::set<g2o::HyperGraph::Edge*>& plane_edges,
-                               const g2o::VertexRoom* corr_node);
+                               const int plane_id,
+                               const g2o::VertexRoom* corr_node) const;
 
  private:
   /**
@@ -288,6 +312,7 @@ class InfiniteRoomMapper : public MapperUtils {
   double infinite_room_dist_threshold;
   bool use_parallel_plane_constraint, use_perpendicular_plane_constraint;
   double dupl_plane_matching_information;
+  std::unique_ptr<RoomRegistry> room_registry;
 };
 
 /**
@@ -377,6 +402,7 @@ class FiniteRoomMapper : public MapperUtils {
   /**
    * @brief
    *
+   * @param graph_slam
    * @param room_pose
    * @param rooms_vec
    * @param x_vert_planes
@@ -388,7 +414,8 @@ class FiniteRoomMapper : public MapperUtils {
    * @param detected_mapped_plane_pairs
    * @return
    */
-  int associate_rooms(const Eigen::Isometry3d& room_center,
+  int associate_rooms(std::shared_ptr<GraphSLAM>& graph_slam,
+                      const Eigen::Isometry3d& room_center,
                       const std::unordered_map<int, Rooms>& rooms_vec,
                       const std::unordered_map<int, VerticalPlanes>& x_vert_planes,
                       const std::unordered_map<int, VerticalPlanes>& y_vert_planes,
@@ -402,14 +429,11 @@ class FiniteRoomMapper : public MapperUtils {
   /**
    * @brief
    *
-   * @param plane_type
-   * @param plane_edges
+   * @param plane_id
    * @param room_node
-   * @return Success or failure
+   * @return true if the plane bounds the room
    */
-  bool check_room_ids(const int plane_type,
-                      const std::set<g2o::HyperGraph::Edge*>& plane_edges,
-                      const g2o::VertexRoom* room_node);
+  bool check_room_ids(const int plane_id, const g2o::VertexRoom* room_node) const;
   bool check_plane_ids(const std::set<g2o::HyperGraph::Edge*>& plane_edges,
                        const g2o::VertexPlane* plane_node);
   /**
@@ -511,6 +535,7 @@ class FiniteRoomMapper : public MapperUtils {
   double room_dist_threshold;
   bool use_parallel_plane_constraint, use_perpendicular_plane_constraint;
   double dupl_plane_matching_information;
+  std::unique_ptr<RoomRegistry> room_registry;
 };
 
 }  // namespace s_graphs
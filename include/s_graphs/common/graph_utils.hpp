@@ -183,9 +183,11 @@ class GraphUtils {
                                    GraphSLAM* compressed_graph);
 
   /**
-   * @brief
+   * @brief Copy the optimized estimates of the compressed graph back to the
+   * entities and mark them as updated in the covisibility graph.
    *
    * @param compressed_graph
+   * @param covisibility_graph
    * @param keyframes
    * @param x_vert_planes
    * @param y_vert_planes
@@ -195,6 +197,7 @@ class GraphUtils {
    * @param floors_vec
    */
   static void update_graph(const std::unique_ptr<GraphSLAM>& compressed_graph,
+                           const std::shared_ptr<GraphSLAM>& covisibility_graph,
                            std::map<int, KeyFrame::Ptr> keyframes,
                            std::unordered_map<int, VerticalPlanes>& x_vert_planes,
                            std::unordered_map<int, VerticalPlanes>& y_vert_planes,
@@ -203,6 +206,31 @@ class GraphUtils {
                            std::unordered_map<int, InfiniteRooms>& y_infinite_rooms,
                            std::unordered_map<int, Floors>& floors_vec);
 
+  /**
+   * @brief Copy the estimates of the given vertices of the compressed graph back to
+   * the entities and mark them as updated in the covisibility graph. Used to apply
+   * the iterates of a running optimization without walking the whole graph.
+   *
+   * @param vertices: vertices of the compressed graph to copy
+   * @param covisibility_graph
+   * @param keyframes
+   * @param x_vert_planes
+   * @param y_vert_planes
+   * @param rooms_vec
+   * @param x_infinite_rooms
+   * @param y_infinite_rooms
+   * @param floors_vec
+   */
+  static void update_graph(const std::vector<g2o::OptimizableGraph::Vertex*>& vertices,
+                           const std::shared_ptr<GraphSLAM>& covisibility_graph,
+                           const std::map<int, KeyFrame::Ptr>& keyframes,
+                           std::unordered_map<int, VerticalPlanes>& x_vert_planes,
+                           std::unordered_map<int, VerticalPlanes>& y_vert_planes,
+                           std::unordered_map<int, Rooms>& rooms_vec,
+                           std::unordered_map<int, InfiniteRooms>& x_infinite_rooms,
+                           std::unordered_map<int, InfiniteRooms>& y_infinite_rooms,
+                           std::unordered_map<int, Floors>& floors_vec);
+
   /**
    * @brief Set the marginalize info object
    *
@@ -0,0 +1,139 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef GRID_INDEX_HPP
+#define GRID_INDEX_HPP
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace s_graphs {
+
+/**
+ * @brief Uniform 2D grid over the xy plane used to find the entities (rooms, infinite
+ * rooms, ...) close to a position without scanning all of them
+ */
+class GridIndex2D {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /**
+   * @brief Constructor for class GridIndex2D
+   *
+   * @param cell_size: side of the grid cells, queries are cheapest when the radius is
+   * not larger than the cell size
+   */
+  GridIndex2D(const double cell_size) : cell_size(cell_size) {}
+
+  /**
+   * @brief Adds an entity to the grid
+   *
+   * @param index: user defined index of the entity (id, position in a vector, ...)
+   * @param position
+   */
+  void insert(const int index, const Eigen::Vector2d& position) {
+    cells[cell_key(position)].emplace_back(index, position);
+  }
+
+  /**
+   * @brief Removes an entity from the grid
+   *
+   * @param index
+   * @param position: position the entity was inserted with
+   */
+  void erase(const int index, const Eigen::Vector2d& position) {
+    auto cell = cells.find(cell_key(position));
+    if (cell == cells.end()) return;
+    auto& entries = cell->second;
+    entries.erase(std::remove_if(entries.begin(),
+                                 entries.end(),
+                                 [&](const std::pair<int, Eigen::Vector2d>& entry) {
+                                   return entry.first == index;
+                                 }),
+                  entries.end());
+    if (entries.empty()) cells.erase(cell);
+  }
+
+  /**
+   * @brief Removes all the entities
+   */
+  void clear() { cells.clear(); }
+
+  /**
+   * @brief Finds the entities closer than radius to the position
+   *
+   * @param position
+   * @param radius
+   * @return indices of the entities, in ascending order
+   */
+  std::vector<int> query(const Eigen::Vector2d& position, const double radius) const {
+    std::vector<int> indices;
+    const int64_t reach = static_cast<int64_t>(std::ceil(radius / cell_size));
+    const int64_t cx = static_cast<int64_t>(std::floor(position.x() / cell_size));
+    const int64_t cy = static_cast<int64_t>(std::floor(position.y() / cell_size));
+
+    for (int64_t x = cx - reach; x <= cx + reach; ++x) {
+      for (int64_t y = cy - reach; y <= cy + reach; ++y) {
+        auto cell = cells.find(pack(x, y));
+        if (cell == cells.end()) continue;
+        for (const auto& entry : cell->second) {
+          if ((entry.second - position).norm() < radius) indices.push_back(entry.first);
+        }
+      }
+    }
+
+    std::sort(indices.begin(), indices.end());
+    return indices;
+  }
+
+ private:
+  uint64_t cell_key(const Eigen::Vector2d& position) const {
+    return pack(static_cast<int64_t>(std::floor(position.x() / cell_size)),
+                static_cast<int64_t>(std::floor(position.y() / cell_size)));
+  }
+
+  static uint64_t pack(const int64_t x, const int64_t y) {
+    return (static_cast<uint64_t>(x) << 32) ^ (static_cast<uint64_t>(y) & 0xffffffff);
+  }
+
+ private:
+  double cell_size;
+  std::unordered_map<uint64_t, std::vector<std::pair<int, Eigen::Vector2d>>> cells;
+};
+
+}  // namespace s_graphs
+
+#endif  // GRID_INDEX_HPP
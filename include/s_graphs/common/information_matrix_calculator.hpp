@@ -93,7 +93,7 @@ class InformationMatrixCalculator {
    * @param relpose
    * @return Information matrix
    */
-  Eigen::MatrixXd calc_information_matrix(
+  Eigen::Matrix<double, 6, 6> calc_information_matrix(
       const pcl::PointCloud<PointT>::ConstPtr& cloud1,
       const pcl::PointCloud<PointT>::ConstPtr& cloud2,
       const Eigen::Isometry3d& relpose) const;
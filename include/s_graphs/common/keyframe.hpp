@@ -38,6 +38,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <boost/optional.hpp>
 #include <s_graphs/common/optimization_data.hpp>
 #include <s_graphs/common/planes.hpp>
+#include <s_graphs/common/voxel_covariance_map.hpp>
 #include <vector>
 
 #include "rclcpp/rclcpp.hpp"
@@ -121,6 +122,8 @@ struct KeyFrame {
   double accum_distance;   // accumulated distance from the first node (by
                            // scan_matching_odometry)
   pcl::PointCloud<PointT>::ConstPtr cloud;  // point cloud
+  VoxelCovarianceMap::ConstPtr
+      voxel_map;  // voxelized cloud, built when the keyframe is first a target
   pcl::PointCloud<PointNormal>::Ptr
       cloud_seg_body;  // semantically segmented pointcloud
   std::vector<int> x_plane_ids, y_plane_ids,
@@ -164,6 +167,7 @@ struct KeyFrameSnapshot {
   ~KeyFrameSnapshot();
 
  public:
+  long id = -1;                             // id of the keyframe, -1 if unknown
   Eigen::Isometry3d pose;                   // pose estimated by graph optimization
   pcl::PointCloud<PointT>::ConstPtr cloud;  // point cloud
   bool k_marginalized = false;              // whether keyframe is marginalized
@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef KEYFRAME_INDEX_HPP
+#define KEYFRAME_INDEX_HPP
+
+#include <map>
+#include <s_graphs/common/keyframe.hpp>
+#include <vector>
+
+namespace s_graphs {
+
+/**
+ * @brief Keyframes kept sorted by stamp, so that the trajectory can be walked in time
+ * order without sorting the keyframe map. Spatial queries are served by
+ * KeyFrameStateStore.
+ */
+class KeyFrameIndex {
+ public:
+  /**
+   * @brief Adds a keyframe. Keyframes usually arrive in stamp order, in which case
+   * this is an append.
+   *
+   * @param keyframe
+   */
+  void insert(const KeyFrame::Ptr& keyframe);
+
+  /**
+   * @brief Replaces the content of the index with the given keyframes
+   *
+   * @param keyframes
+   */
+  void rebuild(const std::map<int, KeyFrame::Ptr>& keyframes);
+
+  void clear();
+
+  bool empty() const { return stamp_order.empty(); }
+
+  size_t size() const { return stamp_order.size(); }
+
+  /**
+   * @brief
+   *
+   * @return all the keyframes in stamp order
+   */
+  const std::vector<KeyFrame::Ptr>& by_stamp() const { return stamp_order; }
+
+ private:
+  std::vector<KeyFrame::Ptr> stamp_order;
+};
+
+}  // namespace s_graphs
+
+#endif  // KEYFRAME_INDEX_HPP
@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef KEYFRAME_STATE_STORE_HPP
+#define KEYFRAME_STATE_STORE_HPP
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <map>
+#include <s_graphs/backend/graph_slam.hpp>
+#include <s_graphs/common/keyframe.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace s_graphs {
+
+/**
+ * @brief Contiguous copy of the keyframe state (stamps, accumulated distances, poses
+ * and flags), one array per field and one slot per keyframe. Bulk queries run over
+ * these arrays instead of following the keyframe and vertex pointers.
+ */
+class KeyFrameStateStore {
+ public:
+  enum Flags : uint8_t { MARGINALIZED = 1 << 0 };
+
+  /**
+   * @brief Appends a keyframe and copies its current state
+   *
+   * @param keyframe
+   */
+  void insert(const KeyFrame::Ptr& keyframe);
+
+  /**
+   * @brief Replaces the content of the store with the given keyframes
+   *
+   * @param keyframes
+   */
+  void rebuild(const std::map<int, KeyFrame::Ptr>& keyframes);
+
+  /**
+   * @brief Copies again the state of the keyframes whose vertex was updated in the
+   * graph since the last sync. Returns immediately if the graph did not change.
+   *
+   * @param graph
+   */
+  void sync(const GraphSLAM& graph);
+
+  void clear();
+
+  size_t size() const { return keyframes.size(); }
+
+  bool empty() const { return keyframes.empty(); }
+
+  /**
+   * @brief
+   *
+   * @param id
+   * @return slot of the keyframe with this id, -1 if it is not stored
+   */
+  int slot(const long id) const;
+
+  const KeyFrame::Ptr& keyframe(const size_t slot) const { return keyframes[slot]; }
+
+  Eigen::Isometry3d pose(const size_t slot) const;
+
+  bool has_flag(const size_t slot, const Flags flag) const {
+    return flags[slot] & flag;
+  }
+
+  /**
+   * @brief Collects the slots of the keyframes closer than radius to center in the
+   * xy plane and with an accumulated distance up to max_accum_distance
+   *
+   * @param center
+   * @param radius
+   * @param max_accum_distance
+   * @param found_slots
+   */
+  void find_near(const Eigen::Vector2d& center,
+                 const double radius,
+                 const double max_accum_distance,
+                 std::vector<size_t>& found_slots) const;
+
+  /**
+   * @brief
+   *
+   * @return snapshots of all the keyframes, in slot order
+   */
+  std::vector<KeyFrameSnapshot::Ptr> create_snapshots() const;
+
+ private:
+  void write_state(const size_t slot, const uint64_t revision);
+
+ private:
+  std::vector<KeyFrame::Ptr> keyframes;
+  std::vector<long> ids;
+  std::vector<double> stamps;
+  std::vector<double> accum_distances;
+  std::vector<double> pos_x, pos_y, pos_z;
+  std::vector<double> rot_x, rot_y, rot_z, rot_w;
+  std::vector<uint8_t> flags;
+  std::vector<uint64_t> revisions;  // vertex revision of the stored state
+
+  std::unordered_map<long, size_t> slots;
+  uint64_t synced_revision = 0;
+};
+
+}  // namespace s_graphs
+
+#endif  // KEYFRAME_STATE_STORE_HPP
@@ -32,6 +32,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #ifndef PLANE_UTILS_HPP
 #define PLANE_UTILS_HPP
 
+#include <g2o/types/slam3d/isometry3d_mappings.h>
 #include <g2o/types/slam3d/vertex_se3.h>
 #include <pcl/common/angles.h>
 #include <pcl/common/common.h>
@@ -227,6 +228,24 @@ class PlaneUtils {
    * @return
    */
   static double plane_difference(g2o::Plane3D plane1, g2o::Plane3D plane2);
+
+  /**
+   * @brief Covariance of a detected plane once moved to the map frame. The pose and
+   * plane uncertainties are propagated to first order, J_p * C_p * J_p^T + J_l * C_l
+   * * J_l^T, with the jacobians of keyframe_pose * plane_body taken by central
+   * differences on the tangent spaces the vertices are updated on.
+   *
+   * @param keyframe_pose: map pose of the keyframe
+   * @param plane_body: plane detected in the keyframe
+   * @param pose_covariance: keyframe pose covariance [t, qx, qy, qz]
+   * @param plane_covariance: detection covariance [azimuth, elevation, distance]
+   * @return covariance of the plane in the map frame
+   */
+  static Eigen::Matrix3d plane_map_covariance(
+      const Eigen::Isometry3d& keyframe_pose,
+      const g2o::Plane3D& plane_body,
+      const Eigen::Matrix<double, 6, 6>& pose_covariance,
+      const Eigen::Matrix3d& plane_covariance);
 };
 }  // namespace s_graphs
 #endif  // PLANE_UTILS_HPP
@@ -105,7 +105,8 @@ class Planes {
                            // body frame
   pcl::PointCloud<PointNormal>::Ptr
       cloud_seg_map;           // segmented points of the plane in global map frame
-  Eigen::Matrix3d covariance;  // covariance of the landmark
+  Eigen::Matrix3d covariance =
+      Eigen::Matrix3d::Identity();  // covariance of the landmark
   std::vector<g2o::VertexSE3*> keyframe_node_vec;  // vector keyframe node instance
   std::vector<double> color;
   int revit_id;
@@ -32,8 +32,14 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #ifndef HDL_GRAPH_SLAM_REGISTRATIONS_HPP
 #define HDL_GRAPH_SLAM_REGISTRATIONS_HPP
 
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
 #include <pcl/registration/registration.h>
 
+#include <Eigen/Dense>
+#include <limits>
+#include <vector>
+
 namespace s_graphs {
 
 struct registration_params {
@@ -59,6 +65,38 @@ struct registration_params {
 boost::shared_ptr<pcl::Registration<pcl::PointXYZI, pcl::PointXYZI>>
 select_registration_method(registration_params params);
 
+/**
+ * @brief Outcome of the last alignment of a registration, with the squared distance
+ * from every aligned source point to its closest target point.
+ */
+struct RegistrationResult {
+  bool has_converged = false;
+  Eigen::Matrix4f final_transformation = Eigen::Matrix4f::Identity();
+  /** mean squared correspondence distance, as pcl::Registration::getFitnessScore */
+  double fitness_score = std::numeric_limits<double>::max();
+  /** fraction of the source points closer to the target than the inlier distance */
+  float inlier_fraction = 0.0f;
+  std::vector<float> sq_distances;
+};
+
+/**
+ * @brief Evaluate the last alignment of a registration. FAST_GICP keeps the
+ * correspondences of its final iteration and they are reused, the other methods need
+ * one nearest neighbour search per point.
+ *
+ * @param registration Registration that has just aligned its source
+ * @param aligned Source aligned by the registration
+ * @param inlier_distance Maximum correspondence distance of an inlier
+ * @param max_range Maximum squared distance counted in the fitness score, as in
+ * pcl::Registration::getFitnessScore
+ * @return Registration result
+ */
+RegistrationResult get_registration_result(
+    pcl::Registration<pcl::PointXYZI, pcl::PointXYZI>& registration,
+    const pcl::PointCloud<pcl::PointXYZI>& aligned,
+    const double inlier_distance,
+    const double max_range = std::numeric_limits<double>::max());
+
 }  // namespace s_graphs
 
 #endif  //
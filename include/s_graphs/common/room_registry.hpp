@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef ROOM_REGISTRY_HPP
+#define ROOM_REGISTRY_HPP
+
+#include <Eigen/Dense>
+#include <s_graphs/backend/graph_slam.hpp>
+#include <s_graphs/common/grid_index.hpp>
+#include <s_graphs/common/infinite_rooms.hpp>
+#include <s_graphs/common/rooms.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace s_graphs {
+
+/**
+ * @brief Spatial index over the room and infinite room centres, and the plane to room
+ * membership as adjacency lists, so that the room mappers answer association and
+ * duplicate checks with local queries. It is rebuilt lazily, only when a room was
+ * added, removed or moved in the graph since the last sync.
+ */
+class RoomRegistry {
+ public:
+  /**
+   * @brief Constructor for class RoomRegistry
+   *
+   * @param cell_size: side of the grid cells, best set to the usual query radius
+   */
+  RoomRegistry(const double cell_size);
+
+  /**
+   * @brief Re-indexes the rooms if any of them changed in the graph
+   *
+   * @param graph_slam: graph holding the room vertices
+   * @param rooms_vec
+   */
+  void sync_rooms(const GraphSLAM& graph_slam,
+                  const std::unordered_map<int, Rooms>& rooms_vec);
+
+  /**
+   * @brief Re-indexes the infinite rooms if any of them changed in the graph
+   *
+   * @param graph_slam: graph holding the infinite room vertices
+   * @param x_infinite_rooms
+   * @param y_infinite_rooms
+   */
+  void sync_infinite_rooms(
+      const GraphSLAM& graph_slam,
+      const std::unordered_map<int, InfiniteRooms>& x_infinite_rooms,
+      const std::unordered_map<int, InfiniteRooms>& y_infinite_rooms);
+
+  /**
+   * @brief
+   *
+   * @param position: xy position in the map frame
+   * @param radius
+   * @return ids of the rooms whose centre is closer than radius, in ascending order
+   */
+  std::vector<int> find_rooms(const Eigen::Vector2d& position,
+                              const double radius) const;
+
+  /**
+   * @brief
+   *
+   * @param position: xy position in the map frame
+   * @param radius
+   * @return id of the closest room whose centre is closer than radius, -1 if none
+   */
+  int find_nearest_room(const Eigen::Vector2d& position, const double radius) const;
+
+  /**
+   * @brief
+   *
+   * @param plane_type: X_VERT_PLANE or Y_VERT_PLANE
+   * @param position: xy position in the map frame
+   * @param radius
+   * @return id of the closest infinite room of the class whose centre is closer than
+   * radius, -1 if none
+   */
+  int find_nearest_infinite_room(const int plane_type,
+                                 const Eigen::Vector2d& position,
+                                 const double radius) const;
+
+  /**
+   * @brief Infinite rooms are unbounded along their planes, so they are compared on
+   * the coordinate across them only (x for X_VERT_PLANE, y for Y_VERT_PLANE)
+   *
+   * @param plane_type: X_VERT_PLANE or Y_VERT_PLANE
+   * @param coordinate
+   * @param radius
+   * @return ids of the infinite rooms of the class whose centre coordinate is closer
+   * than radius, in ascending order
+   */
+  std::vector<int> find_infinite_rooms(const int plane_type,
+                                       const double coordinate,
+                                       const double radius) const;
+
+  /**
+   * @brief
+   *
+   * @param plane1_id
+   * @param plane2_id
+   * @return id of a room bounded by both planes, -1 if none
+   */
+  int find_room_with_planes(const int plane1_id, const int plane2_id) const;
+
+  /**
+   * @brief
+   *
+   * @param plane_type: X_VERT_PLANE or Y_VERT_PLANE
+   * @param plane1_id
+   * @param plane2_id
+   * @return id of an infinite room of the class bounded by both planes, -1 if none
+   */
+  int find_infinite_room_with_planes(const int plane_type,
+                                     const int plane1_id,
+                                     const int plane2_id) const;
+
+  /**
+   * @brief
+   *
+   * @param room_id
+   * @param plane_id
+   * @return true if the plane bounds the room
+   */
+  bool room_has_plane(const int room_id, const int plane_id) const;
+
+  /**
+   * @brief
+   *
+   * @param plane_type: X_VERT_PLANE or Y_VERT_PLANE
+   * @param infinite_room_id
+   * @param plane_id
+   * @return true if the plane bounds the infinite room
+   */
+  bool infinite_room_has_plane(const int plane_type,
+                               const int infinite_room_id,
+                               const int plane_id) const;
+
+ private:
+  struct InfiniteRoomIndex {
+    InfiniteRoomIndex(const double cell_size) : grid(cell_size) {}
+
+    GridIndex2D grid;
+    std::unordered_map<int, Eigen::Vector2d> positions;
+    std::vector<std::pair<double, int>> coordinates;  // sorted across the planes
+    std::unordered_map<int, std::vector<int>> plane_rooms;
+  };
+
+  void index_infinite_rooms(
+      const std::unordered_map<int, InfiniteRooms>& infinite_rooms,
+      const int axis,
+      InfiniteRoomIndex& index);
+
+  const InfiniteRoomIndex* infinite_room_index(const int plane_type) const;
+
+ private:
+  GridIndex2D room_grid;
+  std::unordered_map<int, Eigen::Vector2d> room_positions;
+  std::unordered_map<int, std::vector<int>> plane_rooms;
+  InfiniteRoomIndex x_infinite_room_index, y_infinite_room_index;
+
+  const GraphSLAM* rooms_graph;
+  const GraphSLAM* infinite_rooms_graph;
+  uint64_t rooms_revision;
+  uint64_t infinite_rooms_revision;
+};
+
+}  // namespace s_graphs
+
+#endif  // ROOM_REGISTRY_HPP
@@ -0,0 +1,127 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef TILED_MAP_CLOUD_HPP
+#define TILED_MAP_CLOUD_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <map>
+#include <s_graphs/common/keyframe.hpp>
+#include <s_graphs/common/map_cloud_generator.hpp>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace s_graphs {
+
+/**
+ * @brief Map point cloud split in square xy tiles. Every keyframe belongs to the tile
+ * of its position, and only the tiles whose keyframes were added, moved or removed
+ * are regenerated with MapCloudGenerator.
+ */
+class TiledMapCloud {
+ public:
+  using PointT = pcl::PointXYZI;
+  typedef std::pair<int, int> TileKey;
+  typedef std::vector<std::pair<TileKey, pcl::PointCloud<PointT>::Ptr>> TileClouds;
+
+  /**
+   * @brief Constructor of class TiledMapCloud
+   *
+   * @param resolution: voxel size of the map, <= 0 to keep all the points
+   * @param tile_size: side of the tiles
+   * @param pose_tolerance: translation [m] and rotation [rad] under which a keyframe
+   * is not considered moved
+   */
+  TiledMapCloud(const double resolution,
+                const double tile_size,
+                const double pose_tolerance);
+
+  /**
+   * @brief Brings the tiles up to date with the keyframes. Once time_budget seconds
+   * are spent, the remaining tiles are left for the next calls.
+   *
+   * @param keyframes
+   * @param time_budget
+   * @return true if all the tiles are up to date
+   */
+  bool update(const std::vector<KeyFrameSnapshot::Ptr>& keyframes,
+              const double time_budget);
+
+  /**
+   * @brief
+   *
+   * @return map point cloud assembled from the tiles
+   */
+  pcl::PointCloud<PointT>::Ptr get_map();
+
+  /**
+   * @brief
+   *
+   * @return tiles rebuilt by the last update, with an empty cloud for the tiles
+   * that lost all their keyframes
+   */
+  TileClouds get_updated_tiles() const;
+
+  void clear();
+
+ private:
+  struct KeyFrameEntry {
+    TileKey tile;
+    KeyFrameSnapshot::Ptr keyframe;  // snapshot the tile is generated from
+  };
+
+  struct Tile {
+    std::set<long> keyframe_ids;
+    pcl::PointCloud<PointT>::Ptr cloud;  // null until the tile is first built
+  };
+
+  TileKey tile_key(const Eigen::Isometry3d& pose) const;
+  void rebuild_tile(const TileKey& key);
+
+ private:
+  double resolution;
+  double tile_size;
+  double pose_tolerance;
+
+  std::map<long, KeyFrameEntry> keyframe_entries;
+  std::map<TileKey, Tile> tiles;
+  std::set<TileKey> pending_tiles;  // changed tiles not rebuilt yet
+  std::vector<TileKey> updated_tiles;
+  MapCloudGenerator map_cloud_generator;
+  pcl::PointCloud<PointT>::Ptr map_cloud;  // cached, reset when a tile changes
+};
+
+}  // namespace s_graphs
+
+#endif  // TILED_MAP_CLOUD_HPP
@@ -0,0 +1,218 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef TIME_SERIES_BUFFER_HPP
+#define TIME_SERIES_BUFFER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <s_graphs/common/keyframe.hpp>
+
+namespace s_graphs {
+
+/**
+ * @brief Bounded buffer of sensor samples sorted by stamp. Samples are expected
+ * mostly in order and are appended, late samples are inserted at their place. When
+ * the capacity is exceeded the oldest samples are dropped.
+ */
+template <typename T>
+class TimeSeriesBuffer {
+ public:
+  struct Sample {
+    double stamp;  // seconds
+    T data;
+  };
+
+  /**
+   * @brief Samples around a stamp. before is the last sample at or before the stamp
+   * and after the first one after it, any of them may be missing.
+   */
+  struct Bracket {
+    const Sample* before = nullptr;
+    const Sample* after = nullptr;
+    double alpha = 0.0;  // interpolation weight of after, 0 at before
+
+    /**
+     * @brief Whether the closest bracketing sample is within max_time_diff
+     */
+    bool is_within(const double stamp, const double max_time_diff) const {
+      double time_diff = std::numeric_limits<double>::max();
+      if (before) time_diff = stamp - before->stamp;
+      if (after) time_diff = std::min(time_diff, after->stamp - stamp);
+      return time_diff <= max_time_diff;
+    }
+  };
+
+  /**
+   * @brief Constructor for class TimeSeriesBuffer
+   *
+   * @param capacity: max number of samples kept
+   */
+  TimeSeriesBuffer(const size_t capacity) : capacity(capacity) {}
+
+  /**
+   * @brief Adds a sample
+   *
+   * @param stamp
+   * @param data
+   */
+  void insert(const double stamp, const T& data) {
+    if (samples.empty() || samples.back().stamp <= stamp) {
+      samples.push_back(Sample{stamp, data});
+    } else {
+      samples.insert(upper_bound(stamp), Sample{stamp, data});
+    }
+    while (samples.size() > capacity) samples.pop_front();
+  }
+
+  /**
+   * @brief Finds the samples around a stamp with a binary search
+   *
+   * @param stamp
+   * @return Bracket of the stamp
+   */
+  Bracket bracket(const double stamp) const {
+    Bracket bracket;
+    auto after = upper_bound(stamp);
+    if (after != samples.end()) bracket.after = &(*after);
+    if (after != samples.begin()) bracket.before = &(*std::prev(after));
+    if (bracket.before && bracket.after) {
+      bracket.alpha = (stamp - bracket.before->stamp) /
+                      (bracket.after->stamp - bracket.before->stamp);
+    }
+    return bracket;
+  }
+
+  /**
+   * @brief Drops the samples older than stamp, except the last one before it so
+   * that the stamp can still be bracketed
+   *
+   * @param stamp
+   */
+  void erase_before(const double stamp) {
+    auto first = upper_bound(stamp);
+    if (first == samples.begin()) return;
+    samples.erase(samples.begin(), std::prev(first));
+  }
+
+  bool empty() const { return samples.empty(); }
+  size_t size() const { return samples.size(); }
+  double front_stamp() const { return samples.front().stamp; }
+  double back_stamp() const { return samples.back().stamp; }
+
+ private:
+  typename std::deque<Sample>::const_iterator upper_bound(const double stamp) const {
+    return std::upper_bound(
+        samples.begin(),
+        samples.end(),
+        stamp,
+        [](const double stamp, const Sample& sample) { return stamp < sample.stamp; });
+  }
+
+ private:
+  size_t capacity;
+  std::deque<Sample> samples;
+};
+
+/**
+ * @brief Associates keyframes with the samples of a time series. A watermark on the
+ * keyframe ids makes every call visit only the keyframes that were not decided yet.
+ */
+template <typename T>
+class TimeSeriesAssociation {
+ public:
+  typedef typename TimeSeriesBuffer<T>::Bracket Bracket;
+
+  /**
+   * @brief Constructor for class TimeSeriesAssociation
+   *
+   * @param capacity: max number of buffered samples
+   * @param max_time_diff: max time between a keyframe and its closest sample
+   */
+  TimeSeriesAssociation(const size_t capacity, const double max_time_diff)
+      : buffer(capacity),
+        max_time_diff(max_time_diff),
+        watermark(std::numeric_limits<int>::min()) {}
+
+  /**
+   * @brief Adds a sample to the time series
+   *
+   * @param stamp
+   * @param data
+   */
+  void insert(const double stamp, const T& data) { buffer.insert(stamp, data); }
+
+  /**
+   * @brief Calls associate_keyframe(keyframe, bracket) for the keyframes newer than
+   * the watermark which have a sample close enough. A keyframe is only decided once
+   * a sample after it was received, so it can be interpolated. The walk stops,
+   * without moving the watermark, when associate_keyframe returns false.
+   *
+   * @param keyframes
+   * @param associate_keyframe
+   */
+  template <typename Function>
+  void associate(const std::map<int, KeyFrame::Ptr>& keyframes,
+                 Function associate_keyframe) {
+    if (buffer.empty()) return;
+
+    double last_stamp = -1.0;
+    for (auto keyframe = keyframes.upper_bound(watermark);
+         keyframe != keyframes.end();
+         keyframe++) {
+      double stamp = keyframe->second->stamp.seconds();
+      if (stamp > buffer.back_stamp()) break;
+
+      Bracket bracket = buffer.bracket(stamp);
+      if (bracket.is_within(stamp, max_time_diff) &&
+          !associate_keyframe(keyframe->second, bracket)) {
+        break;
+      }
+      watermark = keyframe->first;
+      last_stamp = stamp;
+    }
+
+    if (last_stamp >= 0.0) buffer.erase_before(last_stamp - max_time_diff);
+  }
+
+ private:
+  TimeSeriesBuffer<T> buffer;
+  double max_time_diff;
+  int watermark;  // id of the last decided keyframe
+};
+
+}  // namespace s_graphs
+
+#endif  // TIME_SERIES_BUFFER_HPP
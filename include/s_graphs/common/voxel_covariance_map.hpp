@@ -0,0 +1,163 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef VOXEL_COVARIANCE_MAP_HPP
+#define VOXEL_COVARIANCE_MAP_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace s_graphs {
+
+/**
+ * @brief Voxelized gaussian map of point clouds, the target distribution of VGICP.
+ * Every voxel keeps the mean and covariance of the points inside it. Clouds are
+ * inserted and removed by id, the sums each cloud added to the voxels are kept so
+ * that removing it only updates the voxels it touched.
+ */
+class VoxelCovarianceMap {
+ public:
+  using PointT = pcl::PointXYZI;
+  using Ptr = std::shared_ptr<VoxelCovarianceMap>;
+  using ConstPtr = std::shared_ptr<const VoxelCovarianceMap>;
+
+  struct Voxel {
+    Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d covariance = Eigen::Matrix3d::Identity();
+    int num_points = 0;
+  };
+
+  /**
+   * @brief Constructor for class VoxelCovarianceMap
+   *
+   * @param resolution: side of the voxels
+   * @param min_points_per_voxel: voxels with fewer points are not used as targets
+   */
+  VoxelCovarianceMap(const double resolution, const int min_points_per_voxel = 3);
+
+  /**
+   * @brief Adds a cloud to the map, replacing the cloud with the same id
+   *
+   * @param id
+   * @param cloud
+   * @param pose: pose of the cloud in the map frame
+   */
+  void insert(const int id,
+              const pcl::PointCloud<PointT>& cloud,
+              const Eigen::Isometry3d& pose = Eigen::Isometry3d::Identity());
+
+  /**
+   * @brief Removes a cloud from the map
+   *
+   * @param id
+   * @return false if there was no cloud with this id
+   */
+  bool remove(const int id);
+
+  /**
+   * @brief Whether a cloud with this id is in the map
+   *
+   * @param id
+   */
+  bool contains(const int id) const;
+
+  /**
+   * @brief Finds the voxel containing a point. The caller must hold lock_shared()
+   * while it uses the voxel.
+   *
+   * @param point: point in the map frame
+   * @return voxel, nullptr if it is empty or has too few points
+   */
+  const Voxel* lookup(const Eigen::Vector3d& point) const;
+
+  /**
+   * @brief Shared lock of the map, held by the consumers reading voxels while other
+   * threads insert or remove clouds
+   */
+  std::shared_lock<std::shared_mutex> lock_shared() const;
+
+  /**
+   * @brief Means of the voxels, with the number of points as intensity
+   */
+  pcl::PointCloud<PointT>::Ptr means() const;
+
+  /**
+   * @brief Regularizes a covariance as a plane, as done by GICP
+   *
+   * @param covariance
+   * @return covariance with eigenvalues (1e-3, 1, 1)
+   */
+  static Eigen::Matrix3d regularize(const Eigen::Matrix3d& covariance);
+
+  double resolution() const { return voxel_resolution; }
+  size_t size() const;
+
+ private:
+  struct Sums {
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sum_outer = Eigen::Matrix3d::Zero();
+    int num_points = 0;
+
+    void add(const Eigen::Vector3d& point);
+    Sums& operator+=(const Sums& other);
+    Sums& operator-=(const Sums& other);
+  };
+
+  struct VoxelEntry {
+    Sums sums;
+    Voxel voxel;
+    bool valid = false;
+  };
+
+  uint64_t voxel_key(const Eigen::Vector3d& point) const;
+  void update_voxel(VoxelEntry& entry) const;
+  bool remove_unlocked(const int id);
+
+ private:
+  double voxel_resolution;
+  int min_points_per_voxel;
+
+  mutable std::shared_mutex mutex;
+  std::unordered_map<uint64_t, VoxelEntry> voxels;
+  std::unordered_map<int, std::vector<std::pair<uint64_t, Sums>>> clouds;
+};
+
+}  // namespace s_graphs
+
+#endif  // VOXEL_COVARIANCE_MAP_HPP
@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef VOXEL_MAP_REGISTRATION_HPP
+#define VOXEL_MAP_REGISTRATION_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/registration/registration.h>
+
+#include <Eigen/Dense>
+#include <s_graphs/common/voxel_covariance_map.hpp>
+#include <vector>
+
+namespace s_graphs {
+
+/**
+ * @brief Distribution to distribution registration (VGICP) of a source cloud against
+ * a VoxelCovarianceMap. The map can be shared by several registrations and kept
+ * alive across alignments, so its covariances are computed once per target cloud.
+ * Setting a point cloud as target builds a private map with the set resolution.
+ */
+class VoxelMapRegistration : public pcl::Registration<pcl::PointXYZI, pcl::PointXYZI> {
+ public:
+  using PointT = pcl::PointXYZI;
+
+  VoxelMapRegistration();
+
+  /**
+   * @brief Side of the voxels of the maps built by setInputTarget
+   */
+  void setResolution(const double resolution) { this->resolution = resolution; }
+  double getResolution() const { return resolution; }
+
+  /**
+   * @brief Number of neighbours used to estimate the source covariances
+   */
+  void setCorrespondenceRandomness(const int k) { k_correspondences = k; }
+
+  void setNumThreads(const int num_threads);
+
+  void setInputSource(const PointCloudSourceConstPtr& cloud) override;
+
+  void setInputTarget(const PointCloudTargetConstPtr& cloud) override;
+
+  /**
+   * @brief Uses a shared map as target. The map only serves the alignment, the
+   * cloud stays the PCL target, so getFitnessScore is still measured against the
+   * points the map was built from.
+   *
+   * @param map
+   * @param cloud: points the map was built from
+   */
+  void setTargetMap(const VoxelCovarianceMap::ConstPtr& map,
+                    const PointCloudTargetConstPtr& cloud);
+
+  const VoxelCovarianceMap::ConstPtr& getTargetMap() const { return target_map; }
+
+ protected:
+  void computeTransformation(PointCloudSource& output, const Matrix4& guess) override;
+
+ private:
+  void compute_source_covariances();
+
+  /**
+   * @brief Gauss-Newton system of the alignment at trans, with the perturbation
+   * applied on the left
+   *
+   * @return number of source points with a target voxel
+   */
+  int linearize(const Eigen::Isometry3d& trans,
+                Eigen::Matrix<double, 6, 6>& H,
+                Eigen::Matrix<double, 6, 1>& b) const;
+
+ private:
+  double resolution;
+  int k_correspondences;
+  int num_threads;
+
+  VoxelCovarianceMap::ConstPtr target_map;
+  std::vector<Eigen::Matrix3d> source_covariances;
+};
+
+}  // namespace s_graphs
+
+#endif  // VOXEL_MAP_REGISTRATION_HPP
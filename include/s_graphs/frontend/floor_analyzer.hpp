@@ -89,6 +89,35 @@ class FloorAnalyzer {
       const std::vector<s_graphs::msg::PlaneData>& current_x_vert_planes,
       const std::vector<s_graphs::msg::PlaneData>& current_y_vert_planes,
       std::vector<s_graphs::msg::PlaneData>& floor_plane_candidates_vec);
+
+ private:
+  /**
+   * @brief Direction corrected parameters of a wall, computed once per plane.
+   */
+  struct FloorPlaneCandidate {
+    const s_graphs::msg::PlaneData* plane;
+    Eigen::Vector3d normal;
+    float offset;       // signed distance of the wall along the x+y axis
+    double last_point;  // x (or y) coordinate of the last wall point
+  };
+
+  /**
+   * @brief Finds the widest pair of opposing parallel walls of one direction.
+   *
+   * Sweeps the walls by their last point, so the placement check costs
+   * O(n log n). Pairs rejected by the parallelism check add one step each.
+   *
+   * @param plane_type
+   * @param current_vert_planes
+   * @param floor_plane1: wall with positive normal, direction corrected
+   * @param floor_plane2: wall with negative normal, direction corrected
+   * @return true if a pair was found
+   */
+  bool find_widest_plane_pair(
+      const int plane_type,
+      const std::vector<s_graphs::msg::PlaneData>& current_vert_planes,
+      s_graphs::msg::PlaneData& floor_plane1,
+      s_graphs::msg::PlaneData& floor_plane2) const;
 };
 }  // namespace s_graphs
 
@@ -35,9 +35,12 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <g2o/types/slam3d/vertex_se3.h>
 
 #include <boost/format.hpp>
+#include <limits>
 #include <s_graphs/backend/graph_slam.hpp>
 #include <s_graphs/common/keyframe.hpp>
+#include <s_graphs/common/keyframe_state_store.hpp>
 #include <s_graphs/common/registrations.hpp>
+#include <s_graphs/common/voxel_map_registration.hpp>
 
 namespace s_graphs {
 
@@ -132,7 +135,7 @@ class LoopDetector {
   /**
    * @brief Detect loops and add them to the pose graph
    *
-   * @param keyframes
+   * @param keyframe_store
    *          Keyframes
    * @param new_keyframes
    *          Newly registered keyframes
@@ -140,12 +143,12 @@ class LoopDetector {
    *          Pose graph
    * @return Loop vector
    */
-  std::vector<Loop::Ptr> detect(const std::map<int, KeyFrame::Ptr>& keyframes,
+  std::vector<Loop::Ptr> detect(const KeyFrameStateStore& keyframe_store,
                                 const std::deque<KeyFrame::Ptr>& new_keyframes,
                                 s_graphs::GraphSLAM& covisibility_graph) {
     std::vector<Loop::Ptr> detected_loops;
     for (const auto& new_keyframe : new_keyframes) {
-      auto candidates = find_candidates(keyframes, new_keyframe);
+      auto candidates = find_candidates(keyframe_store, new_keyframe);
       auto loop = matching(candidates, new_keyframe, covisibility_graph);
       if (loop) {
         detected_loops.push_back(loop);
@@ -155,12 +158,12 @@ class LoopDetector {
     return detected_loops;
   }
 
-  std::vector<Loop::Ptr> detect(const std::map<int, KeyFrame::Ptr>& keyframes,
+  std::vector<Loop::Ptr> detect(const KeyFrameStateStore& keyframe_store,
                                 const std::vector<KeyFrame::Ptr>& new_keyframes,
                                 s_graphs::GraphSLAM& covisibility_graph) {
     std::vector<Loop::Ptr> detected_loops;
     for (const auto& new_keyframe : new_keyframes) {
-      auto candidates = find_candidates(keyframes, new_keyframe);
+      auto candidates = find_candidates(keyframe_store, new_keyframe);
       auto loop = matching(candidates, new_keyframe, covisibility_graph);
       if (loop) {
         detected_loops.push_back(loop);
@@ -185,13 +188,37 @@ class LoopDetector {
     return detected_loops;
   }
 
+  /**
+   * @brief Sets the cloud of a keyframe as registration target. With VOXEL_MAP the
+   * voxel map of the keyframe is built once and shared by all its matchings.
+   *
+   * @param keyframe
+   */
+  void set_registration_target(const KeyFrame::Ptr& keyframe) {
+    auto voxel_map_registration =
+        dynamic_cast<VoxelMapRegistration*>(registration.get());
+    if (!voxel_map_registration) {
+      registration->setInputTarget(keyframe->cloud);
+      return;
+    }
+
+    if (!keyframe->voxel_map ||
+        keyframe->voxel_map->resolution() != voxel_map_registration->getResolution()) {
+      auto voxel_map = std::make_shared<VoxelCovarianceMap>(
+          voxel_map_registration->getResolution());
+      voxel_map->insert(0, *keyframe->cloud);
+      keyframe->voxel_map = voxel_map;
+    }
+    voxel_map_registration->setTargetMap(keyframe->voxel_map, keyframe->cloud);
+  }
+
   bool matching(const KeyFrame::Ptr& keyframe,
                 const KeyFrame::Ptr& prev_keyframe,
                 Eigen::Matrix4f& relative_pose) {
     relative_pose.setIdentity();
     pcl::PointCloud<PointT>::Ptr aligned(new pcl::PointCloud<PointT>());
 
-    registration->setInputTarget(prev_keyframe->cloud);
+    set_registration_target(prev_keyframe);
     registration->setInputSource(keyframe->cloud);
     Eigen::Isometry3d prev_keyframe_estimate = prev_keyframe->node->estimate();
     prev_keyframe_estimate.linear() =
@@ -207,7 +234,11 @@ class LoopDetector {
     guess(2, 3) = 0.0;
     registration->align(*aligned, guess);
 
-    double score = registration->getFitnessScore(fitness_score_max_range);
+    double score = get_registration_result(*registration,
+                                           *aligned,
+                                           registration->getMaxCorrespondenceDistance(),
+                                           fitness_score_max_range)
+                       .fitness_score;
 
     if (!registration->hasConverged() || score > keyframe_matching_threshold) {
       return false;
@@ -229,14 +260,14 @@ class LoopDetector {
    * @brief Find loop candidates. A detected loop begins at one of #keyframes and ends
    * at #new_keyframe
    *
-   * @param keyframes
+   * @param keyframe_store
    *          Candidate keyframes of loop start
    * @param new_keyframe
    *          Loop end keyframe
    * @return Loop candidates
    */
   std::map<int, KeyFrame::Ptr> find_candidates(
-      const std::map<int, KeyFrame::Ptr>& keyframes,
+      const KeyFrameStateStore& keyframe_store,
       const KeyFrame::Ptr& new_keyframe) const {
     // too close to the last registered loop edge
     if (new_keyframe->accum_distance - last_edge_accum_distance <
@@ -247,23 +278,17 @@ class LoopDetector {
     std::map<int, KeyFrame::Ptr> candidates;
     // candidates.reserve(32);
 
-    for (const auto& k : keyframes) {
-      // traveled distance between keyframes is too small
-      if (new_keyframe->accum_distance - k.second->accum_distance <
-          accum_distance_thresh) {
-        continue;
-      }
-
-      const auto& pos1 = k.second->node->estimate().translation();
-      const auto& pos2 = new_keyframe->node->estimate().translation();
-
-      // estimated distance between keyframes is too small
-      double dist = (pos1.head<2>() - pos2.head<2>()).norm();
-      if (dist > distance_thresh) {
-        continue;
-      }
-
-      candidates.insert({k.first, k.second});
+    // traveled distance between keyframes must be large enough and estimated
+    // distance between them small enough
+    std::vector<size_t> candidate_slots;
+    keyframe_store.find_near(new_keyframe->node->estimate().translation().head<2>(),
+                             distance_thresh,
+                             new_keyframe->accum_distance - accum_distance_thresh,
+                             candidate_slots);
+
+    for (const size_t slot : candidate_slots) {
+      const KeyFrame::Ptr& keyframe = keyframe_store.keyframe(slot);
+      candidates.insert({keyframe->id(), keyframe});
     }
 
     return candidates;
@@ -290,7 +315,7 @@ class LoopDetector {
       return nullptr;
     }
 
-    registration->setInputTarget(new_keyframe->cloud);
+    set_registration_target(new_keyframe);
 
     double best_score = std::numeric_limits<double>::max();
     KeyFrame::Ptr best_matched;
@@ -331,7 +356,12 @@ class LoopDetector {
       }
       // std::cout << "." << std::flush;
 
-      double score = registration->getFitnessScore(fitness_score_max_range);
+      double score =
+          get_registration_result(*registration,
+                                  *aligned,
+                                  registration->getMaxCorrespondenceDistance(),
+                                  fitness_score_max_range)
+              .fitness_score;
       if (!registration->hasConverged() || score > best_score) {
         continue;
       }
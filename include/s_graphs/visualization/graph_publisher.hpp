@@ -41,6 +41,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <pcl/point_types.h>
 #include <pcl_conversions/pcl_conversions.h>
 
+#include <atomic>
 #include <boost/format.hpp>
 #include <cmath>
 #include <g2o/edge_infinite_room_plane.hpp>
@@ -57,6 +58,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <g2o/vertex_room.hpp>
 #include <g2o/vertex_wall.hpp>
 #include <iostream>
+#include <memory>
 #include <s_graphs/backend/floor_mapper.hpp>
 #include <s_graphs/backend/graph_slam.hpp>
 #include <s_graphs/backend/keyframe_mapper.hpp>
@@ -75,8 +77,10 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <s_graphs/frontend/loop_detector.hpp>
 #include <s_graphs/frontend/plane_analyzer.hpp>
 #include <s_graphs/visualization/graph_visualizer.hpp>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 #include "geometry_msgs/msg/point.hpp"
 #include "reasoning_msgs/msg/attribute.hpp"
@@ -97,7 +101,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 class GraphPublisher {
  public:
-  GraphPublisher();
+  GraphPublisher(const rclcpp::Node::SharedPtr node);
   ~GraphPublisher();
 
  public:
@@ -113,6 +117,41 @@ class GraphPublisher {
       const std::vector<s_graphs::InfiniteRooms>& x_infinite_rooms,
       const std::vector<s_graphs::InfiniteRooms>& y_infinite_rooms);
 
+  /**
+   * @brief Builds an incremental update of the graph. Only nodes whose vertex
+   * revision in the covisibility graph changed, new edges and entities removed
+   * since the previous call are added to graph_msg, unless a full snapshot is
+   * due (every graph_full_snapshot_ticks calls or after request_full_snapshot).
+   * In a diff, removed nodes have type "Removed" and removed edges carry a
+   * single attribute named "Removed".
+   *
+   * @param covisibility_graph
+   * @param graph_type
+   * @param x_vert_planes_prior
+   * @param y_vert_planes_prior
+   * @param rooms_vec_prior
+   * @param x_vert_planes
+   * @param y_vert_planes
+   * @param rooms_vec
+   * @param graph_msg: output graph, a full snapshot or a diff
+   * @return true if graph_msg holds a full snapshot
+   */
+  bool publish_graph_update(
+      const std::shared_ptr<s_graphs::GraphSLAM>& covisibility_graph,
+      const std::string& graph_type,
+      const std::vector<s_graphs::VerticalPlanes>& x_vert_planes_prior,
+      const std::vector<s_graphs::VerticalPlanes>& y_vert_planes_prior,
+      const std::vector<s_graphs::Rooms>& rooms_vec_prior,
+      const std::vector<s_graphs::VerticalPlanes>& x_vert_planes,
+      const std::vector<s_graphs::VerticalPlanes>& y_vert_planes,
+      const std::vector<s_graphs::Rooms>& rooms_vec,
+      reasoning_msgs::msg::Graph& graph_msg);
+
+  /**
+   * @brief Forces the next publish_graph_update to emit a full snapshot.
+   */
+  void request_full_snapshot();
+
   reasoning_msgs::msg::GraphKeyframes publish_graph_keyframes(
       const g2o::SparseOptimizer* local_graph,
       const std::vector<s_graphs::KeyFrame::Ptr>& keyframes);
@@ -121,6 +160,30 @@ class GraphPublisher {
                               const std::vector<s_graphs::Rooms>& rooms_vec);
 
  private:
+  reasoning_msgs::msg::Node make_plane_node(const int id,
+                                            const Eigen::Vector4d& coeffs) const;
+  reasoning_msgs::msg::Node make_room_node(const s_graphs::Rooms& room) const;
+  reasoning_msgs::msg::Edge make_edge(const int origin_node,
+                                      const int target_node,
+                                      const std::string& attribute_name) const;
+
+  /**
+   * @brief Refreshes the ids of the planes connected by Edge2Planes, only when
+   * the structure of the graph changed since the last scan.
+   */
+  void update_plane_pair_ids(const std::shared_ptr<s_graphs::GraphSLAM>& graph);
+
+ private:
+  int full_snapshot_ticks;
+  int tick_counter;
+  std::atomic<bool> snapshot_requested;
+
+  // id -> vertex revision of every node in the last published graph
+  std::unordered_map<int, uint64_t> published_nodes;
+  std::set<std::pair<int, int>> published_edges;
+
+  uint64_t plane_pairs_revision;
+  std::vector<int> plane_pair_ids;
 };
 
 #endif  // GRAPH_PUBLISHER_HPP
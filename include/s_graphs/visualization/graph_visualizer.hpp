@@ -53,6 +53,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <s_graphs/backend/room_mapper.hpp>
 #include <s_graphs/common/door_ways.hpp>
 #include <s_graphs/common/floors.hpp>
+#include <s_graphs/common/grid_index.hpp>
 #include <s_graphs/common/infinite_rooms.hpp>
 #include <s_graphs/common/keyframe.hpp>
 #include <s_graphs/common/optimization_data.hpp>
@@ -61,7 +62,12 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <s_graphs/common/rooms.hpp>
 #include <s_graphs/frontend/keyframe_updater.hpp>
 #include <s_graphs/frontend/plane_analyzer.hpp>
+#include <s_graphs/visualization/marker_cache.hpp>
+#include <s_graphs/visualization/plane_lod.hpp>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "geometry_msgs/msg/point.h"
 #include "geometry_msgs/msg/point_stamped.h"
@@ -92,7 +98,9 @@ class GraphVisualizer {
 
  public:
   /**
-   * @brief Creates a marker array
+   * @brief Creates the marker array of the current tick. Markers are retained between
+   * calls, so only the ones that changed since the previous call are returned,
+   * together with DELETE markers for the entities that disappeared.
    *
    * @param stamp
    * @param local_graph
@@ -109,12 +117,20 @@ class GraphVisualizer {
       const std::vector<VerticalPlanes>& x_plane_snapshot,
       const std::vector<VerticalPlanes>& y_plane_snapshot,
       const std::vector<HorizontalPlanes>& hort_plane_snapshot,
-      std::vector<InfiniteRooms> x_infinite_room_snapshot,
-      std::vector<InfiniteRooms> y_infinite_room_snapshot,
-      std::vector<Rooms> room_snapshot,
+      const std::vector<InfiniteRooms>& x_infinite_room_snapshot,
+      const std::vector<InfiniteRooms>& y_infinite_room_snapshot,
+      const std::vector<Rooms>& room_snapshot,
       double loop_detector_radius,
-      std::vector<KeyFrame::Ptr> keyframes,
-      std::vector<Floors> floors_vec);
+      const std::vector<KeyFrame::Ptr>& keyframes,
+      const std::vector<Floors>& floors_vec);
+
+  /**
+   * @brief Level of detail representation of the planes, updated on every call to
+   * create_marker_array
+   *
+   * @return const PlaneLOD&
+   */
+  const PlaneLOD& get_plane_lod() const { return *plane_lod; }
 
   /**
    * @brief Create a compressed graph object
@@ -217,11 +233,49 @@ class GraphVisualizer {
    */
   geometry_msgs::msg::Point compute_room_point(geometry_msgs::msg::Point room_p1);
 
+  /**
+   * @brief Compact state of a plane used to detect if its marker must be resent
+   *
+   * @param plane
+   * @return Eigen::VectorXd
+   */
+  Eigen::VectorXd compute_plane_state(const Planes& plane);
+
+  /**
+   * @brief Creates the marker of a plane at the given level of detail. Header,
+   * namespace, id and color are left to the caller.
+   *
+   * @param geometry
+   * @param level
+   * @return visualization_msgs::msg::Marker
+   */
+  visualization_msgs::msg::Marker create_plane_marker(const PlaneGeometryLOD& geometry,
+                                                      const int level);
+
+  /**
+   * @brief Submits the cluster markers of a room to the marker cache with ids stable
+   * across ticks. The markers of an entity go to the namespaces vertex_ns/<id> and
+   * edge_ns/<id>, numbered by cluster pair.
+   *
+   * @param cluster_array
+   * @param entity_id
+   * @param frame_id
+   * @param vertex_ns
+   * @param edge_ns
+   */
+  void submit_cluster_markers(const visualization_msgs::msg::MarkerArray& cluster_array,
+                              const int entity_id,
+                              const std::string& frame_id,
+                              const std::string& vertex_ns,
+                              const std::string& edge_ns);
+
  private:
   std::string map_frame_id;
   double color_r, color_g, color_b;
   std::shared_ptr<tf2_ros::TransformListener> tf_listener{nullptr};
   std::unique_ptr<tf2_ros::Buffer> tf_buffer;
+  std::unique_ptr<MarkerCache> marker_cache;
+  std::unique_ptr<PlaneLOD> plane_lod;
   rclcpp::Node* node_ptr_;
   std::string keyframes_layer_id;
   std::string walls_layer_id;
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef MARKER_CACHE_HPP
+#define MARKER_CACHE_HPP
+
+#include <Eigen/Dense>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "rclcpp/rclcpp.hpp"
+#include "visualization_msgs/msg/marker.hpp"
+#include "visualization_msgs/msg/marker_array.hpp"
+
+namespace s_graphs {
+
+/**
+ * @brief Retains the last published marker of every entity, keyed by namespace and
+ * id, so that each publishing tick only carries the markers that changed plus
+ * DELETE markers for the entities that disappeared.
+ */
+class MarkerCache {
+ public:
+  /**
+   * @brief Constructor for class MarkerCache
+   *
+   * @param delta_threshold: minimum change in a marker (or its state vector) to be
+   * republished
+   * @param full_refresh_ticks: every how many ticks all retained markers are
+   * republished for late joining subscribers, 0 to disable
+   */
+  MarkerCache(const double delta_threshold, const int full_refresh_ticks);
+  ~MarkerCache();
+
+ public:
+  /**
+   * @brief Marks the entity as alive in the current tick and checks if its state
+   * changed since it was last updated. Used to skip building expensive markers.
+   *
+   * @param ns
+   * @param id
+   * @param state: compact description of the entity (estimate, cloud size, ...)
+   * @return true if the entity is new or its state moved beyond the threshold
+   */
+  bool is_dirty(const std::string& ns, const int id, const Eigen::VectorXd& state);
+
+  /**
+   * @brief Stores the marker together with its state and queues it for publishing
+   *
+   * @param marker
+   * @param state
+   */
+  void update(const visualization_msgs::msg::Marker& marker,
+              const Eigen::VectorXd& state);
+
+  /**
+   * @brief Compares the marker against the retained one and queues it for publishing
+   * only if its geometry or appearance changed beyond the threshold
+   *
+   * @param marker
+   */
+  void submit(const visualization_msgs::msg::Marker& marker);
+
+  /**
+   * @brief Closes the current tick. Entities not seen during the tick are removed
+   * and a DELETE marker is emitted for each of them.
+   *
+   * @param stamp
+   * @return The markers to publish in this tick
+   */
+  visualization_msgs::msg::MarkerArray flush(const rclcpp::Time& stamp);
+
+  /**
+   * @brief Drops all the retained markers
+   */
+  void clear();
+
+  /**
+   * @brief Revision counter, increased on every marker addition, modification or
+   * deletion
+   */
+  uint64_t get_revision() const { return revision; }
+
+ private:
+  typedef std::pair<std::string, int> MarkerKey;
+
+  struct MarkerEntry {
+    visualization_msgs::msg::Marker marker;
+    Eigen::VectorXd state;
+    uint64_t revision;
+    uint64_t last_seen_tick;
+  };
+
+  /**
+   * @brief
+   *
+   * @param current
+   * @param retained
+   * @return true if both markers differ beyond the threshold
+   */
+  bool has_changed(const visualization_msgs::msg::Marker& current,
+                   const visualization_msgs::msg::Marker& retained) const;
+
+ private:
+  double delta_threshold;
+  int full_refresh_ticks;
+
+  uint64_t tick;
+  uint64_t revision;
+  std::map<MarkerKey, MarkerEntry> entries;
+  std::set<MarkerKey> pending_keys;
+};
+
+}  // namespace s_graphs
+
+#endif  // MARKER_CACHE_HPP
@@ -0,0 +1,249 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef PLANE_LOD_HPP
+#define PLANE_LOD_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Eigen/Dense>
+#include <limits>
+#include <map>
+#include <s_graphs/common/plane_utils.hpp>
+#include <s_graphs/common/planes.hpp>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+
+namespace s_graphs {
+
+/**
+ * @brief Simplified geometry of a mapped plane. The points are expressed in the plane
+ * basis (origin, u_axis, v_axis) so the outline and the quad stay flat.
+ */
+struct PlaneGeometryLOD {
+  typedef pcl::PointXYZRGBNormal PointNormal;
+
+  /**
+   * @brief Points of a voxel, summed in the plane basis so the voxel survives a
+   * change of the plane estimate
+   */
+  struct VoxelCell {
+    Eigen::Vector3d uvw_sum = Eigen::Vector3d::Zero();
+    size_t count = 0;
+  };
+  typedef std::map<std::tuple<int, int, int>, VoxelCell> VoxelCells;
+
+  Eigen::Vector4d coeffs = Eigen::Vector4d::Constant(
+      std::numeric_limits<double>::quiet_NaN());  // plane estimate of the basis
+  Eigen::Vector3d origin;
+  Eigen::Vector3d u_axis;
+  Eigen::Vector3d v_axis;
+
+  size_t num_segments = 0;             // keyframe segments of the plane summarized
+  size_t source_size = 0;              // points of cloud_seg_map summarized
+  Eigen::Vector3d point_sum;           // sum of the points, for the centroid
+  Eigen::Vector2d uv_min, uv_max;      // extents of the plane in its own basis
+  std::vector<Eigen::Vector2d> outline_uv;  // convex hull, counter clockwise
+  std::vector<VoxelCells> voxel_cells;      // voxels of every resolution
+  std::vector<pcl::PointCloud<PointNormal>::Ptr>
+      voxel_levels;  // decimated points, from the finest to the coarsest resolution
+
+  /**
+   * @brief Whether the geometry still summarizes the plane, that is it was built
+   * from the same keyframe segments, the same number of map points and the same
+   * plane estimate
+   *
+   * @param plane
+   */
+  bool is_current(const Planes& plane) const;
+
+  /**
+   * @brief
+   *
+   * @return centroid of the plane points in map frame
+   */
+  Eigen::Vector3d centroid() const;
+
+  /**
+   * @brief
+   *
+   * @return closed outline of the plane in map frame
+   */
+  std::vector<Eigen::Vector3d> outline() const;
+
+  /**
+   * @brief
+   *
+   * @return corners of the rectangle bounding the plane points in map frame
+   */
+  std::vector<Eigen::Vector3d> quad() const;
+};
+
+/**
+ * @brief Keeps a level of detail representation of every mapped plane and selects
+ * which level to render for each of them. The levels are, from the most to the
+ * least detailed, the voxel decimated point sets, the outline and the quad.
+ */
+class PlaneLOD {
+  typedef pcl::PointXYZRGBNormal PointNormal;
+
+ public:
+  /**
+   * @brief Constructor for class PlaneLOD
+   *
+   * @param node
+   */
+  PlaneLOD(const rclcpp::Node::SharedPtr node);
+  ~PlaneLOD();
+
+ public:
+  /**
+   * @brief Updates the simplified geometry of the plane. When only the plane
+   * estimate changed the cached geometry is moved rigidly onto the new plane, and
+   * the points of the keyframe segments added since the last update are summarized
+   * on top of it. The geometry is rebuilt from the whole map cloud when points were
+   * dropped, e.g. when a keyframe is marginalized. A shift of the keyframes along
+   * the plane does not change its estimate and is not followed by the geometry.
+   *
+   * @param plane_type
+   * @param plane
+   * @return the simplified geometry of the plane
+   */
+  const PlaneGeometryLOD& update(const int plane_type, const Planes& plane);
+
+  /**
+   * @brief
+   *
+   * @param plane_type
+   * @param plane_id
+   * @return the simplified geometry of the plane, nullptr if it was never updated
+   */
+  const PlaneGeometryLOD* find(const int plane_type, const int plane_id) const;
+
+  /**
+   * @brief Drops the planes that were not updated since the previous call
+   */
+  void remove_unused();
+
+  /**
+   * @brief Selects the level of every plane from its distance to the viewpoint, then
+   * coarsens the farthest planes until the total number of points fits in the budget
+   *
+   * @param geometries
+   * @param viewpoint
+   * @return the level of each geometry
+   */
+  std::vector<int> select_levels(const std::vector<const PlaneGeometryLOD*>& geometries,
+                                 const Eigen::Vector3d& viewpoint) const;
+
+  /**
+   * @brief
+   *
+   * @param geometry
+   * @param level
+   * @return number of points needed to render the geometry at the given level
+   */
+  size_t get_level_size(const PlaneGeometryLOD& geometry, const int level) const;
+
+  int get_outline_level() const { return voxel_resolutions.size(); }
+  int get_quad_level() const { return voxel_resolutions.size() + 1; }
+  double get_voxel_resolution(const int level) const {
+    return voxel_resolutions[level];
+  }
+  double get_near_distance() const { return near_distance; }
+
+ private:
+  /**
+   * @brief
+   *
+   * @param geometry
+   * @param plane
+   */
+  void reset_geometry(PlaneGeometryLOD& geometry, const Planes& plane);
+
+  /**
+   * @brief Moves the geometry rigidly onto the current plane estimate, rotating it
+   * about its centroid. The coordinates in the plane basis are kept.
+   *
+   * @param geometry
+   * @param plane
+   */
+  void rebase_geometry(PlaneGeometryLOD& geometry, const Planes& plane);
+
+  /**
+   * @brief Summarizes the points of the map cloud of the plane from the given index
+   *
+   * @param geometry
+   * @param cloud
+   * @param first
+   */
+  void add_points(PlaneGeometryLOD& geometry,
+                  const pcl::PointCloud<PointNormal>::ConstPtr& cloud,
+                  const size_t first);
+
+  /**
+   * @brief Regenerates the decimated points of every level from the voxels
+   *
+   * @param geometry
+   */
+  void update_voxel_levels(PlaneGeometryLOD& geometry) const;
+
+  /**
+   * @brief Andrew's monotone chain convex hull
+   *
+   * @param points
+   * @return the hull in counter clockwise order
+   */
+  std::vector<Eigen::Vector2d> convex_hull(std::vector<Eigen::Vector2d> points) const;
+
+ private:
+  typedef std::pair<int, int> PlaneKey;
+
+  struct PlaneEntry {
+    PlaneGeometryLOD geometry;
+    bool used;
+  };
+
+  std::vector<double> voxel_resolutions;
+  double near_distance;
+  double far_distance;
+  int point_budget;
+
+  std::map<PlaneKey, PlaneEntry> entries;
+};
+
+}  // namespace s_graphs
+
+#endif  // PLANE_LOD_HPP
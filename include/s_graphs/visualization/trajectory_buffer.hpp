@@ -0,0 +1,139 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#ifndef TRAJECTORY_BUFFER_HPP
+#define TRAJECTORY_BUFFER_HPP
+
+#include <Eigen/Dense>
+#include <deque>
+#include <mutex>
+#include <s_graphs/common/keyframe_index.hpp>
+#include <string>
+#include <vector>
+
+#include "geometry_msgs/msg/pose_stamped.hpp"
+#include "nav_msgs/msg/path.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+namespace s_graphs {
+
+/**
+ * @brief Bounded corrected odometry path. The latest poses are kept at full rate in a
+ * tail, older ones are decimated by distance and angle into the history. Every pose
+ * keeps its odometry so the path can be re-anchored on the optimized keyframes.
+ */
+class TrajectoryBuffer {
+ public:
+  /**
+   * @brief Constructor for class TrajectoryBuffer
+   *
+   * @param tail_size: number of latest poses kept at full rate
+   * @param max_size: max number of poses kept, 0 for unbounded
+   * @param min_distance: min translation between two history poses
+   * @param min_angle: min rotation between two history poses
+   * @param full_path_interval: poses between two full path publications
+   */
+  TrajectoryBuffer(const int tail_size,
+                   const int max_size,
+                   const double min_distance,
+                   const double min_angle,
+                   const int full_path_interval);
+
+  /**
+   * @brief Adds an odometry pose, corrected with the current odom2map transform
+   *
+   * @param stamp
+   * @param odom_pose: pose in odom frame
+   * @param odom2map
+   * @param frame_id: map frame id
+   * @return the corrected pose
+   */
+  geometry_msgs::msg::PoseStamped add_pose(const rclcpp::Time& stamp,
+                                           const Eigen::Isometry3d& odom_pose,
+                                           const Eigen::Matrix4f& odom2map,
+                                           const std::string& frame_id);
+
+  /**
+   * @brief Corrects every stored pose with the odom2map transform of the last
+   * keyframe before it
+   *
+   * @param keyframe_index
+   */
+  void reanchor(const KeyFrameIndex& keyframe_index);
+
+  /**
+   * @brief Whether the full path should be published with the current pose. It is
+   * due every full_path_interval poses and after a re-anchoring.
+   */
+  bool is_full_path_due();
+
+  /**
+   * @brief
+   *
+   * @return decimated history followed by the tail
+   */
+  nav_msgs::msg::Path get_path() const;
+
+  /**
+   * @brief
+   *
+   * @return latest poses at full rate
+   */
+  nav_msgs::msg::Path get_tail() const;
+
+  void clear();
+
+ private:
+  struct TrajectoryPose {
+    rclcpp::Time stamp;
+    Eigen::Isometry3d odom_pose;
+    geometry_msgs::msg::PoseStamped corrected;
+  };
+
+  void push_history(TrajectoryPose&& pose);
+
+ private:
+  size_t tail_size;
+  size_t max_size;
+  double min_distance;
+  double min_angle;
+  int full_path_interval;
+
+  mutable std::mutex trajectory_mutex;
+  std::deque<TrajectoryPose> history;
+  std::deque<TrajectoryPose> tail;
+  int poses_since_full_path;
+  bool reanchored;
+};
+
+}  // namespace s_graphs
+
+#endif  // TRAJECTORY_BUFFER_HPP
@@ -62,22 +62,35 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 namespace g2o {
 
 void EdgeSE3PointToPlane::computeError() {
+  Eigen::Vector4d q = plane_in_keyframe();
+  _error(0) = q.dot(gram_product(q)) / 2;
+}
+
+void EdgeSE3PointToPlane::linearizeOplus() {
   const g2o::VertexSE3* v1 = static_cast<const g2o::VertexSE3*>(_vertices[0]);
   const g2o::VertexPlane* v2 = static_cast<const g2o::VertexPlane*>(_vertices[1]);
 
-  Eigen::Matrix4d Ti = v1->estimate().matrix();
-  Eigen::Vector4d Pj = v2->estimate().toVector();
-  Eigen::Matrix4d Gij = _measurement;
-  _error = Pj.transpose() * Ti * Gij * Ti.transpose() * Pj / 2;
+  Eigen::Vector4d q = plane_in_keyframe();
+  Eigen::Vector4d g = gram_product(q);  // de/dq
+  Eigen::Vector3d n = q.head<3>();
+
+  // Ti * exp(dx): q becomes [R^T * n; t^T * n + d], R ~ I + 2 * [dqv]x
+  _jacobianOplusXi.block<1, 3>(0, 0) = g(3) * n.transpose();
+  _jacobianOplusXi.block<1, 3>(0, 3) = 2.0 * g.head<3>().cross(n).transpose();
+
+  // the plane increment rotates the normal by (azimuth, elevation) around the
+  // current one and shifts the distance, d = -Pj(3)
+  Eigen::Vector4d h = v1->estimate().matrix() * g;  // de/dPj
+  Eigen::Matrix3d R = g2o::Plane3D::rotation(v2->estimate().normal());
+  _jacobianOplusXj(0, 0) = h.head<3>().dot(R.col(1));
+  _jacobianOplusXj(0, 1) = h.head<3>().dot(R.col(2));
+  _jacobianOplusXj(0, 2) = -h(3);
 }
 
 bool EdgeSE3PointToPlane::read(std::istream& is) {
-  Eigen::Matrix4d v;
-  for (int i = 0; i < measurement().rows(); ++i)
-    for (int j = 0; j < measurement().cols(); ++j) {
-      is >> v(i, j);
-    }
-  setMeasurement(Eigen::Matrix4d(v));
+  PackedGram v;
+  for (int i = 0; i < v.size(); ++i) is >> v(i);
+  setMeasurement(v);
 
   for (int i = 0; i < information().rows(); ++i)
     for (int j = i; j < information().cols(); ++j) {
@@ -86,17 +99,34 @@ bool EdgeSE3PointToPlane::read(std::istream& is) {
     }
   return true;
 }
-bool EdgeSE3PointToPlane::write(std::ostream& os) const {
-  Eigen::Matrix4d v = _measurement;
 
-  for (int i = 0; i < measurement().rows(); ++i)
-    for (int j = 0; j < measurement().cols(); ++j) {
-      os << " " << v(i, j);
-    }
+bool EdgeSE3PointToPlane::write(std::ostream& os) const {
+  for (int i = 0; i < _measurement.size(); ++i) os << " " << _measurement(i);
 
   for (int i = 0; i < information().rows(); ++i)
     for (int j = i; j < information().cols(); ++j) os << " " << information()(i, j);
   return os.good();
 }
-}  // namespace g2o
 
+EdgeSE3PointToPlane::PackedGram EdgeSE3PointToPlane::pack(const Eigen::Matrix4d& m) {
+  PackedGram packed;
+  int k = 0;
+  for (int i = 0; i < 4; ++i)
+    for (int j = i; j < 4; ++j) packed(k++) = m(i, j);
+  return packed;
+}
+
+Eigen::Vector4d EdgeSE3PointToPlane::plane_in_keyframe() const {
+  const g2o::VertexSE3* v1 = static_cast<const g2o::VertexSE3*>(_vertices[0]);
+  const g2o::VertexPlane* v2 = static_cast<const g2o::VertexPlane*>(_vertices[1]);
+  return v1->estimate().matrix().transpose() * v2->estimate().toVector();
+}
+
+Eigen::Vector4d EdgeSE3PointToPlane::gram_product(const Eigen::Vector4d& q) const {
+  const PackedGram& m = _measurement;
+  return Eigen::Vector4d(m(0) * q(0) + m(1) * q(1) + m(2) * q(2) + m(3) * q(3),
+                         m(1) * q(0) + m(4) * q(1) + m(5) * q(2) + m(6) * q(3),
+                         m(2) * q(0) + m(5) * q(1) + m(7) * q(2) + m(8) * q(3),
+                         m(3) * q(0) + m(6) * q(1) + m(8) * q(2) + m(9) * q(3));
+}
+}  // namespace g2o
@@ -29,6 +29,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 // SPDX-License-Identifier: BSD-2-Clause
 
+#include <array>
 #include <s_graphs/backend/room_mapper.hpp>
 
 namespace s_graphs {
@@ -51,6 +52,7 @@ FiniteRoomMapper::FiniteRoomMapper(const rclcpp::Node::SharedPtr node) {
       node->get_parameter("use_perpendicular_plane_constraint")
           .get_parameter_value()
           .get<bool>();
+  room_registry = std::make_unique<RoomRegistry>(room_dist_threshold);
 }
 
 FiniteRoomMapper::~FiniteRoomMapper() {}
@@ -79,54 +81,48 @@ bool FiniteRoomMapper::lookup_rooms(
   room_center.translation().y() = room_data.room_center.position.y;
   room_center.translation().z() = room_data.room_center.position.z;
 
-  float min_dist_room_x_inf_room = 100;
-  s_graphs::InfiniteRooms matched_x_infinite_room;
-  for (const auto& current_x_infinite_room : x_infinite_rooms) {
-    if ((room_data.x_planes[0].id == current_x_infinite_room.second.plane1_id ||
-         room_data.x_planes[0].id == current_x_infinite_room.second.plane2_id) &&
-        (room_data.x_planes[1].id == current_x_infinite_room.second.plane1_id ||
-         room_data.x_planes[1].id == current_x_infinite_room.second.plane2_id)) {
-      min_dist_room_x_inf_room = 0;
-      matched_x_infinite_room = current_x_infinite_room.second;
-      break;
-    }
-    float dist_room_x_inf_room =
-        sqrt(pow(room_data.room_center.position.x -
-                     current_x_infinite_room.second.node->estimate().translation()(0),
-                 2) +
-             pow(room_data.room_center.position.y -
-                     current_x_infinite_room.second.node->estimate().translation()(1),
-                 2));
-    if (dist_room_x_inf_room < min_dist_room_x_inf_room) {
-      min_dist_room_x_inf_room = dist_room_x_inf_room;
-      matched_x_infinite_room = current_x_infinite_room.second;
-    }
-  }
+  // infinite rooms bounded by the same planes, else the closest one
+  room_registry->sync_infinite_rooms(*graph_slam, x_infinite_rooms, y_infinite_rooms);
+  const Eigen::Vector2d room_position = room_center.translation().head(2);
+  auto match_infinite_room =
+      [&](const int plane_type,
+          const std::unordered_map<int, InfiniteRooms>& infinite_rooms,
+          const s_graphs::msg::PlaneData& plane1,
+          const s_graphs::msg::PlaneData& plane2,
+          s_graphs::InfiniteRooms& matched_infinite_room) {
+        float min_dist = 100;
+        int infinite_room_id = room_registry->find_infinite_room_with_planes(
+            plane_type, plane1.id, plane2.id);
+        if (infinite_room_id != -1) {
+          min_dist = 0;
+        } else {
+          infinite_room_id = room_registry->find_nearest_infinite_room(
+              plane_type, room_position, 1.0);
+          if (infinite_room_id == -1) return min_dist;
+          min_dist = (room_position - infinite_rooms.at(infinite_room_id)
+                                          .node->estimate()
+                                          .translation()
+                                          .head(2))
+                         .norm();
+        }
+        matched_infinite_room = infinite_rooms.at(infinite_room_id);
+        return min_dist;
+      };
 
-  float min_dist_room_y_inf_room = 100;
+  s_graphs::InfiniteRooms matched_x_infinite_room;
+  float min_dist_room_x_inf_room =
+      match_infinite_room(PlaneUtils::plane_class::X_VERT_PLANE,
+                          x_infinite_rooms,
+                          room_data.x_planes[0],
+                          room_data.x_planes[1],
+                          matched_x_infinite_room);
   s_graphs::InfiniteRooms matched_y_infinite_room;
-  for (const auto& current_y_infinite_room : y_infinite_rooms) {
-    if ((room_data.y_planes[0].id == current_y_infinite_room.second.plane1_id ||
-         room_data.y_planes[0].id == current_y_infinite_room.second.plane2_id) &&
-        (room_data.y_planes[1].id == current_y_infinite_room.second.plane1_id ||
-         room_data.y_planes[1].id == current_y_infinite_room.second.plane2_id)) {
-      min_dist_room_y_inf_room = 0;
-      matched_y_infinite_room = current_y_infinite_room.second;
-      break;
-    }
-
-    float dist_room_y_inf_room =
-        sqrt(pow(room_data.room_center.position.x -
-                     current_y_infinite_room.second.node->estimate().translation()(0),
-                 2) +
-             pow(room_data.room_center.position.y -
-                     current_y_infinite_room.second.node->estimate().translation()(1),
-                 2));
-    if (dist_room_y_inf_room < min_dist_room_y_inf_room) {
-      min_dist_room_y_inf_room = dist_room_y_inf_room;
-      matched_y_infinite_room = current_y_infinite_room.second;
-    }
-  }
+  float min_dist_room_y_inf_room =
+      match_infinite_room(PlaneUtils::plane_class::Y_VERT_PLANE,
+                          y_infinite_rooms,
+                          room_data.y_planes[0],
+                          room_data.y_planes[1],
+                          matched_y_infinite_room);
 
   auto found_x_plane1 = x_vert_planes.find(room_data.x_planes[0].id);
   auto found_x_plane2 = x_vert_planes.find(room_data.x_planes[1].id);
@@ -329,7 +325,8 @@ bool FiniteRoomMapper::factor_rooms(
   }
 
   std::vector<std::pair<VerticalPlanes, VerticalPlanes>> detected_mapped_plane_pairs;
-  room_data_association = associate_rooms(room_center,
+  room_data_association = associate_rooms(graph_slam,
+                                          room_center,
                                           rooms_vec,
                                           x_vert_planes,
                                           y_vert_planes,
@@ -474,6 +471,7 @@ bool FiniteRoomMapper::factor_rooms(
 }
 
 int FiniteRoomMapper::associate_rooms(
+    std::shared_ptr<GraphSLAM>& graph_slam,
     const Eigen::Isometry3d& room_center,
     const std::unordered_map<int, Rooms>& rooms_vec,
     const std::unordered_map<int, VerticalPlanes>& x_vert_planes,
@@ -487,136 +485,59 @@ int FiniteRoomMapper::associate_rooms(
   float min_dist = 100;
   int data_association;
   data_association = -1;
-  bool x_plane1_min_segment = false, x_plane2_min_segment = false;
-  bool y_plane1_min_segment = false, y_plane2_min_segment = false;
-
-  for (const auto& room : rooms_vec) {
-    float diff_x =
-        room_center.translation()(0) - room.second.node->estimate().translation()(0);
-    float diff_y =
-        room_center.translation()(1) - room.second.node->estimate().translation()(1);
-    float dist = sqrt(std::pow(diff_x, 2) + std::pow(diff_y, 2));
+  const std::array<const VerticalPlanes*, 4> det_planes = {
+      &x_plane1, &x_plane2, &y_plane1, &y_plane2};
+  std::array<const VerticalPlanes*, 4> mapped_planes;
+
+  // only the rooms closer than the threshold can be associated
+  room_registry->sync_rooms(*graph_slam, rooms_vec);
+  const Eigen::Vector2d room_position = room_center.translation().head(2);
+  for (const int room_id :
+       room_registry->find_rooms(room_position, room_dist_threshold)) {
+    const Rooms& room = rooms_vec.at(room_id);
+    float dist = (room_position - room.node->estimate().translation().head(2)).norm();
     RCLCPP_DEBUG(node_obj->get_logger(), "room planes", "dist room %f", dist);
+    if (dist >= min_dist) continue;
+
+    auto found_mapped_xplane1 = x_vert_planes.find(room.plane_x1_id);
+    auto found_mapped_xplane2 = x_vert_planes.find(room.plane_x2_id);
+    auto found_mapped_yplane1 = y_vert_planes.find(room.plane_y1_id);
+    auto found_mapped_yplane2 = y_vert_planes.find(room.plane_y2_id);
+    if (found_mapped_xplane1 == x_vert_planes.end() ||
+        found_mapped_xplane2 == x_vert_planes.end() ||
+        found_mapped_yplane1 == y_vert_planes.end() ||
+        found_mapped_yplane2 == y_vert_planes.end())
+      continue;
 
-    std::vector<std::pair<VerticalPlanes, VerticalPlanes>>
-        current_detected_mapped_plane_pairs;
-    auto found_mapped_xplane1 = x_vert_planes.find(room.second.plane_x1_id);
-    auto found_mapped_xplane2 = x_vert_planes.find(room.second.plane_x2_id);
-
-    std::pair<VerticalPlanes, VerticalPlanes> x1_detected_mapped_plane_pair;
-    std::pair<VerticalPlanes, VerticalPlanes> x2_detected_mapped_plane_pair;
-
-    if (x_plane1.id == (found_mapped_xplane1->second).id ||
-        x_plane1.id == (found_mapped_xplane2->second).id) {
-      x_plane1_min_segment = true;
-      x1_detected_mapped_plane_pair.first = x_plane1;
-      x1_detected_mapped_plane_pair.second = x_plane1;
-    } else if ((x_plane1).plane_node->estimate().coeffs().head(3).dot(
-                   (found_mapped_xplane1->second)
-                       .plane_node->estimate()
-                       .coeffs()
-                       .head(3)) > 0) {
-      double maha_dist = PlaneUtils::plane_difference(
-          (found_mapped_xplane1->second).plane, x_plane1.plane);
-      if (maha_dist < 0.5) x_plane1_min_segment = true;
-      x1_detected_mapped_plane_pair.first = x_plane1;
-      x1_detected_mapped_plane_pair.second = (found_mapped_xplane1->second);
-
-    } else {
-      double maha_dist = PlaneUtils::plane_difference(
-          (found_mapped_xplane2->second).plane, x_plane1.plane);
-      if (maha_dist < 0.5) x_plane1_min_segment = true;
-      x1_detected_mapped_plane_pair.first = x_plane1;
-      x1_detected_mapped_plane_pair.second = (found_mapped_xplane2->second);
+    const std::array<const VerticalPlanes*, 4> current_mapped_planes = {
+        &match_room_plane(
+            x_plane1, found_mapped_xplane1->second, found_mapped_xplane2->second),
+        &match_room_plane(
+            x_plane2, found_mapped_xplane1->second, found_mapped_xplane2->second),
+        &match_room_plane(
+            y_plane1, found_mapped_yplane1->second, found_mapped_yplane2->second),
+        &match_room_plane(
+            y_plane2, found_mapped_yplane1->second, found_mapped_yplane2->second)};
+
+    bool min_segment = true;
+    for (size_t i = 0; i < det_planes.size() && min_segment; ++i) {
+      if (current_mapped_planes[i] == det_planes[i]) continue;
+      double maha_dist = PlaneUtils::plane_difference(current_mapped_planes[i]->plane,
+                                                      det_planes[i]->plane);
+      min_segment = maha_dist < 0.5;
     }
 
-    current_detected_mapped_plane_pairs.push_back(x1_detected_mapped_plane_pair);
-    if (x_plane2.id == (found_mapped_xplane1->second).id ||
-        x_plane2.id == (found_mapped_xplane2->second).id) {
-      x_plane2_min_segment = true;
-      x2_detected_mapped_plane_pair.first = x_plane2;
-      x2_detected_mapped_plane_pair.second = x_plane2;
-    } else if ((x_plane2).plane_node->estimate().coeffs().head(3).dot(
-                   (found_mapped_xplane1->second)
-                       .plane_node->estimate()
-                       .coeffs()
-                       .head(3)) > 0) {
-      double maha_dist = PlaneUtils::plane_difference(
-          (found_mapped_xplane1->second).plane, x_plane2.plane);
-      if (maha_dist < 0.5) x_plane2_min_segment = true;
-      x2_detected_mapped_plane_pair.first = x_plane2;
-      x2_detected_mapped_plane_pair.second = (found_mapped_xplane1->second);
-
-    } else {
-      double maha_dist = PlaneUtils::plane_difference(
-          (found_mapped_xplane2->second).plane, x_plane2.plane);
-      if (maha_dist < 0.5) x_plane2_min_segment = true;
-      x2_detected_mapped_plane_pair.first = x_plane2;
-      x2_detected_mapped_plane_pair.second = (found_mapped_xplane2->second);
-    }
-    current_detected_mapped_plane_pairs.push_back(x2_detected_mapped_plane_pair);
-
-    auto found_mapped_yplane1 = y_vert_planes.find(room.second.plane_y1_id);
-    auto found_mapped_yplane2 = y_vert_planes.find(room.second.plane_y2_id);
-
-    std::pair<VerticalPlanes, VerticalPlanes> y1_detected_mapped_plane_pair;
-    std::pair<VerticalPlanes, VerticalPlanes> y2_detected_mapped_plane_pair;
-
-    if (y_plane1.id == (found_mapped_yplane1->second).id ||
-        y_plane1.id == (found_mapped_yplane2->second).id) {
-      y_plane1_min_segment = true;
-      y1_detected_mapped_plane_pair.first = y_plane1;
-      y1_detected_mapped_plane_pair.second = y_plane1;
-    } else if ((y_plane1).plane_node->estimate().coeffs().head(3).dot(
-                   (found_mapped_yplane1->second)
-                       .plane_node->estimate()
-                       .coeffs()
-                       .head(3)) > 0) {
-      double maha_dist = PlaneUtils::plane_difference(
-          (found_mapped_yplane1->second).plane, y_plane1.plane);
-      if (maha_dist < 0.5) y_plane1_min_segment = true;
-      y1_detected_mapped_plane_pair.first = y_plane1;
-      y1_detected_mapped_plane_pair.second = (found_mapped_yplane1->second);
-
-    } else {
-      double maha_dist = PlaneUtils::plane_difference(
-          (found_mapped_yplane2->second).plane, y_plane1.plane);
-      if (maha_dist < 0.5) y_plane1_min_segment = true;
-      y1_detected_mapped_plane_pair.first = y_plane1;
-      y1_detected_mapped_plane_pair.second = (found_mapped_yplane2->second);
-    }
-    current_detected_mapped_plane_pairs.push_back(y1_detected_mapped_plane_pair);
-
-    if (y_plane2.id == (found_mapped_yplane1->second).id ||
-        y_plane2.id == (found_mapped_yplane2->second).id) {
-      y_plane2_min_segment = true;
-      y2_detected_mapped_plane_pair.first = y_plane2;
-      y2_detected_mapped_plane_pair.second = y_plane2;
-    } else if ((y_plane2).plane_node->estimate().coeffs().head(3).dot(
-                   (found_mapped_yplane1->second)
-                       .plane_node->estimate()
-                       .coeffs()
-                       .head(3)) > 0) {
-      double maha_dist = PlaneUtils::plane_difference(
-          (found_mapped_yplane1->second).plane, y_plane2.plane);
-      if (maha_dist < 0.5) y_plane2_min_segment = true;
-      y2_detected_mapped_plane_pair.first = y_plane2;
-      y2_detected_mapped_plane_pair.second = (found_mapped_yplane1->second);
-
-    } else {
-      double maha_dist = PlaneUtils::plane_difference(
-          (found_mapped_yplane2->second).plane, y_plane2.plane);
-      if (maha_dist < 0.5) y_plane2_min_segment = true;
-      y2_detected_mapped_plane_pair.first = y_plane2;
-      y2_detected_mapped_plane_pair.second = (found_mapped_yplane2->second);
+    if (min_segment) {
+      min_dist = dist;
+      data_association = room.id;
+      mapped_planes = current_mapped_planes;
     }
-    current_detected_mapped_plane_pairs.push_back(y2_detected_mapped_plane_pair);
+  }
 
-    if (dist < min_dist && (x_plane1_min_segment && x_plane2_min_segment &&
-                            y_plane1_min_segment && y_plane2_min_segment)) {
-      min_dist = dist;
-      data_association = room.second.id;
-      detected_mapped_plane_pairs = current_detected_mapped_plane_pairs;
+  if (data_association != -1) {
+    detected_mapped_plane_pairs.clear();
+    for (size_t i = 0; i < det_planes.size(); ++i) {
+      detected_mapped_plane_pairs.emplace_back(*det_planes[i], *mapped_planes[i]);
     }
   }
 
@@ -626,33 +547,9 @@ int FiniteRoomMapper::associate_rooms(
   return data_association;
 }
 
-bool FiniteRoomMapper::check_room_ids(
-    const int plane_type,
-    const std::set<g2o::HyperGraph::Edge*>& plane_edges,
-    const g2o::VertexRoom* room_node) {
-  for (auto edge_itr = plane_edges.begin(); edge_itr != plane_edges.end(); ++edge_itr) {
-    if (plane_type == PlaneUtils::plane_class::X_VERT_PLANE) {
-      g2o::EdgeRoom4Planes* edge_room_4planes =
-          dynamic_cast<g2o::EdgeRoom4Planes*>(*edge_itr);
-      if (edge_room_4planes) {
-        g2o::VertexRoom* found_room_node =
-            dynamic_cast<g2o::VertexRoom*>(edge_room_4planes->vertices()[0]);
-        if (found_room_node->id() == room_node->id()) return true;
-      }
-    }
-
-    if (plane_type == PlaneUtils::plane_class::Y_VERT_PLANE) {
-      g2o::EdgeRoom4Planes* edge_room_4planes =
-          dynamic_cast<g2o::EdgeRoom4Planes*>(*edge_itr);
-      if (edge_room_4planes) {
-        g2o::VertexRoom* found_room_node =
-            dynamic_cast<g2o::VertexRoom*>(edge_room_4planes->vertices()[0]);
-        if (found_room_node->id() == room_node->id()) return true;
-      }
-    }
-  }
-
-  return false;
+bool FiniteRoomMapper::check_room_ids(const int plane_id,
+                                      const g2o::VertexRoom* room_node) const {
+  return room_registry->room_has_plane(room_node->id(), plane_id);
 }
 
 void FiniteRoomMapper::map_room_from_existing_infinite_rooms(
@@ -672,7 +569,8 @@ void FiniteRoomMapper::map_room_from_existing_infinite_rooms(
   int room_data_association;
 
   std::vector<std::pair<VerticalPlanes, VerticalPlanes>> detected_mapped_plane_pairs;
-  room_data_association = associate_rooms(room_center,
+  room_data_association = associate_rooms(graph_slam,
+                                          room_center,
                                           rooms_vec,
                                           x_vert_planes,
                                           y_vert_planes,
@@ -730,7 +628,8 @@ void FiniteRoomMapper::map_room_from_existing_x_infinite_room(
   int room_data_association;
 
   std::vector<std::pair<VerticalPlanes, VerticalPlanes>> detected_mapped_plane_pairs;
-  room_data_association = associate_rooms(room_center,
+  room_data_association = associate_rooms(graph_slam,
+                                          room_center,
                                           rooms_vec,
                                           x_vert_planes,
                                           y_vert_planes,
@@ -797,7 +696,8 @@ void FiniteRoomMapper::map_room_from_existing_y_infinite_room(
   int room_data_association;
 
   std::vector<std::pair<VerticalPlanes, VerticalPlanes>> detected_mapped_plane_pairs;
-  room_data_association = associate_rooms(room_center,
+  room_data_association = associate_rooms(graph_slam,
+                                          room_center,
                                           rooms_vec,
                                           x_vert_planes,
                                           y_vert_planes,
@@ -154,6 +154,7 @@ void FloorMapper::factor_floor_room_nodes(
     const std::unordered_map<int, s_graphs::InfiniteRooms>& x_infinite_rooms,
     const std::unordered_map<int, s_graphs::InfiniteRooms>& y_infinite_rooms) {
   Eigen::Matrix2d information_floor;
+  information_floor.setZero();
   information_floor(0, 0) = 0.0001;
   information_floor(1, 1) = 0.0001;
 
@@ -33,7 +33,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 namespace s_graphs {
 
-GPSMapper::GPSMapper(const rclcpp::Node::SharedPtr node) {
+GPSMapper::GPSMapper(const rclcpp::Node::SharedPtr node) : gps_series(1024, 0.2) {
   gps_time_offset =
       node->get_parameter("gps_time_offset").get_parameter_value().get<int>();
   gps_edge_stddev_xy =
@@ -48,46 +48,24 @@ bool GPSMapper::map_gps_data(
     std::shared_ptr<GraphSLAM>& covisibility_graph,
     std::deque<geographic_msgs::msg::GeoPointStamped::SharedPtr>& gps_queue,
     const std::map<int, KeyFrame::Ptr>& keyframes) {
-  bool updated = false;
-  auto gps_cursor = gps_queue.begin();
-
-  for (auto& keyframe : keyframes) {
-    if (keyframe.second->stamp > gps_queue.back()->header.stamp) {
-      break;
-    }
-
-    if (keyframe.second->stamp < (*gps_cursor)->header.stamp ||
-        keyframe.second->utm_coord) {
-      continue;
-    }
-
-    // find the gps data which is closest to the keyframe
-    auto closest_gps = gps_cursor;
-    for (auto gps = gps_cursor; gps != gps_queue.end(); gps++) {
-      auto dt = (rclcpp::Time((*closest_gps)->header.stamp) - keyframe.second->stamp)
-                    .seconds();
-      auto dt2 =
-          (rclcpp::Time((*gps)->header.stamp) - keyframe.second->stamp).seconds();
-      if (std::abs(dt) < std::abs(dt2)) {
-        break;
-      }
-
-      closest_gps = gps;
-    }
+  for (const auto& gps : gps_queue) {
+    gps_series.insert(rclcpp::Time(gps->header.stamp).seconds(), gps);
+  }
+  gps_queue.clear();
 
-    // if the time residual between the gps and keyframe is too large, skip it
-    gps_cursor = closest_gps;
-    if (0.2 <
-        std::abs((rclcpp::Time((*closest_gps)->header.stamp) - keyframe.second->stamp)
-                     .seconds())) {
-      continue;
-    }
+  bool updated = false;
+  auto associate_keyframe = [&](const KeyFrame::Ptr& keyframe, const auto& bracket) {
+    if (keyframe->utm_coord) return true;
 
     // convert (latitude, longitude, altitude) -> (easting, northing, altitude) in UTM
-    // coordinate
-    geodesy::UTMPoint utm;
-    geodesy::fromMsg((*closest_gps)->position, utm);
-    Eigen::Vector3d xyz(utm.easting, utm.northing, utm.altitude);
+    // coordinate, interpolated at the keyframe stamp
+    Eigen::Vector3d xyz;
+    if (bracket.before && bracket.after) {
+      xyz = (1.0 - bracket.alpha) * to_utm(*bracket.before->data) +
+            bracket.alpha * to_utm(*bracket.after->data);
+    } else {
+      xyz = to_utm(bracket.before ? *bracket.before->data : *bracket.after->data);
+    }
 
     // the first gps data position will be the origin of the map
     if (!zero_utm) {
@@ -95,36 +73,36 @@ bool GPSMapper::map_gps_data(
     }
     xyz -= (*zero_utm);
 
-    keyframe.second->utm_coord = xyz;
+    keyframe->utm_coord = xyz;
 
     g2o::OptimizableGraph::Edge* edge;
     if (std::isnan(xyz.z())) {
       Eigen::Matrix2d information_matrix =
           Eigen::Matrix2d::Identity() / gps_edge_stddev_xy;
       edge = covisibility_graph->add_se3_prior_xy_edge(
-          keyframe.second->node, xyz.head<2>(), information_matrix);
+          keyframe->node, xyz.head<2>(), information_matrix);
     } else {
       Eigen::Matrix3d information_matrix = Eigen::Matrix3d::Identity();
       information_matrix.block<2, 2>(0, 0) /= gps_edge_stddev_xy;
       information_matrix(2, 2) /= gps_edge_stddev_z;
       edge = covisibility_graph->add_se3_prior_xyz_edge(
-          keyframe.second->node, xyz, information_matrix);
+          keyframe->node, xyz, information_matrix);
     }
     covisibility_graph->add_robust_kernel(edge, "Huber", 1.0);
 
     updated = true;
+    return true;
+  };
+  gps_series.associate(keyframes, associate_keyframe);
 
-    auto remove_loc = std::upper_bound(
-        gps_queue.begin(),
-        gps_queue.end(),
-        keyframes.rbegin()->second->stamp,
-        [=](const rclcpp::Time& stamp,
-            const geographic_msgs::msg::GeoPointStamped::SharedPtr& geopoint) {
-          return stamp < geopoint->header.stamp;
-        });
-    gps_queue.erase(gps_queue.begin(), remove_loc);
-    return updated;
-  }
+  return updated;
+}
+
+Eigen::Vector3d GPSMapper::to_utm(
+    const geographic_msgs::msg::GeoPointStamped& gps) const {
+  geodesy::UTMPoint utm;
+  geodesy::fromMsg(gps.position, utm);
+  return Eigen::Vector3d(utm.easting, utm.northing, utm.altitude);
 }
 
 }  // namespace s_graphs
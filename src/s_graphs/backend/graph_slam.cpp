@@ -29,11 +29,13 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 // SPDX-License-Identifier: BSD-2-Clause
 
+#include <g2o/config.h>
 #include <g2o/core/block_solver.h>
 #include <g2o/core/factory.h>
 #include <g2o/core/linear_solver.h>
 #include <g2o/core/optimization_algorithm.h>
 #include <g2o/core/optimization_algorithm_factory.h>
+#include <g2o/core/optimization_algorithm_with_hessian.h>
 #include <g2o/core/robust_kernel_factory.h>
 #include <g2o/core/sparse_optimizer.h>
 #include <g2o/solvers/pcg/linear_solver_pcg.h>
@@ -42,7 +44,9 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <g2o/types/slam3d/types_slam3d.h>
 #include <g2o/types/slam3d_addons/types_slam3d_addons.h>
 
+#include <algorithm>
 #include <boost/format.hpp>
+#include <cmath>
 #include <g2o/edge_infinite_room_plane.hpp>
 #include <g2o/edge_loop_closure.hpp>
 #include <g2o/edge_plane.hpp>
@@ -63,6 +67,10 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <g2o/vertex_wall.hpp>
 #include <s_graphs/backend/graph_slam.hpp>
 
+#if defined(G2O_OPENMP) && defined(_OPENMP)
+#include <omp.h>
+#endif
+
 G2O_USE_OPTIMIZATION_LIBRARY(pcg)
 G2O_USE_OPTIMIZATION_LIBRARY(cholmod)  // be aware of that cholmod brings GPL dependency
 G2O_USE_OPTIMIZATION_LIBRARY(
@@ -102,33 +110,51 @@ G2O_REGISTER_TYPE(VERTEX_INFINITE_ROOM, VertexInfiniteRoom)
 
 namespace s_graphs {
 
+namespace {
+
+/**
+ * @brief Forwards the end of every solver iteration to a callback.
+ */
+class PostIterationAction : public g2o::HyperGraphAction {
+ public:
+  PostIterationAction(const std::function<void(int)>& on_iteration)
+      : on_iteration(on_iteration) {}
+
+  g2o::HyperGraphAction* operator()(const g2o::HyperGraph*,
+                                    Parameters* parameters) override {
+    auto iteration_parameters = dynamic_cast<ParametersIteration*>(parameters);
+    on_iteration(iteration_parameters ? iteration_parameters->iteration : -1);
+    return this;
+  }
+
+ private:
+  std::function<void(int)> on_iteration;
+};
+
+}  // namespace
+
 /**
  * @brief constructor
  */
 GraphSLAM::GraphSLAM(const std::string& solver_type, bool save_time) {
   graph.reset(new g2o::SparseOptimizer());
-  g2o::SparseOptimizer* graph = dynamic_cast<g2o::SparseOptimizer*>(this->graph.get());
-
-  std::cout << "construct solver: " << solver_type << std::endl;
-  g2o::OptimizationAlgorithmFactory* solver_factory =
-      g2o::OptimizationAlgorithmFactory::instance();
-  g2o::OptimizationAlgorithmProperty solver_property;
-  g2o::OptimizationAlgorithm* solver =
-      solver_factory->construct(solver_type, solver_property);
-  graph->setAlgorithm(solver);
-
-  if (!graph->solver()) {
-    std::cerr << std::endl;
-    std::cerr << "error : failed to allocate solver!!" << std::endl;
-    solver_factory->listSolvers(std::cerr);
-    std::cerr << "-------------" << std::endl;
-    std::cin.ignore(1);
-    return;
-  }
-  std::cout << "done" << std::endl;
+  preemption_requested = false;
+  force_stop = false;
+  best_chi2 = 0.0;
+  optimization_time_budget = 0.0;
+  post_iteration_action = std::make_unique<PostIterationAction>(
+      [this](const int iteration) { on_iteration(iteration); });
+  graph->addPostIterationAction(post_iteration_action.get());
+  graph->setForceStopFlag(&force_stop);
+
+  solver_config.solver_type = solver_type;
+  if (!allocate_solver(solver_type)) return;
+  apply_block_ordering(solver_config.block_ordering);
 
   robust_kernel_factory = g2o::RobustKernelFactory::instance();
   nbr_of_vertices = nbr_of_edges = 0;
+  revision = structure_revision = 0;
+  revision_threshold = 1e-4;
   timing_counter = 0;
   sum_prev_timings = 0.0;
 
@@ -146,6 +172,75 @@ GraphSLAM::GraphSLAM(const std::string& solver_type, bool save_time) {
 GraphSLAM::~GraphSLAM() { graph.reset(); }
 
 void GraphSLAM::select_solver_type(const std::string& solver_type) {
+  solver_config.solver_type = solver_type;
+  if (allocate_solver(solver_type)) apply_block_ordering(solver_config.block_ordering);
+}
+
+void GraphSLAM::configure_solver(const SolverConfig& config) {
+  if (config.solver_type != solver_config.solver_type || !graph->solver()) {
+    select_solver_type(config.solver_type);
+  }
+  solver_config = config;
+  apply_block_ordering(config.block_ordering);
+  if (config.num_threads > 1 && !solver_supports_threads()) {
+    std::cerr << "g2o was built without G2O_OPENMP, the solver runs on one thread"
+              << std::endl;
+  }
+}
+
+bool GraphSLAM::solver_supports_threads() {
+#if defined(G2O_OPENMP) && defined(_OPENMP)
+  return true;
+#else
+  return false;
+#endif
+}
+
+const SolverConfig& GraphSLAM::get_solver_config() const { return solver_config; }
+
+void GraphSLAM::set_optimization_time_budget(const double seconds) {
+  optimization_time_budget = seconds;
+}
+
+void GraphSLAM::request_preemption() { preemption_requested = true; }
+
+void GraphSLAM::set_iteration_callback(
+    const std::function<void(int, double)>& callback) {
+  iteration_callback = callback;
+}
+
+void GraphSLAM::begin_optimization() {
+  preemption_requested = false;
+  force_stop = false;
+  optimization_start = rclcpp::Clock{}.now();
+}
+
+bool GraphSLAM::optimization_stopped() const {
+  return force_stop || preemption_requested;
+}
+
+void GraphSLAM::on_iteration(const int iteration) {
+  // the first iteration of a solve starts a new chi2 reference, as the active edges
+  // may differ from the previous solve
+  if (iteration_callback) {
+    graph->computeActiveErrors();
+    const double chi2 = graph->activeRobustChi2();
+    if (iteration == 0 || chi2 < best_chi2) {
+      best_chi2 = chi2;
+      iteration_callback(iteration, chi2);
+    }
+  }
+
+  if (preemption_requested) {
+    force_stop = true;
+  } else if (optimization_time_budget > 0.0 &&
+             (rclcpp::Clock{}.now() - optimization_start).seconds() >
+                 optimization_time_budget) {
+    force_stop = true;
+  }
+}
+
+bool GraphSLAM::allocate_solver(const std::string& solver_type) {
   g2o::SparseOptimizer* graph = dynamic_cast<g2o::SparseOptimizer*>(this->graph.get());
 
   std::cout << "construct solver: " << solver_type << std::endl;
@@ -162,9 +257,41 @@ void GraphSLAM::select_solver_type(const std::string& solver_type) {
     solver_factory->listSolvers(std::cerr);
     std::cerr << "-------------" << std::endl;
     std::cin.ignore(1);
-    return;
+    return false;
   }
   std::cout << "done" << std::endl;
+  return true;
+}
+
+namespace {
+
+/**
+ * @brief Set the ordering of the sparse linear solver behind a block solver. Returns
+ * false if the solver is not a BlockSolverT or its linear solver is not CCS based.
+ */
+template <typename BlockSolverT>
+bool set_block_ordering(g2o::Solver& solver, const bool block_ordering) {
+  auto block_solver = dynamic_cast<BlockSolverT*>(&solver);
+  if (!block_solver) return false;
+  auto linear_solver =
+      dynamic_cast<g2o::LinearSolverCCS<typename BlockSolverT::PoseMatrixType>*>(
+          &block_solver->linearSolver());
+  if (!linear_solver) return false;
+  linear_solver->setBlockOrdering(block_ordering);
+  return true;
+}
+
+}  // namespace
+
+void GraphSLAM::apply_block_ordering(const bool block_ordering) {
+  auto algorithm =
+      dynamic_cast<g2o::OptimizationAlgorithmWithHessian*>(graph->solver());
+  if (!algorithm) return;
+
+  // variable and fixed 6_3 blocks are the two layouts the factory names provide
+  if (!set_block_ordering<g2o::BlockSolverX>(algorithm->solver(), block_ordering)) {
+    set_block_ordering<g2o::BlockSolver_6_3>(algorithm->solver(), block_ordering);
+  }
 }
 
 int GraphSLAM::retrieve_total_nbr_of_vertices() const {
@@ -180,6 +307,78 @@ int GraphSLAM::increment_local_nbr_of_vertices() { return nbr_of_vertices += 1;
 
 int GraphSLAM::increment_local_nbr_of_edges() { return nbr_of_edges += 1; }
 
+uint64_t GraphSLAM::get_revision() const { return revision; }
+
+uint64_t GraphSLAM::get_structure_revision() const { return structure_revision; }
+
+uint64_t GraphSLAM::get_vertex_revision(const int vertex_id) const {
+  std::lock_guard<std::mutex> lock(vertex_revisions_mutex);
+  auto found = vertex_revisions.find(vertex_id);
+  if (found == vertex_revisions.end()) return 0;
+  return found->second.revision;
+}
+
+namespace {
+
+/**
+ * @brief Estimate of a vertex as a parameter vector, empty if it has none.
+ */
+std::vector<double> get_estimate_data(g2o::HyperGraph::Vertex* vertex) {
+  auto optimizable = dynamic_cast<g2o::OptimizableGraph::Vertex*>(vertex);
+  if (!optimizable || optimizable->estimateDimension() <= 0) return {};
+
+  std::vector<double> estimate(optimizable->estimateDimension());
+  if (!optimizable->getEstimateData(estimate.data())) return {};
+  return estimate;
+}
+
+}  // namespace
+
+void GraphSLAM::mark_vertex_updated(const int vertex_id) {
+  std::vector<double> estimate = get_estimate_data(graph->vertex(vertex_id));
+
+  std::lock_guard<std::mutex> lock(vertex_revisions_mutex);
+  vertex_revisions[vertex_id] = VertexRevision{++revision, std::move(estimate)};
+}
+
+bool GraphSLAM::mark_vertex_changed(const int vertex_id) {
+  std::vector<double> estimate = get_estimate_data(graph->vertex(vertex_id));
+
+  std::lock_guard<std::mutex> lock(vertex_revisions_mutex);
+  auto found = vertex_revisions.find(vertex_id);
+  if (found != vertex_revisions.end() && !estimate.empty() &&
+      found->second.estimate.size() == estimate.size()) {
+    bool moved = false;
+    for (size_t i = 0; i < estimate.size() && !moved; i++) {
+      moved = std::abs(estimate[i] - found->second.estimate[i]) > revision_threshold;
+    }
+    if (!moved) return false;
+  }
+
+  vertex_revisions[vertex_id] = VertexRevision{++revision, std::move(estimate)};
+  return true;
+}
+
+void GraphSLAM::set_revision_threshold(const double threshold) {
+  revision_threshold = threshold;
+}
+
+void GraphSLAM::mark_vertex_added(const int vertex_id) {
+  mark_vertex_updated(vertex_id);
+  structure_revision = revision.load();
+}
+
+void GraphSLAM::mark_vertex_removed(const int vertex_id) {
+  {
+    std::lock_guard<std::mutex> lock(vertex_revisions_mutex);
+    vertex_revisions.erase(vertex_id);
+  }
+  landmark_marginals.erase(vertex_id);
+  structure_revision = ++revision;
+}
+
+void GraphSLAM::mark_structure_updated() { structure_revision = ++revision; }
+
 g2o::VertexSE3* GraphSLAM::add_se3_node(const Eigen::Isometry3d& pose,
                                         bool use_vertex_size_id) {
   g2o::VertexSE3* vertex(new g2o::VertexSE3());
@@ -189,6 +388,7 @@ g2o::VertexSE3* GraphSLAM::add_se3_node(const Eigen::Isometry3d& pose,
     vertex->setId(static_cast<int>(retrieve_total_nbr_of_vertices()));
   vertex->setEstimate(pose);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
   this->increment_local_nbr_of_vertices();
 
   return vertex;
@@ -200,6 +400,7 @@ g2o::VertexSE3* GraphSLAM::copy_se3_node(const g2o::VertexSE3* node) {
   vertex->setEstimate(node->estimate());
   if (node->fixed()) vertex->setFixed(true);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
 
   return vertex;
 }
@@ -214,6 +415,7 @@ g2o::VertexPlane* GraphSLAM::add_plane_node(const Eigen::Vector4d& plane_coeffs,
   vertex->setId(id);
   vertex->setEstimate(plane_coeffs);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
   this->increment_local_nbr_of_vertices();
 
   return vertex;
@@ -225,15 +427,18 @@ g2o::VertexPlane* GraphSLAM::copy_plane_node(const g2o::VertexPlane* node) {
   vertex->setEstimate(node->estimate());
   if (node->fixed()) vertex->setFixed(true);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
 
   return vertex;
 }
 
 bool GraphSLAM::remove_plane_node(g2o::VertexPlane* plane_vertex) {
+  mark_vertex_removed(plane_vertex->id());
   return graph->removeVertex(plane_vertex);
 }
 
 bool GraphSLAM::remove_room_node(g2o::VertexRoom* room_vertex) {
+  mark_vertex_removed(room_vertex->id());
   return graph->removeVertex(room_vertex);
 }
 
@@ -242,6 +447,7 @@ g2o::VertexPointXYZ* GraphSLAM::add_point_xyz_node(const Eigen::Vector3d& xyz) {
   vertex->setId(static_cast<int>(retrieve_local_nbr_of_vertices()));
   vertex->setEstimate(xyz);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
   this->increment_local_nbr_of_vertices();
 
   return vertex;
@@ -252,6 +458,7 @@ g2o::VertexRoom* GraphSLAM::add_room_node(const Eigen::Isometry3d& room_pose) {
   vertex->setId(static_cast<int>(retrieve_local_nbr_of_vertices()));
   vertex->setEstimate(room_pose);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
   this->increment_local_nbr_of_vertices();
 
   return vertex;
@@ -262,6 +469,7 @@ g2o::VertexDoorWay* GraphSLAM::add_doorway_node(const Eigen::Isometry3d& doorway
   vertex->setId(static_cast<int>(retrieve_local_nbr_of_vertices()));
   vertex->setEstimate(doorway_pose);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
   this->increment_local_nbr_of_vertices();
 
   return vertex;
@@ -273,6 +481,7 @@ g2o::VertexRoom* GraphSLAM::copy_room_node(const g2o::VertexRoom* node) {
   vertex->setEstimate(node->estimate());
   if (node->fixed()) vertex->setFixed(true);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
 
   return vertex;
 }
@@ -282,6 +491,7 @@ g2o::VertexFloor* GraphSLAM::add_floor_node(const Eigen::Isometry3d& floor_pose)
   vertex->setId(static_cast<int>(retrieve_local_nbr_of_vertices()));
   vertex->setEstimate(floor_pose);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
   this->increment_local_nbr_of_vertices();
 
   return vertex;
@@ -293,6 +503,7 @@ g2o::VertexFloor* GraphSLAM::copy_floor_node(const g2o::VertexFloor* node) {
   vertex->setEstimate(node->estimate());
   if (node->fixed()) vertex->setFixed(true);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
 
   return vertex;
 }
@@ -300,6 +511,7 @@ g2o::VertexFloor* GraphSLAM::copy_floor_node(const g2o::VertexFloor* node) {
 void GraphSLAM::update_floor_node(g2o::VertexFloor* floor_node,
                                   const Eigen::Isometry3d& floor_pose) {
   floor_node->setEstimate(floor_pose);
+  mark_vertex_updated(floor_node->id());
 
   return;
 }
@@ -309,6 +521,7 @@ g2o::VertexWallXYZ* GraphSLAM::add_wall_node(const Eigen::Vector3d& wall_center)
   vertex->setId(static_cast<int>(retrieve_local_nbr_of_vertices()));
   vertex->setEstimate(wall_center);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
   this->increment_local_nbr_of_vertices();
 
   return vertex;
@@ -320,6 +533,7 @@ g2o::VertexWallXYZ* GraphSLAM::copy_wall_node(const g2o::VertexWallXYZ* wall_nod
   vertex->setEstimate(wall_node->estimate());
   if (wall_node->fixed()) vertex->setFixed(true);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
 
   return vertex;
 }
@@ -329,6 +543,7 @@ g2o::VertexDeviation* GraphSLAM::add_deviation_node(const Eigen::Isometry3d& pos
   vertex->setId(static_cast<int>(retrieve_local_nbr_of_vertices()));
   vertex->setEstimate(pose);
   graph->addVertex(vertex);
+  mark_vertex_added(vertex->id());
   this->increment_local_nbr_of_vertices();
   return vertex;
 }
@@ -336,7 +551,7 @@ g2o::VertexDeviation* GraphSLAM::add_deviation_node(const Eigen::Isometry3d& pos
 g2o::EdgeSE3* GraphSLAM::add_se3_edge(g2o::VertexSE3* v1,
                                       g2o::VertexSE3* v2,
                                       const Eigen::Isometry3d& relative_pose,
-                                      const Eigen::MatrixXd& information_matrix,
+                                      const InformationMatrix<6>& information_matrix,
                                       const bool use_edge_size_id) {
   g2o::EdgeSE3* edge(new g2o::EdgeSE3());
   if (use_edge_size_id)
@@ -348,6 +563,7 @@ g2o::EdgeSE3* GraphSLAM::add_se3_edge(g2o::VertexSE3* v1,
   edge->vertices()[0] = v1;
   edge->vertices()[1] = v2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -357,7 +573,7 @@ g2o::EdgeLoopClosure* GraphSLAM::add_loop_closure_edge(
     g2o::VertexSE3* v1,
     g2o::VertexSE3* v2,
     const Eigen::Isometry3d& relative_pose,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<6>& information_matrix) {
   g2o::EdgeLoopClosure* edge(new g2o::EdgeLoopClosure());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(relative_pose);
@@ -365,6 +581,7 @@ g2o::EdgeLoopClosure* GraphSLAM::add_loop_closure_edge(
   edge->vertices()[0] = v1;
   edge->vertices()[1] = v2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -380,6 +597,7 @@ g2o::EdgeSE3* GraphSLAM::copy_se3_edge(g2o::EdgeSE3* e,
   edge->vertices()[0] = v1;
   edge->vertices()[1] = v2;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
@@ -388,7 +606,7 @@ g2o::EdgeSE3Plane* GraphSLAM::add_se3_plane_edge(
     g2o::VertexSE3* v_se3,
     g2o::VertexPlane* v_plane,
     const Eigen::Vector4d& plane_coeffs,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<3>& information_matrix) {
   g2o::EdgeSE3Plane* edge(new g2o::EdgeSE3Plane());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(plane_coeffs);
@@ -396,6 +614,7 @@ g2o::EdgeSE3Plane* GraphSLAM::add_se3_plane_edge(
   edge->vertices()[0] = v_se3;
   edge->vertices()[1] = v_plane;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -411,6 +630,7 @@ g2o::EdgeSE3* GraphSLAM::copy_loop_closure_edge(g2o::EdgeLoopClosure* e,
   edge->vertices()[0] = v1;
   edge->vertices()[1] = v2;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
@@ -425,18 +645,21 @@ g2o::EdgeSE3Plane* GraphSLAM::copy_se3_plane_edge(g2o::EdgeSE3Plane* e,
   edge->vertices()[0] = v1;
   edge->vertices()[1] = v2;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
 
 bool GraphSLAM::remove_se3_plane_edge(g2o::EdgeSE3Plane* se3_plane_edge) {
   bool ack = graph->removeEdge(se3_plane_edge);
+  if (ack) mark_structure_updated();
 
   return ack;
 }
 
-void GraphSLAM::update_se3edge_information(g2o::EdgeSE3* edge_se3,
-                                           Eigen::MatrixXd information_matrix) {
+void GraphSLAM::update_se3edge_information(
+    g2o::EdgeSE3* edge_se3,
+    const InformationMatrix<6>& information_matrix) {
   edge_se3->setInformation(information_matrix);
 }
 
@@ -444,7 +667,7 @@ g2o::EdgeSE3PointToPlane* GraphSLAM::add_se3_point_to_plane_edge(
     g2o::VertexSE3* v_se3,
     g2o::VertexPlane* v_plane,
     const Eigen::Matrix4d& points_matrix,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<1>& information_matrix) {
   g2o::EdgeSE3PointToPlane* edge(new g2o::EdgeSE3PointToPlane());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(points_matrix);
@@ -452,6 +675,7 @@ g2o::EdgeSE3PointToPlane* GraphSLAM::add_se3_point_to_plane_edge(
   edge->vertices()[0] = v_se3;
   edge->vertices()[1] = v_plane;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -461,7 +685,7 @@ g2o::EdgeSE3PointXYZ* GraphSLAM::add_se3_point_xyz_edge(
     g2o::VertexSE3* v_se3,
     g2o::VertexPointXYZ* v_xyz,
     const Eigen::Vector3d& xyz,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<3>& information_matrix) {
   g2o::EdgeSE3PointXYZ* edge(new g2o::EdgeSE3PointXYZ());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(xyz);
@@ -469,6 +693,7 @@ g2o::EdgeSE3PointXYZ* GraphSLAM::add_se3_point_xyz_edge(
   edge->vertices()[0] = v_se3;
   edge->vertices()[1] = v_xyz;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -477,13 +702,14 @@ g2o::EdgeSE3PointXYZ* GraphSLAM::add_se3_point_xyz_edge(
 g2o::EdgePlanePriorNormal* GraphSLAM::add_plane_normal_prior_edge(
     g2o::VertexPlane* v,
     const Eigen::Vector3d& normal,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<3>& information_matrix) {
   g2o::EdgePlanePriorNormal* edge(new g2o::EdgePlanePriorNormal());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(normal);
   edge->setInformation(information_matrix);
   edge->vertices()[0] = v;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -492,13 +718,14 @@ g2o::EdgePlanePriorNormal* GraphSLAM::add_plane_normal_prior_edge(
 g2o::EdgePlanePriorDistance* GraphSLAM::add_plane_distance_prior_edge(
     g2o::VertexPlane* v,
     double distance,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<1>& information_matrix) {
   g2o::EdgePlanePriorDistance* edge(new g2o::EdgePlanePriorDistance());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(distance);
   edge->setInformation(information_matrix);
   edge->vertices()[0] = v;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -507,13 +734,14 @@ g2o::EdgePlanePriorDistance* GraphSLAM::add_plane_distance_prior_edge(
 g2o::EdgeSE3PriorXY* GraphSLAM::add_se3_prior_xy_edge(
     g2o::VertexSE3* v_se3,
     const Eigen::Vector2d& xy,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<2>& information_matrix) {
   g2o::EdgeSE3PriorXY* edge(new g2o::EdgeSE3PriorXY());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(xy);
   edge->setInformation(information_matrix);
   edge->vertices()[0] = v_se3;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -522,13 +750,14 @@ g2o::EdgeSE3PriorXY* GraphSLAM::add_se3_prior_xy_edge(
 g2o::EdgeSE3PriorXYZ* GraphSLAM::add_se3_prior_xyz_edge(
     g2o::VertexSE3* v_se3,
     const Eigen::Vector3d& xyz,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<3>& information_matrix) {
   g2o::EdgeSE3PriorXYZ* edge(new g2o::EdgeSE3PriorXYZ());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(xyz);
   edge->setInformation(information_matrix);
   edge->vertices()[0] = v_se3;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -538,7 +767,7 @@ g2o::EdgeSE3PriorVec* GraphSLAM::add_se3_prior_vec_edge(
     g2o::VertexSE3* v_se3,
     const Eigen::Vector3d& direction,
     const Eigen::Vector3d& measurement,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<3>& information_matrix) {
   Eigen::Matrix<double, 6, 1> m;
   m.head<3>() = direction;
   m.tail<3>() = measurement;
@@ -549,6 +778,7 @@ g2o::EdgeSE3PriorVec* GraphSLAM::add_se3_prior_vec_edge(
   edge->setInformation(information_matrix);
   edge->vertices()[0] = v_se3;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -557,13 +787,14 @@ g2o::EdgeSE3PriorVec* GraphSLAM::add_se3_prior_vec_edge(
 g2o::EdgeSE3PriorQuat* GraphSLAM::add_se3_prior_quat_edge(
     g2o::VertexSE3* v_se3,
     const Eigen::Quaterniond& quat,
-    const Eigen::MatrixXd& information_matrix) {
+    const InformationMatrix<3>& information_matrix) {
   g2o::EdgeSE3PriorQuat* edge(new g2o::EdgeSE3PriorQuat());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(quat);
   edge->setInformation(information_matrix);
   edge->vertices()[0] = v_se3;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -572,7 +803,7 @@ g2o::EdgeSE3PriorQuat* GraphSLAM::add_se3_prior_quat_edge(
 g2o::EdgePlane* GraphSLAM::add_plane_edge(g2o::VertexPlane* v_plane1,
                                           g2o::VertexPlane* v_plane2,
                                           const Eigen::Vector4d& measurement,
-                                          const Eigen::Matrix4d& information) {
+                                          const InformationMatrix<4>& information) {
   g2o::EdgePlane* edge(new g2o::EdgePlane());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(measurement);
@@ -580,6 +811,7 @@ g2o::EdgePlane* GraphSLAM::add_plane_edge(g2o::VertexPlane* v_plane1,
   edge->vertices()[0] = v_plane1;
   edge->vertices()[1] = v_plane2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -589,7 +821,7 @@ g2o::EdgePlaneIdentity* GraphSLAM::add_plane_identity_edge(
     g2o::VertexPlane* v_plane1,
     g2o::VertexPlane* v_plane2,
     const Eigen::Vector4d& measurement,
-    const Eigen::Matrix4d& information) {
+    const InformationMatrix<4>& information) {
   g2o::EdgePlaneIdentity* edge(new g2o::EdgePlaneIdentity());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(measurement);
@@ -597,6 +829,7 @@ g2o::EdgePlaneIdentity* GraphSLAM::add_plane_identity_edge(
   edge->vertices()[0] = v_plane1;
   edge->vertices()[1] = v_plane2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -606,7 +839,7 @@ g2o::EdgePlaneParallel* GraphSLAM::add_plane_parallel_edge(
     g2o::VertexPlane* v_plane1,
     g2o::VertexPlane* v_plane2,
     const Eigen::Vector3d& measurement,
-    const Eigen::MatrixXd& information) {
+    const InformationMatrix<1>& information) {
   g2o::EdgePlaneParallel* edge(new g2o::EdgePlaneParallel());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(measurement);
@@ -614,6 +847,7 @@ g2o::EdgePlaneParallel* GraphSLAM::add_plane_parallel_edge(
   edge->vertices()[0] = v_plane1;
   edge->vertices()[1] = v_plane2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -623,7 +857,7 @@ g2o::EdgePlanePerpendicular* GraphSLAM::add_plane_perpendicular_edge(
     g2o::VertexPlane* v_plane1,
     g2o::VertexPlane* v_plane2,
     const Eigen::Vector3d& measurement,
-    const Eigen::MatrixXd& information) {
+    const InformationMatrix<1>& information) {
   g2o::EdgePlanePerpendicular* edge(new g2o::EdgePlanePerpendicular());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(measurement);
@@ -631,6 +865,7 @@ g2o::EdgePlanePerpendicular* GraphSLAM::add_plane_perpendicular_edge(
   edge->vertices()[0] = v_plane1;
   edge->vertices()[1] = v_plane2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -638,13 +873,14 @@ g2o::EdgePlanePerpendicular* GraphSLAM::add_plane_perpendicular_edge(
 
 g2o::Edge2Planes* GraphSLAM::add_2planes_edge(g2o::VertexPlane* v_plane1,
                                               g2o::VertexPlane* v_plane2,
-                                              const Eigen::MatrixXd& information) {
+                                              const InformationMatrix<3>& information) {
   g2o::Edge2Planes* edge(new g2o::Edge2Planes());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setInformation(information);
   edge->vertices()[0] = v_plane1;
   edge->vertices()[1] = v_plane2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -659,6 +895,7 @@ g2o::Edge2Planes* GraphSLAM::copy_2planes_edge(g2o::Edge2Planes* e,
   edge->vertices()[0] = v1;
   edge->vertices()[1] = v2;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
@@ -674,6 +911,7 @@ g2o::EdgeWall2Planes* GraphSLAM::copy_wall_2planes_edge(g2o::EdgeWall2Planes* e,
   edge->vertices()[1] = v2;
   edge->vertices()[2] = v3;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
@@ -682,7 +920,7 @@ g2o::EdgeSE3PlanePlane* GraphSLAM::add_se3_point_to_2planes_edge(
     g2o::VertexDeviation* v_se3,
     g2o::VertexPlane* v_plane1,
     g2o::VertexPlane* v_plane2,
-    const Eigen::MatrixXd& information) {
+    const InformationMatrix<3>& information) {
   std::cout << "inside graph slam function" << std::endl;
   g2o::EdgeSE3PlanePlane* edge(new g2o::EdgeSE3PlanePlane());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
@@ -692,16 +930,18 @@ g2o::EdgeSE3PlanePlane* GraphSLAM::add_se3_point_to_2planes_edge(
   edge->vertices()[1] = v_plane1;
   edge->vertices()[2] = v_plane2;
   graph->addEdge(edge);
+  mark_structure_updated();
   std::cout << "Edge added" << std::endl;
   this->increment_local_nbr_of_edges();
 
   return edge;
 }
 
-g2o::EdgeSE3Room* GraphSLAM::add_se3_room_edge(g2o::VertexSE3* v_se3,
-                                               g2o::VertexRoom* v_room,
-                                               const Eigen::Vector2d& measurement,
-                                               const Eigen::MatrixXd& information) {
+g2o::EdgeSE3Room* GraphSLAM::add_se3_room_edge(
+    g2o::VertexSE3* v_se3,
+    g2o::VertexRoom* v_room,
+    const Eigen::Vector2d& measurement,
+    const InformationMatrix<2>& information) {
   g2o::EdgeSE3Room* edge(new g2o::EdgeSE3Room());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(measurement);
@@ -709,6 +949,7 @@ g2o::EdgeSE3Room* GraphSLAM::add_se3_room_edge(g2o::VertexSE3* v_se3,
   edge->vertices()[0] = v_se3;
   edge->vertices()[1] = v_room;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -719,7 +960,7 @@ g2o::EdgeRoom2Planes* GraphSLAM::add_room_2planes_edge(
     g2o::VertexPlane* v_plane1,
     g2o::VertexPlane* v_plane2,
     g2o::VertexRoom* v_cluster_center,
-    const Eigen::MatrixXd& information) {
+    const InformationMatrix<2>& information) {
   g2o::EdgeRoom2Planes* edge(new g2o::EdgeRoom2Planes());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setInformation(information);
@@ -728,6 +969,7 @@ g2o::EdgeRoom2Planes* GraphSLAM::add_room_2planes_edge(
   edge->vertices()[2] = v_plane2;
   edge->vertices()[3] = v_cluster_center;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -738,7 +980,7 @@ g2o::EdgeWall2Planes* GraphSLAM::add_wall_2planes_edge(
     g2o::VertexPlane* v_plane1,
     g2o::VertexPlane* v_plane2,
     Eigen::Vector3d wall_point,
-    const Eigen::MatrixXd& information) {
+    const InformationMatrix<3>& information) {
   g2o::EdgeWall2Planes* edge(new g2o::EdgeWall2Planes(wall_point));
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setInformation(information);
@@ -746,6 +988,7 @@ g2o::EdgeWall2Planes* GraphSLAM::add_wall_2planes_edge(
   edge->vertices()[1] = v_plane1;
   edge->vertices()[2] = v_plane2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -756,7 +999,7 @@ g2o::EdgeDoorWay2Rooms* GraphSLAM::add_doorway_2rooms_edge(
     g2o::VertexDoorWay* v_door_r2,
     g2o::VertexRoom* v_room1,
     g2o::VertexRoom* v_room2,
-    const Eigen::MatrixXd& information) {
+    const InformationMatrix<3>& information) {
   g2o::EdgeDoorWay2Rooms* edge(new g2o::EdgeDoorWay2Rooms());
   edge->setInformation(information);
   edge->vertices()[0] = v_door_r1;
@@ -764,12 +1007,14 @@ g2o::EdgeDoorWay2Rooms* GraphSLAM::add_doorway_2rooms_edge(
   edge->vertices()[2] = v_room1;
   edge->vertices()[3] = v_room2;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
 
 bool GraphSLAM::remove_room_2planes_edge(g2o::EdgeRoom2Planes* room_plane_edge) {
   bool ack = graph->removeEdge(room_plane_edge);
+  if (ack) mark_structure_updated();
 
   return ack;
 }
@@ -787,6 +1032,7 @@ g2o::EdgeRoom2Planes* GraphSLAM::copy_room_2planes_edge(g2o::EdgeRoom2Planes* e,
   edge->vertices()[2] = v3;
   edge->vertices()[3] = v4;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
@@ -797,7 +1043,7 @@ g2o::EdgeRoom4Planes* GraphSLAM::add_room_4planes_edge(
     g2o::VertexPlane* v_xplane2,
     g2o::VertexPlane* v_yplane1,
     g2o::VertexPlane* v_yplane2,
-    const Eigen::MatrixXd& information) {
+    const InformationMatrix<2>& information) {
   g2o::EdgeRoom4Planes* edge(new g2o::EdgeRoom4Planes());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setInformation(information);
@@ -807,6 +1053,7 @@ g2o::EdgeRoom4Planes* GraphSLAM::add_room_4planes_edge(
   edge->vertices()[3] = v_yplane1;
   edge->vertices()[4] = v_yplane2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -816,7 +1063,7 @@ g2o::EdgeSE3RoomRoom* GraphSLAM::add_deviation_two_rooms_edge(
     g2o::VertexDeviation* v1,
     g2o::VertexRoom* v2,
     g2o::VertexRoom* v3,
-    const Eigen::MatrixXd& information) {
+    const InformationMatrix<6>& information) {
   g2o::EdgeSE3RoomRoom* edge(new g2o::EdgeSE3RoomRoom());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setInformation(information);
@@ -825,6 +1072,7 @@ g2o::EdgeSE3RoomRoom* GraphSLAM::add_deviation_two_rooms_edge(
   edge->vertices()[1] = v2;
   edge->vertices()[2] = v3;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
   std::cout << "edge added !" << std::endl;
   return edge;
@@ -832,13 +1080,14 @@ g2o::EdgeSE3RoomRoom* GraphSLAM::add_deviation_two_rooms_edge(
 
 g2o::Edge2Rooms* GraphSLAM::add_2rooms_edge(g2o::VertexRoom* v1,
                                             g2o::VertexRoom* v2,
-                                            const Eigen::MatrixXd& information) {
+                                            const InformationMatrix<2>& information) {
   g2o::Edge2Rooms* edge(new g2o::Edge2Rooms());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setInformation(information);
   edge->vertices()[0] = v1;
   edge->vertices()[1] = v2;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
   return edge;
 }
@@ -858,14 +1107,16 @@ g2o::EdgeRoom4Planes* GraphSLAM::copy_room_4planes_edge(g2o::EdgeRoom4Planes* e,
   edge->vertices()[3] = v4;
   edge->vertices()[4] = v5;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
 
-g2o::EdgeFloorRoom* GraphSLAM::add_floor_room_edge(g2o::VertexFloor* v_floor,
-                                                   g2o::VertexRoom* v_room,
-                                                   const Eigen::Vector2d& measurement,
-                                                   const Eigen::MatrixXd& information) {
+g2o::EdgeFloorRoom* GraphSLAM::add_floor_room_edge(
+    g2o::VertexFloor* v_floor,
+    g2o::VertexRoom* v_room,
+    const Eigen::Vector2d& measurement,
+    const InformationMatrix<2>& information) {
   g2o::EdgeFloorRoom* edge(new g2o::EdgeFloorRoom());
   edge->setId(static_cast<int>(retrieve_local_nbr_of_edges()));
   edge->setMeasurement(measurement);
@@ -873,6 +1124,7 @@ g2o::EdgeFloorRoom* GraphSLAM::add_floor_room_edge(g2o::VertexFloor* v_floor,
   edge->vertices()[0] = v_floor;
   edge->vertices()[1] = v_room;
   graph->addEdge(edge);
+  mark_structure_updated();
   this->increment_local_nbr_of_edges();
 
   return edge;
@@ -888,12 +1140,14 @@ g2o::EdgeFloorRoom* GraphSLAM::copy_floor_room_edge(g2o::EdgeFloorRoom* e,
   edge->vertices()[0] = v1;
   edge->vertices()[1] = v2;
   graph->addEdge(edge);
+  mark_structure_updated();
 
   return edge;
 }
 
 bool GraphSLAM::remove_room_room_edge(g2o::EdgeFloorRoom* room_room_edge) {
   bool ack = graph->removeEdge(room_room_edge);
+  if (ack) mark_structure_updated();
 
   return ack;
 }
@@ -939,10 +1193,19 @@ int GraphSLAM::optimize(const std::string optimization_type, const int num_itera
   }
 
   std::cout << "optimize!!" << std::endl;
+  begin_optimization();
+#if defined(G2O_OPENMP) && defined(_OPENMP)
+  // g2o evaluates errors and jacobians in OpenMP regions of the calling thread
+  const int default_num_threads = omp_get_max_threads();
+  if (solver_config.num_threads > 0) omp_set_num_threads(solver_config.num_threads);
+#endif
   auto t1 = rclcpp::Clock{}.now();
   int iterations = graph->optimize(num_iterations);
   auto t2 = rclcpp::Clock{}.now();
-  std::cout << "done" << std::endl;
+#if defined(G2O_OPENMP) && defined(_OPENMP)
+  omp_set_num_threads(default_num_threads);
+#endif
+  std::cout << (force_stop ? "stopped early" : "done") << std::endl;
   std::cout << "iterations: " << iterations << " / " << num_iterations << std::endl;
   std::cout << "chi2: (before)" << chi2 << " -> (after)" << graph->chi2() << std::endl;
   std::cout << "time: " << boost::format("%.3f") % (t2 - t1).seconds() << "[sec]"
@@ -964,6 +1227,13 @@ int GraphSLAM::optimize(const std::string optimization_type, const int num_itera
     throw std::invalid_argument("GRAPH RETURNED A NAN...STOPPING THE EXPERIMENT");
   }
 
+  // only the vertices that actually moved during the iterations get a revision
+  if (iterations > 0) {
+    for (const auto vertex : graph->activeVertices()) {
+      if (!vertex->fixed()) mark_vertex_changed(vertex->id());
+    }
+  }
+
   return iterations;
 }
 
@@ -977,6 +1247,60 @@ bool GraphSLAM::compute_landmark_marginals(
   }
 }
 
+int GraphSLAM::update_landmark_marginals(const std::vector<int>& pose_ids) {
+  landmark_marginals.clear();
+
+  // only the diagonal blocks of the active landmarks are recovered, the solver
+  // never builds the full inverse
+  std::vector<g2o::OptimizableGraph::Vertex*> landmarks;
+  std::vector<std::pair<int, int>> block_indices;
+  for (const auto vertex : graph->activeVertices()) {
+    if (vertex->fixed() || vertex->hessianIndex() < 0) continue;
+    const bool requested_pose =
+        dynamic_cast<g2o::VertexSE3*>(vertex) &&
+        std::find(pose_ids.begin(), pose_ids.end(), vertex->id()) != pose_ids.end();
+    if (!requested_pose && !dynamic_cast<g2o::VertexPlane*>(vertex) &&
+        !dynamic_cast<g2o::VertexRoom*>(vertex) &&
+        !dynamic_cast<g2o::VertexInfiniteRoom*>(vertex))
+      continue;
+    landmarks.push_back(vertex);
+    block_indices.emplace_back(vertex->hessianIndex(), vertex->hessianIndex());
+  }
+  if (block_indices.empty()) return 0;
+
+  g2o::SparseBlockMatrix<Eigen::MatrixXd> spinv;
+  if (!compute_landmark_marginals(spinv, block_indices)) return 0;
+
+  for (const auto vertex : landmarks) {
+    const Eigen::MatrixXd* block =
+        spinv.block(vertex->hessianIndex(), vertex->hessianIndex());
+    if (block == nullptr || !block->allFinite()) continue;
+
+    Eigen::LDLT<Eigen::MatrixXd> ldlt(*block);
+    if (ldlt.info() != Eigen::Success || !ldlt.isPositive()) continue;
+
+    landmark_marginals[vertex->id()].covariance = *block;
+  }
+
+  return static_cast<int>(landmark_marginals.size());
+}
+
+bool GraphSLAM::build_full_system() {
+  auto algorithm =
+      dynamic_cast<g2o::OptimizationAlgorithmWithHessian*>(graph->solver());
+  if (!algorithm || !graph->initializeOptimization()) return false;
+  if (!algorithm->init()) return false;
+
+  graph->computeActiveErrors();
+  return algorithm->solver().buildSystem();
+}
+
+const LandmarkMarginal* GraphSLAM::get_landmark_marginal(const int vertex_id) const {
+  auto found = landmark_marginals.find(vertex_id);
+  if (found == landmark_marginals.end()) return nullptr;
+  return &found->second;
+}
+
 void GraphSLAM::save(const std::string& filename) {
   g2o::SparseOptimizer* graph = dynamic_cast<g2o::SparseOptimizer*>(this->graph.get());
 
@@ -1002,6 +1326,11 @@ bool GraphSLAM::load(const std::string& filename) {
     return false;
   }
 
+  for (const auto& vertex : graph->vertices()) {
+    mark_vertex_added(vertex.first);
+  }
+  mark_structure_updated();
+
   return true;
 }
 
@@ -0,0 +1,408 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <g2o/core/robust_kernel.h>
+#include <g2o/types/slam3d_addons/plane3d.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <g2o/edge_se3_plane.hpp>
+#include <g2o/vertex_floor.hpp>
+#include <g2o/vertex_infinite_room.hpp>
+#include <g2o/vertex_room.hpp>
+#include <map>
+#include <s_graphs/backend/hierarchical_optimizer.hpp>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace s_graphs {
+
+namespace {
+
+using VertexPredicate = std::function<bool(const g2o::HyperGraph::Vertex*)>;
+
+bool is_keyframe(const g2o::HyperGraph::Vertex* vertex) {
+  return dynamic_cast<const g2o::VertexSE3*>(vertex) != nullptr;
+}
+
+bool is_plane(const g2o::HyperGraph::Vertex* vertex) {
+  return dynamic_cast<const g2o::VertexPlane*>(vertex) != nullptr;
+}
+
+/**
+ * @brief Edges between keyframes and planes only, i.e. the ones a room subproblem
+ * condenses. Odometry, loop closures and keyframe priors are included.
+ */
+bool is_keyframe_edge(const g2o::HyperGraph::Edge* edge) {
+  bool has_keyframe = false;
+  for (const auto vertex : edge->vertices()) {
+    if (is_keyframe(vertex))
+      has_keyframe = true;
+    else if (!is_plane(vertex))
+      return false;
+  }
+  return has_keyframe;
+}
+
+/**
+ * @brief Fixes every vertex of an edge set that is not free for the duration of a
+ * solve and releases them again on destruction.
+ */
+class ScopedFixedVertices {
+ public:
+  ScopedFixedVertices(const g2o::HyperGraph::EdgeSet& edges,
+                      const VertexPredicate& is_free) {
+    for (const auto edge : edges) {
+      for (const auto vertex : edge->vertices()) {
+        auto optimizable = static_cast<g2o::OptimizableGraph::Vertex*>(vertex);
+        if (optimizable->fixed() || is_free(optimizable)) continue;
+        optimizable->setFixed(true);
+        fixed_vertices.push_back(optimizable);
+      }
+    }
+  }
+
+  ~ScopedFixedVertices() {
+    for (const auto vertex : fixed_vertices) vertex->setFixed(false);
+  }
+
+ private:
+  std::vector<g2o::OptimizableGraph::Vertex*> fixed_vertices;
+};
+
+int solve(g2o::SparseOptimizer* graph,
+          g2o::HyperGraph::EdgeSet& edges,
+          const int num_iterations) {
+  if (edges.empty()) return 0;
+
+  graph->initializeOptimization(edges);
+  int iterations = graph->optimize(num_iterations);
+  if (std::isnan(graph->chi2())) {
+    throw std::invalid_argument("GRAPH RETURNED A NAN...STOPPING THE EXPERIMENT");
+  }
+  return iterations;
+}
+
+/**
+ * @brief Robust chi2 of every edge of the graph at the current estimates. The edges
+ * are evaluated directly so the structure of the last solve is left initialized.
+ */
+double total_chi2(const g2o::SparseOptimizer* graph) {
+  double chi2 = 0.0;
+  for (const auto hyper_edge : graph->edges()) {
+    auto edge = static_cast<g2o::OptimizableGraph::Edge*>(hyper_edge);
+    edge->computeError();
+    if (edge->robustKernel()) {
+      Eigen::Vector3d rho;
+      edge->robustKernel()->robustify(edge->chi2(), rho);
+      chi2 += rho[0];
+    } else {
+      chi2 += edge->chi2();
+    }
+  }
+  return chi2;
+}
+
+}  // namespace
+
+HierarchicalOptimizer::HierarchicalOptimizer(const rclcpp::Node::SharedPtr node) {
+  subproblem_iterations = node->get_parameter("hierarchical_subproblem_iterations")
+                              .get_parameter_value()
+                              .get<int>();
+  max_rounds =
+      node->get_parameter("hierarchical_max_rounds").get_parameter_value().get<int>();
+}
+
+HierarchicalOptimizer::~HierarchicalOptimizer() {}
+
+int HierarchicalOptimizer::optimize(GraphSLAM* graph_slam, const int num_iterations) {
+  g2o::SparseOptimizer* graph = graph_slam->graph.get();
+  if (graph->edges().size() < 10) {
+    return -1;
+  }
+
+  std::cout << std::endl;
+  std::cout << "--- hierarchical graph optimization ---" << std::endl;
+  std::cout << "nodes: " << graph->vertices().size()
+            << "   edges: " << graph->edges().size() << std::endl;
+  graph->setVerbose(false);
+  graph_slam->begin_optimization();
+
+  auto t1 = rclcpp::Clock{}.now();
+  const std::vector<RoomCluster> room_clusters = build_room_clusters(graph);
+
+  // a pass is kept while it decreases the error of the whole graph, the last one
+  // decreasing it by less than this fraction ends the optimization
+  const double convergence_ratio = 1e-3;
+  g2o::SparseOptimizer::VertexContainer vertices;
+  for (const auto& vertex_pair : graph->vertices()) {
+    vertices.push_back(static_cast<g2o::OptimizableGraph::Vertex*>(vertex_pair.second));
+  }
+
+  double chi2 = total_chi2(graph);
+  int iterations = 0, rounds = 0;
+  size_t num_plane_priors = 0;
+  // a preemption or an exhausted time budget ends the pass in progress, which is
+  // still kept if it lowered the error, and no further pass is started
+  while (rounds < max_rounds && !graph_slam->optimization_stopped()) {
+    graph->push(vertices);
+    std::vector<PlanePrior> plane_priors;
+    int round_iterations = 0;
+    for (const auto& room_cluster : room_clusters) {
+      if (graph_slam->optimization_stopped()) break;
+      round_iterations += solve_room(graph, room_cluster, plane_priors);
+    }
+    if (!graph_slam->optimization_stopped()) {
+      round_iterations +=
+          std::max(solve_condensed(graph, plane_priors, num_iterations), 0);
+    }
+    if (!graph_slam->optimization_stopped()) {
+      round_iterations += std::max(solve_keyframes(graph), 0);
+    }
+
+    const double round_chi2 = total_chi2(graph);
+    if (round_chi2 > chi2) {
+      graph->pop(vertices);
+      break;
+    }
+    graph->discardTop(vertices);
+    iterations += round_iterations;
+    num_plane_priors = plane_priors.size();
+    rounds++;
+
+    const bool converged = chi2 - round_chi2 <= convergence_ratio * chi2;
+    chi2 = round_chi2;
+    if (converged) break;
+  }
+  auto t2 = rclcpp::Clock{}.now();
+
+  std::cout << "rooms: " << room_clusters.size()
+            << "   condensed planes: " << num_plane_priors << "   passes: " << rounds
+            << std::endl;
+  std::cout << "chi2: " << chi2 << "   iterations: " << iterations
+            << "   time: " << (t2 - t1).seconds() << "[sec]" << std::endl;
+
+  if (iterations > 0) {
+    for (const auto& vertex_pair : graph->vertices()) {
+      auto vertex = static_cast<g2o::OptimizableGraph::Vertex*>(vertex_pair.second);
+      if (!vertex->fixed()) graph_slam->mark_vertex_changed(vertex->id());
+    }
+  }
+
+  return iterations;
+}
+
+std::vector<HierarchicalOptimizer::RoomCluster>
+HierarchicalOptimizer::build_room_clusters(g2o::SparseOptimizer* graph) const {
+  std::vector<g2o::OptimizableGraph::Vertex*> room_nodes;
+  for (const auto& vertex_pair : graph->vertices()) {
+    auto vertex = static_cast<g2o::OptimizableGraph::Vertex*>(vertex_pair.second);
+    if (dynamic_cast<g2o::VertexFloor*>(vertex)) continue;
+    if (dynamic_cast<g2o::VertexRoom*>(vertex) ||
+        dynamic_cast<g2o::VertexInfiniteRoom*>(vertex))
+      room_nodes.push_back(vertex);
+  }
+  std::sort(room_nodes.begin(),
+            room_nodes.end(),
+            [](const g2o::OptimizableGraph::Vertex* lhs,
+               const g2o::OptimizableGraph::Vertex* rhs) {
+              return lhs->id() < rhs->id();
+            });
+
+  std::vector<RoomCluster> room_clusters(room_nodes.size());
+  std::unordered_map<const g2o::HyperGraph::Vertex*, int> plane_owner;
+  for (size_t i = 0; i < room_nodes.size(); i++) {
+    room_clusters[i].room_node = room_nodes[i];
+    for (const auto edge : room_nodes[i]->edges()) {
+      for (const auto vertex : edge->vertices()) {
+        auto plane = dynamic_cast<g2o::VertexPlane*>(vertex);
+        if (plane && plane_owner.emplace(plane, static_cast<int>(i)).second) {
+          room_clusters[i].planes.push_back(plane);
+        }
+      }
+    }
+  }
+  if (plane_owner.empty()) return room_clusters;
+
+  // a keyframe goes to the room whose planes it observes most, the lowest room id
+  // wins ties
+  for (const auto& vertex_pair : graph->vertices()) {
+    auto keyframe = dynamic_cast<g2o::VertexSE3*>(vertex_pair.second);
+    if (!keyframe) continue;
+
+    std::map<int, int> observations;
+    for (const auto edge : keyframe->edges()) {
+      for (const auto vertex : edge->vertices()) {
+        auto found = plane_owner.find(vertex);
+        if (found != plane_owner.end()) observations[found->second]++;
+      }
+    }
+
+    int room_index = -1, max_observations = 0;
+    for (const auto& observation : observations) {
+      if (observation.second > max_observations) {
+        max_observations = observation.second;
+        room_index = observation.first;
+      }
+    }
+    if (room_index != -1) room_clusters[room_index].keyframes.push_back(keyframe);
+  }
+
+  return room_clusters;
+}
+
+int HierarchicalOptimizer::solve_room(g2o::SparseOptimizer* graph,
+                                      const RoomCluster& cluster,
+                                      std::vector<PlanePrior>& plane_priors) const {
+  if (cluster.keyframes.empty() || cluster.planes.empty()) return 0;
+
+  std::unordered_set<const g2o::HyperGraph::Vertex*> room_vertices;
+  room_vertices.insert(cluster.keyframes.begin(), cluster.keyframes.end());
+  room_vertices.insert(cluster.planes.begin(), cluster.planes.end());
+
+  // keyframes and planes of the neighbouring rooms act as a fixed boundary
+  g2o::HyperGraph::EdgeSet edges;
+  for (const auto vertex : room_vertices) {
+    for (const auto edge : vertex->edges()) {
+      if (is_keyframe_edge(edge)) edges.insert(edge);
+    }
+  }
+
+  ScopedFixedVertices boundary(edges, [&](const g2o::HyperGraph::Vertex* vertex) {
+    return room_vertices.count(vertex) > 0;
+  });
+  const int iterations = solve(graph, edges, subproblem_iterations);
+  if (iterations <= 0) return 0;
+
+  std::vector<g2o::VertexPlane*> planes;
+  std::vector<std::pair<int, int>> block_indices;
+  for (const auto plane : cluster.planes) {
+    if (plane->fixed() || plane->hessianIndex() < 0) continue;
+    planes.push_back(plane);
+    block_indices.emplace_back(plane->hessianIndex(), plane->hessianIndex());
+  }
+  if (block_indices.empty()) return iterations;
+
+  g2o::SparseBlockMatrix<Eigen::MatrixXd> spinv;
+  if (!graph->computeMarginals(spinv, block_indices)) return iterations;
+
+  for (const auto plane : planes) {
+    const Eigen::MatrixXd* block =
+        spinv.block(plane->hessianIndex(), plane->hessianIndex());
+    if (block == nullptr || !block->allFinite()) continue;
+
+    Eigen::LDLT<Eigen::MatrixXd> ldlt(*block);
+    if (ldlt.info() != Eigen::Success || !ldlt.isPositive()) continue;
+
+    PlanePrior plane_prior;
+    plane_prior.plane = plane;
+    plane_prior.coeffs = plane->estimate().coeffs();
+    plane_prior.information = ldlt.solve(Eigen::MatrixXd::Identity(3, 3));
+    plane_priors.push_back(plane_prior);
+  }
+  return iterations;
+}
+
+int HierarchicalOptimizer::solve_condensed(g2o::SparseOptimizer* graph,
+                                           const std::vector<PlanePrior>& plane_priors,
+                                           const int num_iterations) const {
+  std::unordered_set<const g2o::HyperGraph::Vertex*> condensed_planes;
+  for (const auto& plane_prior : plane_priors) {
+    condensed_planes.insert(plane_prior.plane);
+  }
+
+  // keyframe observations are only kept for the planes without a prior
+  g2o::HyperGraph::EdgeSet edges;
+  for (const auto edge : graph->edges()) {
+    if (is_keyframe_edge(edge)) {
+      bool observes_free_plane = false;
+      for (const auto vertex : edge->vertices()) {
+        if (is_plane(vertex) && condensed_planes.count(vertex) == 0) {
+          observes_free_plane = true;
+        }
+      }
+      if (!observes_free_plane) continue;
+    }
+    edges.insert(edge);
+  }
+
+  // the priors are plane observations from a fixed frame at the origin
+  int anchor_id = 0;
+  for (const auto& vertex_pair : graph->vertices()) {
+    anchor_id = std::max(anchor_id, vertex_pair.first + 1);
+  }
+  g2o::VertexSE3* anchor = new g2o::VertexSE3();
+  anchor->setId(anchor_id);
+  anchor->setEstimate(Eigen::Isometry3d::Identity());
+  anchor->setFixed(true);
+  graph->addVertex(anchor);
+
+  for (const auto& plane_prior : plane_priors) {
+    g2o::EdgeSE3Plane* edge = new g2o::EdgeSE3Plane();
+    edge->setMeasurement(g2o::Plane3D(plane_prior.coeffs));
+    edge->setInformation(plane_prior.information);
+    edge->vertices()[0] = anchor;
+    edge->vertices()[1] = plane_prior.plane;
+    graph->addEdge(edge);
+    edges.insert(edge);
+  }
+
+  int iterations;
+  {
+    ScopedFixedVertices keyframes(edges, [](const g2o::HyperGraph::Vertex* vertex) {
+      return !is_keyframe(vertex);
+    });
+    iterations = solve(graph, edges, num_iterations);
+  }
+
+  // removing the anchor also removes the priors attached to it
+  graph->removeVertex(anchor);
+  return iterations;
+}
+
+int HierarchicalOptimizer::solve_keyframes(g2o::SparseOptimizer* graph) const {
+  g2o::HyperGraph::EdgeSet edges;
+  for (const auto edge : graph->edges()) {
+    for (const auto vertex : edge->vertices()) {
+      if (is_keyframe(vertex)) {
+        edges.insert(edge);
+        break;
+      }
+    }
+  }
+
+  ScopedFixedVertices landmarks(edges, is_keyframe);
+  return solve(graph, edges, subproblem_iterations);
+}
+
+}  // namespace s_graphs
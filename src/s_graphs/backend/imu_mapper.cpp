@@ -33,7 +33,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 namespace s_graphs {
 
-IMUMapper::IMUMapper(const rclcpp::Node::SharedPtr node) {
+IMUMapper::IMUMapper(const rclcpp::Node::SharedPtr node) : imu_series(8192, 0.2) {
   imu_time_offset =
       node->get_parameter("imu_time_offset").get_parameter_value().get<double>();
   enable_imu_orientation =
@@ -55,104 +55,97 @@ bool IMUMapper::map_imu_data(std::shared_ptr<GraphSLAM>& covisibility_graph,
                              std::deque<sensor_msgs::msg::Imu::SharedPtr>& imu_queue,
                              const std::map<int, KeyFrame::Ptr>& keyframes,
                              const std::string base_frame_id) {
-  bool updated = false;
-  auto imu_cursor = imu_queue.begin();
-
-  for (auto& keyframe : keyframes) {
-    if (keyframe.second->stamp > imu_queue.back()->header.stamp) {
-      break;
-    }
-
-    if (keyframe.second->stamp < (*imu_cursor)->header.stamp ||
-        keyframe.second->acceleration) {
-      continue;
-    }
-
-    // find imu data which is closest to the keyframe
-    auto closest_imu = imu_cursor;
-    for (auto imu = imu_cursor; imu != imu_queue.end(); imu++) {
-      auto dt = (rclcpp::Time((*closest_imu)->header.stamp) - keyframe.second->stamp)
-                    .seconds();
-      auto dt2 =
-          (rclcpp::Time((*imu)->header.stamp) - keyframe.second->stamp).seconds();
-      if (std::abs(dt) < std::abs(dt2)) {
-        break;
-      }
-
-      closest_imu = imu;
-    }
-
-    imu_cursor = closest_imu;
-    if (0.2 <
-        std::abs((rclcpp::Time((*closest_imu)->header.stamp) - keyframe.second->stamp)
-                     .seconds())) {
-      continue;
-    }
-
-    const auto& imu_ori = (*closest_imu)->orientation;
-    const auto& imu_acc = (*closest_imu)->linear_acceleration;
-
-    geometry_msgs::msg::Vector3Stamped acc_imu;
-    geometry_msgs::msg::Vector3Stamped acc_base;
-    geometry_msgs::msg::QuaternionStamped quat_imu;
-    geometry_msgs::msg::QuaternionStamped quat_base;
+  for (const auto& imu : imu_queue) {
+    imu_series.insert(rclcpp::Time(imu->header.stamp).seconds(), imu);
+  }
+  imu_queue.clear();
 
-    quat_imu.header.frame_id = acc_imu.header.frame_id =
-        (*closest_imu)->header.frame_id;
-    quat_imu.header.stamp = acc_imu.header.stamp = rclcpp::Time(0);
-    acc_imu.vector = (*closest_imu)->linear_acceleration;
-    quat_imu.quaternion = (*closest_imu)->orientation;
+  bool updated = false;
+  auto associate_keyframe = [&](const KeyFrame::Ptr& keyframe, const auto& bracket) {
+    if (keyframe->acceleration) return true;
 
-    try {
-      tf_buffer->transform(acc_imu, acc_base, base_frame_id);
-      tf_buffer->transform(quat_imu, quat_base, base_frame_id);
-    } catch (std::exception& e) {
+    const auto& imu = bracket.before ? bracket.before->data : bracket.after->data;
+    if (!update_imu_to_base_rotation(tf_buffer, imu->header.frame_id, base_frame_id)) {
       std::cerr << "failed to find transform!!" << std::endl;
       return false;
     }
 
-    keyframe.second->acceleration =
-        Eigen::Vector3d(acc_base.vector.x, acc_base.vector.y, acc_base.vector.z);
-    keyframe.second->orientation = Eigen::Quaterniond(quat_base.quaternion.w,
-                                                      quat_base.quaternion.x,
-                                                      quat_base.quaternion.y,
-                                                      quat_base.quaternion.z);
-    keyframe.second->orientation = keyframe.second->orientation;
-    if (keyframe.second->orientation->w() < 0.0) {
-      keyframe.second->orientation->coeffs() = -keyframe.second->orientation->coeffs();
+    auto to_eigen = [](const sensor_msgs::msg::Imu& imu,
+                       Eigen::Quaterniond& orientation,
+                       Eigen::Vector3d& acceleration) {
+      orientation = Eigen::Quaterniond(imu.orientation.w,
+                                       imu.orientation.x,
+                                       imu.orientation.y,
+                                       imu.orientation.z);
+      acceleration = Eigen::Vector3d(imu.linear_acceleration.x,
+                                     imu.linear_acceleration.y,
+                                     imu.linear_acceleration.z);
+    };
+    Eigen::Quaterniond imu_ori;
+    Eigen::Vector3d imu_acc;
+    to_eigen(*imu, imu_ori, imu_acc);
+    if (bracket.before && bracket.after) {
+      Eigen::Quaterniond after_ori;
+      Eigen::Vector3d after_acc;
+      to_eigen(*bracket.after->data, after_ori, after_acc);
+      imu_ori = imu_ori.slerp(bracket.alpha, after_ori);
+      imu_acc = (1.0 - bracket.alpha) * imu_acc + bracket.alpha * after_acc;
+    }
+
+    keyframe->acceleration = (*imu_to_base_rotation) * imu_acc;
+    keyframe->orientation = (*imu_to_base_rotation) * imu_ori;
+    if (keyframe->orientation->w() < 0.0) {
+      keyframe->orientation->coeffs() = -keyframe->orientation->coeffs();
     }
 
     if (enable_imu_orientation) {
-      Eigen::MatrixXd info =
-          Eigen::MatrixXd::Identity(3, 3) / imu_orientation_edge_stddev;
+      InformationMatrix<3> info =
+          InformationMatrix<3>::Identity() / imu_orientation_edge_stddev;
       auto edge = covisibility_graph->add_se3_prior_quat_edge(
-          keyframe.second->node, *keyframe.second->orientation, info);
+          keyframe->node, *keyframe->orientation, info);
       covisibility_graph->add_robust_kernel(edge, "Huber", 1.0);
     }
 
     if (enable_imu_acceleration) {
-      Eigen::MatrixXd info =
-          Eigen::MatrixXd::Identity(3, 3) / imu_acceleration_edge_stddev;
+      InformationMatrix<3> info =
+          InformationMatrix<3>::Identity() / imu_acceleration_edge_stddev;
       g2o::OptimizableGraph::Edge* edge =
-          covisibility_graph->add_se3_prior_vec_edge(keyframe.second->node,
+          covisibility_graph->add_se3_prior_vec_edge(keyframe->node,
                                                      -Eigen::Vector3d::UnitZ(),
-                                                     *keyframe.second->acceleration,
+                                                     *keyframe->acceleration,
                                                      info);
       covisibility_graph->add_robust_kernel(edge, "Huber", 1.0);
     }
     updated = true;
+    return true;
+  };
+  imu_series.associate(keyframes, associate_keyframe);
+
+  return updated;
+}
+
+bool IMUMapper::update_imu_to_base_rotation(
+    const std::unique_ptr<tf2_ros::Buffer>& tf_buffer,
+    const std::string& imu_frame_id,
+    const std::string& base_frame_id) {
+  if (imu_to_base_rotation && imu_to_base_frame_ids.first == imu_frame_id &&
+      imu_to_base_frame_ids.second == base_frame_id) {
+    return true;
   }
 
-  auto remove_loc = std::upper_bound(
-      imu_queue.begin(),
-      imu_queue.end(),
-      keyframes.rbegin()->second->stamp,
-      [=](const rclcpp::Time& stamp, const sensor_msgs::msg::Imu::SharedPtr imu) {
-        return stamp < imu->header.stamp;
-      });
-  imu_queue.erase(imu_queue.begin(), remove_loc);
+  geometry_msgs::msg::TransformStamped transform;
+  try {
+    transform =
+        tf_buffer->lookupTransform(base_frame_id, imu_frame_id, tf2::TimePointZero);
+  } catch (std::exception& e) {
+    return false;
+  }
 
-  return updated;
+  const auto& rotation = transform.transform.rotation;
+  imu_to_base_rotation =
+      Eigen::Quaterniond(rotation.w, rotation.x, rotation.y, rotation.z).normalized();
+  imu_to_base_frame_ids = std::make_pair(imu_frame_id, base_frame_id);
+  return true;
 }
 
 }  // namespace s_graphs
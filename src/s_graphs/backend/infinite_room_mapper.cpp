@@ -54,6 +54,7 @@ InfiniteRoomMapper::InfiniteRoomMapper(const rclcpp::Node::SharedPtr node) {
       node->get_parameter("use_perpendicular_plane_constraint")
           .get_parameter_value()
           .get<bool>();
+  room_registry = std::make_unique<RoomRegistry>(infinite_room_dist_threshold);
 }
 
 InfiniteRoomMapper::~InfiniteRoomMapper() {}
@@ -94,31 +95,15 @@ bool InfiniteRoomMapper::lookup_infinite_rooms(
   cluster_center.translation().z() = room_data.cluster_center.z;
 
   if (plane_type == PlaneUtils::plane_class::X_VERT_PLANE) {
-    // check the distance with the current room vector
-    Rooms matched_room;
+    // check for a room bounded by the same planes or close to this one
+    room_registry->sync_rooms(*graph_slam, rooms_vec);
     float min_dist_x_inf_room_room = 100;
-    for (const auto& current_room : rooms_vec) {
-      if ((room_data.x_planes[0].id == current_room.second.plane_x1_id ||
-           room_data.x_planes[0].id == current_room.second.plane_x2_id) &&
-          (room_data.x_planes[1].id == current_room.second.plane_x1_id ||
-           room_data.x_planes[1].id == current_room.second.plane_x2_id)) {
-        min_dist_x_inf_room_room = 0;
-        matched_room = current_room.second;
-        break;
-      }
-
-      float dist_x_inf_room_room =
-          sqrt(pow(room_data.room_center.position.x -
-                       current_room.second.node->estimate().translation()(0),
-                   2) +
-               pow(room_data.room_center.position.y -
-                       current_room.second.node->estimate().translation()(1),
-                   2));
-      if (dist_x_inf_room_room < min_dist_x_inf_room_room) {
-        min_dist_x_inf_room_room = dist_x_inf_room_room;
-        matched_room = current_room.second;
-      }
-    }
+    int matched_room_id = room_registry->find_room_with_planes(
+        room_data.x_planes[0].id, room_data.x_planes[1].id);
+    if (matched_room_id == -1)
+      matched_room_id =
+          room_registry->find_nearest_room(room_center.translation().head(2), 1.0);
+    if (matched_room_id != -1) min_dist_x_inf_room_room = 0;
 
     if (min_dist_x_inf_room_room < 1.0) {
       std::cout << "Room already exists in the given location, not inserting an x "
@@ -160,30 +145,14 @@ bool InfiniteRoomMapper::lookup_infinite_rooms(
   }
 
   else if (plane_type == PlaneUtils::plane_class::Y_VERT_PLANE) {
+    room_registry->sync_rooms(*graph_slam, rooms_vec);
     float min_dist_y_inf_room_room = 100;
-    Rooms matched_room;
-    for (const auto& current_room : rooms_vec) {
-      if ((room_data.y_planes[0].id == current_room.second.plane_y1_id ||
-           room_data.y_planes[0].id == current_room.second.plane_y2_id) &&
-          (room_data.y_planes[1].id == current_room.second.plane_y1_id ||
-           room_data.y_planes[1].id == current_room.second.plane_y2_id)) {
-        min_dist_y_inf_room_room = 0;
-        matched_room = current_room.second;
-        break;
-      }
-
-      float dist_y_inf_room_room =
-          sqrt(pow(room_data.room_center.position.x -
-                       current_room.second.node->estimate().translation()(0),
-                   2) +
-               pow(room_data.room_center.position.y -
-                       current_room.second.node->estimate().translation()(1),
-                   2));
-      if (dist_y_inf_room_room < min_dist_y_inf_room_room) {
-        min_dist_y_inf_room_room = dist_y_inf_room_room;
-        matched_room = current_room.second;
-      }
-    }
+    int matched_room_id = room_registry->find_room_with_planes(
+        room_data.y_planes[0].id, room_data.y_planes[1].id);
+    if (matched_room_id == -1)
+      matched_room_id =
+          room_registry->find_nearest_room(room_center.translation().head(2), 1.0);
+    if (matched_room_id != -1) min_dist_y_inf_room_room = 0;
     if (min_dist_y_inf_room_room < 1.0) {
       std::cout << "Room already exists in the given location, not inserting a y "
                    "infinite_room"
@@ -286,7 +255,8 @@ bool InfiniteRoomMapper::factor_infinite_rooms(
     }
 
     std::vector<std::pair<VerticalPlanes, VerticalPlanes>> detected_mapped_plane_pairs;
-    room_data_association = associate_infinite_rooms(plane_type,
+    room_data_association = associate_infinite_rooms(graph_slam,
+                                                     plane_type,
                                                      room_center,
                                                      (found_plane1->second),
                                                      (found_plane2->second),
@@ -381,7 +351,8 @@ bool InfiniteRoomMapper::factor_infinite_rooms(
       return duplicate_found;
 
     std::vector<std::pair<VerticalPlanes, VerticalPlanes>> detected_mapped_plane_pairs;
-    room_data_association = associate_infinite_rooms(plane_type,
+    room_data_association = associate_infinite_rooms(graph_slam,
+                                                     plane_type,
                                                      room_center,
                                                      (found_plane1->second),
                                                      (found_plane2->second),
@@ -471,6 +442,7 @@ bool InfiniteRoomMapper::factor_infinite_rooms(
 }
 
 int InfiniteRoomMapper::associate_infinite_rooms(
+    std::shared_ptr<GraphSLAM>& graph_slam,
     const int& plane_type,
     const Eigen::Isometry3d& room_center,
     const VerticalPlanes& plane1,
@@ -482,144 +454,62 @@ int InfiniteRoomMapper::associate_infinite_rooms(
     std::vector<std::pair<VerticalPlanes, VerticalPlanes>>&
         detected_mapped_plane_pairs) {
   float min_dist = 100;
-  bool plane1_min_segment = false, plane2_min_segment = false;
-
   int data_association;
   data_association = -1;
 
-  if (plane_type == PlaneUtils::plane_class::X_VERT_PLANE) {
-    for (const auto& x_inf_room : x_infinite_rooms) {
-      float dist = sqrt(pow(room_center.translation()(0) -
-                                x_inf_room.second.node->estimate().translation()(0),
-                            2));
-
-      std::vector<std::pair<VerticalPlanes, VerticalPlanes>>
-          current_detected_mapped_plane_pairs;
-      std::pair<VerticalPlanes, VerticalPlanes> x1_detected_mapped_plane_pair;
-      std::pair<VerticalPlanes, VerticalPlanes> x2_detected_mapped_plane_pair;
-
-      auto found_mapped_plane1 = x_vert_planes.find(x_inf_room.second.plane1_id);
-      auto found_mapped_plane2 = x_vert_planes.find(x_inf_room.second.plane2_id);
-
-      if (plane1.id == (found_mapped_plane1->second).id ||
-          plane1.id == (found_mapped_plane2->second).id) {
-        plane1_min_segment = true;
-        x1_detected_mapped_plane_pair.first = plane1;
-        x1_detected_mapped_plane_pair.second = plane1;
-      } else if ((plane1).plane_node->estimate().coeffs().head(3).dot(
-                     (found_mapped_plane1->second)
-                         .plane_node->estimate()
-                         .coeffs()
-                         .head(3)) > 0) {
-        plane1_min_segment = PlaneUtils::check_point_neighbours(
-            (found_mapped_plane1->second).cloud_seg_map, plane1.cloud_seg_map);
-        x1_detected_mapped_plane_pair.first = plane1;
-        x1_detected_mapped_plane_pair.second = (found_mapped_plane1->second);
-      } else {
-        plane1_min_segment = PlaneUtils::check_point_neighbours(
-            (found_mapped_plane2->second).cloud_seg_map, plane1.cloud_seg_map);
-        x1_detected_mapped_plane_pair.first = plane1;
-        x1_detected_mapped_plane_pair.second = (found_mapped_plane2->second);
-      }
-      current_detected_mapped_plane_pairs.push_back(x1_detected_mapped_plane_pair);
-
-      if (plane2.id == (found_mapped_plane1->second).id ||
-          plane2.id == (found_mapped_plane2->second).id) {
-        plane2_min_segment = true;
-        x2_detected_mapped_plane_pair.first = plane2;
-        x2_detected_mapped_plane_pair.second = plane2;
-      } else if ((plane2).plane_node->estimate().coeffs().head(3).dot(
-                     (found_mapped_plane1->second)
-                         .plane_node->estimate()
-                         .coeffs()
-                         .head(3)) > 0) {
-        plane2_min_segment = PlaneUtils::check_point_neighbours(
-            (found_mapped_plane1->second).cloud_seg_map, plane2.cloud_seg_map);
-        x2_detected_mapped_plane_pair.first = plane2;
-        x2_detected_mapped_plane_pair.second = (found_mapped_plane1->second);
-      } else {
-        plane2_min_segment = PlaneUtils::check_point_neighbours(
-            (found_mapped_plane2->second).cloud_seg_map, plane2.cloud_seg_map);
-        x2_detected_mapped_plane_pair.first = plane2;
-        x2_detected_mapped_plane_pair.second = (found_mapped_plane2->second);
-      }
-      current_detected_mapped_plane_pairs.push_back(x2_detected_mapped_plane_pair);
-
-      if (dist < min_dist && (plane1_min_segment && plane2_min_segment)) {
-        min_dist = dist;
-        data_association = x_inf_room.second.id;
-        detected_mapped_plane_pairs = current_detected_mapped_plane_pairs;
-        RCLCPP_DEBUG(
-            node_obj->get_logger(), "infinite_room planes", "dist x room %f", dist);
-      }
+  const int axis = plane_type == PlaneUtils::plane_class::X_VERT_PLANE ? 0 : 1;
+  const auto& infinite_rooms = axis == 0 ? x_infinite_rooms : y_infinite_rooms;
+  const auto& vert_planes = axis == 0 ? x_vert_planes : y_vert_planes;
+  const VerticalPlanes* mapped_plane1 = nullptr;
+  const VerticalPlanes* mapped_plane2 = nullptr;
+
+  // only the infinite rooms closer than the threshold across their planes can be
+  // associated
+  room_registry->sync_infinite_rooms(*graph_slam, x_infinite_rooms, y_infinite_rooms);
+  for (const int infinite_room_id :
+       room_registry->find_infinite_rooms(plane_type,
+                                          room_center.translation()(axis),
+                                          infinite_room_dist_threshold)) {
+    const InfiniteRooms& inf_room = infinite_rooms.at(infinite_room_id);
+    float dist = fabs(room_center.translation()(axis) -
+                      inf_room.node->estimate().translation()(axis));
+    if (dist >= min_dist) continue;
+
+    auto found_mapped_plane1 = vert_planes.find(inf_room.plane1_id);
+    auto found_mapped_plane2 = vert_planes.find(inf_room.plane2_id);
+    if (found_mapped_plane1 == vert_planes.end() ||
+        found_mapped_plane2 == vert_planes.end())
+      continue;
+
+    const VerticalPlanes& current_mapped_plane1 = match_room_plane(
+        plane1, found_mapped_plane1->second, found_mapped_plane2->second);
+    const VerticalPlanes& current_mapped_plane2 = match_room_plane(
+        plane2, found_mapped_plane1->second, found_mapped_plane2->second);
+
+    bool plane1_min_segment =
+        &current_mapped_plane1 == &plane1 ||
+        PlaneUtils::check_point_neighbours(current_mapped_plane1.cloud_seg_map,
+                                           plane1.cloud_seg_map);
+    bool plane2_min_segment =
+        plane1_min_segment &&
+        (&current_mapped_plane2 == &plane2 ||
+         PlaneUtils::check_point_neighbours(current_mapped_plane2.cloud_seg_map,
+                                            plane2.cloud_seg_map));
+
+    if (plane1_min_segment && plane2_min_segment) {
+      min_dist = dist;
+      data_association = inf_room.id;
+      mapped_plane1 = &current_mapped_plane1;
+      mapped_plane2 = &current_mapped_plane2;
+      RCLCPP_DEBUG(
+          node_obj->get_logger(), "infinite_room planes", "dist room %f", dist);
     }
   }
 
-  if (plane_type == PlaneUtils::plane_class::Y_VERT_PLANE) {
-    for (const auto& y_inf_room : y_infinite_rooms) {
-      float dist = sqrt(pow(room_center.translation()(1) -
-                                y_inf_room.second.node->estimate().translation()(1),
-                            2));
-
-      std::vector<std::pair<VerticalPlanes, VerticalPlanes>>
-          current_detected_mapped_plane_pairs;
-      std::pair<VerticalPlanes, VerticalPlanes> y1_detected_mapped_plane_pair;
-      std::pair<VerticalPlanes, VerticalPlanes> y2_detected_mapped_plane_pair;
-      auto found_mapped_plane1 = y_vert_planes.find(y_inf_room.second.plane1_id);
-      auto found_mapped_plane2 = y_vert_planes.find(y_inf_room.second.plane2_id);
-
-      if (plane1.id == (found_mapped_plane1->second).id ||
-          plane1.id == (found_mapped_plane2->second).id) {
-        plane1_min_segment = true;
-        y1_detected_mapped_plane_pair.first = plane1;
-        y1_detected_mapped_plane_pair.second = plane1;
-      } else if ((plane1).plane_node->estimate().coeffs().head(3).dot(
-                     (found_mapped_plane1->second)
-                         .plane_node->estimate()
-                         .coeffs()
-                         .head(3)) > 0) {
-        plane1_min_segment = PlaneUtils::check_point_neighbours(
-            (found_mapped_plane1->second).cloud_seg_map, plane1.cloud_seg_map);
-        y1_detected_mapped_plane_pair.first = plane1;
-        y1_detected_mapped_plane_pair.second = (found_mapped_plane1->second);
-      } else {
-        plane1_min_segment = PlaneUtils::check_point_neighbours(
-            (found_mapped_plane2->second).cloud_seg_map, plane1.cloud_seg_map);
-        y1_detected_mapped_plane_pair.first = plane1;
-        y1_detected_mapped_plane_pair.second = (found_mapped_plane2->second);
-      }
-      current_detected_mapped_plane_pairs.push_back(y1_detected_mapped_plane_pair);
-
-      if (plane2.id == (found_mapped_plane1->second).id ||
-          plane2.id == (found_mapped_plane2->second).id) {
-        plane2_min_segment = true;
-        y2_detected_mapped_plane_pair.first = plane2;
-        y2_detected_mapped_plane_pair.second = plane2;
-      } else if ((plane2).plane_node->estimate().coeffs().head(3).dot(
-                     (found_mapped_plane1->second)
-                         .plane_node->estimate()
-                         .coeffs()
-                         .head(3)) > 0) {
-        plane2_min_segment = PlaneUtils::check_point_neighbours(
-            (found_mapped_plane1->second).cloud_seg_map, plane2.cloud_seg_map);
-        y2_detected_mapped_plane_pair.first = plane2;
-        y2_detected_mapped_plane_pair.second = (found_mapped_plane1->second);
-      } else {
-        plane2_min_segment = PlaneUtils::check_point_neighbours(
-            (found_mapped_plane2->second).cloud_seg_map, plane2.cloud_seg_map);
-        y2_detected_mapped_plane_pair.first = plane2;
-        y2_detected_mapped_plane_pair.second = (found_mapped_plane2->second);
-      }
-      current_detected_mapped_plane_pairs.push_back(y2_detected_mapped_plane_pair);
-
-      if (dist < min_dist && (plane1_min_segment && plane2_min_segment)) {
-        min_dist = dist;
-        data_association = y_inf_room.second.id;
-        detected_mapped_plane_pairs = current_detected_mapped_plane_pairs;
-        RCLCPP_DEBUG(
-            node_obj->get_logger(), "infinite_room planes", "dist y room %f", dist);
-      }
-    }
+  if (data_association != -1) {
+    detected_mapped_plane_pairs.clear();
+    detected_mapped_plane_pairs.emplace_back(plane1, *mapped_plane1);
+    detected_mapped_plane_pairs.emplace_back(plane2, *mapped_plane2);
   }
 
   // RCLCPP_DEBUG(node_obj->get_logger(),"infinite_room planes", "min dist %f",
@@ -631,30 +521,9 @@ int InfiniteRoomMapper::associate_infinite_rooms(
 
 bool InfiniteRoomMapper::check_infinite_room_ids(
     const int plane_type,
-    const std::set<g2o::HyperGraph::Edge*>& plane_edges,
-    const g2o::VertexRoom* room_node) {
-  for (auto edge_itr = plane_edges.begin(); edge_itr != plane_edges.end(); ++edge_itr) {
-    if (plane_type == PlaneUtils::plane_class::X_VERT_PLANE) {
-      g2o::EdgeRoom2Planes* edge_infinite_room_planes =
-          dynamic_cast<g2o::EdgeRoom2Planes*>(*edge_itr);
-      if (edge_infinite_room_planes) {
-        g2o::VertexRoom* found_infinite_room_node =
-            dynamic_cast<g2o::VertexRoom*>(edge_infinite_room_planes->vertices()[0]);
-        if (found_infinite_room_node->id() == room_node->id()) return true;
-      }
-    }
-
-    if (plane_type == PlaneUtils::plane_class::Y_VERT_PLANE) {
-      g2o::EdgeRoom2Planes* edge_infinite_room_planes =
-          dynamic_cast<g2o::EdgeRoom2Planes*>(*edge_itr);
-      if (edge_infinite_room_planes) {
-        g2o::VertexRoom* found_infinite_room_node =
-            dynamic_cast<g2o::VertexRoom*>(edge_infinite_room_planes->vertices()[0]);
-        if (found_infinite_room_node->id() == room_node->id()) return true;
-      }
-    }
-  }
-  return false;
+    const int plane_id,
+    const g2o::VertexRoom* room_node) const {
+  return room_registry->infinite_room_has_plane(plane_type, room_node->id(), plane_id);
 }
 
 }  // namespace s_graphs
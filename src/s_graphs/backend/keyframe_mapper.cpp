@@ -86,7 +86,7 @@ int KeyframeMapper::map_keyframes(
         i == 0 ? keyframes.rbegin()->second : keyframe_queue[i - 1];
 
     Eigen::Isometry3d relative_pose = keyframe->odom.inverse() * prev_keyframe->odom;
-    Eigen::MatrixXd information = inf_calclator->calc_information_matrix(
+    InformationMatrix<6> information = inf_calclator->calc_information_matrix(
         keyframe->cloud, prev_keyframe->cloud, relative_pose);
     auto edge = covisibility_graph->add_se3_edge(
         keyframe->node, prev_keyframe->node, relative_pose, information);
@@ -153,7 +153,7 @@ void KeyframeMapper::map_keyframes(std::shared_ptr<GraphSLAM>& local_graph,
           loop_detector->matching(keyframe, prev_keyframe, loop_relative_pose);
 
       if (0) {
-        Eigen::MatrixXd information = inf_calclator->calc_information_matrix(
+        InformationMatrix<6> information = inf_calclator->calc_information_matrix(
             keyframe->cloud,
             prev_keyframe->cloud,
             Eigen::Isometry3d(loop_relative_pose.cast<double>()));
@@ -167,7 +167,7 @@ void KeyframeMapper::map_keyframes(std::shared_ptr<GraphSLAM>& local_graph,
       } else {
         Eigen::Isometry3d relative_pose =
             keyframe->node->estimate().inverse() * prev_keyframe->node->estimate();
-        Eigen::MatrixXd information = Eigen::MatrixXd::Identity(6, 6);
+        InformationMatrix<6> information = InformationMatrix<6>::Identity();
 
         auto edge = local_graph->add_se3_edge(
             keyframe->node, prev_keyframe->node, relative_pose, information);
@@ -183,7 +183,7 @@ void KeyframeMapper::add_anchor_node(std::shared_ptr<GraphSLAM>& graph,
                                      g2o::EdgeSE3*& anchor_edge,
                                      bool use_vertex_id) {
   if (node_obj->get_parameter("fix_first_node").get_parameter_value().get<bool>()) {
-    Eigen::MatrixXd inf = Eigen::MatrixXd::Identity(6, 6);
+    InformationMatrix<6> inf = InformationMatrix<6>::Identity();
     std::stringstream sst(node_obj->get_parameter("fix_first_node_stddev")
                               .get_parameter_value()
                               .get<std::string>());
@@ -212,7 +212,7 @@ void KeyframeMapper::remap_delayed_keyframe(
     KeyFrame::Ptr keyframe,
     KeyFrame::Ptr prev_keyframe) {
   Eigen::Isometry3d relative_pose = keyframe->odom.inverse() * prev_keyframe->odom;
-  Eigen::MatrixXd information = inf_calclator->calc_information_matrix(
+  InformationMatrix<6> information = inf_calclator->calc_information_matrix(
       keyframe->cloud, prev_keyframe->cloud, relative_pose);
 
   std::set<g2o::HyperGraph::Edge*> edges = keyframe->node->edges();
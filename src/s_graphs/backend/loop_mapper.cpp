@@ -44,7 +44,7 @@ void LoopMapper::add_loops(const std::shared_ptr<GraphSLAM>& covisibility_graph,
                            std::mutex& graph_mutex) {
   for (const auto& loop : loops) {
     Eigen::Isometry3d relpose(loop->relative_pose.cast<double>());
-    Eigen::MatrixXd information_matrix = inf_calclator->calc_information_matrix(
+    InformationMatrix<6> information_matrix = inf_calclator->calc_information_matrix(
         loop->key1->cloud, loop->key2->cloud, relpose);
     graph_mutex.lock();
     std::cout << "loop found between keyframes " << loop->key1->node->id() << " and "
@@ -29,10 +29,144 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 // SPDX-License-Identifier: BSD-2-Clause
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
 #include <s_graphs/backend/plane_mapper.hpp>
 
 namespace s_graphs {
 
+namespace {
+
+// neighbour test of PlaneUtils::check_point_neighbours
+constexpr float neighbour_sq_dist = 0.5f;
+constexpr int min_neighbour_points = 100;
+// not smaller than the neighbour distance, so a query visits 27 cells at most
+constexpr float neighbour_cell_size = 0.7072f;
+
+/**
+ * @brief Plane detected in a keyframe, classified before the association
+ */
+struct PlaneDetection {
+  int type;
+  g2o::Plane3D plane_body;
+  g2o::Plane3D plane_map;
+  pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloud_seg_body;
+  Eigen::Matrix4d Gij;
+};
+
+/**
+ * @brief Voxel hash over the points of a detected plane segment in the map frame.
+ * It answers the same overlap test as PlaneUtils::check_point_neighbours while only
+ * visiting the cells around each mapped point.
+ */
+class PointNeighbourGrid {
+ public:
+  PointNeighbourGrid(const pcl::PointCloud<pcl::PointXYZRGBNormal>& cloud_seg_body,
+                     const Eigen::Matrix4f& keyframe_pose) {
+    points.reserve(cloud_seg_body.size());
+    for (const auto& point : cloud_seg_body.points) {
+      const Eigen::Vector3f map_point =
+          (keyframe_pose * point.getVector4fMap()).head<3>();
+      cells[cell_key(cell_of(map_point))].push_back(points.size());
+      points.push_back(map_point);
+    }
+  }
+
+  bool overlaps(const pcl::PointCloud<pcl::PointXYZRGBNormal>& cloud_seg_map) const {
+    int point_count = 0;
+    for (const auto& point : cloud_seg_map.points) {
+      if (has_neighbour(point.getVector3fMap()) &&
+          ++point_count > min_neighbour_points)
+        return true;
+    }
+    return false;
+  }
+
+ private:
+  bool has_neighbour(const Eigen::Vector3f& query) const {
+    const Eigen::Vector3i cell = cell_of(query);
+    for (int dx = -1; dx <= 1; ++dx) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dz = -1; dz <= 1; ++dz) {
+          auto found = cells.find(cell_key(cell + Eigen::Vector3i(dx, dy, dz)));
+          if (found == cells.end()) continue;
+          for (const size_t index : found->second) {
+            if ((points[index] - query).squaredNorm() < neighbour_sq_dist) return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  static Eigen::Vector3i cell_of(const Eigen::Vector3f& point) {
+    return (point / neighbour_cell_size).array().floor().cast<int>();
+  }
+
+  static int64_t cell_key(const Eigen::Vector3i& cell) {
+    return (static_cast<int64_t>(cell.x() & 0x1FFFFF) << 42) |
+           (static_cast<int64_t>(cell.y() & 0x1FFFFF) << 21) |
+           static_cast<int64_t>(cell.z() & 0x1FFFFF);
+  }
+
+  std::vector<Eigen::Vector3f> points;
+  std::unordered_map<int64_t, std::vector<size_t>> cells;
+};
+
+/**
+ * @brief Finds, among the planes created earlier for the same keyframe, the one a
+ * detection left unmatched belongs to. Those planes still have the identity as
+ * information and no points in the map frame, so the distance is euclidean and the
+ * overlap is tested against the points of the detection that created them.
+ *
+ * @return id of the plane, -1 if the detection is a new plane too
+ */
+int associate_batch_plane(
+    const int plane_type,
+    const Eigen::Isometry3d& keyframe_pose,
+    const PlaneDetection& detection,
+    const std::vector<std::pair<int, const PlaneDetection*>>& batch_planes,
+    const double plane_dist_threshold) {
+  const Eigen::Isometry3d m2n = keyframe_pose.inverse();
+  const Eigen::Matrix4f pose = keyframe_pose.matrix().cast<float>();
+  const bool check_neighbours = plane_type != PlaneUtils::plane_class::HORT_PLANE;
+
+  int data_association = -1;
+  double min_dist = plane_dist_threshold;
+  std::unique_ptr<PointNeighbourGrid> detection_grid;
+  for (const auto& [plane_id, batch_detection] : batch_planes) {
+    const double dist =
+        (m2n * batch_detection->plane_map).ominus(detection.plane_body).norm();
+    if (!(dist < min_dist)) continue;
+
+    if (check_neighbours) {
+      if (!detection_grid) {
+        detection_grid =
+            std::make_unique<PointNeighbourGrid>(*detection.cloud_seg_body, pose);
+      }
+      pcl::PointCloud<pcl::PointXYZRGBNormal> batch_cloud_map;
+      batch_cloud_map.reserve(batch_detection->cloud_seg_body->size());
+      for (const auto& point : batch_detection->cloud_seg_body->points) {
+        pcl::PointXYZRGBNormal map_point;
+        map_point.getVector4fMap() = pose * point.getVector4fMap();
+        batch_cloud_map.push_back(map_point);
+      }
+      if (!detection_grid->overlaps(batch_cloud_map)) continue;
+    }
+
+    min_dist = dist;
+    data_association = plane_id;
+  }
+  return data_association;
+}
+
+}  // namespace
+
 PlaneMapper::PlaneMapper(const rclcpp::Node::SharedPtr node) {
   node_obj = node;
   use_point_to_plane =
@@ -42,6 +176,12 @@ PlaneMapper::PlaneMapper(const rclcpp::Node::SharedPtr node) {
   plane_dist_threshold = node_obj->get_parameter("plane_dist_threshold")
                              .get_parameter_value()
                              .get<double>();
+  plane_maha_dist_threshold = node_obj->get_parameter("plane_maha_dist_threshold")
+                                  .get_parameter_value()
+                                  .get<double>();
+  constant_covariance =
+      node_obj->get_parameter("constant_covariance").get_parameter_value().get<bool>();
+  keyframe_pose_covariance.setZero();
   plane_points_dist =
       node_obj->get_parameter("plane_points_dist").get_parameter_value().get<double>();
   min_plane_points =
@@ -50,6 +190,11 @@ PlaneMapper::PlaneMapper(const rclcpp::Node::SharedPtr node) {
 
 PlaneMapper::~PlaneMapper() {}
 
+void PlaneMapper::set_keyframe_pose_covariance(
+    const Eigen::Matrix<double, 6, 6>& covariance) {
+  keyframe_pose_covariance = covariance;
+}
+
 void PlaneMapper::map_extracted_planes(
     std::shared_ptr<GraphSLAM>& graph_slam,
     KeyFrame::Ptr keyframe,
@@ -57,71 +202,107 @@ void PlaneMapper::map_extracted_planes(
     std::unordered_map<int, VerticalPlanes>& x_vert_planes,
     std::unordered_map<int, VerticalPlanes>& y_vert_planes,
     std::unordered_map<int, HorizontalPlanes>& hort_planes) {
-  std::vector<plane_data_list> x_det_infinite_room_candidates,
-      y_det_infinite_room_candidates;
-  std::vector<plane_data_list> x_det_room_candidates, y_det_room_candidates;
-
+  // classify all the detections of the keyframe first, so that each class is
+  // associated against the mapped planes in a single batch
+  std::vector<PlaneDetection> detections;
   for (const auto& cloud_seg_body : extracted_cloud_vec) {
     if (cloud_seg_body->points.size() < min_plane_points) continue;
-    keyframe->cloud_seg_body = cloud_seg_body;
-
-    g2o::Plane3D det_plane_body_frame =
-        Eigen::Vector4d(cloud_seg_body->back().normal_x,
-                        cloud_seg_body->back().normal_y,
-                        cloud_seg_body->back().normal_z,
-                        cloud_seg_body->back().curvature);
-    int plane_type = add_planes_to_graph(graph_slam,
+
+    PlaneDetection detection;
+    detection.plane_body = Eigen::Vector4d(cloud_seg_body->back().normal_x,
+                                           cloud_seg_body->back().normal_y,
+                                           cloud_seg_body->back().normal_z,
+                                           cloud_seg_body->back().curvature);
+    detection.plane_map = convert_plane_to_map_frame(keyframe, detection.plane_body);
+    detection.type = get_plane_type(detection.plane_map);
+    if (detection.type < 0) {
+      // no dominant axis, factor_planes has no class to add it to
+      RCLCPP_DEBUG(node_obj->get_logger(),
+                   "plane association",
+                   "dropped a plane without a dominant normal axis");
+      continue;
+    }
+
+    detection.cloud_seg_body = cloud_seg_body;
+    detection.Gij.setZero();
+    if (use_point_to_plane) {
+      detection.cloud_seg_body = filter_point_to_plane_inliers(detection.plane_map,
+                                                               keyframe->estimate(),
+                                                               cloud_seg_body,
+                                                               detection.Gij);
+    }
+    detections.push_back(detection);
+  }
+
+  for (const int plane_type : {PlaneUtils::plane_class::X_VERT_PLANE,
+                               PlaneUtils::plane_class::Y_VERT_PLANE,
+                               PlaneUtils::plane_class::HORT_PLANE}) {
+    std::vector<const PlaneDetection*> class_detections;
+    std::vector<g2o::Plane3D> det_planes;
+    std::vector<pcl::PointCloud<PointNormal>::Ptr> cloud_seg_body_vec;
+    for (const auto& detection : detections) {
+      if (detection.type != plane_type) continue;
+      class_detections.push_back(&detection);
+      det_planes.push_back(detection.plane_body);
+      cloud_seg_body_vec.push_back(detection.cloud_seg_body);
+    }
+    if (class_detections.empty()) continue;
+
+    std::vector<int> data_associations = associate_planes(plane_type,
+                                                          keyframe,
+                                                          det_planes,
+                                                          cloud_seg_body_vec,
+                                                          x_vert_planes,
+                                                          y_vert_planes,
+                                                          hort_planes);
+
+    // detections left unmatched may be segments of the same new plane, as when they
+    // were factored one by one they join the planes created before them
+    std::vector<std::pair<int, const PlaneDetection*>> batch_planes;
+    for (size_t i = 0; i < class_detections.size(); ++i) {
+      int data_association = data_associations[i];
+      if (data_association == -1) {
+        data_association = associate_batch_plane(plane_type,
+                                                 keyframe->estimate(),
+                                                 *class_detections[i],
+                                                 batch_planes,
+                                                 plane_dist_threshold);
+      }
+
+      keyframe->cloud_seg_body = class_detections[i]->cloud_seg_body;
+      const int plane_id = factor_planes(graph_slam,
+                                         plane_type,
                                          keyframe,
-                                         det_plane_body_frame,
+                                         class_detections[i]->plane_map,
+                                         class_detections[i]->plane_body,
+                                         class_detections[i]->Gij,
+                                         data_association,
                                          x_vert_planes,
                                          y_vert_planes,
                                          hort_planes);
+      if (data_association == -1) {
+        batch_planes.emplace_back(plane_id, class_detections[i]);
+      }
+    }
   }
+
+  if (!detections.empty())
+    convert_plane_points_to_map(x_vert_planes, y_vert_planes, hort_planes);
 }
 
 /**
- * @brief detected plane mapping
- *
+ * @brief get the plane type based on the largest value of the normal orientation
+ * x,y and z
  */
-int PlaneMapper::add_planes_to_graph(
-    std::shared_ptr<GraphSLAM>& graph_slam,
-    KeyFrame::Ptr& keyframe,
-    const g2o::Plane3D& det_plane_body_frame,
-    std::unordered_map<int, VerticalPlanes>& x_vert_planes,
-    std::unordered_map<int, VerticalPlanes>& y_vert_planes,
-    std::unordered_map<int, HorizontalPlanes>& hort_planes) {
-  int plane_id;
-  int plane_type = -1;
-
-  g2o::Plane3D det_plane_map_frame =
-      convert_plane_to_map_frame(keyframe, det_plane_body_frame);
-
-  /* Get the plane type based on the largest value of the normal orientation x,y and z
-   */
-  if (fabs(det_plane_map_frame.coeffs()(0)) > fabs(det_plane_map_frame.coeffs()(1)) &&
-      fabs(det_plane_map_frame.coeffs()(0)) > fabs(det_plane_map_frame.coeffs()(2)))
-    plane_type = PlaneUtils::plane_class::X_VERT_PLANE;
-  else if (fabs(det_plane_map_frame.coeffs()(1)) >
-               fabs(det_plane_map_frame.coeffs()(0)) &&
-           fabs(det_plane_map_frame.coeffs()(1)) >
-               fabs(det_plane_map_frame.coeffs()(2)))
-    plane_type = PlaneUtils::plane_class::Y_VERT_PLANE;
-  else if (fabs(det_plane_map_frame.coeffs()(2)) >
-               fabs(det_plane_map_frame.coeffs()(0)) &&
-           fabs(det_plane_map_frame.coeffs()(2)) >
-               fabs(det_plane_map_frame.coeffs()(1)))
-    plane_type = PlaneUtils::plane_class::HORT_PLANE;
-
-  plane_id = sort_planes(graph_slam,
-                         plane_type,
-                         keyframe,
-                         det_plane_map_frame,
-                         det_plane_body_frame,
-                         x_vert_planes,
-                         y_vert_planes,
-                         hort_planes);
-
-  return plane_type;
+int PlaneMapper::get_plane_type(const g2o::Plane3D& det_plane_map_frame) const {
+  const Eigen::Vector4d& coeffs = det_plane_map_frame.coeffs();
+  if (fabs(coeffs(0)) > fabs(coeffs(1)) && fabs(coeffs(0)) > fabs(coeffs(2)))
+    return PlaneUtils::plane_class::X_VERT_PLANE;
+  else if (fabs(coeffs(1)) > fabs(coeffs(0)) && fabs(coeffs(1)) > fabs(coeffs(2)))
+    return PlaneUtils::plane_class::Y_VERT_PLANE;
+  else if (fabs(coeffs(2)) > fabs(coeffs(0)) && fabs(coeffs(2)) > fabs(coeffs(1)))
+    return PlaneUtils::plane_class::HORT_PLANE;
+  return -1;
 }
 
 /**
@@ -142,30 +323,6 @@ g2o::Plane3D PlaneMapper::convert_plane_to_map_frame(
   return det_plane_map_frame;
 }
 
-/**
- * @brief sort and factor the detected planes
- *
- */
-int PlaneMapper::sort_planes(std::shared_ptr<GraphSLAM>& graph_slam,
-                             const int& plane_type,
-                             KeyFrame::Ptr& keyframe,
-                             const g2o::Plane3D& det_plane_map_frame,
-                             const g2o::Plane3D& det_plane_body_frame,
-                             std::unordered_map<int, VerticalPlanes>& x_vert_planes,
-                             std::unordered_map<int, VerticalPlanes>& y_vert_planes,
-                             std::unordered_map<int, HorizontalPlanes>& hort_planes) {
-  int plane_id = factor_planes(graph_slam,
-                               plane_type,
-                               keyframe,
-                               det_plane_map_frame,
-                               det_plane_body_frame,
-                               x_vert_planes,
-                               y_vert_planes,
-                               hort_planes);
-
-  return plane_id;
-}
-
 /**
  * @brief create vertical plane factors
  */
@@ -174,41 +331,12 @@ int PlaneMapper::factor_planes(std::shared_ptr<GraphSLAM>& graph_slam,
                                KeyFrame::Ptr& keyframe,
                                const g2o::Plane3D& det_plane_map_frame,
                                const g2o::Plane3D& det_plane_body_frame,
+                               const Eigen::Matrix4d& Gij,
+                               int data_association,
                                std::unordered_map<int, VerticalPlanes>& x_vert_planes,
                                std::unordered_map<int, VerticalPlanes>& y_vert_planes,
                                std::unordered_map<int, HorizontalPlanes>& hort_planes) {
   g2o::VertexPlane* plane_node;
-  int plane_id = -1;
-
-  Eigen::Matrix4d Gij;
-  Gij.setZero();
-  if (use_point_to_plane) {
-    auto it = keyframe->cloud_seg_body->points.begin();
-    while (it != keyframe->cloud_seg_body->points.end()) {
-      PointNormal point_tmp;
-      point_tmp = *it;
-      Eigen::Vector4d point(point_tmp.x, point_tmp.y, point_tmp.z, 1);
-      double point_to_plane_d = det_plane_map_frame.coeffs().transpose() *
-                                keyframe->node->estimate().matrix() * point;
-
-      if (abs(point_to_plane_d) < 0.1) {
-        Gij += point * point.transpose();
-        ++it;
-      } else {
-        it = keyframe->cloud_seg_body->points.erase(it);
-      }
-    }
-  }
-
-  int data_association;
-  data_association = -1;
-  data_association = associate_plane(plane_type,
-                                     keyframe,
-                                     det_plane_body_frame.coeffs(),
-                                     keyframe->cloud_seg_body,
-                                     x_vert_planes,
-                                     y_vert_planes,
-                                     hort_planes);
 
   switch (plane_type) {
     case PlaneUtils::plane_class::X_VERT_PLANE: {
@@ -384,14 +512,15 @@ int PlaneMapper::factor_planes(std::shared_ptr<GraphSLAM>& graph_slam,
   }
 
   if (use_point_to_plane) {
-    Eigen::Matrix<double, 1, 1> information(0.001);
+    InformationMatrix<1> information(0.001);
     auto edge = graph_slam->add_se3_point_to_plane_edge(
         keyframe->node, plane_node, Gij, information);
     graph_slam->add_robust_kernel(edge, "Huber", 1.0);
   } else {
+    // the plane error is [azimuth, elevation, distance], the distance is trusted less
     Eigen::Matrix3d plane_information_mat =
         Eigen::Matrix3d::Identity() * plane_information;
-    plane_information_mat(3, 3) = plane_information_mat(3, 3) / 10;
+    plane_information_mat(2, 2) = plane_information_mat(2, 2) / 10;
 
     auto edge = graph_slam->add_se3_plane_edge(keyframe->node,
                                                plane_node,
@@ -400,11 +529,57 @@ int PlaneMapper::factor_planes(std::shared_ptr<GraphSLAM>& graph_slam,
     graph_slam->add_robust_kernel(edge, "Huber", 1.0);
   }
 
-  convert_plane_points_to_map(x_vert_planes, y_vert_planes, hort_planes);
-
   return data_association;
 }
 
+pcl::PointCloud<PlaneMapper::PointNormal>::Ptr
+PlaneMapper::filter_point_to_plane_inliers(
+    const g2o::Plane3D& det_plane_map_frame,
+    const Eigen::Isometry3d& keyframe_pose,
+    const pcl::PointCloud<PointNormal>::ConstPtr& cloud_seg_body,
+    Eigen::Matrix4d& Gij) const {
+  const double inlier_dist = 0.1;
+  const int block_size = 1024;
+  const int num_points = cloud_seg_body->size();
+
+  // the plane is moved to the body frame once, instead of moving every point
+  Eigen::Vector4d body_plane =
+      keyframe_pose.matrix().transpose() * det_plane_map_frame.coeffs();
+  auto points = cloud_seg_body->getMatrixXfMap(
+      3, sizeof(PointNormal) / sizeof(float), offsetof(PointNormal, x) / sizeof(float));
+  Eigen::ArrayXd residuals =
+      (body_plane.head<3>().transpose() * points.cast<double>()).transpose().array() +
+      body_plane(3);
+
+  pcl::PointCloud<PointNormal>::Ptr inlier_cloud(new pcl::PointCloud<PointNormal>());
+  inlier_cloud->header = cloud_seg_body->header;
+  inlier_cloud->reserve(num_points);
+  Eigen::Matrix4Xd inliers(4, num_points);
+  for (int i = 0; i < num_points; i++) {
+    if (std::abs(residuals(i)) >= inlier_dist) continue;
+    inliers.col(inlier_cloud->size()) << points.col(i).cast<double>(), 1.0;
+    inlier_cloud->push_back(cloud_seg_body->points[i]);
+  }
+
+  const int num_inliers = inlier_cloud->size();
+  const int num_blocks = (num_inliers + block_size - 1) / block_size;
+  Gij.setZero();
+#pragma omp parallel
+  {
+    Eigen::Matrix4d block_sum = Eigen::Matrix4d::Zero();
+#pragma omp for nowait
+    for (int b = 0; b < num_blocks; b++) {
+      const int first = b * block_size;
+      auto block = inliers.middleCols(first, std::min(block_size, num_inliers - first));
+      block_sum.noalias() += block * block.transpose();
+    }
+#pragma omp critical
+    Gij += block_sum;
+  }
+
+  return inlier_cloud;
+}
+
 /**
  * @brief data assoction betweeen the planes
  */
@@ -416,141 +591,129 @@ int PlaneMapper::associate_plane(
     const std::unordered_map<int, VerticalPlanes>& x_vert_planes,
     const std::unordered_map<int, VerticalPlanes>& y_vert_planes,
     const std::unordered_map<int, HorizontalPlanes>& hort_planes) {
-  int data_association;
-  double vert_min_maha_dist = 100;
-  double hort_min_maha_dist = 100;
-  Eigen::Isometry3d m2n = keyframe->estimate().inverse();
-
-  switch (plane_type) {
-    case PlaneUtils::plane_class::X_VERT_PLANE: {
-      for (const auto& x_vert_plane : x_vert_planes) {
-        g2o::Plane3D local_plane = m2n * x_vert_plane.second.plane;
-        Eigen::Vector3d error = local_plane.ominus(det_plane);
-        double maha_dist =
-            sqrt(error.transpose() * x_vert_plane.second.covariance.inverse() * error);
-        RCLCPP_DEBUG(node_obj->get_logger(),
-                     "xplane plane association",
-                     "maha distance xplane: %f",
-                     maha_dist);
-
-        // printf("\n maha distance x: %f", maha_dist);
+  return associate_planes(plane_type,
+                          keyframe,
+                          {det_plane},
+                          {cloud_seg_body},
+                          x_vert_planes,
+                          y_vert_planes,
+                          hort_planes)
+      .front();
+}
 
-        if (std::isnan(maha_dist) || maha_dist < 1e-3) {
-          Eigen::Matrix3d cov = Eigen::Matrix3d::Identity();
-          maha_dist = sqrt(error.transpose() * cov * error);
-        }
-        if (maha_dist < vert_min_maha_dist) {
-          vert_min_maha_dist = maha_dist;
-          data_association = x_vert_plane.second.id;
-        }
-      }
-      if (vert_min_maha_dist < plane_dist_threshold) {
-        if (!x_vert_planes.at(data_association).cloud_seg_map->empty()) {
-          float min_segment = std::numeric_limits<float>::max();
-          pcl::PointCloud<PointNormal>::Ptr cloud_seg_detected(
-              new pcl::PointCloud<PointNormal>());
-          Eigen::Matrix4f current_keyframe_pose =
-              keyframe->estimate().matrix().cast<float>();
-          for (size_t j = 0; j < cloud_seg_body->points.size(); ++j) {
-            PointNormal dst_pt;
-            dst_pt.getVector4fMap() =
-                current_keyframe_pose * cloud_seg_body->points[j].getVector4fMap();
-            cloud_seg_detected->points.push_back(dst_pt);
-          }
-          bool valid_neighbour = PlaneUtils::check_point_neighbours(
-              x_vert_planes.at(data_association).cloud_seg_map, cloud_seg_detected);
+/**
+ * @brief batched data association of the planes of one class detected in a
+ * keyframe
+ */
+std::vector<int> PlaneMapper::associate_planes(
+    const int& plane_type,
+    const KeyFrame::Ptr& keyframe,
+    const std::vector<g2o::Plane3D>& det_planes,
+    const std::vector<pcl::PointCloud<PointNormal>::Ptr>& cloud_seg_body_vec,
+    const std::unordered_map<int, VerticalPlanes>& x_vert_planes,
+    const std::unordered_map<int, VerticalPlanes>& y_vert_planes,
+    const std::unordered_map<int, HorizontalPlanes>& hort_planes) {
+  std::vector<int> data_associations(det_planes.size(), -1);
 
-          if (!valid_neighbour) {
-            data_association = -1;
-          }
-        }
-      } else {
-        data_association = -1;
-      }
+  std::vector<const Planes*> landmarks;
+  switch (plane_type) {
+    case PlaneUtils::plane_class::X_VERT_PLANE:
+      for (const auto& x_vert_plane : x_vert_planes)
+        landmarks.push_back(&x_vert_plane.second);
       break;
-    }
-    case PlaneUtils::plane_class::Y_VERT_PLANE: {
-      for (const auto& y_vert_plane : y_vert_planes) {
-        float dist =
-            fabs(det_plane.coeffs()(3) - y_vert_plane.second.plane.coeffs()(3));
-        g2o::Plane3D local_plane = m2n * y_vert_plane.second.plane;
-        Eigen::Vector3d error = local_plane.ominus(det_plane);
-        double maha_dist =
-            sqrt(error.transpose() * y_vert_plane.second.covariance.inverse() * error);
-        RCLCPP_DEBUG(node_obj->get_logger(),
-                     "yplane plane association",
-                     "maha distance yplane: %f",
-                     maha_dist);
-        // printf("\n maha distance y: %f", maha_dist);
-
-        if (std::isnan(maha_dist) || maha_dist < 1e-3) {
-          Eigen::Matrix3d cov = Eigen::Matrix3d::Identity();
-          maha_dist = sqrt(error.transpose() * cov * error);
-        }
-        if (maha_dist < vert_min_maha_dist) {
-          vert_min_maha_dist = maha_dist;
-          data_association = y_vert_plane.second.id;
-        }
-      }
-      if (vert_min_maha_dist < plane_dist_threshold) {
-        if (!y_vert_planes.at(data_association).cloud_seg_map->empty()) {
-          float min_segment = std::numeric_limits<float>::max();
-          pcl::PointCloud<PointNormal>::Ptr cloud_seg_detected(
-              new pcl::PointCloud<PointNormal>());
-          Eigen::Matrix4f current_keyframe_pose =
-              keyframe->estimate().matrix().cast<float>();
-          for (size_t j = 0; j < cloud_seg_body->points.size(); ++j) {
-            PointNormal dst_pt;
-            dst_pt.getVector4fMap() =
-                current_keyframe_pose * cloud_seg_body->points[j].getVector4fMap();
-            cloud_seg_detected->points.push_back(dst_pt);
-          }
-          bool valid_neighbour = PlaneUtils::check_point_neighbours(
-              y_vert_planes.at(data_association).cloud_seg_map, cloud_seg_detected);
-
-          if (!valid_neighbour) {
-            data_association = -1;
-          }
-        }
-      } else {
-        data_association = -1;
-      }
+    case PlaneUtils::plane_class::Y_VERT_PLANE:
+      for (const auto& y_vert_plane : y_vert_planes)
+        landmarks.push_back(&y_vert_plane.second);
       break;
-    }
-    case PlaneUtils::plane_class::HORT_PLANE: {
-      for (const auto& hort_plane : hort_planes) {
-        g2o::Plane3D local_plane = m2n * hort_plane.second.plane;
-        Eigen::Vector3d error = local_plane.ominus(det_plane);
-        double maha_dist =
-            sqrt(error.transpose() * hort_plane.second.covariance.inverse() * error);
-        // std::cout << "cov hor: " << hort_planes[i].covariance.inverse() << std::endl;
-        RCLCPP_DEBUG(node_obj->get_logger(),
-                     "hort plane association",
-                     "maha distance hort: %f",
-                     maha_dist);
-
-        if (std::isnan(maha_dist) || maha_dist < 1e-3) {
-          Eigen::Matrix3d cov = Eigen::Matrix3d::Identity();
-          maha_dist = sqrt(error.transpose() * cov * error);
-        }
-        if (maha_dist < hort_min_maha_dist) {
-          vert_min_maha_dist = maha_dist;
-          data_association = hort_plane.second.id;
-        }
-      }
-
-      if (hort_min_maha_dist > plane_dist_threshold) data_association = -1;
+    case PlaneUtils::plane_class::HORT_PLANE:
+      for (const auto& hort_plane : hort_planes)
+        landmarks.push_back(&hort_plane.second);
       break;
-    }
     default:
       std::cout << "associating planes had an error " << std::endl;
-      break;
+      return data_associations;
   }
+  if (landmarks.empty() || det_planes.empty()) return data_associations;
+
+  // distances of every landmark (rows) to every detection (cols)
+  const int num_detections = det_planes.size();
+  Eigen::MatrixXd maha_dists(landmarks.size(), num_detections);
+  if (constant_covariance) {
+    const Eigen::Isometry3d m2n = keyframe->estimate().inverse();
+    Eigen::Matrix3Xd errors(3, num_detections);
+    for (size_t i = 0; i < landmarks.size(); ++i) {
+      const g2o::Plane3D local_plane = m2n * landmarks[i]->plane;
+      for (int j = 0; j < num_detections; ++j) {
+        errors.col(j) = local_plane.ominus(det_planes[j]);
+      }
+      maha_dists.row(i) = errors.colwise().norm();
+    }
+  } else {
+    // the marginals are expressed in the map frame, so the detections are moved
+    // there with their covariance before comparing them
+    const Eigen::Isometry3d keyframe_pose = keyframe->estimate();
+    Eigen::Matrix3d measurement_covariance = Eigen::Matrix3d::Identity();
+    measurement_covariance(2, 2) = 10;
+    measurement_covariance /= plane_information;
+
+    std::vector<g2o::Plane3D> det_planes_map(num_detections);
+    std::vector<Eigen::Matrix3d> det_covariances(num_detections);
+    for (int j = 0; j < num_detections; ++j) {
+      det_planes_map[j] = keyframe_pose * det_planes[j];
+      det_covariances[j] = PlaneUtils::plane_map_covariance(keyframe_pose,
+                                                            det_planes[j],
+                                                            keyframe_pose_covariance,
+                                                            measurement_covariance);
+    }
+    for (size_t i = 0; i < landmarks.size(); ++i) {
+      for (int j = 0; j < num_detections; ++j) {
+        const Eigen::Vector3d error = landmarks[i]->plane.ominus(det_planes_map[j]);
+        Eigen::LDLT<Eigen::Matrix3d> ldlt(landmarks[i]->covariance +
+                                          det_covariances[j]);
+        maha_dists(i, j) = ldlt.info() == Eigen::Success && ldlt.isPositive()
+                               ? std::sqrt(error.dot(ldlt.solve(error)))
+                               : std::numeric_limits<double>::infinity();
+      }
+    }
+  }
+  RCLCPP_DEBUG(node_obj->get_logger(),
+               "plane association",
+               "min maha distance: %f",
+               maha_dists.minCoeff());
+
+  const double dist_threshold =
+      constant_covariance ? plane_dist_threshold : plane_maha_dist_threshold;
+  std::vector<std::tuple<double, int, int>> gated_pairs;
+  for (int i = 0; i < maha_dists.rows(); ++i) {
+    for (int j = 0; j < num_detections; ++j) {
+      if (maha_dists(i, j) < dist_threshold)
+        gated_pairs.emplace_back(maha_dists(i, j), i, j);
+    }
+  }
+  std::sort(gated_pairs.begin(), gated_pairs.end());
+
+  // greedy assignment by increasing distance, every detection takes the closest
+  // landmark it overlaps. Several segments of one wall in the same keyframe may join
+  // the same landmark. Vertical planes must overlap the points already mapped.
+  const bool check_neighbours = plane_type != PlaneUtils::plane_class::HORT_PLANE;
+  const Eigen::Matrix4f keyframe_pose = keyframe->estimate().matrix().cast<float>();
+  std::vector<std::unique_ptr<PointNeighbourGrid>> detection_grids(num_detections);
+  for (const auto& [maha_dist, i, j] : gated_pairs) {
+    if (data_associations[j] != -1) continue;
+
+    const auto& cloud_seg_map = landmarks[i]->cloud_seg_map;
+    if (check_neighbours && cloud_seg_map != nullptr && !cloud_seg_map->empty()) {
+      if (!detection_grids[j]) {
+        detection_grids[j] = std::make_unique<PointNeighbourGrid>(
+            *cloud_seg_body_vec[j], keyframe_pose);
+      }
+      if (!detection_grids[j]->overlaps(*cloud_seg_map)) continue;
+    }
 
-  // printf("\n vert min maha dist: %f", vert_min_maha_dist);
-  // printf("\n hort min maha dist: %f", hort_min_maha_dist);
+    data_associations[j] = landmarks[i]->id;
+  }
 
-  return data_association;
+  return data_associations;
 }
 
 /**
@@ -535,7 +535,7 @@ void GraphUtils::connect_broken_keyframes(
 
     /* TODO:HB check if its necessary for summing information mats from se3->plane
      * edges as well */
-    Eigen::MatrixXd information = Eigen::MatrixXd::Identity(6, 6);
+    InformationMatrix<6> information = InformationMatrix<6>::Identity();
     auto start_keyframe_it = keyframes.lower_bound(prev_keyframe->second->id());
     auto end_keyframe_it = std::prev(keyframes.upper_bound(keyframe->second->id()));
 
@@ -585,7 +585,7 @@ void GraphUtils::connect_broken_keyframes(
     if (vertex1 && vertex2) {
       /* TODO: HB setting high value for information makes the graph diverge */
       // information.setIdentity();
-      information = Eigen::MatrixXd::Identity(6, 6);
+      information = InformationMatrix<6>::Identity();
 
       auto edge = compressed_graph->add_se3_edge(
           vertex1, vertex2, relative_pose, information, true);
@@ -872,6 +872,7 @@ void GraphUtils::connect_rooms_floors(
 }
 
 void GraphUtils::update_graph(const std::unique_ptr<GraphSLAM>& compressed_graph,
+                              const std::shared_ptr<GraphSLAM>& covisibility_graph,
                               std::map<int, KeyFrame::Ptr> keyframes,
                               std::unordered_map<int, VerticalPlanes>& x_vert_planes,
                               std::unordered_map<int, VerticalPlanes>& y_vert_planes,
@@ -879,11 +880,33 @@ void GraphUtils::update_graph(const std::unique_ptr<GraphSLAM>& compressed_graph
                               std::unordered_map<int, InfiniteRooms>& x_infinite_rooms,
                               std::unordered_map<int, InfiniteRooms>& y_infinite_rooms,
                               std::unordered_map<int, Floors>& floors_vec) {
-  // Loop over all the vertices of the graph
-  for (auto it = compressed_graph->graph->vertices().begin();
-       it != compressed_graph->graph->vertices().end();
-       ++it) {
-    g2o::OptimizableGraph::Vertex* v = (g2o::OptimizableGraph::Vertex*)(it->second);
+  std::vector<g2o::OptimizableGraph::Vertex*> vertices;
+  vertices.reserve(compressed_graph->graph->vertices().size());
+  for (const auto& vertex : compressed_graph->graph->vertices()) {
+    vertices.push_back(static_cast<g2o::OptimizableGraph::Vertex*>(vertex.second));
+  }
+  update_graph(vertices,
+               covisibility_graph,
+               keyframes,
+               x_vert_planes,
+               y_vert_planes,
+               rooms_vec,
+               x_infinite_rooms,
+               y_infinite_rooms,
+               floors_vec);
+}
+
+void GraphUtils::update_graph(
+    const std::vector<g2o::OptimizableGraph::Vertex*>& vertices,
+    const std::shared_ptr<GraphSLAM>& covisibility_graph,
+    const std::map<int, KeyFrame::Ptr>& keyframes,
+    std::unordered_map<int, VerticalPlanes>& x_vert_planes,
+    std::unordered_map<int, VerticalPlanes>& y_vert_planes,
+    std::unordered_map<int, Rooms>& rooms_vec,
+    std::unordered_map<int, InfiniteRooms>& x_infinite_rooms,
+    std::unordered_map<int, InfiniteRooms>& y_infinite_rooms,
+    std::unordered_map<int, Floors>& floors_vec) {
+  for (const auto v : vertices) {
     g2o::VertexSE3* vertex_se3 = dynamic_cast<g2o::VertexSE3*>(v);
 
     // if vertex is se3 check for it in keyframes vector and update its node estimate
@@ -891,8 +914,10 @@ void GraphUtils::update_graph(const std::unique_ptr<GraphSLAM>& compressed_graph
       int id = vertex_se3->id();
       auto keyframe = keyframes.find(id);
 
-      if (keyframe != keyframes.end())
+      if (keyframe != keyframes.end()) {
         (*keyframe).second->node->setEstimate(vertex_se3->estimate());
+        covisibility_graph->mark_vertex_changed(id);
+      }
       continue;
     }
 
@@ -903,12 +928,14 @@ void GraphUtils::update_graph(const std::unique_ptr<GraphSLAM>& compressed_graph
 
       if (x_plane != x_vert_planes.end()) {
         (*x_plane).second.plane_node->setEstimate(vertex_plane->estimate());
+        covisibility_graph->mark_vertex_changed(id);
         continue;
       } else {
         auto y_plane = y_vert_planes.find(id);
 
         if (y_plane != y_vert_planes.end()) {
           (*y_plane).second.plane_node->setEstimate(vertex_plane->estimate());
+          covisibility_graph->mark_vertex_changed(id);
           continue;
         }
       }
@@ -921,18 +948,21 @@ void GraphUtils::update_graph(const std::unique_ptr<GraphSLAM>& compressed_graph
       auto room = rooms_vec.find(id);
       if (room != rooms_vec.end()) {
         (*room).second.node->setEstimate(vertex_room->estimate());
+        covisibility_graph->mark_vertex_changed(id);
         continue;
       } else {
         auto x_inf_room = x_infinite_rooms.find(id);
 
         if (x_inf_room != x_infinite_rooms.end()) {
           (*x_inf_room).second.node->setEstimate(vertex_room->estimate());
+          covisibility_graph->mark_vertex_changed(id);
           continue;
         } else {
           auto y_inf_room = y_infinite_rooms.find(id);
 
           if (y_inf_room != y_infinite_rooms.end()) {
             (*y_inf_room).second.node->setEstimate(vertex_room->estimate());
+            covisibility_graph->mark_vertex_changed(id);
             continue;
           }
         }
@@ -946,6 +976,7 @@ void GraphUtils::update_graph(const std::unique_ptr<GraphSLAM>& compressed_graph
 
       if (floor != floors_vec.end()) {
         (*floor).second.node->setEstimate(vertex_floor->estimate());
+        covisibility_graph->mark_vertex_changed(id);
         continue;
       }
     }
@@ -997,6 +1028,7 @@ void GraphUtils::set_marginalize_info(
             data->set_marginalized_info(marginalized);
             covis_vertex_se3->setUserData(data);
             covis_vertex_se3->setEstimate((local_vertex_se3)->estimate());
+            covisibility_graph->mark_vertex_updated(covis_vertex_se3->id());
           }
         }
       }
@@ -1014,7 +1046,10 @@ void GraphUtils::set_marginalize_info(
       // find the equivalent in the covis graph
       auto covis_v = dynamic_cast<g2o::VertexPlane*>(
           covisibility_graph->graph->vertex(vertex_plane->id()));
-      if (covis_v) covis_v->setEstimate(vertex_plane->estimate());
+      if (covis_v) {
+        covis_v->setEstimate(vertex_plane->estimate());
+        covisibility_graph->mark_vertex_updated(covis_v->id());
+      }
       continue;
     }
 
@@ -1022,7 +1057,10 @@ void GraphUtils::set_marginalize_info(
     if (vertex_room) {
       auto covis_v = dynamic_cast<g2o::VertexRoom*>(
           covisibility_graph->graph->vertex(vertex_room->id()));
-      if (covis_v) covis_v->setEstimate(vertex_room->estimate());
+      if (covis_v) {
+        covis_v->setEstimate(vertex_room->estimate());
+        covisibility_graph->mark_vertex_updated(covis_v->id());
+      }
       continue;
     }
   }
@@ -60,12 +60,12 @@ InformationMatrixCalculator::InformationMatrixCalculator(
 
 InformationMatrixCalculator::~InformationMatrixCalculator() {}
 
-Eigen::MatrixXd InformationMatrixCalculator::calc_information_matrix(
+Eigen::Matrix<double, 6, 6> InformationMatrixCalculator::calc_information_matrix(
     const pcl::PointCloud<PointT>::ConstPtr& cloud1,
     const pcl::PointCloud<PointT>::ConstPtr& cloud2,
     const Eigen::Isometry3d& relpose) const {
   if (use_const_inf_matrix || cloud1->points.empty() || cloud2->points.empty()) {
-    Eigen::MatrixXd inf = Eigen::MatrixXd::Identity(6, 6);
+    Eigen::Matrix<double, 6, 6> inf = Eigen::Matrix<double, 6, 6>::Identity();
     inf.topLeftCorner(3, 3).array() /= const_stddev_x;
     inf.bottomRightCorner(3, 3).array() /= const_stddev_q;
     return inf;
@@ -83,7 +83,7 @@ Eigen::MatrixXd InformationMatrixCalculator::calc_information_matrix(
   float w_q =
       weight(var_gain_a, fitness_score_thresh, min_var_q, max_var_q, fitness_score);
 
-  Eigen::MatrixXd inf = Eigen::MatrixXd::Identity(6, 6);
+  Eigen::Matrix<double, 6, 6> inf = Eigen::Matrix<double, 6, 6>::Identity();
   inf.topLeftCorner(3, 3).array() /= w_x;
   inf.bottomRightCorner(3, 3).array() /= w_q;
   return inf;
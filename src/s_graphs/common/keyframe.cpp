@@ -209,6 +209,7 @@ KeyFrameSnapshot::KeyFrameSnapshot(const Eigen::Isometry3d& pose,
     : pose(pose), cloud(cloud), k_marginalized(marginalized) {}
 
 KeyFrameSnapshot::KeyFrameSnapshot(const KeyFrame::Ptr& key) {
+  id = key->id();
   pose = key->node->estimate();
   cloud = key->cloud;
   k_marginalized = GraphUtils::get_keyframe_marg_data(key->node);
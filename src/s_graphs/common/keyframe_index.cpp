@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <algorithm>
+#include <s_graphs/common/keyframe_index.hpp>
+
+namespace s_graphs {
+
+namespace {
+
+// stamps are compared as nanoseconds, rclcpp::Time comparison throws on mixed clocks
+bool stamp_less(const KeyFrame::Ptr& lhs, const KeyFrame::Ptr& rhs) {
+  return lhs->stamp.nanoseconds() < rhs->stamp.nanoseconds();
+}
+
+}  // namespace
+
+void KeyFrameIndex::insert(const KeyFrame::Ptr& keyframe) {
+  if (stamp_order.empty() || !stamp_less(keyframe, stamp_order.back())) {
+    stamp_order.push_back(keyframe);
+    return;
+  }
+  stamp_order.insert(
+      std::upper_bound(stamp_order.begin(), stamp_order.end(), keyframe, stamp_less),
+      keyframe);
+}
+
+void KeyFrameIndex::rebuild(const std::map<int, KeyFrame::Ptr>& keyframes) {
+  clear();
+  stamp_order.reserve(keyframes.size());
+  for (const auto& keyframe : keyframes) {
+    stamp_order.push_back(keyframe.second);
+  }
+  std::stable_sort(stamp_order.begin(), stamp_order.end(), stamp_less);
+}
+
+void KeyFrameIndex::clear() { stamp_order.clear(); }
+
+}  // namespace s_graphs
@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <g2o/types/slam3d/vertex_se3.h>
+
+#include <s_graphs/common/graph_utils.hpp>
+#include <s_graphs/common/keyframe_state_store.hpp>
+
+namespace s_graphs {
+
+void KeyFrameStateStore::insert(const KeyFrame::Ptr& keyframe) {
+  if (slots.count(keyframe->id())) return;
+
+  size_t slot = keyframes.size();
+  slots[keyframe->id()] = slot;
+  keyframes.push_back(keyframe);
+  ids.push_back(keyframe->id());
+  stamps.push_back(keyframe->stamp.seconds());
+  accum_distances.push_back(keyframe->accum_distance);
+  for (auto array : {&pos_x, &pos_y, &pos_z, &rot_x, &rot_y, &rot_z, &rot_w}) {
+    array->push_back(0.0);
+  }
+  flags.push_back(0);
+  revisions.push_back(0);
+  write_state(slot, 0);
+}
+
+void KeyFrameStateStore::rebuild(const std::map<int, KeyFrame::Ptr>& keyframes) {
+  clear();
+  for (const auto& keyframe : keyframes) {
+    insert(keyframe.second);
+  }
+}
+
+void KeyFrameStateStore::sync(const GraphSLAM& graph) {
+  if (graph.get_revision() == synced_revision) return;
+
+  for (size_t i = 0; i < keyframes.size(); i++) {
+    uint64_t revision = graph.get_vertex_revision(ids[i]);
+    if (revision > revisions[i]) write_state(i, revision);
+  }
+  synced_revision = graph.get_revision();
+}
+
+void KeyFrameStateStore::clear() {
+  keyframes.clear();
+  ids.clear();
+  stamps.clear();
+  accum_distances.clear();
+  for (auto array : {&pos_x, &pos_y, &pos_z, &rot_x, &rot_y, &rot_z, &rot_w}) {
+    array->clear();
+  }
+  flags.clear();
+  revisions.clear();
+  slots.clear();
+  synced_revision = 0;
+}
+
+int KeyFrameStateStore::slot(const long id) const {
+  auto found = slots.find(id);
+  return found != slots.end() ? static_cast<int>(found->second) : -1;
+}
+
+Eigen::Isometry3d KeyFrameStateStore::pose(const size_t slot) const {
+  Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+  pose.linear() =
+      Eigen::Quaterniond(rot_w[slot], rot_x[slot], rot_y[slot], rot_z[slot])
+          .toRotationMatrix();
+  pose.translation() = Eigen::Vector3d(pos_x[slot], pos_y[slot], pos_z[slot]);
+  return pose;
+}
+
+void KeyFrameStateStore::find_near(const Eigen::Vector2d& center,
+                                   const double radius,
+                                   const double max_accum_distance,
+                                   std::vector<size_t>& found_slots) const {
+  const size_t num_keyframes = keyframes.size();
+  const double* x = pos_x.data();
+  const double* y = pos_y.data();
+  const double* accum_distance = accum_distances.data();
+  const double center_x = center.x(), center_y = center.y();
+  const double squared_radius = radius * radius;
+
+  // branchless pass over the arrays so that the compiler can vectorize it
+  std::vector<uint8_t> mask(num_keyframes);
+  for (size_t i = 0; i < num_keyframes; i++) {
+    const double dx = x[i] - center_x;
+    const double dy = y[i] - center_y;
+    mask[i] = (accum_distance[i] <= max_accum_distance) &
+              (dx * dx + dy * dy <= squared_radius);
+  }
+
+  for (size_t i = 0; i < num_keyframes; i++) {
+    if (mask[i]) found_slots.push_back(i);
+  }
+}
+
+std::vector<KeyFrameSnapshot::Ptr> KeyFrameStateStore::create_snapshots() const {
+  std::vector<KeyFrameSnapshot::Ptr> snapshots(keyframes.size());
+  for (size_t i = 0; i < keyframes.size(); i++) {
+    snapshots[i] = std::make_shared<KeyFrameSnapshot>(
+        pose(i), keyframes[i]->cloud, has_flag(i, MARGINALIZED));
+    snapshots[i]->id = ids[i];
+  }
+  return snapshots;
+}
+
+void KeyFrameStateStore::write_state(const size_t slot, const uint64_t revision) {
+  const KeyFrame::Ptr& keyframe = keyframes[slot];
+  revisions[slot] = revision;
+  if (!keyframe->node) return;
+
+  const Eigen::Isometry3d& estimate = keyframe->node->estimate();
+  Eigen::Quaterniond rotation(estimate.linear());
+  rotation.normalize();
+  pos_x[slot] = estimate.translation().x();
+  pos_y[slot] = estimate.translation().y();
+  pos_z[slot] = estimate.translation().z();
+  rot_x[slot] = rotation.x();
+  rot_y[slot] = rotation.y();
+  rot_z[slot] = rotation.z();
+  rot_w[slot] = rotation.w();
+
+  flags[slot] = 0;
+  if (GraphUtils::get_keyframe_marg_data(keyframe->node)) flags[slot] |= MARGINALIZED;
+}
+
+}  // namespace s_graphs
@@ -373,4 +373,41 @@ double PlaneUtils::plane_difference(g2o::Plane3D plane1, g2o::Plane3D plane2) {
   double maha_dist = sqrt(error.transpose() * information * error);
   return maha_dist;
 }
+
+Eigen::Matrix3d PlaneUtils::plane_map_covariance(
+    const Eigen::Isometry3d& keyframe_pose,
+    const g2o::Plane3D& plane_body,
+    const Eigen::Matrix<double, 6, 6>& pose_covariance,
+    const Eigen::Matrix3d& plane_covariance) {
+  const double eps = 1e-6;
+  const g2o::Plane3D plane_map = keyframe_pose * plane_body;
+
+  Eigen::Matrix<double, 3, 6> pose_jacobian;
+  for (int k = 0; k < 6; ++k) {
+    g2o::Vector6 delta = g2o::Vector6::Zero();
+    delta(k) = eps;
+    const g2o::Plane3D plus =
+        (keyframe_pose * g2o::internal::fromVectorMQT(delta)) * plane_body;
+    const g2o::Plane3D minus =
+        (keyframe_pose * g2o::internal::fromVectorMQT(-delta)) * plane_body;
+    pose_jacobian.col(k) =
+        (plus.ominus(plane_map) - minus.ominus(plane_map)) / (2 * eps);
+  }
+
+  Eigen::Matrix3d plane_jacobian;
+  for (int k = 0; k < 3; ++k) {
+    Eigen::Vector3d delta = Eigen::Vector3d::Zero();
+    delta(k) = eps;
+    g2o::Plane3D plus = plane_body, minus = plane_body;
+    plus.oplus(delta);
+    minus.oplus(-delta);
+    plane_jacobian.col(k) =
+        ((keyframe_pose * plus).ominus(plane_map) -
+         (keyframe_pose * minus).ominus(plane_map)) /
+        (2 * eps);
+  }
+
+  return pose_jacobian * pose_covariance * pose_jacobian.transpose() +
+         plane_jacobian * plane_covariance * plane_jacobian.transpose();
+}
 }  // namespace s_graphs
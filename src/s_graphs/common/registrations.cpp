@@ -39,6 +39,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <fast_gicp/gicp/fast_vgicp.hpp>
 #include <iostream>
 #include <s_graphs/common/registrations.hpp>
+#include <s_graphs/common/voxel_map_registration.hpp>
 
 #ifdef USE_VGICP_CUDA
 #include <fast_gicp/gicp/fast_vgicp_cuda.hpp>
@@ -46,6 +47,19 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 namespace s_graphs {
 
+namespace {
+
+/**
+ * @brief FastGICP exposing the correspondence distances of its final iteration.
+ */
+template <typename PointSource, typename PointTarget>
+class FastGICPWithResiduals : public fast_gicp::FastGICP<PointSource, PointTarget> {
+ public:
+  const std::vector<float>& get_sq_distances() const { return this->sq_distances_; }
+};
+
+}  // namespace
+
 boost::shared_ptr<pcl::Registration<pcl::PointXYZI, pcl::PointXYZI>>
 select_registration_method(registration_params params) {
   using PointT = pcl::PointXYZI;
@@ -54,8 +68,8 @@ select_registration_method(registration_params params) {
   std::string registration_method = params.registration_method;
   if (registration_method == "FAST_GICP") {
     std::cout << "registration: FAST_GICP" << std::endl;
-    boost::shared_ptr<fast_gicp::FastGICP<PointT, PointT>> gicp(
-        new fast_gicp::FastGICP<PointT, PointT>());
+    boost::shared_ptr<FastGICPWithResiduals<PointT, PointT>> gicp(
+        new FastGICPWithResiduals<PointT, PointT>());
     gicp->setNumThreads(params.reg_num_threads);
     gicp->setTransformationEpsilon(params.reg_transformation_epsilon);
     gicp->setMaximumIterations(params.reg_maximum_iterations);
@@ -87,6 +101,15 @@ select_registration_method(registration_params params) {
     vgicp->setMaximumIterations(params.reg_maximum_iterations);
     vgicp->setCorrespondenceRandomness(params.reg_correspondence_randomness);
     return vgicp;
+  } else if (registration_method == "VOXEL_MAP") {
+    std::cout << "registration: VOXEL_MAP" << std::endl;
+    boost::shared_ptr<VoxelMapRegistration> voxel_map(new VoxelMapRegistration());
+    voxel_map->setNumThreads(params.reg_num_threads);
+    voxel_map->setResolution(params.reg_resolution);
+    voxel_map->setTransformationEpsilon(params.reg_transformation_epsilon);
+    voxel_map->setMaximumIterations(params.reg_maximum_iterations);
+    voxel_map->setCorrespondenceRandomness(params.reg_correspondence_randomness);
+    return voxel_map;
   } else if (registration_method == "ICP") {
     std::cout << "registration: ICP" << std::endl;
     boost::shared_ptr<pcl::IterativeClosestPoint<PointT, PointT>> icp(
@@ -163,4 +186,49 @@ select_registration_method(registration_params params) {
   return nullptr;
 }
 
+RegistrationResult get_registration_result(
+    pcl::Registration<pcl::PointXYZI, pcl::PointXYZI>& registration,
+    const pcl::PointCloud<pcl::PointXYZI>& aligned,
+    const double inlier_distance,
+    const double max_range) {
+  using PointT = pcl::PointXYZI;
+
+  RegistrationResult result;
+  result.has_converged = registration.hasConverged();
+  result.final_transformation = registration.getFinalTransformation();
+  if (aligned.empty()) return result;
+
+  auto fast_gicp = dynamic_cast<FastGICPWithResiduals<PointT, PointT>*>(&registration);
+  if (fast_gicp && fast_gicp->get_sq_distances().size() == aligned.size()) {
+    result.sq_distances = fast_gicp->get_sq_distances();
+  } else {
+    result.sq_distances.resize(aligned.size());
+    std::vector<int> k_indices;
+    std::vector<float> k_sq_dists;
+    auto search = registration.getSearchMethodTarget();
+    for (size_t i = 0; i < aligned.size(); i++) {
+      search->nearestKSearch(aligned.at(i), 1, k_indices, k_sq_dists);
+      result.sq_distances[i] =
+          k_sq_dists.empty() ? std::numeric_limits<float>::max() : k_sq_dists[0];
+    }
+  }
+
+  int num_inliers = 0, num_fitness_points = 0;
+  double sum_sq_distances = 0.0;
+  const double sq_inlier_distance = inlier_distance * inlier_distance;
+  for (const float sq_distance : result.sq_distances) {
+    if (sq_distance < sq_inlier_distance) num_inliers++;
+    if (sq_distance <= max_range) {
+      sum_sq_distances += sq_distance;
+      num_fitness_points++;
+    }
+  }
+  result.inlier_fraction = static_cast<float>(num_inliers) / aligned.size();
+  if (num_fitness_points > 0) {
+    result.fitness_score = sum_sq_distances / num_fitness_points;
+  }
+
+  return result;
+}
+
 }  // namespace s_graphs
@@ -0,0 +1,248 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <algorithm>
+#include <limits>
+#include <s_graphs/common/plane_utils.hpp>
+#include <s_graphs/common/room_registry.hpp>
+
+namespace s_graphs {
+
+namespace {
+
+/**
+ * @brief whether a room was added, removed or moved since the last sync
+ */
+template <typename RoomT>
+bool rooms_changed(const GraphSLAM& graph_slam,
+                   const std::unordered_map<int, Eigen::Vector2d>& positions,
+                   const uint64_t synced_revision,
+                   const std::unordered_map<int, RoomT>& rooms) {
+  if (rooms.size() != positions.size()) return true;
+  for (const auto& room : rooms) {
+    if (room.second.node == nullptr || !positions.count(room.first)) return true;
+    if (graph_slam.get_vertex_revision(room.second.node->id()) > synced_revision)
+      return true;
+  }
+  return false;
+}
+
+int nearest(const std::vector<int>& ids,
+            const std::unordered_map<int, Eigen::Vector2d>& positions,
+            const Eigen::Vector2d& position) {
+  int nearest_id = -1;
+  double min_dist = std::numeric_limits<double>::max();
+  for (const int id : ids) {
+    const double dist = (positions.at(id) - position).norm();
+    if (dist < min_dist) {
+      min_dist = dist;
+      nearest_id = id;
+    }
+  }
+  return nearest_id;
+}
+
+bool has_room(const std::unordered_map<int, std::vector<int>>& plane_rooms,
+              const int plane_id,
+              const int room_id) {
+  auto rooms = plane_rooms.find(plane_id);
+  if (rooms == plane_rooms.end()) return false;
+  return std::find(rooms->second.begin(), rooms->second.end(), room_id) !=
+         rooms->second.end();
+}
+
+int common_room(const std::unordered_map<int, std::vector<int>>& plane_rooms,
+                const int plane1_id,
+                const int plane2_id) {
+  auto rooms1 = plane_rooms.find(plane1_id);
+  auto rooms2 = plane_rooms.find(plane2_id);
+  if (rooms1 == plane_rooms.end() || rooms2 == plane_rooms.end()) return -1;
+  for (const int room_id : rooms1->second) {
+    if (std::find(rooms2->second.begin(), rooms2->second.end(), room_id) !=
+        rooms2->second.end())
+      return room_id;
+  }
+  return -1;
+}
+
+}  // namespace
+
+RoomRegistry::RoomRegistry(const double cell_size)
+    : room_grid(cell_size),
+      x_infinite_room_index(cell_size),
+      y_infinite_room_index(cell_size),
+      rooms_graph(nullptr),
+      infinite_rooms_graph(nullptr),
+      rooms_revision(0),
+      infinite_rooms_revision(0) {}
+
+void RoomRegistry::sync_rooms(const GraphSLAM& graph_slam,
+                              const std::unordered_map<int, Rooms>& rooms_vec) {
+  if (&graph_slam == rooms_graph &&
+      (graph_slam.get_revision() == rooms_revision ||
+       !rooms_changed(graph_slam, room_positions, rooms_revision, rooms_vec)))
+    return;
+
+  room_grid.clear();
+  room_positions.clear();
+  plane_rooms.clear();
+  for (const auto& room : rooms_vec) {
+    if (room.second.node == nullptr) continue;
+    const Eigen::Vector2d position = room.second.node->estimate().translation().head(2);
+    room_grid.insert(room.first, position);
+    room_positions[room.first] = position;
+    for (const int plane_id : {room.second.plane_x1_id,
+                               room.second.plane_x2_id,
+                               room.second.plane_y1_id,
+                               room.second.plane_y2_id}) {
+      plane_rooms[plane_id].push_back(room.first);
+    }
+  }
+  rooms_graph = &graph_slam;
+  rooms_revision = graph_slam.get_revision();
+}
+
+void RoomRegistry::sync_infinite_rooms(
+    const GraphSLAM& graph_slam,
+    const std::unordered_map<int, InfiniteRooms>& x_infinite_rooms,
+    const std::unordered_map<int, InfiniteRooms>& y_infinite_rooms) {
+  if (&graph_slam == infinite_rooms_graph &&
+      (graph_slam.get_revision() == infinite_rooms_revision ||
+       (!rooms_changed(graph_slam,
+                       x_infinite_room_index.positions,
+                       infinite_rooms_revision,
+                       x_infinite_rooms) &&
+        !rooms_changed(graph_slam,
+                       y_infinite_room_index.positions,
+                       infinite_rooms_revision,
+                       y_infinite_rooms))))
+    return;
+
+  index_infinite_rooms(x_infinite_rooms, 0, x_infinite_room_index);
+  index_infinite_rooms(y_infinite_rooms, 1, y_infinite_room_index);
+  infinite_rooms_graph = &graph_slam;
+  infinite_rooms_revision = graph_slam.get_revision();
+}
+
+void RoomRegistry::index_infinite_rooms(
+    const std::unordered_map<int, InfiniteRooms>& infinite_rooms,
+    const int axis,
+    InfiniteRoomIndex& index) {
+  index.grid.clear();
+  index.positions.clear();
+  index.coordinates.clear();
+  index.plane_rooms.clear();
+  for (const auto& infinite_room : infinite_rooms) {
+    if (infinite_room.second.node == nullptr) continue;
+    const Eigen::Vector2d position =
+        infinite_room.second.node->estimate().translation().head(2);
+    index.grid.insert(infinite_room.first, position);
+    index.positions[infinite_room.first] = position;
+    index.coordinates.emplace_back(position(axis), infinite_room.first);
+    index.plane_rooms[infinite_room.second.plane1_id].push_back(infinite_room.first);
+    index.plane_rooms[infinite_room.second.plane2_id].push_back(infinite_room.first);
+  }
+  std::sort(index.coordinates.begin(), index.coordinates.end());
+}
+
+const RoomRegistry::InfiniteRoomIndex* RoomRegistry::infinite_room_index(
+    const int plane_type) const {
+  if (plane_type == PlaneUtils::plane_class::X_VERT_PLANE)
+    return &x_infinite_room_index;
+  if (plane_type == PlaneUtils::plane_class::Y_VERT_PLANE)
+    return &y_infinite_room_index;
+  return nullptr;
+}
+
+std::vector<int> RoomRegistry::find_rooms(const Eigen::Vector2d& position,
+                                          const double radius) const {
+  return room_grid.query(position, radius);
+}
+
+int RoomRegistry::find_nearest_room(const Eigen::Vector2d& position,
+                                    const double radius) const {
+  return nearest(room_grid.query(position, radius), room_positions, position);
+}
+
+int RoomRegistry::find_nearest_infinite_room(const int plane_type,
+                                             const Eigen::Vector2d& position,
+                                             const double radius) const {
+  const InfiniteRoomIndex* index = infinite_room_index(plane_type);
+  if (index == nullptr) return -1;
+  return nearest(index->grid.query(position, radius), index->positions, position);
+}
+
+std::vector<int> RoomRegistry::find_infinite_rooms(const int plane_type,
+                                                   const double coordinate,
+                                                   const double radius) const {
+  std::vector<int> ids;
+  const InfiniteRoomIndex* index = infinite_room_index(plane_type);
+  if (index == nullptr) return ids;
+
+  auto begin = std::lower_bound(index->coordinates.begin(),
+                                index->coordinates.end(),
+                                std::make_pair(coordinate - radius,
+                                               std::numeric_limits<int>::min()));
+  for (auto itr = begin;
+       itr != index->coordinates.end() && itr->first < coordinate + radius;
+       ++itr) {
+    if (std::abs(itr->first - coordinate) < radius) ids.push_back(itr->second);
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+int RoomRegistry::find_room_with_planes(const int plane1_id,
+                                        const int plane2_id) const {
+  return common_room(plane_rooms, plane1_id, plane2_id);
+}
+
+int RoomRegistry::find_infinite_room_with_planes(const int plane_type,
+                                                 const int plane1_id,
+                                                 const int plane2_id) const {
+  const InfiniteRoomIndex* index = infinite_room_index(plane_type);
+  if (index == nullptr) return -1;
+  return common_room(index->plane_rooms, plane1_id, plane2_id);
+}
+
+bool RoomRegistry::room_has_plane(const int room_id, const int plane_id) const {
+  return has_room(plane_rooms, plane_id, room_id);
+}
+
+bool RoomRegistry::infinite_room_has_plane(const int plane_type,
+                                           const int infinite_room_id,
+                                           const int plane_id) const {
+  const InfiniteRoomIndex* index = infinite_room_index(plane_type);
+  if (index == nullptr) return false;
+  return has_room(index->plane_rooms, plane_id, infinite_room_id);
+}
+
+}  // namespace s_graphs
@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <chrono>
+#include <cmath>
+#include <s_graphs/common/tiled_map_cloud.hpp>
+
+namespace s_graphs {
+
+TiledMapCloud::TiledMapCloud(const double resolution,
+                             const double tile_size,
+                             const double pose_tolerance)
+    : resolution(resolution), tile_size(tile_size), pose_tolerance(pose_tolerance) {}
+
+bool TiledMapCloud::update(const std::vector<KeyFrameSnapshot::Ptr>& keyframes,
+                           const double time_budget) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  // assign the new and moved keyframes to their tiles, the ones missing from the
+  // snapshot are removed
+  std::set<long> current_ids;
+  for (const auto& keyframe : keyframes) {
+    if (keyframe->id < 0 || !keyframe->cloud) continue;
+    current_ids.insert(keyframe->id);
+
+    TileKey tile = tile_key(keyframe->pose);
+    auto entry = keyframe_entries.find(keyframe->id);
+    if (entry != keyframe_entries.end()) {
+      Eigen::Isometry3d delta = entry->second.keyframe->pose.inverse() * keyframe->pose;
+      if (delta.translation().norm() <= pose_tolerance &&
+          Eigen::AngleAxisd(delta.linear()).angle() <= pose_tolerance) {
+        continue;
+      }
+      if (entry->second.tile != tile) {
+        tiles[entry->second.tile].keyframe_ids.erase(keyframe->id);
+        pending_tiles.insert(entry->second.tile);
+      }
+    }
+
+    KeyFrameEntry& new_entry = keyframe_entries[keyframe->id];
+    new_entry.tile = tile;
+    new_entry.keyframe = keyframe;
+    tiles[tile].keyframe_ids.insert(keyframe->id);
+    pending_tiles.insert(tile);
+  }
+
+  for (auto entry = keyframe_entries.begin(); entry != keyframe_entries.end();) {
+    if (current_ids.count(entry->first)) {
+      entry++;
+      continue;
+    }
+    tiles[entry->second.tile].keyframe_ids.erase(entry->first);
+    pending_tiles.insert(entry->second.tile);
+    entry = keyframe_entries.erase(entry);
+  }
+
+  // at least one tile is rebuilt per call so that the map always progresses
+  updated_tiles.clear();
+  for (auto key = pending_tiles.begin(); key != pending_tiles.end();) {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start_time;
+    if (!updated_tiles.empty() && elapsed.count() > time_budget) break;
+
+    rebuild_tile(*key);
+    updated_tiles.push_back(*key);
+    key = pending_tiles.erase(key);
+  }
+  if (!updated_tiles.empty()) map_cloud.reset();
+
+  return pending_tiles.empty();
+}
+
+pcl::PointCloud<TiledMapCloud::PointT>::Ptr TiledMapCloud::get_map() {
+  if (map_cloud) return map_cloud;
+
+  size_t size = 0;
+  for (const auto& tile : tiles) {
+    if (tile.second.cloud) size += tile.second.cloud->size();
+  }
+
+  map_cloud.reset(new pcl::PointCloud<PointT>());
+  map_cloud->reserve(size);
+  for (const auto& tile : tiles) {
+    if (tile.second.cloud) *map_cloud += *tile.second.cloud;
+  }
+  map_cloud->width = map_cloud->size();
+  map_cloud->height = 1;
+  map_cloud->is_dense = false;
+  return map_cloud;
+}
+
+TiledMapCloud::TileClouds TiledMapCloud::get_updated_tiles() const {
+  TileClouds updated;
+  updated.reserve(updated_tiles.size());
+  for (const auto& key : updated_tiles) {
+    auto tile = tiles.find(key);
+    if (tile != tiles.end() && tile->second.cloud) {
+      updated.emplace_back(key, tile->second.cloud);
+    } else {
+      updated.emplace_back(key, new pcl::PointCloud<PointT>());
+    }
+  }
+  return updated;
+}
+
+void TiledMapCloud::clear() {
+  keyframe_entries.clear();
+  tiles.clear();
+  pending_tiles.clear();
+  updated_tiles.clear();
+  map_cloud.reset();
+}
+
+TiledMapCloud::TileKey TiledMapCloud::tile_key(const Eigen::Isometry3d& pose) const {
+  return TileKey(static_cast<int>(std::floor(pose.translation().x() / tile_size)),
+                 static_cast<int>(std::floor(pose.translation().y() / tile_size)));
+}
+
+void TiledMapCloud::rebuild_tile(const TileKey& key) {
+  auto tile = tiles.find(key);
+  if (tile == tiles.end()) return;
+  if (tile->second.keyframe_ids.empty()) {
+    tiles.erase(tile);
+    return;
+  }
+
+  // the tile is transformed and downsampled from its keyframes in one pass, so the
+  // points are quantized only once
+  std::vector<KeyFrameSnapshot::Ptr> tile_keyframes;
+  tile_keyframes.reserve(tile->second.keyframe_ids.size());
+  for (const long id : tile->second.keyframe_ids) {
+    tile_keyframes.push_back(keyframe_entries[id].keyframe);
+  }
+  tile->second.cloud = map_cloud_generator.generate(tile_keyframes, resolution);
+}
+
+}  // namespace s_graphs
@@ -0,0 +1,177 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <pcl/common/point_tests.h>
+
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <s_graphs/common/voxel_covariance_map.hpp>
+
+namespace s_graphs {
+
+void VoxelCovarianceMap::Sums::add(const Eigen::Vector3d& point) {
+  sum += point;
+  sum_outer += point * point.transpose();
+  num_points++;
+}
+
+VoxelCovarianceMap::Sums& VoxelCovarianceMap::Sums::operator+=(const Sums& other) {
+  sum += other.sum;
+  sum_outer += other.sum_outer;
+  num_points += other.num_points;
+  return *this;
+}
+
+VoxelCovarianceMap::Sums& VoxelCovarianceMap::Sums::operator-=(const Sums& other) {
+  sum -= other.sum;
+  sum_outer -= other.sum_outer;
+  num_points -= other.num_points;
+  return *this;
+}
+
+VoxelCovarianceMap::VoxelCovarianceMap(const double resolution,
+                                       const int min_points_per_voxel)
+    : voxel_resolution(resolution), min_points_per_voxel(min_points_per_voxel) {}
+
+void VoxelCovarianceMap::insert(const int id,
+                                const pcl::PointCloud<PointT>& cloud,
+                                const Eigen::Isometry3d& pose) {
+  // the sums of the cloud are computed before taking the lock
+  std::unordered_map<uint64_t, Sums> cloud_sums;
+  for (const auto& point : cloud) {
+    if (!pcl::isFinite(point)) continue;
+    const Eigen::Vector3d transformed = pose * point.getVector3fMap().cast<double>();
+    cloud_sums[voxel_key(transformed)].add(transformed);
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  remove_unlocked(id);
+
+  auto& contributions = clouds[id];
+  contributions.reserve(cloud_sums.size());
+  for (const auto& cloud_sum : cloud_sums) {
+    VoxelEntry& entry = voxels[cloud_sum.first];
+    entry.sums += cloud_sum.second;
+    update_voxel(entry);
+    contributions.push_back(cloud_sum);
+  }
+}
+
+bool VoxelCovarianceMap::remove(const int id) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  return remove_unlocked(id);
+}
+
+bool VoxelCovarianceMap::remove_unlocked(const int id) {
+  auto cloud = clouds.find(id);
+  if (cloud == clouds.end()) return false;
+
+  for (const auto& contribution : cloud->second) {
+    auto entry = voxels.find(contribution.first);
+    if (entry == voxels.end()) continue;
+    entry->second.sums -= contribution.second;
+    if (entry->second.sums.num_points <= 0) {
+      voxels.erase(entry);
+    } else {
+      update_voxel(entry->second);
+    }
+  }
+  clouds.erase(cloud);
+  return true;
+}
+
+bool VoxelCovarianceMap::contains(const int id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return clouds.count(id) > 0;
+}
+
+const VoxelCovarianceMap::Voxel* VoxelCovarianceMap::lookup(
+    const Eigen::Vector3d& point) const {
+  auto entry = voxels.find(voxel_key(point));
+  if (entry == voxels.end() || !entry->second.valid) return nullptr;
+  return &entry->second.voxel;
+}
+
+std::shared_lock<std::shared_mutex> VoxelCovarianceMap::lock_shared() const {
+  return std::shared_lock<std::shared_mutex>(mutex);
+}
+
+pcl::PointCloud<VoxelCovarianceMap::PointT>::Ptr VoxelCovarianceMap::means() const {
+  pcl::PointCloud<PointT>::Ptr cloud(new pcl::PointCloud<PointT>());
+
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  cloud->reserve(voxels.size());
+  for (const auto& entry : voxels) {
+    if (!entry.second.valid) continue;
+    PointT point;
+    point.getVector3fMap() = entry.second.voxel.mean.cast<float>();
+    point.intensity = entry.second.voxel.num_points;
+    cloud->push_back(point);
+  }
+  return cloud;
+}
+
+size_t VoxelCovarianceMap::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return voxels.size();
+}
+
+Eigen::Matrix3d VoxelCovarianceMap::regularize(const Eigen::Matrix3d& covariance) {
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+  const Eigen::Vector3d values(1e-3, 1.0, 1.0);
+  return solver.eigenvectors() * values.asDiagonal() *
+         solver.eigenvectors().transpose();
+}
+
+uint64_t VoxelCovarianceMap::voxel_key(const Eigen::Vector3d& point) const {
+  // 21 bits per axis
+  const Eigen::Vector3i coord = (point / voxel_resolution).array().floor().cast<int>();
+  return (static_cast<uint64_t>(coord.x() & 0x1fffff) << 42) |
+         (static_cast<uint64_t>(coord.y() & 0x1fffff) << 21) |
+         static_cast<uint64_t>(coord.z() & 0x1fffff);
+}
+
+void VoxelCovarianceMap::update_voxel(VoxelEntry& entry) const {
+  const Sums& sums = entry.sums;
+  entry.valid = sums.num_points >= std::max(min_points_per_voxel, 3);
+  if (!entry.valid) return;
+
+  const Eigen::Vector3d mean = sums.sum / sums.num_points;
+  const Eigen::Matrix3d covariance =
+      sums.sum_outer / sums.num_points - mean * mean.transpose();
+  entry.voxel.mean = mean;
+  entry.voxel.covariance = regularize(covariance);
+  entry.voxel.num_points = sums.num_points;
+}
+
+}  // namespace s_graphs
@@ -0,0 +1,216 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <pcl/common/point_tests.h>
+#include <pcl/common/transforms.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include <s_graphs/common/voxel_map_registration.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace s_graphs {
+
+namespace {
+
+Eigen::Matrix3d skew(const Eigen::Vector3d& v) {
+  Eigen::Matrix3d skew;
+  skew << 0.0, -v.z(), v.y(), v.z(), 0.0, -v.x(), -v.y(), v.x(), 0.0;
+  return skew;
+}
+
+Eigen::Isometry3d se3_exp(const Eigen::Matrix<double, 6, 1>& delta) {
+  Eigen::Isometry3d trans = Eigen::Isometry3d::Identity();
+  const double angle = delta.head<3>().norm();
+  if (angle > 1e-12) {
+    trans.linear() =
+        Eigen::AngleAxisd(angle, delta.head<3>() / angle).toRotationMatrix();
+  }
+  trans.translation() = delta.tail<3>();
+  return trans;
+}
+
+}  // namespace
+
+VoxelMapRegistration::VoxelMapRegistration()
+    : resolution(1.0), k_correspondences(20), num_threads(1) {
+  reg_name_ = "VoxelMapRegistration";
+  max_iterations_ = 64;
+  transformation_epsilon_ = 5e-4;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+}
+
+void VoxelMapRegistration::setNumThreads(const int num_threads) {
+  this->num_threads = num_threads > 0 ? num_threads : 1;
+#ifdef _OPENMP
+  if (num_threads <= 0) this->num_threads = omp_get_max_threads();
+#endif
+}
+
+void VoxelMapRegistration::setInputSource(const PointCloudSourceConstPtr& cloud) {
+  if (input_ == cloud) return;
+  pcl::Registration<PointT, PointT>::setInputSource(cloud);
+  source_covariances.clear();
+}
+
+void VoxelMapRegistration::setInputTarget(const PointCloudTargetConstPtr& cloud) {
+  VoxelCovarianceMap::Ptr map = std::make_shared<VoxelCovarianceMap>(resolution);
+  map->insert(0, *cloud);
+  target_map = map;
+  pcl::Registration<PointT, PointT>::setInputTarget(cloud);
+}
+
+void VoxelMapRegistration::setTargetMap(const VoxelCovarianceMap::ConstPtr& map,
+                                        const PointCloudTargetConstPtr& cloud) {
+  target_map = map;
+  pcl::Registration<PointT, PointT>::setInputTarget(cloud);
+}
+
+void VoxelMapRegistration::compute_source_covariances() {
+  pcl::KdTreeFLANN<PointT> kdtree;
+  kdtree.setInputCloud(input_);
+
+  const int num_points = static_cast<int>(input_->size());
+  source_covariances.assign(num_points, Eigen::Matrix3d::Identity());
+
+#pragma omp parallel for num_threads(num_threads) schedule(guided, 8)
+  for (int i = 0; i < num_points; i++) {
+    if (!pcl::isFinite(input_->at(i))) continue;
+
+    std::vector<int> k_indices;
+    std::vector<float> k_sq_distances;
+    kdtree.nearestKSearch(input_->at(i), k_correspondences, k_indices, k_sq_distances);
+    if (k_indices.size() < 3) continue;
+
+    Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sum_outer = Eigen::Matrix3d::Zero();
+    for (const int index : k_indices) {
+      const Eigen::Vector3d point = input_->at(index).getVector3fMap().cast<double>();
+      mean += point;
+      sum_outer += point * point.transpose();
+    }
+    mean /= k_indices.size();
+    source_covariances[i] = VoxelCovarianceMap::regularize(
+        sum_outer / k_indices.size() - mean * mean.transpose());
+  }
+}
+
+int VoxelMapRegistration::linearize(const Eigen::Isometry3d& trans,
+                                    Eigen::Matrix<double, 6, 6>& H,
+                                    Eigen::Matrix<double, 6, 1>& b) const {
+  H.setZero();
+  b.setZero();
+  int num_correspondences = 0;
+
+  const int num_points = static_cast<int>(input_->size());
+#pragma omp parallel num_threads(num_threads)
+  {
+    Eigen::Matrix<double, 6, 6> H_local = Eigen::Matrix<double, 6, 6>::Zero();
+    Eigen::Matrix<double, 6, 1> b_local = Eigen::Matrix<double, 6, 1>::Zero();
+    int num_local = 0;
+
+#pragma omp for nowait schedule(guided, 8)
+    for (int i = 0; i < num_points; i++) {
+      if (!pcl::isFinite(input_->at(i))) continue;
+
+      const Eigen::Vector3d transformed =
+          trans * input_->at(i).getVector3fMap().cast<double>();
+      const VoxelCovarianceMap::Voxel* voxel = target_map->lookup(transformed);
+      if (!voxel) continue;
+
+      const Eigen::Matrix3d combined =
+          voxel->covariance +
+          trans.linear() * source_covariances[i] * trans.linear().transpose();
+      const Eigen::Matrix3d mahalanobis = combined.inverse();
+      const Eigen::Vector3d error = voxel->mean - transformed;
+
+      Eigen::Matrix<double, 3, 6> jacobian;
+      jacobian.block<3, 3>(0, 0) = skew(transformed);
+      jacobian.block<3, 3>(0, 3) = -Eigen::Matrix3d::Identity();
+
+      H_local += jacobian.transpose() * mahalanobis * jacobian;
+      b_local += jacobian.transpose() * mahalanobis * error;
+      num_local++;
+    }
+
+#pragma omp critical
+    {
+      H += H_local;
+      b += b_local;
+      num_correspondences += num_local;
+    }
+  }
+
+  return num_correspondences;
+}
+
+void VoxelMapRegistration::computeTransformation(PointCloudSource& output,
+                                                 const Matrix4& guess) {
+  converged_ = false;
+  if (!target_map) {
+    PCL_ERROR("[%s::computeTransformation] No target map was given!\n",
+              reg_name_.c_str());
+    return;
+  }
+  if (source_covariances.size() != input_->size()) {
+    compute_source_covariances();
+  }
+
+  // other consumers may update the map, it must not change during the alignment
+  auto lock = target_map->lock_shared();
+
+  Eigen::Isometry3d trans(guess.cast<double>());
+  for (nr_iterations_ = 0; nr_iterations_ < max_iterations_; nr_iterations_++) {
+    Eigen::Matrix<double, 6, 6> H;
+    Eigen::Matrix<double, 6, 1> b;
+    if (linearize(trans, H, b) < 6) break;
+
+    H += 1e-6 * Eigen::Matrix<double, 6, 6>::Identity();
+    const Eigen::Matrix<double, 6, 1> delta = H.ldlt().solve(-b);
+    trans = se3_exp(delta) * trans;
+
+    if (delta.norm() < transformation_epsilon_) {
+      converged_ = true;
+      break;
+    }
+  }
+
+  previous_transformation_ = final_transformation_;
+  final_transformation_ = trans.matrix().cast<float>();
+  transformation_ = final_transformation_;
+  pcl::transformPointCloud(*input_, output, final_transformation_);
+}
+
+}  // namespace s_graphs
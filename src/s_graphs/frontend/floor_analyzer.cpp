@@ -29,6 +29,8 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 
 // SPDX-License-Identifier: BSD-2-Clause
 
+#include <algorithm>
+#include <map>
 #include <s_graphs/frontend/floor_analyzer.hpp>
 
 namespace s_graphs {
@@ -41,95 +43,121 @@ void FloorAnalyzer::perform_floor_segmentation(
     const std::vector<s_graphs::msg::PlaneData>& current_x_vert_planes,
     const std::vector<s_graphs::msg::PlaneData>& current_y_vert_planes,
     std::vector<s_graphs::msg::PlaneData>& floor_plane_candidates_vec) {
-  // analyze the largest x plane pair
+  // analyze the largest x and y plane pairs
   s_graphs::msg::PlaneData floor_x_plane1, floor_x_plane2;
   s_graphs::msg::PlaneData floor_y_plane1, floor_y_plane2;
-  floor_x_plane1.nx = -1;
-  floor_x_plane2.nx = -1;
-  floor_y_plane1.nx = -1;
-  floor_y_plane2.nx = -1;
-
-  float max_xplane_width = 0;
-  for (auto x_plane1 : current_x_vert_planes) {
-    if (x_plane1.nx < 0) {
-      continue;
-    }
-    PlaneUtils::correct_plane_direction(PlaneUtils::plane_class::X_VERT_PLANE,
-                                        x_plane1);
 
-    for (auto x_plane2 : current_x_vert_planes) {
-      if (x_plane2.nx > 0) {
-        continue;
-      }
-      PlaneUtils::correct_plane_direction(PlaneUtils::plane_class::X_VERT_PLANE,
-                                          x_plane2);
-
-      float x_plane_width = PlaneUtils::width_between_planes(x_plane1, x_plane2);
-      bool planes_placed_correctly = false;
-      if (!x_plane1.plane_points.empty() && !x_plane2.plane_points.empty()) {
-        planes_placed_correctly = PlaneUtils::compute_point_difference(
-            x_plane1.plane_points.back().x, x_plane2.plane_points.back().x);
-      } else
-        continue;
-
-      float dot_product = PlaneUtils::plane_dot_product(x_plane1, x_plane2);
-      if (abs(dot_product) < 0.9) continue;
-
-      if (x_plane_width > max_xplane_width && planes_placed_correctly) {
-        max_xplane_width = x_plane_width;
-        floor_x_plane1 = x_plane1;
-        floor_x_plane2 = x_plane2;
-      }
-    }
+  if (find_widest_plane_pair(PlaneUtils::plane_class::X_VERT_PLANE,
+                             current_x_vert_planes,
+                             floor_x_plane1,
+                             floor_x_plane2)) {
+    floor_plane_candidates_vec.push_back(floor_x_plane1);
+    floor_plane_candidates_vec.push_back(floor_x_plane2);
   }
+  if (find_widest_plane_pair(PlaneUtils::plane_class::Y_VERT_PLANE,
+                             current_y_vert_planes,
+                             floor_y_plane1,
+                             floor_y_plane2)) {
+    floor_plane_candidates_vec.push_back(floor_y_plane1);
+    floor_plane_candidates_vec.push_back(floor_y_plane2);
+  }
+}
 
-  float max_yplane_width = 0;
-  for (auto y_plane1 : current_y_vert_planes) {
-    if (y_plane1.ny < 0) {
-      continue;
-    }
-    PlaneUtils::correct_plane_direction(PlaneUtils::plane_class::Y_VERT_PLANE,
-                                        y_plane1);
-
-    for (auto y_plane2 : current_y_vert_planes) {
-      if (y_plane2.ny > 0) {
-        continue;
+bool FloorAnalyzer::find_widest_plane_pair(
+    const int plane_type,
+    const std::vector<s_graphs::msg::PlaneData>& current_vert_planes,
+    s_graphs::msg::PlaneData& floor_plane1,
+    s_graphs::msg::PlaneData& floor_plane2) const {
+  bool x_plane = plane_type == PlaneUtils::plane_class::X_VERT_PLANE;
+
+  // split the walls by the sign of their normal, without copying the messages
+  std::vector<FloorPlaneCandidate> positive_planes, negative_planes;
+  for (const auto& plane : current_vert_planes) {
+    if (plane.plane_points.empty()) continue;
+
+    Eigen::Vector4d coeffs(plane.nx, plane.ny, plane.nz, plane.d);
+    PlaneUtils::correct_plane_direction(plane_type, coeffs);
+    FloorPlaneCandidate candidate;
+    candidate.plane = &plane;
+    candidate.normal = coeffs.head(3);
+    candidate.offset = fabs(coeffs(3)) * (coeffs(0) + coeffs(1));
+    candidate.last_point =
+        x_plane ? plane.plane_points.back().x : plane.plane_points.back().y;
+
+    float normal_sign = x_plane ? plane.nx : plane.ny;
+    if (normal_sign >= 0) positive_planes.push_back(candidate);
+    if (normal_sign <= 0) negative_planes.push_back(candidate);
+  }
+  if (positive_planes.empty() || negative_planes.empty()) return false;
+
+  // the width of a pair is the difference of the offsets. The placement check
+  // only compares the last points, so sweeping the upper walls by last point and
+  // keeping the admissible lower walls ordered by offset visits the widest placed
+  // pairs first. Only pairs failing the parallelism check cost an extra step.
+  float max_plane_width = 0;
+  const FloorPlaneCandidate* best_plane1 = nullptr;
+  const FloorPlaneCandidate* best_plane2 = nullptr;
+  auto by_last_point = [](const FloorPlaneCandidate& a, const FloorPlaneCandidate& b) {
+    return a.last_point < b.last_point;
+  };
+  std::sort(positive_planes.begin(), positive_planes.end(), by_last_point);
+  std::sort(negative_planes.begin(), negative_planes.end(), by_last_point);
+
+  // search the pairs with upper.offset > lower.offset, the positive wall of a
+  // pair must not lie past the negative one along the axis
+  auto search = [&](const std::vector<FloorPlaneCandidate>& upper,
+                    const std::vector<FloorPlaneCandidate>& lower,
+                    bool upper_is_positive) {
+    std::multimap<float, const FloorPlaneCandidate*> admissible_lower;
+    auto consider = [&](const FloorPlaneCandidate& upper_plane) {
+      for (const auto& [lower_offset, lower_plane] : admissible_lower) {
+        float plane_width = upper_plane.offset - lower_offset;
+        if (plane_width <= max_plane_width) break;
+        if (fabs(upper_plane.normal.dot(lower_plane->normal)) < 0.9) continue;
+
+        max_plane_width = plane_width;
+        best_plane1 = upper_is_positive ? &upper_plane : lower_plane;
+        best_plane2 = upper_is_positive ? lower_plane : &upper_plane;
+        break;
       }
-      PlaneUtils::correct_plane_direction(PlaneUtils::plane_class::Y_VERT_PLANE,
-                                          y_plane2);
-
-      float y_plane_width = PlaneUtils::width_between_planes(y_plane1, y_plane2);
-      bool planes_placed_correctly = false;
-      if (!y_plane1.plane_points.empty() && !y_plane2.plane_points.empty()) {
-        planes_placed_correctly = PlaneUtils::compute_point_difference(
-            y_plane1.plane_points.back().y, y_plane2.plane_points.back().y);
-      } else
-        continue;
-
-      float dot_product = PlaneUtils::plane_dot_product(y_plane1, y_plane2);
-      if (abs(dot_product) < 0.9) continue;
-
-      if (y_plane_width > max_yplane_width && planes_placed_correctly) {
-        max_yplane_width = y_plane_width;
-        floor_y_plane1 = y_plane1;
-        floor_y_plane2 = y_plane2;
+    };
+
+    if (upper_is_positive) {
+      // admissible negative walls have last_point >= the positive one
+      auto lower_it = lower.rbegin();
+      for (auto upper_it = upper.rbegin(); upper_it != upper.rend(); ++upper_it) {
+        for (; lower_it != lower.rend() &&
+               PlaneUtils::compute_point_difference(upper_it->last_point,
+                                                    lower_it->last_point);
+             ++lower_it) {
+          admissible_lower.emplace(lower_it->offset, &*lower_it);
+        }
+        consider(*upper_it);
+      }
+    } else {
+      // admissible positive walls have last_point <= the negative one
+      auto lower_it = lower.begin();
+      for (auto upper_it = upper.begin(); upper_it != upper.end(); ++upper_it) {
+        for (; lower_it != lower.end() &&
+               PlaneUtils::compute_point_difference(lower_it->last_point,
+                                                    upper_it->last_point);
+             ++lower_it) {
+          admissible_lower.emplace(lower_it->offset, &*lower_it);
+        }
+        consider(*upper_it);
       }
     }
-  }
+  };
+  search(positive_planes, negative_planes, true);
+  search(negative_planes, positive_planes, false);
+
+  if (!best_plane1) return false;
 
-  // std::cout << "xplane1: " << floor_x_plane1.nx << ", " << floor_x_plane1.ny << ", "
-  // << floor_x_plane1.nz << ", " << floor_x_plane1.d << std::endl; std::cout <<
-  // "xplane2: " << floor_x_plane2.nx << ", " << floor_x_plane2.ny << ", " <<
-  // floor_x_plane2.nz << ", " << floor_x_plane2.d << std::endl; std::cout << "yplane1:
-  // " << floor_y_plane1.nx << ", " << floor_y_plane1.ny << ", " << floor_y_plane1.nz <<
-  // ", " << floor_y_plane1.d << std::endl; std::cout << "yplane2: " <<
-  // floor_y_plane2.nx << ", " << floor_y_plane2.ny << ", " << floor_y_plane2.nz << ", "
-  // << floor_y_plane2.d << std::endl;
-
-  if (floor_x_plane1.nx != -1) floor_plane_candidates_vec.push_back(floor_x_plane1);
-  if (floor_x_plane2.nx != -1) floor_plane_candidates_vec.push_back(floor_x_plane2);
-  if (floor_y_plane1.nx != -1) floor_plane_candidates_vec.push_back(floor_y_plane1);
-  if (floor_y_plane2.nx != -1) floor_plane_candidates_vec.push_back(floor_y_plane2);
+  floor_plane1 = *best_plane1->plane;
+  floor_plane2 = *best_plane2->plane;
+  PlaneUtils::correct_plane_direction(plane_type, floor_plane1);
+  PlaneUtils::correct_plane_direction(plane_type, floor_plane2);
+  return true;
 }
 
 }  // namespace s_graphs
@@ -30,14 +30,24 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 #include <pcl_conversions/pcl_conversions.h>
 
 #include <algorithm>
+#include <limits>
 #include <s_graphs/visualization/graph_publisher.hpp>
+#include <unordered_set>
 #include <vector>
 
 #include "g2o/vertex_room.hpp"
 
-GraphPublisher::GraphPublisher() {}
+GraphPublisher::GraphPublisher(const rclcpp::Node::SharedPtr node) {
+  full_snapshot_ticks = node->get_parameter("graph_full_snapshot_ticks")
+                            .get_parameter_value()
+                            .get<int>();
+  tick_counter = 0;
+  snapshot_requested = true;
+  plane_pairs_revision = std::numeric_limits<uint64_t>::max();
+}
 
 GraphPublisher::~GraphPublisher() {}
+
 reasoning_msgs::msg::Graph GraphPublisher::publish_graph(
     const g2o::SparseOptimizer* local_graph,
     std::string graph_type,
@@ -378,6 +388,175 @@ reasoning_msgs::msg::Graph GraphPublisher::publish_graph(
   return graph_msg;
 }
 
+bool GraphPublisher::publish_graph_update(
+    const std::shared_ptr<s_graphs::GraphSLAM>& covisibility_graph,
+    const std::string& graph_type,
+    const std::vector<s_graphs::VerticalPlanes>& x_vert_planes_prior,
+    const std::vector<s_graphs::VerticalPlanes>& y_vert_planes_prior,
+    const std::vector<s_graphs::Rooms>& rooms_vec_prior,
+    const std::vector<s_graphs::VerticalPlanes>& x_vert_planes,
+    const std::vector<s_graphs::VerticalPlanes>& y_vert_planes,
+    const std::vector<s_graphs::Rooms>& rooms_vec,
+    reasoning_msgs::msg::Graph& graph_msg) {
+  bool full_snapshot =
+      snapshot_requested.exchange(false) ||
+      (full_snapshot_ticks > 0 && tick_counter % full_snapshot_ticks == 0);
+  tick_counter++;
+
+  graph_msg.nodes.clear();
+  graph_msg.edges.clear();
+  std::unordered_map<int, uint64_t> current_nodes;
+  current_nodes.reserve(published_nodes.size());
+  std::set<std::pair<int, int>> current_edges;
+
+  // a node is only built when it is new, its vertex moved or a snapshot is due
+  auto stage_node = [&](const int id,
+                        const uint64_t revision,
+                        const auto& make_node) {
+    if (!current_nodes.emplace(id, revision).second) return;
+    auto published = published_nodes.find(id);
+    if (full_snapshot || published == published_nodes.end() ||
+        published->second != revision) {
+      graph_msg.nodes.push_back(make_node());
+    }
+  };
+  auto stage_room = [&](const s_graphs::Rooms& room,
+                        const uint64_t revision,
+                        const std::string& edge_name) {
+    stage_node(room.id, revision, [&]() { return make_room_node(room); });
+    const int origin = room.node->id();
+    for (const int target :
+         {room.plane_x1_id, room.plane_x2_id, room.plane_y1_id, room.plane_y2_id}) {
+      auto key = std::make_pair(origin, target);
+      if (!current_edges.insert(key).second) continue;
+      if (full_snapshot || published_edges.count(key) == 0) {
+        graph_msg.edges.push_back(make_edge(origin, target, edge_name));
+      }
+    }
+  };
+
+  if (graph_type == "Prior") {
+    // prior entities never move, they are only sent when new or in a snapshot
+    for (const auto& plane : x_vert_planes_prior) {
+      stage_node(plane.id, 0, [&]() {
+        return make_plane_node(plane.id, plane.plane.coeffs());
+      });
+    }
+    for (const auto& plane : y_vert_planes_prior) {
+      stage_node(plane.id, 0, [&]() {
+        return make_plane_node(plane.id, plane.plane.coeffs());
+      });
+    }
+    for (const auto& room : rooms_vec_prior) {
+      stage_room(room, 0, "Geometric_info");
+    }
+  } else {
+    // the payload is read from the graph so that it matches the staged revision
+    auto stage_graph_plane = [&](const int id) {
+      auto v_plane =
+          dynamic_cast<g2o::VertexPlane*>(covisibility_graph->graph->vertex(id));
+      if (!v_plane) return;
+      stage_node(id, covisibility_graph->get_vertex_revision(id), [&]() {
+        return make_plane_node(id, v_plane->estimate().coeffs());
+      });
+    };
+
+    for (const auto& plane : x_vert_planes) {
+      stage_graph_plane(plane.id);
+    }
+    for (const auto& plane : y_vert_planes) {
+      stage_graph_plane(plane.id);
+    }
+    for (const auto& room : rooms_vec) {
+      stage_room(room,
+                 covisibility_graph->get_vertex_revision(room.node->id()),
+                 "EdgeRoom4Planes");
+    }
+
+    update_plane_pair_ids(covisibility_graph);
+    for (const int id : plane_pair_ids) {
+      stage_graph_plane(id);
+    }
+  }
+
+  // a snapshot replaces the whole graph on the receiver, diffs list removals
+  if (!full_snapshot) {
+    for (const auto& published : published_nodes) {
+      if (current_nodes.count(published.first)) continue;
+      reasoning_msgs::msg::Node graph_node;
+      graph_node.id = published.first;
+      graph_node.type = "Removed";
+      graph_msg.nodes.push_back(graph_node);
+    }
+    for (const auto& published : published_edges) {
+      if (current_edges.count(published)) continue;
+      graph_msg.edges.push_back(
+          make_edge(published.first, published.second, "Removed"));
+    }
+  }
+
+  published_nodes.swap(current_nodes);
+  published_edges.swap(current_edges);
+  return full_snapshot;
+}
+
+void GraphPublisher::request_full_snapshot() { snapshot_requested = true; }
+
+reasoning_msgs::msg::Node GraphPublisher::make_plane_node(
+    const int id,
+    const Eigen::Vector4d& coeffs) const {
+  reasoning_msgs::msg::Node graph_node;
+  reasoning_msgs::msg::Attribute node_attribute;
+  graph_node.id = id;
+  graph_node.type = "Plane";
+  node_attribute.name = "Geometric_info";
+  node_attribute.fl_value.assign(coeffs.data(), coeffs.data() + 4);
+  graph_node.attributes.push_back(node_attribute);
+  return graph_node;
+}
+
+reasoning_msgs::msg::Node GraphPublisher::make_room_node(
+    const s_graphs::Rooms& room) const {
+  reasoning_msgs::msg::Node graph_node;
+  reasoning_msgs::msg::Attribute node_attribute;
+  graph_node.id = room.id;
+  graph_node.type = "Finite Room";
+  node_attribute.name = "Geometric_info";
+  Eigen::Vector2d room_pose = room.node->estimate().translation().head(2);
+  node_attribute.fl_value = {room_pose.x(), room_pose.y(), 0.0};
+  graph_node.attributes.push_back(node_attribute);
+  return graph_node;
+}
+
+reasoning_msgs::msg::Edge GraphPublisher::make_edge(
+    const int origin_node,
+    const int target_node,
+    const std::string& attribute_name) const {
+  reasoning_msgs::msg::Edge graph_edge;
+  reasoning_msgs::msg::Attribute edge_attribute;
+  graph_edge.origin_node = origin_node;
+  graph_edge.target_node = target_node;
+  edge_attribute.name = attribute_name;
+  graph_edge.attributes.push_back(edge_attribute);
+  return graph_edge;
+}
+
+void GraphPublisher::update_plane_pair_ids(
+    const std::shared_ptr<s_graphs::GraphSLAM>& graph) {
+  if (plane_pairs_revision == graph->get_structure_revision()) return;
+  plane_pairs_revision = graph->get_structure_revision();
+
+  plane_pair_ids.clear();
+  std::unordered_set<int> seen_ids;
+  for (const auto edge : graph->graph->edges()) {
+    g2o::Edge2Planes* edge_2p = dynamic_cast<g2o::Edge2Planes*>(edge);
+    if (!edge_2p) continue;
+    for (const auto vertex : edge_2p->vertices()) {
+      if (seen_ids.insert(vertex->id()).second) plane_pair_ids.push_back(vertex->id());
+    }
+  }
+}
+
 reasoning_msgs::msg::GraphKeyframes GraphPublisher::publish_graph_keyframes(
     const g2o::SparseOptimizer* local_graph,
     const std::vector<s_graphs::KeyFrame::Ptr>& keyframes) {
@@ -42,6 +42,14 @@ GraphVisualizer::GraphVisualizer(const rclcpp::Node::SharedPtr node) {
   color_r = node->get_parameter("color_r").get_parameter_value().get<double>();
   color_g = node->get_parameter("color_g").get_parameter_value().get<double>();
   color_b = node->get_parameter("color_b").get_parameter_value().get<double>();
+  double marker_delta_threshold = node->get_parameter("marker_delta_threshold")
+                                      .get_parameter_value()
+                                      .get<double>();
+  int marker_full_refresh_ticks =
+      node->get_parameter("marker_full_refresh_ticks").get_parameter_value().get<int>();
+  marker_cache =
+      std::make_unique<MarkerCache>(marker_delta_threshold, marker_full_refresh_ticks);
+  plane_lod = std::make_unique<PlaneLOD>(node);
 
   keyframes_layer_id = "keyframes_layer";
   walls_layer_id = "walls_layer";
@@ -120,18 +128,14 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
     const std::vector<VerticalPlanes>& x_plane_snapshot,
     const std::vector<VerticalPlanes>& y_plane_snapshot,
     const std::vector<HorizontalPlanes>& hort_plane_snapshot,
-    std::vector<InfiniteRooms> x_infinite_room_snapshot,
-    std::vector<InfiniteRooms> y_infinite_room_snapshot,
-    std::vector<Rooms> room_snapshot,
+    const std::vector<InfiniteRooms>& x_infinite_room_snapshot,
+    const std::vector<InfiniteRooms>& y_infinite_room_snapshot,
+    const std::vector<Rooms>& room_snapshot,
     double loop_detector_radius,
-    std::vector<KeyFrame::Ptr> keyframes,
-    std::vector<Floors> floors_vec) {
-  visualization_msgs::msg::MarkerArray markers;
-  // markers.markers.resize(11);
-
+    const std::vector<KeyFrame::Ptr>& keyframes,
+    const std::vector<Floors>& floors_vec) {
   // node markers
   double wall_vertex_h = 18;
-  rclcpp::Duration duration_planes = rclcpp::Duration::from_seconds(5);
 
   std::string keyframes_layer_id = "keyframes_layer";
   std::string walls_layer_id = "walls_layer";
@@ -147,11 +151,42 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
     floors_layer_id = ns_prefix + "/" + floors_layer_id;
   }
 
+  // id indexed lookup tables, built once per tick
+  std::unordered_map<int, const VerticalPlanes*> x_plane_table, y_plane_table;
+  x_plane_table.reserve(x_plane_snapshot.size());
+  for (const auto& x_plane : x_plane_snapshot) x_plane_table[x_plane.id] = &x_plane;
+  y_plane_table.reserve(y_plane_snapshot.size());
+  for (const auto& y_plane : y_plane_snapshot) y_plane_table[y_plane.id] = &y_plane;
+
+  // level of detail geometry of the planes, also provides their centroids
+  Eigen::Vector3d viewpoint = Eigen::Vector3d::Zero();
+  if (!keyframes.empty()) viewpoint = keyframes.back()->node->estimate().translation();
+
+  std::vector<std::pair<int, const Planes*>> planes;
+  planes.reserve(x_plane_snapshot.size() + y_plane_snapshot.size() +
+                 hort_plane_snapshot.size());
+  for (const auto& x_plane : x_plane_snapshot) {
+    planes.emplace_back(PlaneUtils::plane_class::X_VERT_PLANE, &x_plane);
+  }
+  for (const auto& y_plane : y_plane_snapshot) {
+    planes.emplace_back(PlaneUtils::plane_class::Y_VERT_PLANE, &y_plane);
+  }
+  for (const auto& hort_plane : hort_plane_snapshot) {
+    planes.emplace_back(PlaneUtils::plane_class::HORT_PLANE, &hort_plane);
+  }
+
+  std::vector<const PlaneGeometryLOD*> plane_geometries;
+  plane_geometries.reserve(planes.size());
+  for (const auto& plane : planes) {
+    plane_geometries.push_back(&plane_lod->update(plane.first, *plane.second));
+  }
+  plane_lod->remove_unused();
+
   visualization_msgs::msg::Marker traj_marker;
   traj_marker.header.frame_id = keyframes_layer_id;
   traj_marker.header.stamp = stamp;
   traj_marker.ns = "nodes";
-  traj_marker.id = markers.markers.size();
+  traj_marker.id = 0;
   traj_marker.type = visualization_msgs::msg::Marker::SPHERE_LIST;
 
   traj_marker.pose.orientation.w = 1.0;
@@ -160,7 +195,7 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
   visualization_msgs::msg::Marker imu_marker;
   imu_marker.header = traj_marker.header;
   imu_marker.ns = "imu";
-  imu_marker.id = markers.markers.size() + 1;
+  imu_marker.id = 1;
   imu_marker.type = visualization_msgs::msg::Marker::SPHERE_LIST;
 
   imu_marker.pose.orientation.w = 1.0;
@@ -219,15 +254,15 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
       imu_marker.colors.push_back(color);
     }
   }
-  markers.markers.push_back(traj_marker);
-  markers.markers.push_back(imu_marker);
+  marker_cache->submit(traj_marker);
+  marker_cache->submit(imu_marker);
 
   // keyframe edge markers
   visualization_msgs::msg::Marker traj_edge_marker;
   traj_edge_marker.header.frame_id = keyframes_layer_id;
   traj_edge_marker.header.stamp = stamp;
   traj_edge_marker.ns = "keyframe_keyframe_edges";
-  traj_edge_marker.id = markers.markers.size();
+  traj_edge_marker.id = 0;
   traj_edge_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
   traj_edge_marker.pose.orientation.w = 1.0;
   traj_edge_marker.scale.x = 0.02;
@@ -269,15 +304,14 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
       traj_edge_marker.colors.push_back(color2);
     }
   }
-  markers.markers.push_back(traj_edge_marker);
+  marker_cache->submit(traj_edge_marker);
 
   // keyframe plane edge markers
   visualization_msgs::msg::Marker traj_plane_edge_marker;
   traj_plane_edge_marker.header.frame_id = keyframes_layer_id;
   traj_plane_edge_marker.header.stamp = stamp;
   traj_plane_edge_marker.ns = "keyframe_plane_edges";
-  traj_plane_edge_marker.id = markers.markers.size();
-  traj_plane_edge_marker.lifetime = duration_planes;
+  traj_plane_edge_marker.id = 0;
   traj_plane_edge_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
   traj_plane_edge_marker.pose.orientation.w = 1.0;
   traj_plane_edge_marker.scale.x = 0.01;
@@ -297,24 +331,23 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
       Eigen::Vector3d pt1 = v1->estimate().translation();
       Eigen::Vector3d pt2;
 
-      float r = 0, g = 0, b = 0.0;
-      pcl::CentroidPoint<PointNormal> centroid;
+      int plane_type;
       if (fabs(v2->estimate().normal()(0)) > fabs(v2->estimate().normal()(1)) &&
           fabs(v2->estimate().normal()(0)) > fabs(v2->estimate().normal()(2))) {
-        pt2 = compute_vert_plane_centroid(v2->id(), x_plane_snapshot);
-        r = 0.0;
+        plane_type = PlaneUtils::plane_class::X_VERT_PLANE;
       } else if (fabs(v2->estimate().normal()(1)) > fabs(v2->estimate().normal()(0)) &&
                  fabs(v2->estimate().normal()(1)) > fabs(v2->estimate().normal()(2))) {
-        pt2 = compute_vert_plane_centroid(v2->id(), y_plane_snapshot);
-        b = 0.0;
+        plane_type = PlaneUtils::plane_class::Y_VERT_PLANE;
       } else if (fabs(v2->estimate().normal()(2)) > fabs(v2->estimate().normal()(0)) &&
                  fabs(v2->estimate().normal()(2)) > fabs(v2->estimate().normal()(1))) {
-        pt2 = compute_hort_plane_centroid(v2->id(), hort_plane_snapshot);
-        r = 0;
-        g = 0.0;
+        plane_type = PlaneUtils::plane_class::HORT_PLANE;
       } else
         continue;
 
+      const PlaneGeometryLOD* plane_geometry = plane_lod->find(plane_type, v2->id());
+      if (!plane_geometry || plane_geometry->source_size == 0) continue;
+      pt2 = plane_geometry->centroid();
+
       geometry_msgs::msg::Point point1, point2;
       geometry_msgs::msg::PointStamped point2_stamped, point2_stamped_transformed;
       point1.x = pt1.x();
@@ -349,7 +382,7 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
       traj_plane_edge_marker.colors.push_back(color2);
     }
   }
-  markers.markers.push_back(traj_plane_edge_marker);
+  marker_cache->submit(traj_plane_edge_marker);
 
   // Wall edge markers
   visualization_msgs::msg::Marker wall_center_marker;
@@ -367,7 +400,7 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
       wall_center_marker.ns = "wall_center_marker";
       wall_center_marker.header.frame_id = map_frame_id;
       wall_center_marker.header.stamp = stamp;
-      wall_center_marker.id = markers.markers.size() + 1;
+      wall_center_marker.id = v1->id();
       wall_center_marker.type = visualization_msgs::msg::Marker::SPHERE;
       wall_center_marker.color.r = color_r;
       wall_center_marker.color.g = color_g;
@@ -383,7 +416,7 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
       wall_center_marker.pose.orientation.y = 0.0;
       wall_center_marker.pose.orientation.z = 0.0;
       wall_center_marker.pose.orientation.w = 1.0;
-      markers.markers.push_back(wall_center_marker);
+      marker_cache->submit(wall_center_marker);
     }
   }
 
@@ -392,7 +425,7 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
   sphere_marker.header.frame_id = keyframes_layer_id;
   sphere_marker.header.stamp = stamp;
   sphere_marker.ns = "loop_close_radius";
-  sphere_marker.id = markers.markers.size();
+  sphere_marker.id = 0;
   sphere_marker.type = visualization_msgs::msg::Marker::SPHERE;
 
   if (!keyframes.empty()) {
@@ -407,325 +440,209 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
 
   sphere_marker.color.r = 1.0;
   sphere_marker.color.a = 0.3;
-  markers.markers.push_back(sphere_marker);
-
-  // x vertical plane markers
-  visualization_msgs::msg::Marker x_vert_plane_marker;
-  x_vert_plane_marker.pose.orientation.w = 1.0;
-  x_vert_plane_marker.scale.x = 0.05;
-  x_vert_plane_marker.scale.y = 0.05;
-  x_vert_plane_marker.scale.z = 0.05;
-  // plane_marker.points.resize(vert_planes.size());
-  x_vert_plane_marker.header.frame_id = walls_layer_id;
-  x_vert_plane_marker.header.stamp = stamp;
-  x_vert_plane_marker.ns = "x_vert_planes";
-  x_vert_plane_marker.id = markers.markers.size();
-  x_vert_plane_marker.lifetime = duration_planes;
-  x_vert_plane_marker.type = visualization_msgs::msg::Marker::CUBE_LIST;
-
-  for (int i = 0; i < x_plane_snapshot.size(); ++i) {
-    double p = static_cast<double>(i) / x_plane_snapshot.size();
-    std_msgs::msg::ColorRGBA color;
-    color.r = x_plane_snapshot[i].color[0] / 255;
-    color.g = x_plane_snapshot[i].color[1] / 255;
-    color.b = x_plane_snapshot[i].color[2] / 255;
-    color.a = 0.5;
-    for (size_t j = 0; j < x_plane_snapshot[i].cloud_seg_map->size(); ++j) {
-      geometry_msgs::msg::Point point;
-      point.x = x_plane_snapshot[i].cloud_seg_map->points[j].x;
-      point.y = x_plane_snapshot[i].cloud_seg_map->points[j].y;
-      point.z = x_plane_snapshot[i].cloud_seg_map->points[j].z;
-      x_vert_plane_marker.points.push_back(point);
-      x_vert_plane_marker.colors.push_back(color);
-    }
-  }
-  markers.markers.push_back(x_vert_plane_marker);
-
-  // y vertical plane markers
-  visualization_msgs::msg::Marker y_vert_plane_marker;
-  y_vert_plane_marker.pose.orientation.w = 1.0;
-  y_vert_plane_marker.scale.x = 0.05;
-  y_vert_plane_marker.scale.y = 0.05;
-  y_vert_plane_marker.scale.z = 0.05;
-  // plane_marker.points.resize(vert_planes.size());
-  y_vert_plane_marker.header.frame_id = walls_layer_id;
-  y_vert_plane_marker.header.stamp = stamp;
-  y_vert_plane_marker.ns = "y_vert_planes";
-  y_vert_plane_marker.id = markers.markers.size();
-  y_vert_plane_marker.lifetime = duration_planes;
-  y_vert_plane_marker.type = visualization_msgs::msg::Marker::CUBE_LIST;
-
-  for (int i = 0; i < y_plane_snapshot.size(); ++i) {
-    double p = static_cast<double>(i) / y_plane_snapshot.size();
-    std_msgs::msg::ColorRGBA color;
-    color.r = y_plane_snapshot[i].color[0] / 255;
-    color.g = y_plane_snapshot[i].color[1] / 255;
-    color.b = y_plane_snapshot[i].color[2] / 255;
-    color.a = 0.5;
-    for (size_t j = 0; j < y_plane_snapshot[i].cloud_seg_map->size(); ++j) {
-      geometry_msgs::msg::Point point;
-      point.x = y_plane_snapshot[i].cloud_seg_map->points[j].x;
-      point.y = y_plane_snapshot[i].cloud_seg_map->points[j].y;
-      point.z = y_plane_snapshot[i].cloud_seg_map->points[j].z;
-      y_vert_plane_marker.points.push_back(point);
-      y_vert_plane_marker.colors.push_back(color);
-    }
-  }
-  markers.markers.push_back(y_vert_plane_marker);
-
-  // horizontal plane markers
-  visualization_msgs::msg::Marker hort_plane_marker;
-  hort_plane_marker.pose.orientation.w = 1.0;
-  hort_plane_marker.scale.x = 0.05;
-  hort_plane_marker.scale.y = 0.05;
-  hort_plane_marker.scale.z = 0.05;
-  // plane_marker.points.resize(vert_planes.size());
-  hort_plane_marker.header.frame_id = walls_layer_id;
-  hort_plane_marker.header.stamp = stamp;
-  hort_plane_marker.ns = "hort_planes";
-  hort_plane_marker.id = markers.markers.size();
-  hort_plane_marker.lifetime = duration_planes;
-  hort_plane_marker.type = visualization_msgs::msg::Marker::CUBE_LIST;
-
-  for (int i = 0; i < hort_plane_snapshot.size(); ++i) {
-    for (size_t j = 0; j < hort_plane_snapshot[i].cloud_seg_map->size(); ++j) {
-      geometry_msgs::msg::Point point;
-      point.x = hort_plane_snapshot[i].cloud_seg_map->points[j].x;
-      point.y = hort_plane_snapshot[i].cloud_seg_map->points[j].y;
-      point.z = hort_plane_snapshot[i].cloud_seg_map->points[j].z;
-      hort_plane_marker.points.push_back(point);
+  marker_cache->submit(sphere_marker);
+
+  // plane markers, one per plane so that only the grown or moved ones are resent.
+  // Each plane is drawn at the level of detail chosen from its distance to the robot
+  std::vector<int> plane_levels = plane_lod->select_levels(plane_geometries, viewpoint);
+  for (size_t i = 0; i < planes.size(); ++i) {
+    const Planes& plane = *planes[i].second;
+    std::string plane_ns = "hort_planes";
+    if (planes[i].first == PlaneUtils::plane_class::X_VERT_PLANE)
+      plane_ns = "x_vert_planes";
+    else if (planes[i].first == PlaneUtils::plane_class::Y_VERT_PLANE)
+      plane_ns = "y_vert_planes";
+
+    Eigen::VectorXd state = compute_plane_state(plane);
+    state.conservativeResize(state.size() + 1);
+    state(state.size() - 1) = plane_levels[i];
+    if (!marker_cache->is_dirty(plane_ns, plane.id, state)) continue;
+
+    visualization_msgs::msg::Marker plane_marker =
+        create_plane_marker(*plane_geometries[i], plane_levels[i]);
+    plane_marker.header.frame_id = walls_layer_id;
+    plane_marker.header.stamp = stamp;
+    plane_marker.ns = plane_ns;
+    plane_marker.id = plane.id;
+    if (planes[i].first == PlaneUtils::plane_class::HORT_PLANE) {
+      plane_marker.color.r = 1;
+      plane_marker.color.g = 0.65;
+    } else {
+      plane_marker.color.r = plane.color[0] / 255;
+      plane_marker.color.g = plane.color[1] / 255;
+      plane_marker.color.b = plane.color[2] / 255;
     }
-    hort_plane_marker.color.r = 1;
-    hort_plane_marker.color.g = 0.65;
-    hort_plane_marker.color.a = 0.5;
+    plane_marker.color.a = 0.5;
+    marker_cache->update(plane_marker, state);
   }
-  markers.markers.push_back(hort_plane_marker);
 
-  rclcpp::Duration duration_room = rclcpp::Duration::from_seconds(5);
-  for (auto& single_x_infinite_room : x_infinite_room_snapshot) {
-    single_x_infinite_room.sub_infinite_room = false;
+  // room lookup tables: plane ids used by the rooms and a grid over their positions,
+  // so that the overlap checks below do not scan all the rooms
+  std::set<std::pair<int, int>> room_x_plane_pairs;
+  std::unordered_set<int> room_y_plane_ids;
+  GridIndex2D room_grid(2.0);
+  for (size_t i = 0; i < room_snapshot.size(); ++i) {
+    room_x_plane_pairs.insert(
+        std::minmax(room_snapshot[i].plane_x1_id, room_snapshot[i].plane_x2_id));
+    room_y_plane_ids.insert(room_snapshot[i].plane_y1_id);
+    room_y_plane_ids.insert(room_snapshot[i].plane_y2_id);
+    room_grid.insert(i, room_snapshot[i].node->estimate().translation().head<2>());
   }
 
-  for (int i = 0; i < x_infinite_room_snapshot.size(); ++i) {
-    if (x_infinite_room_snapshot[i].sub_infinite_room) continue;
-
-    bool overlapped_infinite_room = false;
-    float dist_room_x_corr = 100;
-    for (const auto& room : room_snapshot) {
-      if ((room.plane_x1_id == x_infinite_room_snapshot[i].plane1_id ||
-           room.plane_x1_id == x_infinite_room_snapshot[i].plane2_id) &&
-          (room.plane_x2_id == x_infinite_room_snapshot[i].plane1_id ||
-           room.plane_x2_id == x_infinite_room_snapshot[i].plane2_id)) {
-        overlapped_infinite_room = true;
-        break;
-      }
-      dist_room_x_corr =
-          sqrt(pow(room.node->estimate().translation()(0) -
-                       x_infinite_room_snapshot[i].node->estimate().translation()(0),
-                   2) +
-               pow(room.node->estimate().translation()(1) -
-                       x_infinite_room_snapshot[i].node->estimate().translation()(1),
-                   2));
-      if (dist_room_x_corr < 1.0) {
-        overlapped_infinite_room = true;
-        break;
-      }
-    }
+  std::vector<bool> x_infinite_room_drawn(x_infinite_room_snapshot.size(), false);
+  std::vector<bool> x_infinite_room_sub(x_infinite_room_snapshot.size(), false);
+  GridIndex2D x_infinite_room_grid(2.0);
+  for (size_t i = 0; i < x_infinite_room_snapshot.size(); ++i) {
+    x_infinite_room_grid.insert(
+        i, x_infinite_room_snapshot[i].node->estimate().translation().head<2>());
+  }
 
-    float dist_x_corr = 100;
-    for (auto& current_x_infinite_room : x_infinite_room_snapshot) {
-      if (current_x_infinite_room.id == x_infinite_room_snapshot[i].id) continue;
-
-      dist_x_corr =
-          sqrt(pow(current_x_infinite_room.node->estimate().translation()(0) -
-                       x_infinite_room_snapshot[i].node->estimate().translation()(0),
-                   2) +
-               pow(current_x_infinite_room.node->estimate().translation()(1) -
-                       x_infinite_room_snapshot[i].node->estimate().translation()(1),
-                   2));
-      if (dist_x_corr < 2.0) {
-        current_x_infinite_room.sub_infinite_room = true;
-        break;
-      }
+  for (size_t i = 0; i < x_infinite_room_snapshot.size(); ++i) {
+    if (x_infinite_room_sub[i]) continue;
+    const auto& x_infinite_room = x_infinite_room_snapshot[i];
+    Eigen::Vector2d position = x_infinite_room.node->estimate().translation().head<2>();
+
+    // an infinite room is overlapped if a room is bounded by its planes or is too close
+    int plane1_id = x_infinite_room.plane1_id;
+    int plane2_id = x_infinite_room.plane2_id;
+    bool overlapped_infinite_room =
+        room_x_plane_pairs.count(std::minmax(plane1_id, plane2_id)) ||
+        room_x_plane_pairs.count(std::make_pair(plane1_id, plane1_id)) ||
+        room_x_plane_pairs.count(std::make_pair(plane2_id, plane2_id)) ||
+        !room_grid.query(position, 1.0).empty();
+
+    for (const auto& j : x_infinite_room_grid.query(position, 2.0)) {
+      if (x_infinite_room_snapshot[j].id == x_infinite_room.id) continue;
+      x_infinite_room_sub[j] = true;
+      break;
     }
 
-    auto found_plane1 = std::find_if(
-        x_plane_snapshot.begin(),
-        x_plane_snapshot.end(),
-        boost::bind(&VerticalPlanes::id, _1) == x_infinite_room_snapshot[i].plane1_id);
-    auto found_plane2 = std::find_if(
-        x_plane_snapshot.begin(),
-        x_plane_snapshot.end(),
-        boost::bind(&VerticalPlanes::id, _1) == x_infinite_room_snapshot[i].plane2_id);
+    // overlapped infinite rooms are not drawn, their retained markers get deleted
+    if (overlapped_infinite_room) continue;
+    x_infinite_room_drawn[i] = true;
 
     // fill in the line marker
     visualization_msgs::msg::Marker x_infinite_room_line_marker;
     x_infinite_room_line_marker.scale.x = 0.02;
     x_infinite_room_line_marker.pose.orientation.w = 1.0;
-    if (!overlapped_infinite_room) {
-      x_infinite_room_line_marker.ns = "infinite_room_x_lines";
-      x_infinite_room_line_marker.header.frame_id = rooms_layer_id;
-      x_infinite_room_line_marker.header.stamp = stamp;
-      x_infinite_room_line_marker.id = markers.markers.size() + 1;
-      x_infinite_room_line_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
-      x_infinite_room_line_marker.color.r = color_r;
-      x_infinite_room_line_marker.color.g = color_g;
-      x_infinite_room_line_marker.color.b = color_b;
-      x_infinite_room_line_marker.color.a = 1.0;
-      x_infinite_room_line_marker.lifetime = duration_room;
-    } else {
-      x_infinite_room_snapshot[i].id = -1;
-      x_infinite_room_line_marker.ns = "overlapped_infinite_room_x_lines";
-    }
-
-    geometry_msgs::msg::Point p1, p2, p3;
-    p1.x = x_infinite_room_snapshot[i].node->estimate().translation()(0);
-    p1.y = x_infinite_room_snapshot[i].node->estimate().translation()(1);
+    x_infinite_room_line_marker.ns = "infinite_room_x_lines";
+    x_infinite_room_line_marker.header.frame_id = rooms_layer_id;
+    x_infinite_room_line_marker.header.stamp = stamp;
+    x_infinite_room_line_marker.id = x_infinite_room.id;
+    x_infinite_room_line_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
+    x_infinite_room_line_marker.color.r = color_r;
+    x_infinite_room_line_marker.color.g = color_g;
+    x_infinite_room_line_marker.color.b = color_b;
+    x_infinite_room_line_marker.color.a = 1.0;
+
+    geometry_msgs::msg::Point p1;
+    p1.x = position.x();
+    p1.y = position.y();
     p1.z = 0;
 
-    p2 = compute_plane_point(p1, (*found_plane1).cloud_seg_map);
-
-    x_infinite_room_line_marker.points.push_back(p1);
-    x_infinite_room_line_marker.points.push_back(p2);
-
-    p3 = compute_plane_point(p1, (*found_plane2).cloud_seg_map);
-
-    x_infinite_room_line_marker.points.push_back(p1);
-    x_infinite_room_line_marker.points.push_back(p3);
-    markers.markers.push_back(x_infinite_room_line_marker);
+    for (const auto& plane_id : {plane1_id, plane2_id}) {
+      auto found_plane = x_plane_table.find(plane_id);
+      if (found_plane == x_plane_table.end()) continue;
+      x_infinite_room_line_marker.points.push_back(p1);
+      x_infinite_room_line_marker.points.push_back(
+          compute_plane_point(p1, found_plane->second->cloud_seg_map));
+    }
+    marker_cache->submit(x_infinite_room_line_marker);
 
     // x infinite_room cube
     visualization_msgs::msg::Marker infinite_room_pose_marker;
     infinite_room_pose_marker.scale.x = 0.5;
     infinite_room_pose_marker.scale.y = 0.5;
     infinite_room_pose_marker.scale.z = 0.5;
-    // plane_marker.points.resize(vert_planes.size());
     infinite_room_pose_marker.header.frame_id = rooms_layer_id;
     infinite_room_pose_marker.header.stamp = stamp;
-    if (!overlapped_infinite_room) {
-      infinite_room_pose_marker.ns = "x_infinite_room";
-      infinite_room_pose_marker.id = markers.markers.size();
-      infinite_room_pose_marker.type = visualization_msgs::msg::Marker::CUBE;
-      infinite_room_pose_marker.color.r = 1;
-      infinite_room_pose_marker.color.g = 0.64;
-      infinite_room_pose_marker.color.a = 1;
-      infinite_room_pose_marker.pose.position.x =
-          x_infinite_room_snapshot[i].node->estimate().translation()(0);
-      infinite_room_pose_marker.pose.position.y =
-          x_infinite_room_snapshot[i].node->estimate().translation()(1);
-      infinite_room_pose_marker.pose.position.z =
-          x_infinite_room_snapshot[i].node->estimate().translation()(2);
-      Eigen::Quaterniond quat(x_infinite_room_snapshot[i].node->estimate().linear());
-      infinite_room_pose_marker.pose.orientation.x = quat.x();
-      infinite_room_pose_marker.pose.orientation.y = quat.y();
-      infinite_room_pose_marker.pose.orientation.z = quat.z();
-      infinite_room_pose_marker.pose.orientation.w = quat.w();
-
-      infinite_room_pose_marker.lifetime = duration_room;
-      markers.markers.push_back(infinite_room_pose_marker);
-      /* room clusters */
-      int cluster_id = 0;
-      for (auto& cluster : x_infinite_room_snapshot[i].cluster_array.markers) {
-        cluster.header.frame_id = walls_layer_id;
-        if (cluster_id == 0) cluster.ns = "x_infinite_vertex";
-        if (cluster_id == 1) cluster.ns = "x_infinite_vertex_edges";
-        cluster.id = markers.markers.size() + 1;
-        markers.markers.push_back(cluster);
-      }
-    } else
-      infinite_room_pose_marker.ns = "overlapped_x_infinite_room";
+    infinite_room_pose_marker.ns = "x_infinite_room";
+    infinite_room_pose_marker.id = x_infinite_room.id;
+    infinite_room_pose_marker.type = visualization_msgs::msg::Marker::CUBE;
+    infinite_room_pose_marker.color.r = 1;
+    infinite_room_pose_marker.color.g = 0.64;
+    infinite_room_pose_marker.color.a = 1;
+    infinite_room_pose_marker.pose.position.x =
+        x_infinite_room.node->estimate().translation()(0);
+    infinite_room_pose_marker.pose.position.y =
+        x_infinite_room.node->estimate().translation()(1);
+    infinite_room_pose_marker.pose.position.z =
+        x_infinite_room.node->estimate().translation()(2);
+    Eigen::Quaterniond quat(x_infinite_room.node->estimate().linear());
+    infinite_room_pose_marker.pose.orientation.x = quat.x();
+    infinite_room_pose_marker.pose.orientation.y = quat.y();
+    infinite_room_pose_marker.pose.orientation.z = quat.z();
+    infinite_room_pose_marker.pose.orientation.w = quat.w();
+    marker_cache->submit(infinite_room_pose_marker);
+
+    /* room clusters, only drawn for the rooms close to the robot */
+    if ((x_infinite_room.node->estimate().translation() - viewpoint).norm() <
+        plane_lod->get_near_distance()) {
+      submit_cluster_markers(x_infinite_room.cluster_array,
+                             x_infinite_room.id,
+                             walls_layer_id,
+                             "x_infinite_vertex",
+                             "x_infinite_vertex_edges");
+    }
   }
 
-  for (auto& single_y_infinite_room : y_infinite_room_snapshot) {
-    single_y_infinite_room.sub_infinite_room = false;
+  std::vector<bool> y_infinite_room_drawn(y_infinite_room_snapshot.size(), false);
+  std::vector<bool> y_infinite_room_sub(y_infinite_room_snapshot.size(), false);
+  GridIndex2D y_infinite_room_grid(2.0);
+  for (size_t i = 0; i < y_infinite_room_snapshot.size(); ++i) {
+    y_infinite_room_grid.insert(
+        i, y_infinite_room_snapshot[i].node->estimate().translation().head<2>());
   }
 
-  for (int i = 0; i < y_infinite_room_snapshot.size(); ++i) {
-    if (y_infinite_room_snapshot[i].sub_infinite_room) continue;
-
-    bool overlapped_infinite_room = false;
-    float dist_room_y_corr = 100;
-    for (const auto& room : room_snapshot) {
-      if ((room.plane_y1_id == y_infinite_room_snapshot[i].plane1_id ||
-           room.plane_y1_id == y_infinite_room_snapshot[i].plane2_id) ||
-          (room.plane_y2_id == y_infinite_room_snapshot[i].plane1_id ||
-           room.plane_y2_id == y_infinite_room_snapshot[i].plane2_id)) {
-        overlapped_infinite_room = true;
-        break;
-      }
-      dist_room_y_corr =
-          sqrt(pow(room.node->estimate().translation()(0) -
-                       y_infinite_room_snapshot[i].node->estimate().translation()(0),
-                   2) +
-               pow(room.node->estimate().translation()(1) -
-                       y_infinite_room_snapshot[i].node->estimate().translation()(1),
-                   2));
-      if (dist_room_y_corr < 1.0) {
-        overlapped_infinite_room = true;
-        break;
-      }
-    }
-
-    float dist_y_corr = 100;
-    for (auto& current_y_infinite_room : y_infinite_room_snapshot) {
-      if (current_y_infinite_room.id == y_infinite_room_snapshot[i].id) continue;
-      dist_y_corr =
-          sqrt(pow(current_y_infinite_room.node->estimate().translation()(0) -
-                       y_infinite_room_snapshot[i].node->estimate().translation()(0),
-                   2) +
-               pow(current_y_infinite_room.node->estimate().translation()(1) -
-                       y_infinite_room_snapshot[i].node->estimate().translation()(1),
-                   2));
-      if (dist_y_corr < 2.0) {
-        current_y_infinite_room.sub_infinite_room = true;
-        break;
-      }
+  for (size_t i = 0; i < y_infinite_room_snapshot.size(); ++i) {
+    if (y_infinite_room_sub[i]) continue;
+    const auto& y_infinite_room = y_infinite_room_snapshot[i];
+    Eigen::Vector2d position = y_infinite_room.node->estimate().translation().head<2>();
+
+    // an infinite room is overlapped if a room uses one of its planes or is too close
+    int plane1_id = y_infinite_room.plane1_id;
+    int plane2_id = y_infinite_room.plane2_id;
+    bool overlapped_infinite_room = room_y_plane_ids.count(plane1_id) ||
+                                    room_y_plane_ids.count(plane2_id) ||
+                                    !room_grid.query(position, 1.0).empty();
+
+    for (const auto& j : y_infinite_room_grid.query(position, 2.0)) {
+      if (y_infinite_room_snapshot[j].id == y_infinite_room.id) continue;
+      y_infinite_room_sub[j] = true;
+      break;
     }
 
-    auto found_plane1 = std::find_if(
-        y_plane_snapshot.begin(),
-        y_plane_snapshot.end(),
-        boost::bind(&VerticalPlanes::id, _1) == y_infinite_room_snapshot[i].plane1_id);
-    auto found_plane2 = std::find_if(
-        y_plane_snapshot.begin(),
-        y_plane_snapshot.end(),
-        boost::bind(&VerticalPlanes::id, _1) == y_infinite_room_snapshot[i].plane2_id);
+    // overlapped infinite rooms are not drawn, their retained markers get deleted
+    if (overlapped_infinite_room) continue;
+    y_infinite_room_drawn[i] = true;
 
     // fill in the line marker
     visualization_msgs::msg::Marker y_infinite_room_line_marker;
     y_infinite_room_line_marker.scale.x = 0.02;
     y_infinite_room_line_marker.pose.orientation.w = 1.0;
-    if (!overlapped_infinite_room) {
-      y_infinite_room_line_marker.ns = "infinite_room_y_lines";
-      y_infinite_room_line_marker.header.frame_id = rooms_layer_id;
-      y_infinite_room_line_marker.header.stamp = stamp;
-      y_infinite_room_line_marker.id = markers.markers.size() + 1;
-      y_infinite_room_line_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
-      y_infinite_room_line_marker.color.r = color_r;
-      y_infinite_room_line_marker.color.g = color_g;
-      y_infinite_room_line_marker.color.b = color_b;
-      y_infinite_room_line_marker.color.a = 1.0;
-      y_infinite_room_line_marker.lifetime = duration_room;
-    } else {
-      y_infinite_room_snapshot[i].id = -1;
-      y_infinite_room_line_marker.ns = "overlapped_infinite_room_y_lines";
-    }
-
-    geometry_msgs::msg::Point p1, p2, p3;
-    p1.x = y_infinite_room_snapshot[i].node->estimate().translation()(0);
-    p1.y = y_infinite_room_snapshot[i].node->estimate().translation()(1);
+    y_infinite_room_line_marker.ns = "infinite_room_y_lines";
+    y_infinite_room_line_marker.header.frame_id = rooms_layer_id;
+    y_infinite_room_line_marker.header.stamp = stamp;
+    y_infinite_room_line_marker.id = y_infinite_room.id;
+    y_infinite_room_line_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
+    y_infinite_room_line_marker.color.r = color_r;
+    y_infinite_room_line_marker.color.g = color_g;
+    y_infinite_room_line_marker.color.b = color_b;
+    y_infinite_room_line_marker.color.a = 1.0;
+
+    geometry_msgs::msg::Point p1;
+    p1.x = position.x();
+    p1.y = position.y();
     p1.z = 0;
 
-    p2 = compute_plane_point(p1, (*found_plane1).cloud_seg_map);
-
-    y_infinite_room_line_marker.points.push_back(p1);
-    y_infinite_room_line_marker.points.push_back(p2);
-
-    p3 = compute_plane_point(p1, (*found_plane2).cloud_seg_map);
-
-    y_infinite_room_line_marker.points.push_back(p1);
-    y_infinite_room_line_marker.points.push_back(p3);
-    markers.markers.push_back(y_infinite_room_line_marker);
+    for (const auto& plane_id : {plane1_id, plane2_id}) {
+      auto found_plane = y_plane_table.find(plane_id);
+      if (found_plane == y_plane_table.end()) continue;
+      y_infinite_room_line_marker.points.push_back(p1);
+      y_infinite_room_line_marker.points.push_back(
+          compute_plane_point(p1, found_plane->second->cloud_seg_map));
+    }
+    marker_cache->submit(y_infinite_room_line_marker);
 
     // y infinite_room cube
     visualization_msgs::msg::Marker infinite_room_pose_marker;
@@ -733,63 +650,49 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
     infinite_room_pose_marker.scale.x = 0.5;
     infinite_room_pose_marker.scale.y = 0.5;
     infinite_room_pose_marker.scale.z = 0.5;
-    // plane_marker.points.resize(vert_planes.size());
     infinite_room_pose_marker.header.frame_id = rooms_layer_id;
     infinite_room_pose_marker.header.stamp = stamp;
-    if (!overlapped_infinite_room) {
-      infinite_room_pose_marker.ns = "y_infinite_room";
-      infinite_room_pose_marker.id = markers.markers.size();
-      infinite_room_pose_marker.type = visualization_msgs::msg::Marker::CUBE;
-      infinite_room_pose_marker.color.r = 0.13;
-      infinite_room_pose_marker.color.g = 0.54;
-      infinite_room_pose_marker.color.b = 0.13;
-      infinite_room_pose_marker.color.a = 1;
-      infinite_room_pose_marker.pose.position.x =
-          y_infinite_room_snapshot[i].node->estimate().translation()(0);
-      infinite_room_pose_marker.pose.position.y =
-          y_infinite_room_snapshot[i].node->estimate().translation()(1);
-      infinite_room_pose_marker.pose.position.z =
-          y_infinite_room_snapshot[i].node->estimate().translation()(2);
-      Eigen::Quaterniond quat(y_infinite_room_snapshot[i].node->estimate().linear());
-      infinite_room_pose_marker.pose.orientation.x = quat.x();
-      infinite_room_pose_marker.pose.orientation.y = quat.y();
-      infinite_room_pose_marker.pose.orientation.z = quat.z();
-      infinite_room_pose_marker.pose.orientation.w = quat.w();
-      infinite_room_pose_marker.lifetime = duration_room;
-      markers.markers.push_back(infinite_room_pose_marker);
-      /* room clusters */
-      int cluster_id = 0;
-      for (auto& cluster : y_infinite_room_snapshot[i].cluster_array.markers) {
-        cluster.header.frame_id = walls_layer_id;
-        if (cluster_id == 0) cluster.ns = "y_infinite_vertex";
-        if (cluster_id == 1) cluster.ns = "y_infinite_vertex_edges";
-        cluster.id = markers.markers.size() + 1;
-        markers.markers.push_back(cluster);
-      }
-    } else
-      infinite_room_pose_marker.ns = "overlapped_y_infinite_room";
+    infinite_room_pose_marker.ns = "y_infinite_room";
+    infinite_room_pose_marker.id = y_infinite_room.id;
+    infinite_room_pose_marker.type = visualization_msgs::msg::Marker::CUBE;
+    infinite_room_pose_marker.color.r = 0.13;
+    infinite_room_pose_marker.color.g = 0.54;
+    infinite_room_pose_marker.color.b = 0.13;
+    infinite_room_pose_marker.color.a = 1;
+    infinite_room_pose_marker.pose.position.x =
+        y_infinite_room.node->estimate().translation()(0);
+    infinite_room_pose_marker.pose.position.y =
+        y_infinite_room.node->estimate().translation()(1);
+    infinite_room_pose_marker.pose.position.z =
+        y_infinite_room.node->estimate().translation()(2);
+    Eigen::Quaterniond quat(y_infinite_room.node->estimate().linear());
+    infinite_room_pose_marker.pose.orientation.x = quat.x();
+    infinite_room_pose_marker.pose.orientation.y = quat.y();
+    infinite_room_pose_marker.pose.orientation.z = quat.z();
+    infinite_room_pose_marker.pose.orientation.w = quat.w();
+    marker_cache->submit(infinite_room_pose_marker);
+
+    /* room clusters, only drawn for the rooms close to the robot */
+    if ((y_infinite_room.node->estimate().translation() - viewpoint).norm() <
+        plane_lod->get_near_distance()) {
+      submit_cluster_markers(y_infinite_room.cluster_array,
+                             y_infinite_room.id,
+                             walls_layer_id,
+                             "y_infinite_vertex",
+                             "y_infinite_vertex_edges");
+    }
   }
 
   // room markers
-  for (int i = 0; i < room_snapshot.size(); ++i) {
-    room_snapshot[i].sub_room = false;
-  }
-
-  for (int i = 0; i < room_snapshot.size(); ++i) {
-    if (room_snapshot[i].sub_room) continue;
-
-    for (auto& room : room_snapshot) {
-      if (room.id == room_snapshot[i].id) continue;
-      float dist_room_room =
-          sqrt(pow(room.node->estimate().translation()(0) -
-                       room_snapshot[i].node->estimate().translation()(0),
-                   2) +
-               pow(room.node->estimate().translation()(1) -
-                       room_snapshot[i].node->estimate().translation()(1),
-                   2));
-      if (dist_room_room < 2.0 && room.sub_room == false) {
-        room.sub_room = true;
-      }
+  std::vector<bool> room_sub(room_snapshot.size(), false);
+  for (size_t i = 0; i < room_snapshot.size(); ++i) {
+    if (room_sub[i]) continue;
+    const auto& room = room_snapshot[i];
+
+    for (const auto& j : room_grid.query(
+             room.node->estimate().translation().head<2>(), 2.0)) {
+      if (room_snapshot[j].id == room.id) continue;
+      room_sub[j] = true;
     }
 
     // fill the pose marker
@@ -797,27 +700,25 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
     room_marker.scale.x = 0.5;
     room_marker.scale.y = 0.5;
     room_marker.scale.z = 0.5;
-    // plane_marker.points.resize(vert_planes.size());
     room_marker.header.frame_id = rooms_layer_id;
     room_marker.header.stamp = stamp;
     room_marker.ns = "rooms";
-    room_marker.id = markers.markers.size();
+    room_marker.id = room.id;
     room_marker.type = visualization_msgs::msg::Marker::CUBE;
     room_marker.color.r = 1;
     room_marker.color.g = 0.07;
     room_marker.color.b = 0.57;
     room_marker.color.a = 1;
 
-    room_marker.pose.position.x = room_snapshot[i].node->estimate().translation()(0);
-    room_marker.pose.position.y = room_snapshot[i].node->estimate().translation()(1);
-    room_marker.pose.position.z = room_snapshot[i].node->estimate().translation()(2);
-    Eigen::Quaterniond quat(room_snapshot[i].node->estimate().linear());
+    room_marker.pose.position.x = room.node->estimate().translation()(0);
+    room_marker.pose.position.y = room.node->estimate().translation()(1);
+    room_marker.pose.position.z = room.node->estimate().translation()(2);
+    Eigen::Quaterniond quat(room.node->estimate().linear());
     room_marker.pose.orientation.x = quat.x();
     room_marker.pose.orientation.y = quat.y();
     room_marker.pose.orientation.z = quat.z();
     room_marker.pose.orientation.w = quat.w();
-    room_marker.lifetime = duration_room;
-    markers.markers.push_back(room_marker);
+    marker_cache->submit(room_marker);
 
     // fill in the line marker
     visualization_msgs::msg::Marker room_line_marker;
@@ -826,170 +727,120 @@ visualization_msgs::msg::MarkerArray GraphVisualizer::create_marker_array(
     room_line_marker.ns = "rooms_line";
     room_line_marker.header.frame_id = rooms_layer_id;
     room_line_marker.header.stamp = stamp;
-    room_line_marker.id = markers.markers.size() + 1;
+    room_line_marker.id = room.id;
     room_line_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
     room_line_marker.color.r = color_r;
     room_line_marker.color.g = color_g;
     room_line_marker.color.b = color_b;
     room_line_marker.color.a = 1.0;
-    room_line_marker.lifetime = duration_room;
-    geometry_msgs::msg::Point p1, p2, p3, p4, p5;
-    p1.x = room_snapshot[i].node->estimate().translation()(0);
-    p1.y = room_snapshot[i].node->estimate().translation()(1);
-    p1.z = room_snapshot[i].node->estimate().translation()(2);
-
-    auto found_planex1 = std::find_if(
-        x_plane_snapshot.begin(),
-        x_plane_snapshot.end(),
-        boost::bind(&VerticalPlanes::id, _1) == room_snapshot[i].plane_x1_id);
-    auto found_planex2 = std::find_if(
-        x_plane_snapshot.begin(),
-        x_plane_snapshot.end(),
-        boost::bind(&VerticalPlanes::id, _1) == room_snapshot[i].plane_x2_id);
-    auto found_planey1 = std::find_if(
-        y_plane_snapshot.begin(),
-        y_plane_snapshot.end(),
-        boost::bind(&VerticalPlanes::id, _1) == room_snapshot[i].plane_y1_id);
-    auto found_planey2 = std::find_if(
-        y_plane_snapshot.begin(),
-        y_plane_snapshot.end(),
-        boost::bind(&VerticalPlanes::id, _1) == room_snapshot[i].plane_y2_id);
-
-    p2 = compute_plane_point(p1, (*found_planex1).cloud_seg_map);
-
-    room_line_marker.points.push_back(p1);
-    room_line_marker.points.push_back(p2);
-
-    p3 = compute_plane_point(p1, (*found_planex2).cloud_seg_map);
-
-    room_line_marker.points.push_back(p1);
-    room_line_marker.points.push_back(p3);
-
-    p4 = compute_plane_point(p1, (*found_planey1).cloud_seg_map);
-
-    room_line_marker.points.push_back(p1);
-    room_line_marker.points.push_back(p4);
-
-    p5 = compute_plane_point(p1, (*found_planey2).cloud_seg_map);
-
-    room_line_marker.points.push_back(p1);
-    room_line_marker.points.push_back(p5);
-
-    markers.markers.push_back(room_line_marker);
-
-    /* room clusters */
-    int cluster_id = 0;
-    for (auto& cluster : room_snapshot[i].cluster_array.markers) {
-      cluster.header.frame_id = walls_layer_id;
-      if (cluster_id == 0) cluster.ns = "room_vertex";
-      if (cluster_id == 1) cluster.ns = "room_edges";
-      cluster.id = markers.markers.size() + 1;
-      markers.markers.push_back(cluster);
+    geometry_msgs::msg::Point p1;
+    p1.x = room.node->estimate().translation()(0);
+    p1.y = room.node->estimate().translation()(1);
+    p1.z = room.node->estimate().translation()(2);
+
+    for (const auto& plane_id : {room.plane_x1_id, room.plane_x2_id}) {
+      auto found_plane = x_plane_table.find(plane_id);
+      if (found_plane == x_plane_table.end()) continue;
+      room_line_marker.points.push_back(p1);
+      room_line_marker.points.push_back(
+          compute_plane_point(p1, found_plane->second->cloud_seg_map));
+    }
+    for (const auto& plane_id : {room.plane_y1_id, room.plane_y2_id}) {
+      auto found_plane = y_plane_table.find(plane_id);
+      if (found_plane == y_plane_table.end()) continue;
+      room_line_marker.points.push_back(p1);
+      room_line_marker.points.push_back(
+          compute_plane_point(p1, found_plane->second->cloud_seg_map));
+    }
+    marker_cache->submit(room_line_marker);
+
+    /* room clusters, only drawn for the rooms close to the robot */
+    if ((room.node->estimate().translation() - viewpoint).norm() <
+        plane_lod->get_near_distance()) {
+      submit_cluster_markers(room.cluster_array,
+                             room.id,
+                             walls_layer_id,
+                             "room_vertex",
+                             "room_edges");
     }
   }
 
-  rclcpp::Duration duration_floor = rclcpp::Duration::from_seconds(5);
-  for (const auto& floor : floors_vec) {
-    if (floor.id != -1) {
-      visualization_msgs::msg::Marker floor_marker;
-      floor_marker.pose.orientation.w = 1.0;
-      floor_marker.scale.x = 0.5;
-      floor_marker.scale.y = 0.5;
-      floor_marker.scale.z = 0.5;
-      // plane_marker.points.resize(vert_planes.size());
-      floor_marker.header.frame_id = floors_layer_id;
-      floor_marker.header.stamp = stamp;
-      floor_marker.ns = "floors";
-      floor_marker.id = markers.markers.size();
-      floor_marker.type = visualization_msgs::msg::Marker::CUBE;
-      floor_marker.color.r = 0.49;
-      floor_marker.color.g = 0;
-      floor_marker.color.b = 1;
-      floor_marker.color.a = 1;
-      floor_marker.lifetime = duration_floor;
-
-      floor_marker.pose.position.x = floor.node->estimate().translation()(0);
-      floor_marker.pose.position.y = floor.node->estimate().translation()(1);
-      floor_marker.pose.position.z = floor.node->estimate().translation()(2);
-
-      // create line markers between floor and rooms/infinite_rooms
-      visualization_msgs::msg::Marker floor_line_marker;
-      floor_line_marker.scale.x = 0.02;
-      floor_line_marker.pose.orientation.w = 1.0;
-      floor_line_marker.ns = "floor_lines";
-      floor_line_marker.header.frame_id = floors_layer_id;
-      floor_line_marker.header.stamp = stamp;
-      floor_line_marker.id = markers.markers.size() + 1;
-      floor_line_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
-      floor_line_marker.color.r = color_r;
-      floor_line_marker.color.g = color_g;
-      floor_line_marker.color.b = color_b;
-      floor_line_marker.color.a = 1.0;
-      floor_line_marker.lifetime = duration_floor;
-
-      for (const auto& room : room_snapshot) {
-        if (room.sub_room) continue;
-        geometry_msgs::msg::Point p1, p2;
-        p1.x = floor_marker.pose.position.x;
-        p1.y = floor_marker.pose.position.y;
-        p1.z = floor_marker.pose.position.z;
-        p2.x = room.node->estimate().translation()(0);
-        p2.y = room.node->estimate().translation()(1);
-        p2.z = room.node->estimate().translation()(2);
-
-        p2 = compute_room_point(p2);
-
-        floor_line_marker.points.push_back(p1);
-        floor_line_marker.points.push_back(p2);
-      }
-      for (const auto& x_infinite_room : x_infinite_room_snapshot) {
-        if (x_infinite_room.id == -1 || x_infinite_room.sub_infinite_room) continue;
-        geometry_msgs::msg::Point p1, p2;
-        p1.x = floor_marker.pose.position.x;
-        p1.y = floor_marker.pose.position.y;
-        p1.z = floor_marker.pose.position.z;
-        p2.x = x_infinite_room.node->estimate().translation()(0);
-        p2.y = x_infinite_room.node->estimate().translation()(1);
-        p2.z = x_infinite_room.node->estimate().translation()(2);
-
-        p2 = compute_room_point(p2);
-
-        floor_line_marker.points.push_back(p1);
-        floor_line_marker.points.push_back(p2);
-      }
-      for (const auto& y_infinite_room : y_infinite_room_snapshot) {
-        if (y_infinite_room.id == -1 || y_infinite_room.sub_infinite_room) continue;
-        geometry_msgs::msg::Point p1, p2;
-        p1.x = floor_marker.pose.position.x;
-        p1.y = floor_marker.pose.position.y;
-        p1.z = floor_marker.pose.position.z;
-        p2.x = y_infinite_room.node->estimate().translation()(0);
-        p2.y = y_infinite_room.node->estimate().translation()(1);
-        p2.z = y_infinite_room.node->estimate().translation()(2);
-
-        geometry_msgs::msg::PointStamped point2_stamped, point2_stamped_transformed;
-        point2_stamped.header.frame_id = rooms_layer_id;
-        point2_stamped.point.x = p2.x;
-        point2_stamped.point.y = p2.y;
-        point2_stamped.point.z = p2.z;
+  // the rooms every floor is connected to, transformed to the floors layer only once
+  bool has_floor = std::any_of(floors_vec.begin(),
+                               floors_vec.end(),
+                               [](const Floors& floor) { return floor.id != -1; });
+  std::vector<geometry_msgs::msg::Point> floor_room_points;
+  if (has_floor) {
+    auto add_floor_room_point = [&](const Eigen::Vector3d& room_position) {
+      geometry_msgs::msg::Point room_point;
+      room_point.x = room_position(0);
+      room_point.y = room_position(1);
+      room_point.z = room_position(2);
+      floor_room_points.push_back(compute_room_point(room_point));
+    };
+
+    for (size_t i = 0; i < room_snapshot.size(); ++i) {
+      if (room_sub[i]) continue;
+      add_floor_room_point(room_snapshot[i].node->estimate().translation());
+    }
+    for (size_t i = 0; i < x_infinite_room_snapshot.size(); ++i) {
+      if (!x_infinite_room_drawn[i] || x_infinite_room_sub[i]) continue;
+      add_floor_room_point(x_infinite_room_snapshot[i].node->estimate().translation());
+    }
+    for (size_t i = 0; i < y_infinite_room_snapshot.size(); ++i) {
+      if (!y_infinite_room_drawn[i] || y_infinite_room_sub[i]) continue;
+      add_floor_room_point(y_infinite_room_snapshot[i].node->estimate().translation());
+    }
+  }
 
-        // convert point p2 to rooms_layer_id currently it is map_frame_id
-        tf_buffer->transform(point2_stamped,
-                             point2_stamped_transformed,
-                             floors_layer_id,
-                             tf2::TimePointZero,
-                             rooms_layer_id);
-        p2 = point2_stamped_transformed.point;
-        floor_line_marker.points.push_back(p1);
-        floor_line_marker.points.push_back(p2);
-      }
-      markers.markers.push_back(floor_marker);
-      markers.markers.push_back(floor_line_marker);
+  for (const auto& floor : floors_vec) {
+    if (floor.id == -1) continue;
+
+    visualization_msgs::msg::Marker floor_marker;
+    floor_marker.pose.orientation.w = 1.0;
+    floor_marker.scale.x = 0.5;
+    floor_marker.scale.y = 0.5;
+    floor_marker.scale.z = 0.5;
+    floor_marker.header.frame_id = floors_layer_id;
+    floor_marker.header.stamp = stamp;
+    floor_marker.ns = "floors";
+    floor_marker.id = floor.id;
+    floor_marker.type = visualization_msgs::msg::Marker::CUBE;
+    floor_marker.color.r = 0.49;
+    floor_marker.color.g = 0;
+    floor_marker.color.b = 1;
+    floor_marker.color.a = 1;
+
+    floor_marker.pose.position.x = floor.node->estimate().translation()(0);
+    floor_marker.pose.position.y = floor.node->estimate().translation()(1);
+    floor_marker.pose.position.z = floor.node->estimate().translation()(2);
+
+    // create line markers between floor and rooms/infinite_rooms
+    visualization_msgs::msg::Marker floor_line_marker;
+    floor_line_marker.scale.x = 0.02;
+    floor_line_marker.pose.orientation.w = 1.0;
+    floor_line_marker.ns = "floor_lines";
+    floor_line_marker.header.frame_id = floors_layer_id;
+    floor_line_marker.header.stamp = stamp;
+    floor_line_marker.id = floor.id;
+    floor_line_marker.type = visualization_msgs::msg::Marker::LINE_LIST;
+    floor_line_marker.color.r = color_r;
+    floor_line_marker.color.g = color_g;
+    floor_line_marker.color.b = color_b;
+    floor_line_marker.color.a = 1.0;
+
+    floor_line_marker.points.reserve(2 * floor_room_points.size());
+    for (const auto& room_point : floor_room_points) {
+      floor_line_marker.points.push_back(floor_marker.pose.position);
+      floor_line_marker.points.push_back(room_point);
     }
+    marker_cache->submit(floor_marker);
+    marker_cache->submit(floor_line_marker);
   }
 
-  return markers;
+  return marker_cache->flush(stamp);
 }
+
 visualization_msgs::msg::MarkerArray GraphVisualizer::create_prior_marker_array(
     const rclcpp::Time& stamp,
     const g2o::SparseOptimizer* local_graph,
@@ -2130,11 +1981,90 @@ Eigen::Isometry3d GraphVisualizer::compute_plane_pose(const VerticalPlanes& plan
   return pose;
 }
 
+Eigen::VectorXd GraphVisualizer::compute_plane_state(const Planes& plane) {
+  // the map cloud is regenerated from the keyframe poses, so its size and end points
+  // are a cheap fingerprint of both the growth and the displacement of the plane
+  Eigen::VectorXd state = Eigen::VectorXd::Zero(11);
+  state.head(4) = plane.plane_node != nullptr ? plane.plane_node->estimate().coeffs()
+                                              : plane.plane.coeffs();
+  if (plane.cloud_seg_map == nullptr || plane.cloud_seg_map->empty()) return state;
+
+  state(4) = plane.cloud_seg_map->size();
+  state.segment(5, 3) = plane.cloud_seg_map->front().getVector3fMap().cast<double>();
+  state.segment(8, 3) = plane.cloud_seg_map->back().getVector3fMap().cast<double>();
+  return state;
+}
+
+visualization_msgs::msg::Marker GraphVisualizer::create_plane_marker(
+    const PlaneGeometryLOD& geometry, const int level) {
+  visualization_msgs::msg::Marker plane_marker;
+  plane_marker.pose.orientation.w = 1.0;
+
+  auto to_point = [](const Eigen::Vector3d& vec) {
+    geometry_msgs::msg::Point point;
+    point.x = vec.x();
+    point.y = vec.y();
+    point.z = vec.z();
+    return point;
+  };
+
+  if (level < plane_lod->get_outline_level()) {
+    double resolution = std::max(0.05, plane_lod->get_voxel_resolution(level));
+    plane_marker.type = visualization_msgs::msg::Marker::CUBE_LIST;
+    plane_marker.scale.x = plane_marker.scale.y = plane_marker.scale.z = resolution;
+
+    const auto& voxel_cloud = geometry.voxel_levels[level];
+    plane_marker.points.resize(voxel_cloud->size());
+    for (size_t j = 0; j < voxel_cloud->size(); ++j) {
+      plane_marker.points[j].x = voxel_cloud->points[j].x;
+      plane_marker.points[j].y = voxel_cloud->points[j].y;
+      plane_marker.points[j].z = voxel_cloud->points[j].z;
+    }
+  } else if (level == plane_lod->get_outline_level()) {
+    plane_marker.type = visualization_msgs::msg::Marker::LINE_STRIP;
+    plane_marker.scale.x = 0.05;
+    for (const auto& outline_point : geometry.outline()) {
+      plane_marker.points.push_back(to_point(outline_point));
+    }
+  } else {
+    plane_marker.type = visualization_msgs::msg::Marker::TRIANGLE_LIST;
+    plane_marker.scale.x = plane_marker.scale.y = plane_marker.scale.z = 1.0;
+    std::vector<Eigen::Vector3d> corners = geometry.quad();
+    if (corners.size() == 4) {
+      for (const int corner : {0, 1, 2, 0, 2, 3}) {
+        plane_marker.points.push_back(to_point(corners[corner]));
+      }
+    }
+  }
+
+  return plane_marker;
+}
+
+void GraphVisualizer::submit_cluster_markers(
+    const visualization_msgs::msg::MarkerArray& cluster_array,
+    const int entity_id,
+    const std::string& frame_id,
+    const std::string& vertex_ns,
+    const std::string& edge_ns) {
+  // clusters come in vertex/edge pairs, rooms built from infinite rooms carry one pair
+  // per source. Each entity gets its own namespaces so the ids of the pairs never
+  // collide with the ones of another entity.
+  const std::string entity_suffix = "/" + std::to_string(entity_id);
+  for (size_t j = 0; j < cluster_array.markers.size(); ++j) {
+    visualization_msgs::msg::Marker cluster = cluster_array.markers[j];
+    cluster.header.frame_id = frame_id;
+    cluster.ns = ((j % 2 == 0) ? vertex_ns : edge_ns) + entity_suffix;
+    cluster.id = j / 2;
+    cluster.lifetime = rclcpp::Duration::from_seconds(0);
+    marker_cache->submit(cluster);
+  }
+}
+
 Eigen::Vector3d GraphVisualizer::compute_vert_plane_centroid(
     const int current_plane_id,
     const std::vector<VerticalPlanes>& plane_snapshot) {
   Eigen::Vector3d pt;
-  for (auto plane : plane_snapshot) {
+  for (const auto& plane : plane_snapshot) {
     if (plane.id == current_plane_id) {
       double x = 0, y = 0, z = 0;
       for (int p = 0; p < plane.cloud_seg_map->points.size(); ++p) {
@@ -2146,6 +2076,7 @@ Eigen::Vector3d GraphVisualizer::compute_vert_plane_centroid(
       y = y / plane.cloud_seg_map->points.size();
       z = z / plane.cloud_seg_map->points.size();
       pt = Eigen::Vector3d(x, y, z);
+      break;
     }
   }
   return pt;
@@ -2155,7 +2086,7 @@ Eigen::Vector3d GraphVisualizer::compute_hort_plane_centroid(
     const int current_plane_id,
     const std::vector<HorizontalPlanes>& plane_snapshot) {
   Eigen::Vector3d pt;
-  for (auto plane : plane_snapshot) {
+  for (const auto& plane : plane_snapshot) {
     if (plane.id == current_plane_id) {
       double x = 0, y = 0, z = 0;
       for (int p = 0; p < plane.cloud_seg_map->points.size(); ++p) {
@@ -2167,6 +2098,7 @@ Eigen::Vector3d GraphVisualizer::compute_hort_plane_centroid(
       y = y / plane.cloud_seg_map->points.size();
       z = z / plane.cloud_seg_map->points.size();
       pt = Eigen::Vector3d(x, y, z);
+      break;
     }
   }
   return pt;
@@ -0,0 +1,177 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <cmath>
+#include <s_graphs/visualization/marker_cache.hpp>
+
+namespace s_graphs {
+
+MarkerCache::MarkerCache(const double delta_threshold, const int full_refresh_ticks)
+    : delta_threshold(delta_threshold),
+      full_refresh_ticks(full_refresh_ticks),
+      tick(0),
+      revision(0) {}
+
+MarkerCache::~MarkerCache() {}
+
+bool MarkerCache::is_dirty(const std::string& ns,
+                           const int id,
+                           const Eigen::VectorXd& state) {
+  auto entry = entries.find(MarkerKey(ns, id));
+  if (entry == entries.end()) return true;
+
+  entry->second.last_seen_tick = tick;
+  if (entry->second.state.size() != state.size()) return true;
+  if (state.size() == 0) return false;
+
+  return (entry->second.state - state).cwiseAbs().maxCoeff() > delta_threshold;
+}
+
+void MarkerCache::update(const visualization_msgs::msg::Marker& marker,
+                         const Eigen::VectorXd& state) {
+  MarkerKey key(marker.ns, marker.id);
+  MarkerEntry& entry = entries[key];
+  entry.marker = marker;
+  entry.marker.action = visualization_msgs::msg::Marker::ADD;
+  entry.state = state;
+  entry.revision = ++revision;
+  entry.last_seen_tick = tick;
+  pending_keys.insert(key);
+}
+
+void MarkerCache::submit(const visualization_msgs::msg::Marker& marker) {
+  auto entry = entries.find(MarkerKey(marker.ns, marker.id));
+  if (entry != entries.end() && !has_changed(marker, entry->second.marker)) {
+    entry->second.last_seen_tick = tick;
+    return;
+  }
+  update(marker, Eigen::VectorXd());
+}
+
+visualization_msgs::msg::MarkerArray MarkerCache::flush(const rclcpp::Time& stamp) {
+  visualization_msgs::msg::MarkerArray markers;
+
+  // entities that were not reported in this tick do not exist anymore
+  for (auto entry = entries.begin(); entry != entries.end();) {
+    if (entry->second.last_seen_tick == tick) {
+      ++entry;
+      continue;
+    }
+    visualization_msgs::msg::Marker delete_marker;
+    delete_marker.header.frame_id = entry->second.marker.header.frame_id;
+    delete_marker.header.stamp = stamp;
+    delete_marker.ns = entry->first.first;
+    delete_marker.id = entry->first.second;
+    delete_marker.action = visualization_msgs::msg::Marker::DELETE;
+    markers.markers.push_back(delete_marker);
+
+    pending_keys.erase(entry->first);
+    entry = entries.erase(entry);
+    ++revision;
+  }
+
+  bool full_refresh = full_refresh_ticks > 0 && tick % full_refresh_ticks == 0;
+  if (full_refresh) {
+    markers.markers.reserve(markers.markers.size() + entries.size());
+    for (auto& entry : entries) {
+      entry.second.marker.header.stamp = stamp;
+      markers.markers.push_back(entry.second.marker);
+    }
+  } else {
+    markers.markers.reserve(markers.markers.size() + pending_keys.size());
+    for (const auto& key : pending_keys) {
+      auto& marker = entries[key].marker;
+      marker.header.stamp = stamp;
+      markers.markers.push_back(marker);
+    }
+  }
+
+  pending_keys.clear();
+  tick++;
+  return markers;
+}
+
+void MarkerCache::clear() {
+  entries.clear();
+  pending_keys.clear();
+  ++revision;
+}
+
+bool MarkerCache::has_changed(const visualization_msgs::msg::Marker& current,
+                              const visualization_msgs::msg::Marker& retained) const {
+  if (current.type != retained.type ||
+      current.header.frame_id != retained.header.frame_id ||
+      current.points.size() != retained.points.size() ||
+      current.colors.size() != retained.colors.size() ||
+      current.text != retained.text) {
+    return true;
+  }
+
+  auto moved = [&](double a, double b) { return std::fabs(a - b) > delta_threshold; };
+
+  if (moved(current.pose.position.x, retained.pose.position.x) ||
+      moved(current.pose.position.y, retained.pose.position.y) ||
+      moved(current.pose.position.z, retained.pose.position.z) ||
+      moved(current.pose.orientation.x, retained.pose.orientation.x) ||
+      moved(current.pose.orientation.y, retained.pose.orientation.y) ||
+      moved(current.pose.orientation.z, retained.pose.orientation.z) ||
+      moved(current.pose.orientation.w, retained.pose.orientation.w) ||
+      moved(current.scale.x, retained.scale.x) ||
+      moved(current.scale.y, retained.scale.y) ||
+      moved(current.scale.z, retained.scale.z) ||
+      moved(current.color.r, retained.color.r) ||
+      moved(current.color.g, retained.color.g) ||
+      moved(current.color.b, retained.color.b) ||
+      moved(current.color.a, retained.color.a)) {
+    return true;
+  }
+
+  for (size_t i = 0; i < current.points.size(); ++i) {
+    if (moved(current.points[i].x, retained.points[i].x) ||
+        moved(current.points[i].y, retained.points[i].y) ||
+        moved(current.points[i].z, retained.points[i].z)) {
+      return true;
+    }
+  }
+
+  for (size_t i = 0; i < current.colors.size(); ++i) {
+    if (moved(current.colors[i].r, retained.colors[i].r) ||
+        moved(current.colors[i].g, retained.colors[i].g) ||
+        moved(current.colors[i].b, retained.colors[i].b) ||
+        moved(current.colors[i].a, retained.colors[i].a)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace s_graphs
@@ -0,0 +1,336 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <s_graphs/visualization/plane_lod.hpp>
+
+namespace s_graphs {
+
+namespace {
+
+Eigen::Vector4d estimate_coeffs(const Planes& plane) {
+  return plane.plane_node != nullptr ? plane.plane_node->estimate().coeffs()
+                                     : plane.plane.coeffs();
+}
+
+size_t cloud_size(const Planes& plane) {
+  return plane.cloud_seg_map != nullptr ? plane.cloud_seg_map->size() : 0;
+}
+
+}  // namespace
+
+bool PlaneGeometryLOD::is_current(const Planes& plane) const {
+  if (plane.cloud_seg_body_vec.size() != num_segments) return false;
+  if (cloud_size(plane) != source_size) return false;
+  return estimate_coeffs(plane) == coeffs;
+}
+
+Eigen::Vector3d PlaneGeometryLOD::centroid() const {
+  if (source_size == 0) return origin;
+  return point_sum / static_cast<double>(source_size);
+}
+
+std::vector<Eigen::Vector3d> PlaneGeometryLOD::outline() const {
+  std::vector<Eigen::Vector3d> outline_points;
+  outline_points.reserve(outline_uv.size() + 1);
+  for (const auto& uv : outline_uv) {
+    outline_points.push_back(origin + uv.x() * u_axis + uv.y() * v_axis);
+  }
+  if (!outline_points.empty()) outline_points.push_back(outline_points.front());
+  return outline_points;
+}
+
+std::vector<Eigen::Vector3d> PlaneGeometryLOD::quad() const {
+  std::vector<Eigen::Vector3d> corners;
+  if (source_size == 0) return corners;
+  corners.push_back(origin + uv_min.x() * u_axis + uv_min.y() * v_axis);
+  corners.push_back(origin + uv_max.x() * u_axis + uv_min.y() * v_axis);
+  corners.push_back(origin + uv_max.x() * u_axis + uv_max.y() * v_axis);
+  corners.push_back(origin + uv_min.x() * u_axis + uv_max.y() * v_axis);
+  return corners;
+}
+
+PlaneLOD::PlaneLOD(const rclcpp::Node::SharedPtr node) {
+  voxel_resolutions = node->get_parameter("plane_lod_voxel_resolutions")
+                          .get_parameter_value()
+                          .get<std::vector<double>>();
+  near_distance = node->get_parameter("plane_lod_near_distance")
+                      .get_parameter_value()
+                      .get<double>();
+  far_distance =
+      node->get_parameter("plane_lod_far_distance").get_parameter_value().get<double>();
+  point_budget =
+      node->get_parameter("plane_lod_point_budget").get_parameter_value().get<int>();
+
+  std::sort(voxel_resolutions.begin(), voxel_resolutions.end());
+}
+
+PlaneLOD::~PlaneLOD() {}
+
+const PlaneGeometryLOD& PlaneLOD::update(const int plane_type, const Planes& plane) {
+  PlaneEntry& entry = entries[PlaneKey(plane_type, plane.id)];
+  entry.used = true;
+  PlaneGeometryLOD& geometry = entry.geometry;
+
+  if (geometry.is_current(plane)) return geometry;
+
+  // cloud_seg_map appends the segments in keyframe order, so the points of the new
+  // segments are its tail as long as no earlier point was dropped
+  const size_t num_segments = plane.cloud_seg_body_vec.size();
+  size_t num_new_points = 0;
+  for (size_t k = geometry.num_segments; k < num_segments; ++k) {
+    num_new_points += plane.cloud_seg_body_vec[k]->size();
+  }
+  bool incremental = geometry.num_segments > 0 &&
+                     num_segments >= geometry.num_segments &&
+                     cloud_size(plane) == geometry.source_size + num_new_points;
+
+  if (!incremental) {
+    reset_geometry(geometry, plane);
+    if (plane.cloud_seg_map != nullptr) add_points(geometry, plane.cloud_seg_map, 0);
+  } else {
+    if (estimate_coeffs(plane) != geometry.coeffs) rebase_geometry(geometry, plane);
+    if (num_new_points > 0) {
+      add_points(geometry, plane.cloud_seg_map, geometry.source_size);
+    }
+  }
+  geometry.num_segments = num_segments;
+  update_voxel_levels(geometry);
+  return geometry;
+}
+
+const PlaneGeometryLOD* PlaneLOD::find(const int plane_type, const int plane_id) const {
+  auto entry = entries.find(PlaneKey(plane_type, plane_id));
+  if (entry == entries.end()) return nullptr;
+  return &entry->second.geometry;
+}
+
+void PlaneLOD::remove_unused() {
+  for (auto entry = entries.begin(); entry != entries.end();) {
+    if (!entry->second.used) {
+      entry = entries.erase(entry);
+      continue;
+    }
+    entry->second.used = false;
+    ++entry;
+  }
+}
+
+std::vector<int> PlaneLOD::select_levels(
+    const std::vector<const PlaneGeometryLOD*>& geometries,
+    const Eigen::Vector3d& viewpoint) const {
+  const int num_voxel_levels = voxel_resolutions.size();
+  std::vector<int> levels(geometries.size());
+  std::vector<double> distances(geometries.size());
+
+  size_t total_size = 0;
+  for (size_t i = 0; i < geometries.size(); ++i) {
+    distances[i] = (geometries[i]->centroid() - viewpoint).norm();
+
+    if (distances[i] >= far_distance || num_voxel_levels == 0) {
+      levels[i] = get_outline_level();
+    } else if (distances[i] < near_distance) {
+      levels[i] = 0;
+    } else {
+      double ratio = (distances[i] - near_distance) / (far_distance - near_distance);
+      levels[i] = std::min(num_voxel_levels - 1,
+                           1 + static_cast<int>(ratio * (num_voxel_levels - 1)));
+    }
+    total_size += get_level_size(*geometries[i], levels[i]);
+  }
+
+  if (point_budget <= 0) return levels;
+
+  // coarsen the farthest planes first until the budget is met
+  std::vector<size_t> order(geometries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return distances[a] > distances[b];
+  });
+
+  bool coarsened = true;
+  while (total_size > static_cast<size_t>(point_budget) && coarsened) {
+    coarsened = false;
+    for (const auto& i : order) {
+      if (levels[i] >= get_quad_level()) continue;
+      total_size -= get_level_size(*geometries[i], levels[i]);
+      levels[i]++;
+      total_size += get_level_size(*geometries[i], levels[i]);
+      coarsened = true;
+      if (total_size <= static_cast<size_t>(point_budget)) break;
+    }
+  }
+
+  return levels;
+}
+
+size_t PlaneLOD::get_level_size(const PlaneGeometryLOD& geometry,
+                                const int level) const {
+  if (level < get_outline_level()) return geometry.voxel_levels[level]->size();
+  if (level == get_outline_level()) return geometry.outline_uv.size() + 1;
+  return 6;
+}
+
+void PlaneLOD::reset_geometry(PlaneGeometryLOD& geometry, const Planes& plane) {
+  geometry.coeffs = estimate_coeffs(plane);
+
+  Eigen::Vector3d normal = geometry.coeffs.head<3>();
+  double norm = normal.norm();
+  if (norm < 1e-6) {
+    normal = Eigen::Vector3d::UnitZ();
+    norm = 1.0;
+  }
+  normal /= norm;
+
+  Eigen::Vector3d reference = std::fabs(normal.z()) < 0.9 ? Eigen::Vector3d::UnitZ()
+                                                          : Eigen::Vector3d::UnitX();
+  geometry.origin = -(geometry.coeffs(3) / norm) * normal;
+  geometry.u_axis = normal.cross(reference).normalized();
+  geometry.v_axis = normal.cross(geometry.u_axis);
+
+  geometry.num_segments = 0;
+  geometry.source_size = 0;
+  geometry.point_sum.setZero();
+  geometry.uv_min.setConstant(std::numeric_limits<double>::max());
+  geometry.uv_max.setConstant(std::numeric_limits<double>::lowest());
+  geometry.outline_uv.clear();
+  geometry.voxel_cells.assign(voxel_resolutions.size(),
+                              PlaneGeometryLOD::VoxelCells());
+}
+
+void PlaneLOD::rebase_geometry(PlaneGeometryLOD& geometry, const Planes& plane) {
+  Eigen::Vector4d coeffs = estimate_coeffs(plane);
+  double norm = coeffs.head<3>().norm();
+  if (norm < 1e-6) return;
+  Eigen::Vector3d normal = coeffs.head<3>() / norm;
+
+  // rotate the basis about the centroid, which is then projected onto the plane
+  Eigen::Matrix3d rotation =
+      Eigen::Quaterniond::FromTwoVectors(geometry.u_axis.cross(geometry.v_axis),
+                                         normal)
+          .toRotationMatrix();
+  Eigen::Vector3d centroid = geometry.centroid();
+  Eigen::Vector3d new_centroid =
+      centroid - (normal.dot(centroid) + coeffs(3) / norm) * normal;
+
+  geometry.coeffs = coeffs;
+  geometry.origin = new_centroid + rotation * (geometry.origin - centroid);
+  geometry.u_axis = rotation * geometry.u_axis;
+  geometry.v_axis = rotation * geometry.v_axis;
+  geometry.point_sum = new_centroid * static_cast<double>(geometry.source_size);
+}
+
+void PlaneLOD::add_points(PlaneGeometryLOD& geometry,
+                          const pcl::PointCloud<PointNormal>::ConstPtr& cloud,
+                          const size_t first) {
+  // the hull of the new points and the previous hull is the hull of all points
+  std::vector<Eigen::Vector2d> hull_points = geometry.outline_uv;
+  hull_points.reserve(hull_points.size() + cloud->size() - first);
+  const Eigen::Vector3d normal = geometry.u_axis.cross(geometry.v_axis);
+
+  for (size_t i = first; i < cloud->size(); ++i) {
+    Eigen::Vector3d point = cloud->points[i].getVector3fMap().cast<double>();
+    Eigen::Vector3d offset = point - geometry.origin;
+    Eigen::Vector3d uvw(
+        offset.dot(geometry.u_axis), offset.dot(geometry.v_axis), offset.dot(normal));
+
+    geometry.point_sum += point;
+    geometry.uv_min = geometry.uv_min.cwiseMin(uvw.head<2>());
+    geometry.uv_max = geometry.uv_max.cwiseMax(uvw.head<2>());
+    hull_points.push_back(uvw.head<2>());
+
+    for (size_t k = 0; k < voxel_resolutions.size(); ++k) {
+      Eigen::Vector3d index = (uvw / voxel_resolutions[k]).array().floor();
+      auto& cell = geometry.voxel_cells[k][std::make_tuple(
+          static_cast<int>(index.x()), static_cast<int>(index.y()),
+          static_cast<int>(index.z()))];
+      cell.uvw_sum += uvw;
+      cell.count++;
+    }
+  }
+  geometry.outline_uv = convex_hull(hull_points);
+  geometry.source_size = cloud->size();
+}
+
+void PlaneLOD::update_voxel_levels(PlaneGeometryLOD& geometry) const {
+  const Eigen::Vector3d normal = geometry.u_axis.cross(geometry.v_axis);
+
+  geometry.voxel_levels.resize(geometry.voxel_cells.size());
+  for (size_t k = 0; k < geometry.voxel_cells.size(); ++k) {
+    pcl::PointCloud<PointNormal>::Ptr level_cloud(new pcl::PointCloud<PointNormal>());
+    level_cloud->reserve(geometry.voxel_cells[k].size());
+    for (const auto& cell : geometry.voxel_cells[k]) {
+      Eigen::Vector3d uvw =
+          cell.second.uvw_sum / static_cast<double>(cell.second.count);
+      PointNormal level_point;
+      level_point.getVector3fMap() = (geometry.origin + uvw.x() * geometry.u_axis +
+                                      uvw.y() * geometry.v_axis + uvw.z() * normal)
+                                         .cast<float>();
+      level_cloud->push_back(level_point);
+    }
+    geometry.voxel_levels[k] = level_cloud;
+  }
+}
+
+std::vector<Eigen::Vector2d> PlaneLOD::convex_hull(
+    std::vector<Eigen::Vector2d> points) const {
+  if (points.size() < 3) return points;
+
+  std::sort(points.begin(),
+            points.end(),
+            [](const Eigen::Vector2d& a, const Eigen::Vector2d& b) {
+              return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+            });
+
+  auto cross = [](const Eigen::Vector2d& o,
+                  const Eigen::Vector2d& a,
+                  const Eigen::Vector2d& b) {
+    return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+  };
+
+  std::vector<Eigen::Vector2d> hull(2 * points.size());
+  size_t k = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) k--;
+    hull[k++] = points[i];
+  }
+  for (size_t i = points.size() - 1, t = k + 1; i > 0; --i) {
+    while (k >= t && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0) k--;
+    hull[k++] = points[i - 1];
+  }
+  hull.resize(k - 1);
+  return hull;
+}
+
+}  // namespace s_graphs
@@ -0,0 +1,157 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <algorithm>
+#include <s_graphs/common/ros_utils.hpp>
+#include <s_graphs/visualization/trajectory_buffer.hpp>
+#include <utility>
+
+namespace s_graphs {
+
+TrajectoryBuffer::TrajectoryBuffer(const int tail_size,
+                                   const int max_size,
+                                   const double min_distance,
+                                   const double min_angle,
+                                   const int full_path_interval)
+    : tail_size(std::max(tail_size, 1)),
+      max_size(std::max(max_size, 0)),
+      min_distance(min_distance),
+      min_angle(min_angle),
+      full_path_interval(full_path_interval) {
+  poses_since_full_path = 0;
+  reanchored = false;
+}
+
+geometry_msgs::msg::PoseStamped TrajectoryBuffer::add_pose(
+    const rclcpp::Time& stamp,
+    const Eigen::Isometry3d& odom_pose,
+    const Eigen::Matrix4f& odom2map,
+    const std::string& frame_id) {
+  TrajectoryPose pose;
+  pose.stamp = stamp;
+  pose.odom_pose = odom_pose;
+  pose.corrected = matrix2PoseStamped(
+      stamp, odom2map * odom_pose.matrix().cast<float>(), frame_id);
+
+  std::lock_guard<std::mutex> lock(trajectory_mutex);
+  tail.push_back(pose);
+  // the oldest pose leaves the tail before it is counted in the history
+  while (tail.size() > tail_size) {
+    TrajectoryPose oldest = std::move(tail.front());
+    tail.pop_front();
+    push_history(std::move(oldest));
+  }
+  poses_since_full_path++;
+  return pose.corrected;
+}
+
+void TrajectoryBuffer::push_history(TrajectoryPose&& pose) {
+  if (!history.empty()) {
+    Eigen::Isometry3d delta = history.back().odom_pose.inverse() * pose.odom_pose;
+    double angle = Eigen::AngleAxisd(delta.linear()).angle();
+    if (delta.translation().norm() < min_distance && angle < min_angle) return;
+  }
+
+  history.push_back(std::move(pose));
+  if (max_size > 0 && history.size() + tail.size() > max_size) history.pop_front();
+}
+
+void TrajectoryBuffer::reanchor(const KeyFrameIndex& keyframe_index) {
+  // odom2map of every keyframe, the index already keeps them sorted by stamp
+  typedef std::pair<double, Eigen::Matrix4f> Anchor;
+  std::vector<Anchor> anchors;
+  anchors.reserve(keyframe_index.size());
+  for (const auto& keyframe : keyframe_index.by_stamp()) {
+    if (!keyframe->node) continue;
+    Eigen::Isometry3d odom2map = keyframe->node->estimate() * keyframe->odom.inverse();
+    anchors.emplace_back(keyframe->stamp.seconds(), odom2map.matrix().cast<float>());
+  }
+  if (anchors.empty()) return;
+
+  auto correct = [&](TrajectoryPose& pose) {
+    auto anchor = std::upper_bound(
+        anchors.begin(),
+        anchors.end(),
+        pose.stamp.seconds(),
+        [](const double stamp, const Anchor& anchor) { return stamp < anchor.first; });
+    if (anchor != anchors.begin()) anchor--;
+    Eigen::Matrix4f corrected = anchor->second * pose.odom_pose.matrix().cast<float>();
+    pose.corrected =
+        matrix2PoseStamped(pose.stamp, corrected, pose.corrected.header.frame_id);
+  };
+
+  std::lock_guard<std::mutex> lock(trajectory_mutex);
+  std::for_each(history.begin(), history.end(), correct);
+  std::for_each(tail.begin(), tail.end(), correct);
+  reanchored = true;
+}
+
+bool TrajectoryBuffer::is_full_path_due() {
+  std::lock_guard<std::mutex> lock(trajectory_mutex);
+  if (!reanchored && poses_since_full_path < full_path_interval) return false;
+
+  reanchored = false;
+  poses_since_full_path = 0;
+  return true;
+}
+
+nav_msgs::msg::Path TrajectoryBuffer::get_path() const {
+  std::lock_guard<std::mutex> lock(trajectory_mutex);
+  nav_msgs::msg::Path path;
+  if (tail.empty()) return path;
+
+  path.header = tail.back().corrected.header;
+  path.poses.reserve(history.size() + tail.size());
+  for (const auto& pose : history) path.poses.push_back(pose.corrected);
+  for (const auto& pose : tail) path.poses.push_back(pose.corrected);
+  return path;
+}
+
+nav_msgs::msg::Path TrajectoryBuffer::get_tail() const {
+  std::lock_guard<std::mutex> lock(trajectory_mutex);
+  nav_msgs::msg::Path path;
+  if (tail.empty()) return path;
+
+  path.header = tail.back().corrected.header;
+  path.poses.reserve(tail.size());
+  for (const auto& pose : tail) path.poses.push_back(pose.corrected);
+  return path;
+}
+
+void TrajectoryBuffer::clear() {
+  std::lock_guard<std::mutex> lock(trajectory_mutex);
+  history.clear();
+  tail.clear();
+  poses_since_full_path = 0;
+  reanchored = false;
+}
+
+}  // namespace s_graphs
@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+#include <g2o/types/slam3d/isometry3d_mappings.h>
+#include <g2o/types/slam3d/vertex_se3.h>
+#include <g2o/types/slam3d_addons/vertex_plane.h>
+#include <gtest/gtest.h>
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <g2o/edge_se3_point_to_plane.hpp>
+#include <random>
+
+class TestEdgeSE3PointToPlane : public ::testing::Test {
+ public:
+  void SetUp() override {
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    pose.translation() = Eigen::Vector3d(1.5, -0.5, 0.3);
+    pose.linear() = Eigen::AngleAxisd(0.4, Eigen::Vector3d(0.2, -0.3, 1.0).normalized())
+                        .toRotationMatrix();
+    keyframe = new g2o::VertexSE3();
+    keyframe->setId(0);
+    keyframe->setEstimate(pose);
+
+    plane = new g2o::VertexPlane();
+    plane->setId(1);
+    plane->setEstimate(g2o::Plane3D(Eigen::Vector4d(0.8, 0.6, 0.0, -3.0)));
+
+    // the jacobians hold for any measurement, the points are spread around the
+    // keyframe
+    Eigen::Matrix4d gram = Eigen::Matrix4d::Zero();
+    for (int i = 0; i < 50; ++i) {
+      Eigen::Vector4d point;
+      point << 5 * uniform(generator), 5 * uniform(generator),
+          5 * uniform(generator), 1.0;
+      gram += point * point.transpose();
+    }
+
+    edge.vertices()[0] = keyframe;
+    edge.vertices()[1] = plane;
+    edge.setMeasurement(gram);
+    edge.setInformation(Eigen::Matrix<double, 1, 1>::Identity());
+  }
+
+  void TearDown() override {
+    delete keyframe;
+    delete plane;
+  }
+
+  double error_at(const Eigen::Isometry3d& pose, const g2o::Plane3D& plane_estimate) {
+    keyframe->setEstimate(pose);
+    plane->setEstimate(plane_estimate);
+    edge.computeError();
+    return edge.error()(0);
+  }
+
+  g2o::VertexSE3* keyframe;
+  g2o::VertexPlane* plane;
+  g2o::EdgeSE3PointToPlane edge;
+};
+
+TEST_F(TestEdgeSE3PointToPlane, JacobiansMatchCentralDifferences) {
+  const Eigen::Isometry3d pose = keyframe->estimate();
+  const g2o::Plane3D plane_estimate = plane->estimate();
+  edge.linearizeOplus();
+  const Eigen::Matrix<double, 1, 6> jacobian_keyframe = edge.jacobianOplusXi();
+  const Eigen::Matrix<double, 1, 3> jacobian_plane = edge.jacobianOplusXj();
+
+  // the increments are the ones applied by VertexSE3 and VertexPlane::oplus
+  const double eps = 1e-6;
+  for (int k = 0; k < 6; ++k) {
+    g2o::Vector6 delta = g2o::Vector6::Zero();
+    delta(k) = eps;
+    const double plus =
+        error_at(pose * g2o::internal::fromVectorMQT(delta), plane_estimate);
+    const double minus =
+        error_at(pose * g2o::internal::fromVectorMQT(-delta), plane_estimate);
+    const double numeric = (plus - minus) / (2 * eps);
+    EXPECT_NEAR(jacobian_keyframe(0, k), numeric, 1e-4 * (1 + std::fabs(numeric)))
+        << "keyframe column " << k;
+  }
+
+  for (int k = 0; k < 3; ++k) {
+    Eigen::Vector3d delta = Eigen::Vector3d::Zero();
+    delta(k) = eps;
+    g2o::Plane3D plane_plus = plane_estimate, plane_minus = plane_estimate;
+    plane_plus.oplus(delta);
+    plane_minus.oplus(-delta);
+    const double numeric =
+        (error_at(pose, plane_plus) - error_at(pose, plane_minus)) / (2 * eps);
+    EXPECT_NEAR(jacobian_plane(0, k), numeric, 1e-4 * (1 + std::fabs(numeric)))
+        << "plane column " << k;
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
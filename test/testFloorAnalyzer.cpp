@@ -0,0 +1,173 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <s_graphs/common/plane_utils.hpp>
+#include <s_graphs/frontend/floor_analyzer.hpp>
+
+#include "s_graphs/msg/plane_data.hpp"
+
+using namespace s_graphs;
+
+namespace {
+
+// all-pairs scan used by FloorAnalyzer before the sorted search, kept as reference
+bool reference_widest_pair(const int plane_type,
+                           const std::vector<s_graphs::msg::PlaneData>& planes,
+                           float& max_plane_width) {
+  bool x_plane = plane_type == PlaneUtils::plane_class::X_VERT_PLANE;
+  bool found = false;
+  max_plane_width = 0;
+  for (auto plane1 : planes) {
+    if ((x_plane ? plane1.nx : plane1.ny) < 0) continue;
+    PlaneUtils::correct_plane_direction(plane_type, plane1);
+
+    for (auto plane2 : planes) {
+      if ((x_plane ? plane2.nx : plane2.ny) > 0) continue;
+      PlaneUtils::correct_plane_direction(plane_type, plane2);
+      if (plane1.plane_points.empty() || plane2.plane_points.empty()) continue;
+
+      float plane_width = PlaneUtils::width_between_planes(plane1, plane2);
+      bool planes_placed_correctly = PlaneUtils::compute_point_difference(
+          x_plane ? plane1.plane_points.back().x : plane1.plane_points.back().y,
+          x_plane ? plane2.plane_points.back().x : plane2.plane_points.back().y);
+      if (std::abs(PlaneUtils::plane_dot_product(plane1, plane2)) < 0.9) continue;
+
+      if (plane_width > max_plane_width && planes_placed_correctly) {
+        max_plane_width = plane_width;
+        found = true;
+      }
+    }
+  }
+  return found;
+}
+
+std::vector<s_graphs::msg::PlaneData> random_walls(const int plane_type,
+                                                   const int num_walls,
+                                                   std::mt19937& generator) {
+  std::uniform_real_distribution<double> angle(-0.5, 0.5);
+  std::uniform_real_distribution<double> tilt(-0.05, 0.05);
+  std::uniform_real_distribution<double> coordinate(-15.0, 15.0);
+  std::uniform_int_distribution<int> num_points(0, 3);
+  std::bernoulli_distribution flip(0.5);
+
+  std::vector<s_graphs::msg::PlaneData> walls(num_walls);
+  for (int i = 0; i < num_walls; ++i) {
+    double yaw = angle(generator) + (flip(generator) ? M_PI : 0.0);
+    if (plane_type == PlaneUtils::plane_class::Y_VERT_PLANE) yaw += M_PI / 2;
+    Eigen::Vector3d normal(std::cos(yaw), std::sin(yaw), tilt(generator));
+    normal.normalize();
+
+    walls[i].id = i;
+    walls[i].nx = normal(0);
+    walls[i].ny = normal(1);
+    walls[i].nz = normal(2);
+    walls[i].d = coordinate(generator);
+    int points = num_points(generator);
+    for (int j = 0; j < points; ++j) {
+      geometry_msgs::msg::Vector3 point;
+      point.x = coordinate(generator);
+      point.y = coordinate(generator);
+      point.z = 0;
+      walls[i].plane_points.push_back(point);
+    }
+  }
+  return walls;
+}
+
+}  // namespace
+
+TEST(TestFloorAnalyzer, WidestPairOfRoom) {
+  std::vector<s_graphs::msg::PlaneData> x_planes(3), y_planes;
+  x_planes[0].nx = 1;
+  x_planes[0].d = 4;
+  x_planes[1].nx = -1;
+  x_planes[1].d = 6;
+  x_planes[2].nx = -1;
+  x_planes[2].d = 2;
+  for (auto& plane : x_planes) {
+    geometry_msgs::msg::Vector3 point;
+    point.x = -plane.nx * plane.d;
+    plane.plane_points.push_back(point);
+  }
+
+  FloorAnalyzer floor_analyzer;
+  std::vector<s_graphs::msg::PlaneData> floor_planes;
+  floor_analyzer.perform_floor_segmentation(x_planes, y_planes, floor_planes);
+
+  ASSERT_EQ(floor_planes.size(), 2u);
+  EXPECT_NEAR(PlaneUtils::width_between_planes(floor_planes[0], floor_planes[1]),
+              10.0,
+              1e-5);
+}
+
+TEST(TestFloorAnalyzer, MatchesAllPairsScan) {
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> num_walls(0, 60);
+  FloorAnalyzer floor_analyzer;
+
+  for (int trial = 0; trial < 500; ++trial) {
+    auto x_planes = random_walls(
+        PlaneUtils::plane_class::X_VERT_PLANE, num_walls(generator), generator);
+    auto y_planes = random_walls(
+        PlaneUtils::plane_class::Y_VERT_PLANE, num_walls(generator), generator);
+
+    float x_width = 0, y_width = 0;
+    bool x_found =
+        reference_widest_pair(PlaneUtils::plane_class::X_VERT_PLANE, x_planes, x_width);
+    bool y_found =
+        reference_widest_pair(PlaneUtils::plane_class::Y_VERT_PLANE, y_planes, y_width);
+
+    std::vector<s_graphs::msg::PlaneData> floor_planes;
+    floor_analyzer.perform_floor_segmentation(x_planes, y_planes, floor_planes);
+    ASSERT_EQ(floor_planes.size(), 2u * (x_found + y_found)) << "trial " << trial;
+
+    std::vector<float> expected_widths;
+    if (x_found) expected_widths.push_back(x_width);
+    if (y_found) expected_widths.push_back(y_width);
+    for (size_t i = 0; i < expected_widths.size(); ++i) {
+      const auto& plane1 = floor_planes[2 * i];
+      const auto& plane2 = floor_planes[2 * i + 1];
+      EXPECT_NEAR(PlaneUtils::width_between_planes(plane1, plane2),
+                  expected_widths[i],
+                  1e-4)
+          << "trial " << trial;
+      EXPECT_GE(std::abs(PlaneUtils::plane_dot_product(plane1, plane2)), 0.9)
+          << "trial " << trial;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -58,6 +58,8 @@ class TestPlane : public ::testing::Test {
     node->declare_parameter("use_point_to_plane", false);
     node->declare_parameter("plane_information", 0.01);
     node->declare_parameter("plane_dist_threshold", 0.35);
+    node->declare_parameter("plane_maha_dist_threshold", 3.37);
+    node->declare_parameter("constant_covariance", true);
     node->declare_parameter("plane_points_dist", 0.1);
     node->declare_parameter("min_plane_points", 100);
 
@@ -101,10 +103,10 @@ class TestPlane : public ::testing::Test {
         x_vert_planes, y_vert_planes, hort_planes);
   }
 
-  int testAssociatePlanes() {
+  int testAssociatePlanes(const double det_plane_dist = 9.9) {
     g2o::Plane3D det_plane;
     Eigen::Vector4d det_plane_coeffs;
-    det_plane_coeffs << 1, 0, 0, 9.9;
+    det_plane_coeffs << 1, 0, 0, det_plane_dist;
     det_plane = det_plane_coeffs;
 
     odom.setIdentity();
@@ -118,6 +120,7 @@ class TestPlane : public ::testing::Test {
     local_plane << 1, 0, 0, 10;
     g2o::Plane3D mapped_plane(local_plane);
     x_vert_plane.plane = mapped_plane;
+    x_vert_plane.covariance = Eigen::Matrix3d::Identity() * 0.01;
     x_vert_plane.keyframe_node = keyframe->node;
     x_vert_plane.cloud_seg_body = boost::make_shared<pcl::PointCloud<PointNormal>>();
     x_vert_plane.cloud_seg_map = boost::make_shared<pcl::PointCloud<PointNormal>>();
@@ -134,6 +137,57 @@ class TestPlane : public ::testing::Test {
                                       hort_planes);
     return matched_plane;
   }
+
+  std::vector<int> testAssociateWallSegments() {
+    odom.setIdentity();
+    s_graphs::KeyFrame::Ptr keyframe(
+        new s_graphs::KeyFrame(rclcpp::Clock().now(), odom, 0.0, cloud));
+    keyframe->node = graph_slam->add_se3_node(Eigen::Isometry3d::Identity());
+
+    // mapped wall at x = -10 spanning y in [-3, 3]
+    s_graphs::VerticalPlanes x_vert_plane;
+    x_vert_plane.id = 1;
+    x_vert_plane.plane = g2o::Plane3D(Eigen::Vector4d(1, 0, 0, 10));
+    x_vert_plane.keyframe_node = keyframe->node;
+    x_vert_plane.cloud_seg_map = boost::make_shared<pcl::PointCloud<PointNormal>>();
+    for (double y = -3.0; y <= 3.0; y += 0.05) {
+      for (double z : {0.0, 0.5}) {
+        PointNormal point;
+        point.x = -10;
+        point.y = y;
+        point.z = z;
+        x_vert_plane.cloud_seg_map->push_back(point);
+      }
+    }
+    x_vert_plane.keyframe_node_vec.push_back(keyframe->node);
+    x_vert_planes.insert({x_vert_plane.id, x_vert_plane});
+
+    // the same wall seen as two segments separated by a gap
+    std::vector<g2o::Plane3D> det_planes;
+    std::vector<pcl::PointCloud<PointNormal>::Ptr> cloud_segs;
+    for (const double y_start : {-3.0, 0.5}) {
+      det_planes.push_back(g2o::Plane3D(Eigen::Vector4d(1, 0, 0, 10)));
+      cloud_segs.push_back(boost::make_shared<pcl::PointCloud<PointNormal>>());
+      for (double y = y_start; y <= y_start + 2.5; y += 0.1) {
+        for (double z : {0.0, 0.5}) {
+          PointNormal point;
+          point.x = -10;
+          point.y = y;
+          point.z = z;
+          cloud_segs.back()->push_back(point);
+        }
+      }
+    }
+
+    return plane_mapper->associate_planes(
+        s_graphs::PlaneUtils::plane_class::X_VERT_PLANE,
+        keyframe,
+        det_planes,
+        cloud_segs,
+        x_vert_planes,
+        y_vert_planes,
+        hort_planes);
+  }
 };
 
 TEST_F(TestPlane, ConvertPlaneToMap) {
@@ -162,6 +216,51 @@ TEST_F(TestPlane, AssociatePlanes) {
   EXPECT_EQ(matched_plane, 1);
 }
 
+TEST_F(TestPlane, AssociatePlanesMarginals) {
+  node->set_parameter(rclcpp::Parameter("constant_covariance", false));
+  node->set_parameter(rclcpp::Parameter("plane_information", 100.0));
+  plane_mapper = std::make_shared<s_graphs::PlaneMapper>(node);
+
+  EXPECT_EQ(this->testAssociatePlanes(9.9), 1);
+  x_vert_planes.clear();
+  EXPECT_EQ(this->testAssociatePlanes(8.0), -1);
+}
+
+TEST_F(TestPlane, AssociateWallSegments) {
+  std::vector<int> matched_planes = this->testAssociateWallSegments();
+  ASSERT_EQ(matched_planes.size(), 2);
+  EXPECT_EQ(matched_planes[0], 1);
+  EXPECT_EQ(matched_planes[1], 1);
+}
+
+TEST_F(TestPlane, PlaneMapCovariance) {
+  const g2o::Plane3D plane_body(Eigen::Vector4d(1, 0, 0, 10));
+  Eigen::Isometry3d keyframe_pose = Eigen::Isometry3d::Identity();
+  Eigen::Matrix<double, 6, 6> pose_covariance = Eigen::Matrix<double, 6, 6>::Zero();
+  Eigen::Matrix3d plane_covariance = Eigen::Matrix3d::Zero();
+
+  Eigen::Matrix3d covariance = s_graphs::PlaneUtils::plane_map_covariance(
+      keyframe_pose, plane_body, pose_covariance, plane_covariance);
+  EXPECT_NEAR(covariance.norm(), 0, 1e-9);
+
+  // a translation of the keyframe along the normal only moves the plane distance
+  pose_covariance(0, 0) = 0.04;
+  covariance = s_graphs::PlaneUtils::plane_map_covariance(
+      keyframe_pose, plane_body, pose_covariance, plane_covariance);
+  EXPECT_NEAR(covariance(2, 2), 0.04, 1e-6);
+  EXPECT_NEAR(covariance.topLeftCorner<2, 2>().norm(), 0, 1e-6);
+
+  // the detection covariance adds up to the pose one and stays symmetric
+  plane_covariance = Eigen::Vector3d(0.01, 0.01, 0.1).asDiagonal();
+  keyframe_pose.translate(Eigen::Vector3d(2, 1, 0));
+  keyframe_pose.rotate(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()));
+  covariance = s_graphs::PlaneUtils::plane_map_covariance(
+      keyframe_pose, plane_body, pose_covariance, plane_covariance);
+  EXPECT_NEAR((covariance - covariance.transpose()).norm(), 0, 1e-9);
+  EXPECT_GT(covariance(2, 2), 0.1);
+  EXPECT_GT(covariance.ldlt().vectorD().minCoeff(), 0);
+}
+
 int main(int argc, char** argv) {
   rclcpp::init(argc, argv);
   testing::InitGoogleTest(&argc, argv);
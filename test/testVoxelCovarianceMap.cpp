@@ -0,0 +1,147 @@
+/*
+Copyright (c) 2023, University of Luxembourg
+All rights reserved.
+
+Redistributions and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 'AS IS'
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*/
+
+#include <gtest/gtest.h>
+#include <pcl/common/transforms.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Eigen/Dense>
+#include <s_graphs/common/voxel_covariance_map.hpp>
+#include <s_graphs/common/voxel_map_registration.hpp>
+
+using namespace s_graphs;
+typedef pcl::PointXYZI PointT;
+
+class TestVoxelCovarianceMap : public ::testing::Test {
+ public:
+  /**
+   * @brief Corner of a room, three orthogonal walls sampled on a regular grid
+   */
+  pcl::PointCloud<PointT>::Ptr make_corner_cloud() {
+    pcl::PointCloud<PointT>::Ptr cloud(new pcl::PointCloud<PointT>());
+    const double step = 0.05;
+    for (double u = 0; u < 4.0; u += step) {
+      for (double v = 0; v < 4.0; v += step) {
+        PointT x_wall, y_wall, floor;
+        x_wall.getVector3fMap() = Eigen::Vector3f(0, u, v);
+        y_wall.getVector3fMap() = Eigen::Vector3f(u, 0, v);
+        floor.getVector3fMap() = Eigen::Vector3f(u, v, 0);
+        cloud->push_back(x_wall);
+        cloud->push_back(y_wall);
+        cloud->push_back(floor);
+      }
+    }
+    return cloud;
+  }
+};
+
+TEST_F(TestVoxelCovarianceMap, InsertRemove) {
+  VoxelCovarianceMap map(1.0);
+  auto cloud = make_corner_cloud();
+
+  map.insert(0, *cloud);
+  ASSERT_TRUE(map.contains(0));
+  const size_t num_voxels = map.size();
+  ASSERT_GT(num_voxels, 0);
+
+  const Eigen::Vector3d query(0.0, 0.5, 0.5);
+  Eigen::Vector3d mean;
+  {
+    auto lock = map.lock_shared();
+    const VoxelCovarianceMap::Voxel* voxel = map.lookup(query);
+    ASSERT_NE(voxel, nullptr);
+    mean = voxel->mean;
+  }
+
+  // a second overlapping cloud, removing it restores the voxels of the first one
+  Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+  pose.translation() = Eigen::Vector3d(0.3, 0.2, 0.1);
+  map.insert(1, *cloud, pose);
+  EXPECT_TRUE(map.contains(1));
+  EXPECT_TRUE(map.remove(1));
+  EXPECT_FALSE(map.contains(1));
+  EXPECT_EQ(map.size(), num_voxels);
+  {
+    auto lock = map.lock_shared();
+    const VoxelCovarianceMap::Voxel* voxel = map.lookup(query);
+    ASSERT_NE(voxel, nullptr);
+    EXPECT_LT((voxel->mean - mean).norm(), 1e-9);
+  }
+
+  // inserting with the same id replaces the cloud
+  map.insert(0, *cloud);
+  EXPECT_EQ(map.size(), num_voxels);
+
+  EXPECT_TRUE(map.remove(0));
+  EXPECT_FALSE(map.remove(0));
+  EXPECT_FALSE(map.contains(0));
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_TRUE(map.means()->empty());
+}
+
+TEST_F(TestVoxelCovarianceMap, KnownOffsetAlignment) {
+  auto target = make_corner_cloud();
+
+  Eigen::Isometry3d offset = Eigen::Isometry3d::Identity();
+  offset.translation() = Eigen::Vector3d(0.2, -0.1, 0.05);
+  offset.linear() =
+      Eigen::AngleAxisd(0.03, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+
+  pcl::PointCloud<PointT>::Ptr source(new pcl::PointCloud<PointT>());
+  pcl::transformPointCloud(*target, *source, offset.inverse().matrix().cast<float>());
+
+  auto map = std::make_shared<VoxelCovarianceMap>(1.0);
+  map->insert(0, *target);
+
+  VoxelMapRegistration registration;
+  registration.setResolution(1.0);
+  registration.setNumThreads(1);
+  registration.setInputSource(source);
+  registration.setTargetMap(map, target);
+
+  pcl::PointCloud<PointT> aligned;
+  registration.align(aligned);
+  ASSERT_TRUE(registration.hasConverged());
+
+  const Eigen::Isometry3d result(
+      registration.getFinalTransformation().cast<double>());
+  EXPECT_LT((result.translation() - offset.translation()).norm(), 0.02);
+  EXPECT_LT(Eigen::AngleAxisd(result.linear().transpose() * offset.linear()).angle(),
+            0.005);
+
+  // the fitness is measured against the target points, not the voxel means
+  EXPECT_EQ(registration.getInputTarget(), target);
+  EXPECT_LT(registration.getFitnessScore(), 1e-3);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}